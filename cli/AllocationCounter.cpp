@@ -0,0 +1,34 @@
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "AllocationCounter.h"
+
+
+namespace
+{
+    std::atomic<size_t> numAllocations { 0 };
+
+    void* countedAlloc(std::size_t size)
+    {
+        numAllocations.fetch_add(1, std::memory_order_relaxed);
+
+        if (auto* p = std::malloc(size == 0 ? 1 : size))
+            return p;
+
+        throw std::bad_alloc();
+    }
+}
+
+size_t getNumAllocations()
+{
+    return numAllocations.load(std::memory_order_relaxed);
+}
+
+void* operator new(std::size_t size) { return countedAlloc(size); }
+void* operator new[](std::size_t size) { return countedAlloc(size); }
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
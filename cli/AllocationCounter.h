@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstddef>
+
+
+/*
+ * The number of calls to the global operator new so far, across all threads.
+ *
+ * Linking AllocationCounter.cpp into a program replaces the global operator new and
+ * delete with versions that count each allocation, which lets the benchmarks report
+ * how many allocations a piece of work made. It's only linked into elembench.
+ */
+size_t getNumAllocations();
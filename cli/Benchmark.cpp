@@ -1,4 +1,5 @@
 #include <chrono>
+#include <fstream>
 #include <thread>
 #include <vector>
 #include <iostream>
@@ -29,16 +30,27 @@ const auto* kConsoleShimScript = R"script(
 )script";
 
 template <typename FloatType>
-void runBenchmark(std::string const& name, std::string const& inputFileName, std::function<void(elem::Runtime<FloatType>&)>&& initCallback) {
+void runBenchmark(std::string const& name, std::string const& inputFileName, std::function<void(elem::Runtime<FloatType>&)>&& initCallback, std::string const& recordFileName) {
     elem::Runtime<FloatType> runtime(44100.0, 512);
 
     // Allow additional user initialization
     initCallback(runtime);
 
     auto ctx = choc::javascript::createQuickJSContext();
+    std::ofstream recording;
+
+    if (!recordFileName.empty()) {
+        recording.open(recordFileName);
+    }
 
     ctx.registerFunction("__postNativeMessage__", [&](choc::javascript::ArgumentList args) {
-        runtime.applyInstructions(elem::js::parseJSON(args[0]->toString()));
+        auto batch = args[0]->toString();
+
+        if (recording.is_open()) {
+            recording << batch << std::endl;
+        }
+
+        runtime.applyInstructions(batch);
         return choc::value::Value();
     });
 
@@ -111,5 +123,5 @@ void runBenchmark(std::string const& name, std::string const& inputFileName, std
     std::cout << "Done" << std::endl << std::endl;
 }
 
-template void runBenchmark<float>(std::string const& name, std::string const& inputFileName, std::function<void(elem::Runtime<float>&)>&& initCallback);
-template void runBenchmark<double>(std::string const& name, std::string const& inputFileName, std::function<void(elem::Runtime<double>&)>&& initCallback);
+template void runBenchmark<float>(std::string const& name, std::string const& inputFileName, std::function<void(elem::Runtime<float>&)>&& initCallback, std::string const& recordFileName);
+template void runBenchmark<double>(std::string const& name, std::string const& inputFileName, std::function<void(elem::Runtime<double>&)>&& initCallback, std::string const& recordFileName);
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <functional>
+#include <string>
 
 #include "Runtime.h"
 
@@ -9,6 +10,10 @@
  * float or double processing. Before the benchmark starts, your initCallback
  * will be called with a reference to the runtime for additional initialization,
  * like adding a custom node type or filling the shared resource map.
+ *
+ * If recordFileName is non-empty, each instruction batch that the script sends to the
+ * runtime is also written to that file, one JSON batch per line, for replaying later
+ * with `runReplayBenchmark`.
  */
 template <typename FloatType>
-void runBenchmark(std::string const& name, std::string const& inputFileName, std::function<void(elem::Runtime<FloatType>&)>&& initCallback);
+void runBenchmark(std::string const& name, std::string const& inputFileName, std::function<void(elem::Runtime<FloatType>&)>&& initCallback, std::string const& recordFileName = {});
@@ -1,20 +1,131 @@
 #include <iostream>
+#include <sstream>
 #include <string>
+#include <vector>
 
 #include "Benchmark.h"
+#include "BenchmarkSuite.h"
+#include "ReplayBenchmark.h"
 
 
+namespace
+{
+    // Parses the flags that follow `--suite`, returning false on anything unrecognized
+    bool parseSuiteOptions(int argc, char **argv, BenchmarkSuiteOptions& options)
+    {
+        for (int i = 2; i < argc; ++i) {
+            auto const arg = std::string(argv[i]);
+
+            if (i + 1 >= argc) {
+                std::cout << "Missing value for " << arg << std::endl;
+                return false;
+            }
+
+            auto const value = std::string(argv[++i]);
+
+            if (arg == "--json") {
+                options.jsonOutputPath = value;
+            } else if (arg == "--filter") {
+                options.filter = value;
+            } else if (arg == "--duration") {
+                options.duration = std::stod(value);
+            } else if (arg == "--block-sizes") {
+                std::stringstream ss(value);
+                std::string item;
+
+                options.blockSizes.clear();
+
+                while (std::getline(ss, item, ',')) {
+                    options.blockSizes.push_back(std::stoi(item));
+                }
+            } else {
+                std::cout << "Unknown argument: " << arg << std::endl;
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // Parses the arguments that follow `--replay`: an optional recording, then flags
+    bool parseReplayOptions(int argc, char **argv, ReplayBenchmarkOptions& options)
+    {
+        for (int i = 2; i < argc; ++i) {
+            auto const arg = std::string(argv[i]);
+
+            if (arg.rfind("--", 0) != 0) {
+                options.recordingFileName = arg;
+                continue;
+            }
+
+            if (i + 1 >= argc) {
+                std::cout << "Missing value for " << arg << std::endl;
+                return false;
+            }
+
+            auto const value = std::string(argv[++i]);
+
+            if (arg == "--json") {
+                options.jsonOutputPath = value;
+            } else if (arg == "--iterations") {
+                options.iterations = std::stoi(value);
+            } else if (arg == "--block-size") {
+                options.blockSize = std::stoi(value);
+            } else {
+                std::cout << "Unknown argument: " << arg << std::endl;
+                return false;
+            }
+        }
+
+        return true;
+    }
+}
+
 int main(int argc, char **argv)
 {
     // Read the input file from disk
     if (argc < 2) {
         std::cout << "Missing argument: what file do you want to run?" << std::endl;
+        std::cout << "Or run the builtin suite with: elembench --suite [--json path] [--filter name] [--duration seconds] [--block-sizes 64,512]" << std::endl;
+        std::cout << "Or benchmark graph updates with: elembench --replay [recording] [--json path] [--iterations n] [--block-size n]" << std::endl;
+        std::cout << "Or record a file's graph updates with: elembench --record recording file.js" << std::endl;
         return 1;
     }
 
     auto inputFileName = std::string(argv[1]);
+    auto recordFileName = std::string();
+
+    if (inputFileName == "--suite") {
+        BenchmarkSuiteOptions options;
+
+        if (!parseSuiteOptions(argc, argv, options)) {
+            return 1;
+        }
+
+        return runBenchmarkSuite(options);
+    }
+
+    if (inputFileName == "--replay") {
+        ReplayBenchmarkOptions options;
+
+        if (!parseReplayOptions(argc, argv, options)) {
+            return 1;
+        }
+
+        return runReplayBenchmark(options);
+    }
+
+    if (inputFileName == "--record") {
+        if (argc < 4) {
+            std::cout << "Usage: elembench --record recording file.js" << std::endl;
+            return 1;
+        }
+
+        recordFileName = std::string(argv[2]);
+        inputFileName = std::string(argv[3]);
+    }
 
-    runBenchmark<float>("Float", inputFileName, [](auto&) {});
+    runBenchmark<float>("Float", inputFileName, [](auto&) {}, recordFileName);
     runBenchmark<double>("Double", inputFileName, [](auto&) {});
 
     return 0;
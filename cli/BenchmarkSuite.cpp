@@ -0,0 +1,562 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include "BenchmarkSuite.h"
+#include "GraphBuilder.h"
+#include "Runtime.h"
+
+
+namespace
+{
+
+    //==============================================================================
+    // The kinds of input signal we feed to a node under test
+    enum class InputKind {
+        Audio,  // A full scale sine wave
+        Pulse,  // A 0/1 pulse train, for gates, triggers and resets
+        Ramp,   // A ramp from 0 to 1, for phase and table lookups
+        Value,  // A fixed value, written out as a regular (non-constant) buffer
+    };
+
+    struct InputSpec {
+        InputKind kind;
+        double value = 0;
+    };
+
+    InputSpec audio() { return { InputKind::Audio }; }
+    InputSpec pulse() { return { InputKind::Pulse }; }
+    InputSpec ramp() { return { InputKind::Ramp }; }
+    InputSpec value(double v) { return { InputKind::Value, v }; }
+
+    // How to set up a given node type for measurement in isolation. Node types without
+    // an entry here get two audio inputs and no props. Each variant is measured as its
+    // own case, named "node/<type>:<variant>", with its props on top of the others.
+    struct NodeSpec {
+        std::vector<InputSpec> inputs;
+        elem::js::Object props;
+        std::vector<std::pair<std::string, elem::js::Object>> variants = {};
+    };
+
+    constexpr auto kSampleResourceName = "elembench::sample";
+    constexpr auto kImpulseResourceName = "elembench::impulse";
+
+    std::vector<std::pair<std::string, elem::js::Object>> interpolationVariants()
+    {
+        using namespace elem::js;
+
+        return {
+            {"hermite", {{"interpolation", String("hermite")}}},
+            {"sinc", {{"interpolation", String("sinc")}}},
+        };
+    }
+
+    std::map<std::string, NodeSpec> const& getNodeSpecs()
+    {
+        using namespace elem::js;
+
+        static std::map<std::string, NodeSpec> const specs = {
+            {"in",        {{audio()}, {{"channel", Number(0)}}}},
+            {"sin",       {{audio()}, {}}},
+            {"cos",       {{audio()}, {}}},
+            {"tan",       {{audio()}, {}}},
+            {"tanh",      {{audio()}, {}}},
+            {"asinh",     {{audio()}, {}}},
+            {"ln",        {{value(0.5)}, {}}},
+            {"log",       {{value(0.5)}, {}}},
+            {"log2",      {{value(0.5)}, {}}},
+            {"ceil",      {{audio()}, {}}},
+            {"floor",     {{audio()}, {}}},
+            {"sqrt",      {{ramp()}, {}}},
+            {"exp",       {{audio()}, {}}},
+            {"abs",       {{audio()}, {}}},
+            {"pow",       {{ramp(), value(1.5)}, {}}},
+            {"root",      {{audio()}, {{"active", Boolean(true)}, {"channel", Number(0)}}}},
+            {"const",     {{}, {{"value", Number(0.5)}}}},
+            {"phasor",    {{value(440)}, {}}},
+            {"sr",        {{}, {}}},
+            {"seq",       {{pulse()}, {{"seq", Array({Number(1), Number(2), Number(3), Number(4)})}}}},
+            {"seq2",      {{pulse()}, {{"seq", Array({Number(1), Number(2), Number(3), Number(4)})}}}},
+            {"sparseq",   {{pulse()}, {{"seq", Array({
+                Object({{"value", Number(1)}, {"tickTime", Number(0)}}),
+                Object({{"value", Number(2)}, {"tickTime", Number(2)}}),
+                Object({{"value", Number(3)}, {"tickTime", Number(5)}}),
+            })}}}},
+            {"counter",   {{pulse()}, {}}},
+            {"accum",     {{audio(), pulse()}, {}}},
+            {"latch",     {{pulse(), audio()}, {}}},
+            {"maxhold",   {{audio(), pulse()}, {}}},
+            {"once",      {{pulse()}, {{"arm", Boolean(true)}}}},
+            {"rand",      {{}, {{"seed", Number(7)}}}},
+            {"delay",     {{value(1000.5), value(0.5), audio()}, {{"size", Number(44100)}}}},
+            {"sdelay",    {{audio()}, {{"size", Number(1000)}}}},
+            {"multitap",  {{audio(), value(1000.5), value(2205.25), value(3300.75)}, {{"size", Number(44100)}}}},
+            {"z",         {{audio()}, {}}},
+            {"pole",      {{value(0.99), audio()}, {}}},
+            {"env",       {{value(0.99), value(0.999), audio()}, {}}},
+            {"biquad",    {{value(0.2), value(0.4), value(0.2), value(-0.3), value(0.1), audio()}, {}}},
+            {"svf",       {{value(1000), value(0.707), audio()}, {{"mode", String("lowpass")}}}},
+            {"svfshelf",  {{value(1000), value(0.707), value(6), audio()}, {{"mode", String("lowshelf")}}}},
+            {"tapIn",     {{}, {{"name", String("elembench::tap")}}}},
+            {"tapOut",    {{audio()}, {{"name", String("elembench::tap")}}}},
+            {"sample",    {{pulse()}, {{"path", String(kSampleResourceName)}, {"mode", String("trigger")}}, interpolationVariants()}},
+            {"table",     {{ramp()}, {{"path", String(kSampleResourceName)}}, interpolationVariants()}},
+            {"convolve",  {{audio()}, {{"path", String(kImpulseResourceName)}, {"headSize", Number(256)}, {"tailSize", Number(4096)}}}},
+            {"meter",     {{audio()}, {}}},
+            {"scope",     {{audio()}, {}}},
+            {"snapshot",  {{pulse(), audio()}, {}}},
+            {"fft",       {{audio()}, {{"size", Number(2048)}, {"name", String("elembench::fft")}}}},
+            {"spectralgate",    {{audio()}, {{"size", Number(2048)}, {"hop", Number(512)}, {"window", String("hann")}, {"threshold", Number(-50)}, {"floor", Number(-80)}}}},
+            {"spectralfreeze",  {{audio()}, {{"size", Number(4096)}, {"hop", Number(1024)}, {"window", String("hann")}, {"frozen", Boolean(false)}}, {
+                {"frozen", {{"frozen", Boolean(true)}}},
+            }}},
+        };
+
+        return specs;
+    }
+
+    template <typename FloatType>
+    void fillInput(std::vector<FloatType>& buffer, InputSpec const& spec, double sampleRate, size_t offset)
+    {
+        for (size_t i = 0; i < buffer.size(); ++i) {
+            auto const t = (double) (offset + i) / sampleRate;
+
+            switch (spec.kind) {
+                case InputKind::Audio: buffer[i] = FloatType(std::sin(2.0 * M_PI * 220.0 * t)); break;
+                case InputKind::Pulse: buffer[i] = FloatType(std::fmod(t * 8.0, 1.0) < 0.5 ? 1 : 0); break;
+                case InputKind::Ramp:  buffer[i] = FloatType(std::fmod(t * 2.0, 1.0)); break;
+                case InputKind::Value: buffer[i] = FloatType(spec.value); break;
+            }
+        }
+    }
+
+    //==============================================================================
+    struct BenchmarkResult {
+        std::string name;
+        std::string precision;
+        int blockSize;
+        size_t numBlocks;
+        double meanUs;
+        double p50Us;
+        double p99Us;
+        double maxUs;
+        double nsPerSample;
+    };
+
+    // Runs `processBlock` for enough blocks to cover the requested duration, after a
+    // short warm up, and summarizes the per-block timings. `prepareBlock` is called
+    // before each block, outside of the timed region.
+    template <typename PrepareFn, typename ProcessFn>
+    BenchmarkResult measure(std::string const& name, std::string const& precision, int blockSize, BenchmarkSuiteOptions const& options, PrepareFn&& prepareBlock, ProcessFn&& processBlock)
+    {
+        auto const numBlocks = std::max<size_t>(64, static_cast<size_t>(options.duration * options.sampleRate / blockSize));
+
+        for (size_t i = 0; i < 16; ++i) {
+            prepareBlock();
+            processBlock();
+        }
+
+        std::vector<double> deltas;
+        deltas.reserve(numBlocks);
+
+        for (size_t i = 0; i < numBlocks; ++i) {
+            prepareBlock();
+
+            auto t0 = std::chrono::steady_clock::now();
+            processBlock();
+            auto t1 = std::chrono::steady_clock::now();
+
+            deltas.push_back(std::chrono::duration<double, std::micro>(t1 - t0).count());
+        }
+
+        auto const mean = std::accumulate(deltas.begin(), deltas.end(), 0.0) / (double) deltas.size();
+        std::sort(deltas.begin(), deltas.end());
+
+        auto percentile = [&](double p) {
+            return deltas[std::min(deltas.size() - 1, static_cast<size_t>(p * (double) deltas.size()))];
+        };
+
+        return {
+            name,
+            precision,
+            blockSize,
+            numBlocks,
+            mean,
+            percentile(0.5),
+            percentile(0.99),
+            deltas.back(),
+            mean * 1000.0 / (double) blockSize,
+        };
+    }
+
+    //==============================================================================
+    // Constructs a single node outside of any runtime and times its `process` method
+    // directly, feeding it prerendered input buffers
+    template <typename FloatType>
+    BenchmarkResult runNodeCase(
+        std::string const& type,
+        typename elem::Runtime<FloatType>::NodeFactoryFn const& factory,
+        NodeSpec const& spec,
+        std::string const& precision,
+        int blockSize,
+        BenchmarkSuiteOptions const& options)
+    {
+        elem::SharedResourceMap<FloatType> resources;
+        std::vector<FloatType> sampleData(static_cast<size_t>(options.sampleRate));
+
+        for (size_t i = 0; i < sampleData.size(); ++i) {
+            sampleData[i] = FloatType(std::sin(2.0 * M_PI * 440.0 * (double) i / options.sampleRate));
+        }
+
+        resources.insert(kSampleResourceName, elem::SharedResource<FloatType>::adopt(std::move(sampleData)));
+
+        // A second of exponentially decaying noise, about the size and shape of a room
+        // reverb's impulse response
+        std::vector<FloatType> impulseData(static_cast<size_t>(options.sampleRate));
+        uint32_t seed = 1;
+
+        for (size_t i = 0; i < impulseData.size(); ++i) {
+            seed = seed * 1664525u + 1013904223u;
+
+            auto const noise = (double) seed / 4294967296.0 * 2.0 - 1.0;
+            impulseData[i] = FloatType(noise * std::exp(-6.9 * (double) i / options.sampleRate));
+        }
+
+        resources.insert(kImpulseResourceName, elem::SharedResource<FloatType>::adopt(std::move(impulseData)));
+
+        auto node = factory(1, options.sampleRate, blockSize);
+
+        for (auto const& [key, val] : spec.props) {
+            node->setProperty(key, val, resources);
+        }
+
+        std::vector<std::vector<FloatType>> inputs;
+        std::vector<FloatType const*> inputPointers;
+        std::vector<FloatType> output(blockSize);
+
+        for (size_t i = 0; i < spec.inputs.size(); ++i) {
+            inputs.emplace_back(blockSize);
+        }
+
+        for (auto& buffer : inputs) {
+            inputPointers.push_back(buffer.data());
+        }
+
+        size_t sampleTime = 0;
+
+        auto prepare = [&]() {
+            // Roll the inputs forward each block so that stateful nodes see a changing signal
+            for (size_t i = 0; i < inputs.size(); ++i) {
+                fillInput(inputs[i], spec.inputs[i], options.sampleRate, sampleTime);
+            }
+        };
+
+        return measure(type, precision, blockSize, options, prepare, [&]() {
+            node->process(elem::BlockContext<FloatType> {
+                inputPointers.data(),
+                inputPointers.size(),
+                output.data(),
+                static_cast<size_t>(blockSize),
+                nullptr,
+            });
+
+            sampleTime += blockSize;
+        });
+    }
+
+    //==============================================================================
+    struct GraphCase {
+        std::string name;
+        std::function<void(GraphBuilder&)> build;
+    };
+
+    std::vector<GraphCase> getGraphCases()
+    {
+        return {
+            // A single add node summing many inputs
+            {"graph/fanin-add-256", [](GraphBuilder& g) {
+                std::vector<int32_t> inputs;
+
+                for (int i = 0; i < 256; ++i) {
+                    inputs.push_back(g.node("phasor", {}, {g.constant(100.0 + i)}));
+                }
+
+                g.render(g.node("add", {}, inputs));
+            }},
+
+            // A long serial chain of nodes, each depending on the last
+            {"graph/chain-256", [](GraphBuilder& g) {
+                auto x = g.node("phasor", {}, {g.constant(110.0)});
+                auto const gain = g.constant(0.99);
+                auto const bias = g.constant(0.01);
+
+                for (int i = 0; i < 256; ++i) {
+                    switch (i % 3) {
+                        case 0: x = g.node("mul", {}, {x, gain}); break;
+                        case 1: x = g.node("add", {}, {x, bias}); break;
+                        case 2: x = g.node("tanh", {}, {x}); break;
+                    }
+                }
+
+                g.render(x);
+            }},
+
+            // A bank of enveloped sine voices, each gated by its own pulse train
+            {"graph/poly-1000", [](GraphBuilder& g) {
+                auto const twoPi = g.constant(2.0 * M_PI);
+                auto const half = g.constant(0.5);
+                auto const attack = g.constant(0.999);
+                auto const release = g.constant(0.9999);
+
+                std::vector<int32_t> voices;
+
+                for (int i = 0; i < 1000; ++i) {
+                    auto const gate = g.node("le", {}, {g.node("phasor", {}, {g.constant(0.5 + 0.01 * i)}), half});
+                    auto const env = g.node("env", {}, {attack, release, gate});
+                    auto const osc = g.node("sin", {}, {g.node("mul", {}, {twoPi, g.node("phasor", {}, {g.constant(110.0 + i)})})});
+
+                    voices.push_back(g.node("mul", {}, {osc, env}));
+                }
+
+                g.render(g.sum(voices));
+            }},
+
+            // Subtractive synth voices, each an oscillator through a state variable filter
+            // and a biquad, half of them gated off. Identical voices render as batches.
+            {"graph/synth-voices-128", [](GraphBuilder& g) {
+                using namespace elem::js;
+
+                auto const half = g.constant(0.5);
+                auto const q = g.constant(2.0);
+                auto const attack = g.constant(0.999);
+                auto const release = g.constant(0.9999);
+
+                std::vector<int32_t> voices;
+
+                for (int i = 0; i < 128; ++i) {
+                    auto const gate = g.constant(i % 2 == 0 ? 1.0 : 0.0);
+                    auto const osc = g.node("sub", {}, {g.node("phasor", {}, {g.constant(55.0 + 3.0 * i)}), half});
+                    auto const in = g.node("mul", {}, {gate, osc});
+                    auto const cutoff = g.node("add", {}, {g.constant(400.0), g.node("mul", {}, {g.node("phasor", {}, {g.constant(0.25)}), g.constant(1200.0)})});
+                    auto const svf = g.node("svf", {{"mode", String("lowpass")}}, {cutoff, q, in});
+                    auto const biquad = g.node("biquad", {}, {g.constant(0.2), g.constant(0.4), g.constant(0.2), g.constant(-0.5), g.constant(0.3), svf});
+                    auto const env = g.node("env", {}, {attack, release, in});
+
+                    voices.push_back(g.node("mul", {}, {biquad, env}));
+                }
+
+                g.render(g.sum(voices));
+            }},
+
+            // Many feedback delay loops through tapIn/tapOut, each filtered in the loop
+            {"graph/feedback-delays-32", [](GraphBuilder& g) {
+                using namespace elem::js;
+
+                auto const feedback = g.constant(0.6);
+                auto const cutoff = g.constant(2000.0);
+                auto const q = g.constant(0.707);
+                auto const noiseGain = g.constant(0.1);
+
+                std::vector<int32_t> loops;
+
+                for (int i = 0; i < 32; ++i) {
+                    auto const name = "elembench::fb" + std::to_string(i);
+                    auto const noise = g.node("mul", {}, {g.node("rand", {{"seed", Number(i + 1)}}), noiseGain});
+                    auto const tap = g.node("tapIn", {{"name", String(name)}});
+                    auto const in = g.node("add", {}, {noise, g.node("mul", {}, {tap, feedback})});
+                    auto const del = g.node("delay", {{"size", Number(4800)}}, {g.constant(1000.0 + 37.0 * i), g.constant(0), in});
+                    auto const filtered = g.node("svf", {{"mode", String("lowpass")}}, {cutoff, q, del});
+
+                    loops.push_back(g.node("tapOut", {{"name", String(name)}}, {filtered}));
+                }
+
+                g.render(g.sum(loops));
+            }},
+
+            // A chorus of modulated reads from the same input, as one delay node per voice
+            // and then as a single multitap node
+            {"graph/chorus-delays-16", [](GraphBuilder& g) {
+                using namespace elem::js;
+
+                auto const in = g.node("in", {{"channel", Number(0)}});
+                std::vector<int32_t> voices;
+
+                for (int i = 0; i < 16; ++i) {
+                    auto const lfo = g.node("mul", {}, {g.node("phasor", {}, {g.constant(0.3 + 0.05 * i)}), g.constant(40.0)});
+                    auto const len = g.node("add", {}, {lfo, g.constant(400.0 + 23.0 * i)});
+
+                    voices.push_back(g.node("delay", {{"size", Number(2048)}}, {len, g.constant(0), in}));
+                }
+
+                g.render(g.sum(voices));
+            }},
+
+            {"graph/chorus-multitap-16", [](GraphBuilder& g) {
+                using namespace elem::js;
+
+                auto const in = g.node("in", {{"channel", Number(0)}});
+                std::vector<int32_t> children = {in};
+
+                for (int i = 0; i < 16; ++i) {
+                    auto const lfo = g.node("mul", {}, {g.node("phasor", {}, {g.constant(0.3 + 0.05 * i)}), g.constant(40.0)});
+                    children.push_back(g.node("add", {}, {lfo, g.constant(400.0 + 23.0 * i)}));
+                }
+
+                g.render(g.node("multitap", {{"size", Number(2048)}}, children));
+            }},
+
+            // A feedback loop with a latency of 32 samples, which renders in sub-blocks
+            {"graph/feedback-loop-32", [](GraphBuilder& g) {
+                using namespace elem::js;
+
+                auto const in = g.node("in", {{"channel", Number(0)}});
+                auto const fb = g.node("mul", {}, {g.node("tapIn", {{"name", String("loop")}}), g.constant(0.5)});
+                auto const filtered = g.node("pole", {}, {g.constant(0.9), g.node("add", {}, {in, fb})});
+
+                g.render(g.node("tapOut", {{"name", String("loop")}, {"blockSize", Number(32)}}, {filtered}));
+            }},
+        };
+    }
+
+    template <typename FloatType>
+    BenchmarkResult runGraphCase(GraphCase const& graphCase, std::string const& precision, int blockSize, BenchmarkSuiteOptions const& options)
+    {
+        elem::Runtime<FloatType> runtime(options.sampleRate, blockSize);
+        GraphBuilder builder;
+
+        graphCase.build(builder);
+        runtime.applyInstructions(builder.getBatch());
+
+        std::vector<std::vector<FloatType>> outputs(2, std::vector<FloatType>(blockSize));
+        std::vector<FloatType*> outputPointers { outputs[0].data(), outputs[1].data() };
+        return measure(graphCase.name, precision, blockSize, options, []() {}, [&]() {
+            runtime.process(nullptr, 0, outputPointers.data(), outputPointers.size(), static_cast<size_t>(blockSize));
+        });
+    }
+
+    //==============================================================================
+    bool matchesFilter(std::string const& name, BenchmarkSuiteOptions const& options)
+    {
+        return options.filter.empty() || name.find(options.filter) != std::string::npos;
+    }
+
+    void printResult(BenchmarkResult const& r)
+    {
+        std::printf("%-28s %-7s %6d %10.3f %10.3f %10.3f %10.3f %10.3f\n",
+            r.name.c_str(), r.precision.c_str(), r.blockSize, r.meanUs, r.p50Us, r.p99Us, r.maxUs, r.nsPerSample);
+        std::fflush(stdout);
+    }
+
+    template <typename FloatType>
+    void runAll(std::string const& precision, BenchmarkSuiteOptions const& options, std::vector<BenchmarkResult>& results)
+    {
+        std::vector<std::pair<std::string, typename elem::Runtime<FloatType>::NodeFactoryFn>> factories;
+
+        elem::DefaultNodeTypes<FloatType>::forEach([&](std::string const& type, auto&& fn) {
+            factories.push_back({ type, fn });
+        });
+
+        NodeSpec const defaultSpec { {audio(), audio()}, {} };
+
+        for (auto const& [type, factory] : factories) {
+            auto const name = "node/" + type;
+
+            if (!matchesFilter(name, options))
+                continue;
+
+            auto const& specs = getNodeSpecs();
+            auto const it = specs.find(type);
+            auto const& spec = (it != specs.end()) ? it->second : defaultSpec;
+
+            for (auto const bs : options.blockSizes) {
+                results.push_back(runNodeCase<FloatType>(type, factory, spec, precision, bs, options));
+                results.back().name = name;
+                printResult(results.back());
+            }
+
+            for (auto const& [variant, props] : spec.variants) {
+                NodeSpec variantSpec { spec.inputs, spec.props };
+
+                for (auto const& [key, val] : props) {
+                    variantSpec.props.insert_or_assign(key, val);
+                }
+
+                for (auto const bs : options.blockSizes) {
+                    results.push_back(runNodeCase<FloatType>(type, factory, variantSpec, precision, bs, options));
+                    results.back().name = name + ":" + variant;
+                    printResult(results.back());
+                }
+            }
+        }
+
+        for (auto const& graphCase : getGraphCases()) {
+            if (!matchesFilter(graphCase.name, options))
+                continue;
+
+            for (auto const bs : options.blockSizes) {
+                results.push_back(runGraphCase<FloatType>(graphCase, precision, bs, options));
+                printResult(results.back());
+            }
+        }
+    }
+
+    elem::js::Value toJSON(BenchmarkSuiteOptions const& options, std::vector<BenchmarkResult> const& results)
+    {
+        using namespace elem::js;
+
+        Array entries;
+
+        for (auto const& r : results) {
+            entries.push_back(Object({
+                {"name", String(r.name)},
+                {"precision", String(r.precision)},
+                {"blockSize", Number(r.blockSize)},
+                {"numBlocks", Number((double) r.numBlocks)},
+                {"meanUs", Number(r.meanUs)},
+                {"p50Us", Number(r.p50Us)},
+                {"p99Us", Number(r.p99Us)},
+                {"maxUs", Number(r.maxUs)},
+                {"nsPerSample", Number(r.nsPerSample)},
+            }));
+        }
+
+        return Object({
+            {"sampleRate", Number(options.sampleRate)},
+            {"duration", Number(options.duration)},
+            {"results", entries},
+        });
+    }
+
+} // namespace
+
+int runBenchmarkSuite(BenchmarkSuiteOptions const& options)
+{
+    std::vector<BenchmarkResult> results;
+
+    std::printf("%-28s %-7s %6s %10s %10s %10s %10s %10s\n",
+        "case", "type", "block", "mean(us)", "p50(us)", "p99(us)", "max(us)", "ns/sample");
+
+    runAll<float>("float", options, results);
+    runAll<double>("double", options, results);
+
+    if (!options.jsonOutputPath.empty()) {
+        std::ofstream file(options.jsonOutputPath);
+
+        if (!file) {
+            std::cout << "Failed to open " << options.jsonOutputPath << " for writing" << std::endl;
+            return 1;
+        }
+
+        file << elem::js::serialize(toJSON(options, results)) << std::endl;
+    }
+
+    return 0;
+}
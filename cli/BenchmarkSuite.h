@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+
+/*
+ * Options for the benchmark suite, which measures each of the builtin node types in
+ * isolation along with a handful of representative graph shapes, without needing a
+ * JavaScript bundle.
+ *
+ * Every case is run at each block size, in both float and double precision. The
+ * results for each run report the distribution of per-block processing times along
+ * with the average cost per sample. Cases are included if their name contains the
+ * filter string, and an empty filter runs everything.
+ */
+struct BenchmarkSuiteOptions
+{
+    double sampleRate = 44100.0;
+    std::vector<int> blockSizes = {32, 64, 128, 256, 512, 1024, 2048};
+
+    // The length of audio to render for each run, in seconds
+    double duration = 1.0;
+
+    std::string filter;
+
+    // If non-empty, the results are also written to this path as JSON
+    std::string jsonOutputPath;
+};
+
+/*
+ * Runs the benchmark suite, printing a results table to stdout. Returns non-zero if
+ * the JSON output could not be written.
+ */
+int runBenchmarkSuite(BenchmarkSuiteOptions const& options);
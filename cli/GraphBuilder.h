@@ -0,0 +1,121 @@
+#pragma once
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Value.h"
+
+
+/*
+ * A small helper for assembling instruction batches by hand, for the benchmarks that
+ * drive a Runtime without a JavaScript frontend.
+ *
+ * Each call appends the corresponding instructions to the current batch, which can be
+ * handed to `Runtime::applyInstructions` directly or serialized to JSON first. Node ids
+ * keep counting up across batches, so that a builder can describe a sequence of
+ * updates to the same runtime.
+ */
+class GraphBuilder
+{
+public:
+    int32_t node(std::string const& type, elem::js::Object const& props = {}, std::vector<int32_t> const& children = {})
+    {
+        using namespace elem::js;
+
+        auto const id = nextId++;
+
+        batch.push_back(Array({Number(0), Number(id), String(type)}));
+
+        for (auto const& [key, val] : props) {
+            setProperty(id, key, val);
+        }
+
+        for (auto const child : children) {
+            batch.push_back(Array({Number(2), Number(id), Number(child)}));
+        }
+
+        return id;
+    }
+
+    int32_t constant(double v)
+    {
+        return node("const", {{"value", elem::js::Number(v)}});
+    }
+
+    // Sums the given nodes with a tree of add nodes of at most `fanIn` children each
+    int32_t sum(std::vector<int32_t> nodes, size_t fanIn = 16)
+    {
+        while (nodes.size() > 1) {
+            std::vector<int32_t> next;
+
+            for (size_t i = 0; i < nodes.size(); i += fanIn) {
+                auto const end = std::min(nodes.size(), i + fanIn);
+                next.push_back(node("add", {}, std::vector<int32_t>(nodes.begin() + i, nodes.begin() + end)));
+            }
+
+            nodes = std::move(next);
+        }
+
+        return nodes[0];
+    }
+
+    void setProperty(int32_t id, std::string const& key, elem::js::Value const& val)
+    {
+        using namespace elem::js;
+        batch.push_back(Array({Number(3), Number(id), String(key), val}));
+    }
+
+    void deleteNode(int32_t id)
+    {
+        using namespace elem::js;
+        batch.push_back(Array({Number(1), Number(id)}));
+    }
+
+    void activateRoots(std::vector<int32_t> const& roots)
+    {
+        using namespace elem::js;
+
+        Array ids;
+
+        for (auto const id : roots) {
+            ids.push_back(Number(id));
+        }
+
+        batch.push_back(Array({Number(4), ids}));
+    }
+
+    void commit()
+    {
+        batch.push_back(elem::js::Array({elem::js::Number(5)}));
+    }
+
+    // Wraps the given node in a new root on channel 0, returning the root's id
+    int32_t root(int32_t n)
+    {
+        return node("root", {{"channel", elem::js::Number(0)}}, {n});
+    }
+
+    // Renders the given node as the only active root, and commits
+    void render(int32_t n)
+    {
+        activateRoots({root(n)});
+        commit();
+    }
+
+    // Hands back the instructions added since the last call, and starts a new batch
+    elem::js::Array takeBatch()
+    {
+        return std::exchange(batch, {});
+    }
+
+    elem::js::Array const& getBatch() const { return batch; }
+
+    // The id that the next node will be given
+    int32_t getNextId() const { return nextId; }
+
+private:
+    int32_t nextId = 1;
+    elem::js::Array batch;
+};
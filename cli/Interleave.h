@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #include <emmintrin.h>
+  #define ELEM_INTERLEAVE_SSE 1
+#elif defined(__ARM_NEON) || defined(__aarch64__)
+  #include <arm_neon.h>
+  #define ELEM_INTERLEAVE_NEON 1
+#endif
+
+
+/*
+ * Conversions between the interleaved buffers of an audio device and the separate
+ * channel buffers that the runtime works with.
+ *
+ * Stereo, by far the most common case for a device, has a SIMD path that moves four
+ * frames at a time. Other channel counts use a plain strided loop per channel.
+ */
+inline void interleave(float const* const* channels, float* out, size_t numChannels, size_t numFrames)
+{
+    size_t j = 0;
+
+    if (numChannels == 2) {
+        auto const* l = channels[0];
+        auto const* r = channels[1];
+
+#if defined(ELEM_INTERLEAVE_SSE)
+        for (; j + 4 <= numFrames; j += 4) {
+            auto const a = _mm_loadu_ps(l + j);
+            auto const b = _mm_loadu_ps(r + j);
+
+            _mm_storeu_ps(out + 2 * j, _mm_unpacklo_ps(a, b));
+            _mm_storeu_ps(out + 2 * j + 4, _mm_unpackhi_ps(a, b));
+        }
+#elif defined(ELEM_INTERLEAVE_NEON)
+        for (; j + 4 <= numFrames; j += 4) {
+            float32x4x2_t lr { { vld1q_f32(l + j), vld1q_f32(r + j) } };
+            vst2q_f32(out + 2 * j, lr);
+        }
+#endif
+
+        for (; j < numFrames; ++j) {
+            out[2 * j] = l[j];
+            out[2 * j + 1] = r[j];
+        }
+
+        return;
+    }
+
+    for (size_t i = 0; i < numChannels; ++i) {
+        auto const* channel = channels[i];
+
+        for (j = 0; j < numFrames; ++j) {
+            out[i + numChannels * j] = channel[j];
+        }
+    }
+}
+
+inline void deinterleave(float const* in, float* const* channels, size_t numChannels, size_t numFrames)
+{
+    size_t j = 0;
+
+    if (numChannels == 2) {
+        auto* l = channels[0];
+        auto* r = channels[1];
+
+#if defined(ELEM_INTERLEAVE_SSE)
+        for (; j + 4 <= numFrames; j += 4) {
+            auto const a = _mm_loadu_ps(in + 2 * j);
+            auto const b = _mm_loadu_ps(in + 2 * j + 4);
+
+            _mm_storeu_ps(l + j, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+            _mm_storeu_ps(r + j, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+        }
+#elif defined(ELEM_INTERLEAVE_NEON)
+        for (; j + 4 <= numFrames; j += 4) {
+            auto const lr = vld2q_f32(in + 2 * j);
+
+            vst1q_f32(l + j, lr.val[0]);
+            vst1q_f32(r + j, lr.val[1]);
+        }
+#endif
+
+        for (; j < numFrames; ++j) {
+            l[j] = in[2 * j];
+            r[j] = in[2 * j + 1];
+        }
+
+        return;
+    }
+
+    for (size_t i = 0; i < numChannels; ++i) {
+        auto* channel = channels[i];
+
+        for (j = 0; j < numFrames; ++j) {
+            channel[j] = in[i + numChannels * j];
+        }
+    }
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+
+/*
+ * Measures how close each audio callback comes to its deadline.
+ *
+ * The audio thread calls `recordCallback` with the start and end time of each callback,
+ * which it compares against the buffer period: the time the device takes to play the
+ * frames that the callback rendered. That ratio is the callback's load, which goes into
+ * a histogram of 10% wide buckets, where anything over 100% is an overrun. A callback
+ * that starts more than one and a half periods after the previous one is counted as
+ * late, which usually means the device ran dry in between.
+ *
+ * Recording is lock free and allocation free. Any other thread may call `takeSummary`
+ * to collect and reset the counts gathered since its last call.
+ */
+class LoadMonitor
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Ten buckets up to 100% load, one for overruns up to 110%, and the rest
+    static constexpr size_t kNumBuckets = 12;
+
+    struct Summary
+    {
+        uint64_t numCallbacks = 0;
+        uint64_t numOverruns = 0;
+        uint64_t numLateCallbacks = 0;
+
+        // Loads as a fraction of the buffer period
+        double meanLoad = 0;
+        double maxLoad = 0;
+
+        std::array<uint64_t, kNumBuckets> histogram {};
+
+        // Folds another summary into this one
+        void merge(Summary const& other)
+        {
+            auto const total = numCallbacks + other.numCallbacks;
+
+            if (total > 0) {
+                meanLoad = (meanLoad * (double) numCallbacks + other.meanLoad * (double) other.numCallbacks) / (double) total;
+            }
+
+            numCallbacks = total;
+            numOverruns += other.numOverruns;
+            numLateCallbacks += other.numLateCallbacks;
+            maxLoad = std::max(maxLoad, other.maxLoad);
+
+            for (size_t i = 0; i < kNumBuckets; ++i) {
+                histogram[i] += other.histogram[i];
+            }
+        }
+    };
+
+    // Called on the audio thread at the end of each callback
+    void recordCallback(Clock::time_point start, Clock::time_point end, size_t numFrames, double sampleRate)
+    {
+        if (numFrames == 0)
+            return;
+
+        auto const periodNanos = (double) numFrames / sampleRate * 1e9;
+        auto const elapsedNanos = (double) std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+        auto const load = elapsedNanos / periodNanos;
+        auto const loadPpm = static_cast<uint64_t>(load * 1e6);
+
+        auto const bucket = std::min(kNumBuckets - 1, static_cast<size_t>(load * 10.0));
+        histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+
+        numCallbacks.fetch_add(1, std::memory_order_relaxed);
+        totalLoadPpm.fetch_add(loadPpm, std::memory_order_relaxed);
+
+        if (load > 1.0) {
+            numOverruns.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        if (lastStart != Clock::time_point() && (double) std::chrono::duration_cast<std::chrono::nanoseconds>(start - lastStart).count() > 1.5 * periodNanos) {
+            numLateCallbacks.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        lastStart = start;
+
+        auto peak = maxLoadPpm.load(std::memory_order_relaxed);
+
+        while (loadPpm > peak && !maxLoadPpm.compare_exchange_weak(peak, loadPpm, std::memory_order_relaxed)) {}
+    }
+
+    // Called from any thread but the audio thread
+    Summary takeSummary()
+    {
+        Summary s;
+
+        s.numCallbacks = numCallbacks.exchange(0, std::memory_order_relaxed);
+        s.numOverruns = numOverruns.exchange(0, std::memory_order_relaxed);
+        s.numLateCallbacks = numLateCallbacks.exchange(0, std::memory_order_relaxed);
+        s.maxLoad = (double) maxLoadPpm.exchange(0, std::memory_order_relaxed) / 1e6;
+
+        auto const totalLoad = (double) totalLoadPpm.exchange(0, std::memory_order_relaxed) / 1e6;
+        s.meanLoad = s.numCallbacks > 0 ? totalLoad / (double) s.numCallbacks : 0.0;
+
+        for (size_t i = 0; i < kNumBuckets; ++i) {
+            s.histogram[i] = histogram[i].exchange(0, std::memory_order_relaxed);
+        }
+
+        return s;
+    }
+
+    static void print(char const* title, Summary const& s)
+    {
+        std::printf("[%s] %llu callbacks, mean load %.1f%%, max load %.1f%%, %llu overruns, %llu late callbacks\n",
+            title,
+            (unsigned long long) s.numCallbacks,
+            s.meanLoad * 100.0,
+            s.maxLoad * 100.0,
+            (unsigned long long) s.numOverruns,
+            (unsigned long long) s.numLateCallbacks);
+
+        for (size_t i = 0; i < kNumBuckets; ++i) {
+            if (s.histogram[i] == 0)
+                continue;
+
+            if (i + 1 < kNumBuckets) {
+                std::printf("    %3zu-%3zu%%: %llu\n", i * 10, (i + 1) * 10, (unsigned long long) s.histogram[i]);
+            } else {
+                std::printf("       >%zu%%: %llu\n", i * 10, (unsigned long long) s.histogram[i]);
+            }
+        }
+
+        std::fflush(stdout);
+    }
+
+private:
+    std::array<std::atomic<uint64_t>, kNumBuckets> histogram {};
+    std::atomic<uint64_t> numCallbacks = 0;
+    std::atomic<uint64_t> numOverruns = 0;
+    std::atomic<uint64_t> numLateCallbacks = 0;
+    std::atomic<uint64_t> totalLoadPpm = 0;
+    std::atomic<uint64_t> maxLoadPpm = 0;
+
+    // Only touched by the audio thread
+    Clock::time_point lastStart;
+};
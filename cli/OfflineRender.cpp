@@ -0,0 +1,440 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <choc_Files.h>
+#include <choc_javascript.h>
+#include <choc_javascript_QuickJS.h>
+
+#include <Runtime.h>
+
+#include "OfflineRender.h"
+
+
+namespace
+{
+
+    const auto* kConsoleShimScript = R"script(
+(function() {
+  if (typeof globalThis.console === 'undefined') {
+    globalThis.console = {
+      log(...args) {
+        return __log__('[log]', ...args);
+      },
+      warn(...args) {
+        return __log__('[warn]', ...args);
+      },
+      error(...args) {
+        return __log__('[error]', ...args);
+      },
+    };
+  }
+})();
+)script";
+
+    //==============================================================================
+    // Writes chunks of interleaved samples to a file on a background thread, so that
+    // rendering never waits on the disk unless it gets a whole ring of chunks ahead.
+    class AsyncFileWriter
+    {
+    public:
+        AsyncFileWriter(std::FILE* f, size_t samplesPerChunk, size_t numChunks = 4)
+            : file(f), chunkSize(samplesPerChunk)
+        {
+            storage.resize(numChunks * chunkSize);
+
+            for (size_t i = 0; i < numChunks; ++i) {
+                freeChunks.push_back(storage.data() + i * chunkSize);
+            }
+
+            thread = std::thread([this]() { run(); });
+        }
+
+        ~AsyncFileWriter()
+        {
+            finish();
+        }
+
+        size_t getChunkSize() const { return chunkSize; }
+
+        // Waits for a chunk which isn't queued for writing, and hands it to the caller to fill
+        float* acquire()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [this]() { return !freeChunks.empty(); });
+
+            auto* chunk = freeChunks.front();
+            freeChunks.pop_front();
+
+            return chunk;
+        }
+
+        // Queues the first `numSamples` samples of an acquired chunk for writing
+        void submit(float* chunk, size_t numSamples)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                pendingChunks.push_back({chunk, numSamples});
+            }
+
+            cv.notify_all();
+        }
+
+        // Writes anything still queued and stops the background thread. Returns false if
+        // any write failed.
+        bool finish()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                finished = true;
+            }
+
+            cv.notify_all();
+
+            if (thread.joinable()) {
+                thread.join();
+            }
+
+            return !failed;
+        }
+
+    private:
+        void run()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+
+            while (true) {
+                cv.wait(lock, [this]() { return finished || !pendingChunks.empty(); });
+
+                if (pendingChunks.empty())
+                    return;
+
+                auto const next = pendingChunks.front();
+                pendingChunks.pop_front();
+
+                lock.unlock();
+
+                if (std::fwrite(next.data, sizeof(float), next.numSamples, file) != next.numSamples) {
+                    failed = true;
+                }
+
+                lock.lock();
+
+                freeChunks.push_back(next.data);
+                cv.notify_all();
+            }
+        }
+
+        struct PendingChunk {
+            float* data;
+            size_t numSamples;
+        };
+
+        std::FILE* file;
+        size_t chunkSize;
+
+        std::vector<float> storage;
+        std::deque<float*> freeChunks;
+        std::deque<PendingChunk> pendingChunks;
+
+        std::thread thread;
+        std::mutex mutex;
+        std::condition_variable cv;
+        bool finished = false;
+        std::atomic<bool> failed = false;
+    };
+
+    //==============================================================================
+    // The most audio a WAV file can describe, with the rest of the RIFF chunk on top
+    constexpr uint32_t kMaxWavDataBytes = std::numeric_limits<uint32_t>::max() - 36;
+
+    // The header for a WAV file of 32-bit float samples. The sizes are written as zero
+    // up front and filled in once we know them.
+    void writeWavHeader(std::FILE* f, int numChannels, int sampleRate, uint32_t numDataBytes)
+    {
+        auto u32 = [f](uint32_t v) {
+            uint8_t b[4] = { uint8_t(v), uint8_t(v >> 8), uint8_t(v >> 16), uint8_t(v >> 24) };
+            std::fwrite(b, 1, 4, f);
+        };
+
+        auto u16 = [f](uint16_t v) {
+            uint8_t b[2] = { uint8_t(v), uint8_t(v >> 8) };
+            std::fwrite(b, 1, 2, f);
+        };
+
+        std::fwrite("RIFF", 1, 4, f);
+        u32(36 + numDataBytes);
+        std::fwrite("WAVE", 1, 4, f);
+
+        std::fwrite("fmt ", 1, 4, f);
+        u32(16);
+        u16(3); // WAVE_FORMAT_IEEE_FLOAT
+        u16(static_cast<uint16_t>(numChannels));
+        u32(static_cast<uint32_t>(sampleRate));
+        u32(static_cast<uint32_t>(sampleRate * numChannels * 4));
+        u16(static_cast<uint16_t>(numChannels * 4));
+        u16(32);
+
+        std::fwrite("data", 1, 4, f);
+        u32(numDataBytes);
+    }
+
+    //==============================================================================
+    struct OfflineRenderOptions {
+        double duration = 10.0;
+        double sampleRate = 44100.0;
+        int blockSize = 512;
+        int numChannels = 2;
+        bool wav = true;
+        std::string outputFileName;
+        int numJobs = 1;
+        std::vector<std::string> inputFileNames;
+    };
+
+    bool parseOptions(int argc, char** argv, OfflineRenderOptions& options)
+    {
+        for (int i = 1; i < argc; ++i) {
+            auto const arg = std::string(argv[i]);
+
+            if (arg.rfind("--", 0) != 0) {
+                options.inputFileNames.push_back(arg);
+                continue;
+            }
+
+            if (i + 1 >= argc) {
+                std::cout << "Missing value for " << arg << std::endl;
+                return false;
+            }
+
+            auto const value = std::string(argv[++i]);
+
+            if (arg == "--duration") {
+                options.duration = std::stod(value);
+            } else if (arg == "--sample-rate") {
+                options.sampleRate = std::stod(value);
+            } else if (arg == "--block-size") {
+                options.blockSize = std::stoi(value);
+            } else if (arg == "--channels") {
+                options.numChannels = std::stoi(value);
+            } else if (arg == "--format") {
+                if (value != "wav" && value != "raw") {
+                    std::cout << "Unknown format: " << value << std::endl;
+                    return false;
+                }
+
+                options.wav = (value == "wav");
+            } else if (arg == "--output") {
+                options.outputFileName = value;
+            } else if (arg == "--jobs") {
+                options.numJobs = std::max(1, std::stoi(value));
+            } else {
+                std::cout << "Unknown argument: " << arg << std::endl;
+                return false;
+            }
+        }
+
+        if (options.inputFileNames.empty()) {
+            std::cout << "Missing argument: what file do you want to render?" << std::endl;
+            return false;
+        }
+
+        if (!options.outputFileName.empty() && options.inputFileNames.size() > 1) {
+            std::cout << "--output can only be used when rendering a single file" << std::endl;
+            return false;
+        }
+
+        if (options.blockSize <= 0 || options.numChannels <= 0 || options.sampleRate <= 0) {
+            std::cout << "Invalid render settings" << std::endl;
+            return false;
+        }
+
+        // The sizes in a WAV header are 32 bits, which caps the data at just under 4GiB
+        auto const numDataBytes = std::floor(options.duration * options.sampleRate) * options.numChannels * 4.0;
+
+        if (options.wav && numDataBytes > double(kMaxWavDataBytes)) {
+            std::cout << "The render is too long for a WAV file, which holds at most "
+                << (double(kMaxWavDataBytes) / (options.sampleRate * options.numChannels * 4.0))
+                << "s at these settings; use --format raw instead" << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+
+    std::string getOutputFileName(std::string const& inputFileName, OfflineRenderOptions const& options)
+    {
+        if (!options.outputFileName.empty())
+            return options.outputFileName;
+
+        auto const slash = inputFileName.find_last_of("/\\");
+        auto const dot = inputFileName.find_last_of('.');
+        auto const hasExtension = dot != std::string::npos && (slash == std::string::npos || dot > slash);
+
+        return (hasExtension ? inputFileName.substr(0, dot) : inputFileName) + (options.wav ? ".wav" : ".raw");
+    }
+
+    //==============================================================================
+    // Renders a single file, returning false on failure
+    bool renderFile(std::string const& inputFileName, OfflineRenderOptions const& options, std::function<void(elem::Runtime<float>&)> const& initCallback)
+    {
+        auto const outputFileName = getOutputFileName(inputFileName, options);
+        auto const blockSize = static_cast<size_t>(options.blockSize);
+        auto const numChannels = static_cast<size_t>(options.numChannels);
+        auto const totalFrames = static_cast<int64_t>(options.duration * options.sampleRate);
+
+        elem::Runtime<float> runtime(options.sampleRate, options.blockSize);
+
+        auto ctx = choc::javascript::createQuickJSContext();
+
+        ctx.registerFunction("__postNativeMessage__", [&](choc::javascript::ArgumentList args) {
+            runtime.applyInstructions(args[0]->toString());
+            return choc::value::Value();
+        });
+
+        ctx.registerFunction("__log__", [](choc::javascript::ArgumentList args) {
+            for (size_t i = 0; i < args.numArgs; ++i) {
+                std::cout << choc::json::toString(*args[i], true) << std::endl;
+            }
+
+            return choc::value::Value();
+        });
+
+        initCallback(runtime);
+
+        // Shim the js environment for console logging
+        (void) ctx.evaluate(kConsoleShimScript);
+
+        auto contents = choc::file::loadFileAsString(inputFileName);
+        (void) ctx.evaluate(contents);
+
+        std::FILE* file = std::fopen(outputFileName.c_str(), "wb");
+
+        if (file == nullptr) {
+            std::cout << "Failed to open " << outputFileName << " for writing" << std::endl;
+            return false;
+        }
+
+        if (options.wav) {
+            writeWavHeader(file, options.numChannels, static_cast<int>(options.sampleRate), 0);
+        }
+
+        auto t0 = std::chrono::steady_clock::now();
+
+        // Each chunk holds a whole number of blocks, so blocks are interleaved straight
+        // into the chunk that the writer thread will send to disk
+        AsyncFileWriter writer(file, 64 * blockSize * numChannels);
+
+        std::vector<float> scratch(numChannels * blockSize);
+        std::vector<float*> outputPointers;
+
+        for (size_t i = 0; i < numChannels; ++i) {
+            outputPointers.push_back(scratch.data() + i * blockSize);
+        }
+
+        int64_t sampleTime = 0;
+        float* chunk = writer.acquire();
+        size_t chunkOffset = 0;
+
+        while (sampleTime < totalFrames) {
+            auto const numFrames = static_cast<size_t>(std::min<int64_t>(static_cast<int64_t>(blockSize), totalFrames - sampleTime));
+
+            runtime.process(nullptr, 0, outputPointers.data(), numChannels, numFrames, static_cast<void*>(&sampleTime));
+
+            for (size_t i = 0; i < numChannels; ++i) {
+                auto const* channel = outputPointers[i];
+                auto* out = chunk + chunkOffset + i;
+
+                for (size_t j = 0; j < numFrames; ++j) {
+                    out[j * numChannels] = channel[j];
+                }
+            }
+
+            chunkOffset += numFrames * numChannels;
+            sampleTime += static_cast<int64_t>(numFrames);
+
+            if (chunkOffset + blockSize * numChannels > writer.getChunkSize() || sampleTime >= totalFrames) {
+                writer.submit(chunk, chunkOffset);
+                chunkOffset = 0;
+
+                if (sampleTime < totalFrames) {
+                    chunk = writer.acquire();
+                }
+            }
+        }
+
+        auto const ok = writer.finish();
+
+        if (options.wav) {
+            std::fseek(file, 0, SEEK_SET);
+            writeWavHeader(file, options.numChannels, static_cast<int>(options.sampleRate), static_cast<uint32_t>(totalFrames * options.numChannels * 4));
+        }
+
+        std::fclose(file);
+
+        auto const seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+        if (!ok) {
+            std::cout << "Failed writing to " << outputFileName << std::endl;
+            return false;
+        }
+
+        std::cout << "Rendered " << inputFileName << " to " << outputFileName << ": "
+            << options.duration << "s of audio in " << seconds << "s ("
+            << (options.duration / std::max(seconds, 1e-9)) << "x realtime)" << std::endl;
+
+        return true;
+    }
+
+} // namespace
+
+int OfflineRenderMain(int argc, char** argv, std::function<void(elem::Runtime<float>&)> initCallback)
+{
+    OfflineRenderOptions options;
+
+    if (!parseOptions(argc, argv, options)) {
+        return 1;
+    }
+
+    // Each job takes the next file that nobody has started on yet
+    std::atomic<size_t> nextFile = 0;
+    std::atomic<bool> failed = false;
+
+    auto work = [&]() {
+        for (auto i = nextFile++; i < options.inputFileNames.size(); i = nextFile++) {
+            try {
+                if (!renderFile(options.inputFileNames[i], options, initCallback)) {
+                    failed = true;
+                }
+            } catch (std::exception const& e) {
+                std::cout << "Failed to render " << options.inputFileNames[i] << ": " << e.what() << std::endl;
+                failed = true;
+            }
+        }
+    };
+
+    auto const numJobs = std::min(static_cast<size_t>(options.numJobs), options.inputFileNames.size());
+    std::vector<std::thread> jobs;
+
+    for (size_t i = 1; i < numJobs; ++i) {
+        jobs.emplace_back(work);
+    }
+
+    work();
+
+    for (auto& job : jobs) {
+        job.join();
+    }
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <functional>
+
+#include "Runtime.h"
+
+/*
+ * Your main can call this function to render one or more JavaScript files offline,
+ * as fast as the machine allows, rather than to an audio device. Before rendering
+ * starts, your initCallback will be called with a reference to each file's runtime
+ * for your own initialization needs, as with RealtimeMain.
+ *
+ * The arguments are the options followed by the files to render:
+ *
+ *   --duration <seconds>       The length of audio to render, 10 seconds by default
+ *   --sample-rate <hz>         44100 by default
+ *   --block-size <frames>      512 by default
+ *   --channels <n>             2 by default
+ *   --format <wav|raw>         32-bit float WAV, or headerless interleaved 32-bit float.
+ *                              A WAV file holds at most 4GiB of audio, so longer
+ *                              renders must be raw
+ *   --output <path>            Where to write the output, for a single input file. By
+ *                              default each input's output goes next to it, with its
+ *                              extension replaced by the format's
+ *   --jobs <n>                 The number of files to render at once, each on its own
+ *                              thread, 1 by default
+ *
+ * Each file gets its own runtime and JavaScript context. As in the wasm host, the
+ * runtime's userData is a pointer to the int64_t sample time of the current block.
+ * With more than one job, initCallback may be called from several threads at once.
+ */
+extern int OfflineRenderMain(int argc, char **argv, std::function<void(elem::Runtime<float> &)> initCallback);
@@ -0,0 +1,174 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "SingleWriterSingleReaderQueue.h"
+
+
+// The SingleWriterSingleReaderQueue as it was before moving to acquire/release
+// ordering with padded indices, kept here as a baseline to measure against. Every
+// operation loads both indices with sequentially consistent ordering, and both
+// indices share a cache line. The one change is that push always leaves a slot
+// empty: the original would fill the last slot, after which a full queue read as
+// an empty one.
+template <typename T>
+class LegacyQueue
+{
+public:
+    LegacyQueue(size_t capacity = 32)
+        : maxElements(capacity), indexMask(capacity - 1)
+    {
+        queue.resize(capacity);
+    }
+
+    bool push (T && el)
+    {
+        auto const w = writePos.load();
+        auto const r = readPos.load();
+
+        if (numFreeSlots(r, w) > 1)
+        {
+            queue[w] = std::move(el);
+            writePos.store((w + 1u) & indexMask);
+            return true;
+        }
+
+        return false;
+    }
+
+    bool pop (T& el)
+    {
+        auto const r = readPos.load();
+        auto const w = writePos.load();
+
+        if (numFullSlots(r, w) > 0)
+        {
+            el = std::move(queue[r]);
+            readPos.store((r + 1u) & indexMask);
+            return true;
+        }
+
+        return false;
+    }
+
+    size_t size()
+    {
+        return numFullSlots(readPos.load(), writePos.load());
+    }
+
+private:
+    size_t numFullSlots(size_t const r, size_t const w)
+    {
+        if (w > r)
+            return w - r;
+
+        return (maxElements - (r - w)) & indexMask;
+    }
+
+    size_t numFreeSlots(size_t const r, size_t const w)
+    {
+        if (r > w)
+            return r - w;
+
+        return maxElements - (w - r);
+    }
+
+    std::atomic<size_t> maxElements = 0;
+    std::atomic<size_t> readPos = 0;
+    std::atomic<size_t> writePos = 0;
+    std::vector<T> queue;
+
+    size_t indexMask = 0;
+};
+
+//==============================================================================
+// Streams kNumItems values from a writer thread to a reader thread, and reports the
+// throughput. The reader repeatedly drains the queue with the given function, and
+// checks that every item arrives in order.
+constexpr uint64_t kNumItems = 10'000'000;
+
+template <typename QueueType, typename DrainFn>
+void runBenchmark(std::string const& name, size_t capacity, DrainFn&& drain)
+{
+    QueueType queue(capacity);
+
+    auto t0 = std::chrono::steady_clock::now();
+
+    std::thread writer([&]() {
+        for (uint64_t i = 0; i < kNumItems; ++i) {
+            auto v = i;
+
+            while (!queue.push(std::move(v))) {
+                v = i;
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    uint64_t expected = 0;
+    bool ordered = true;
+
+    while (expected < kNumItems) {
+        auto const before = expected;
+
+        drain(queue, [&](uint64_t v) {
+            ordered = ordered && (v == expected);
+            expected++;
+        });
+
+        if (expected == before) {
+            std::this_thread::yield();
+        }
+    }
+
+    writer.join();
+
+    auto t1 = std::chrono::steady_clock::now();
+    auto const seconds = std::chrono::duration<double>(t1 - t0).count();
+
+    std::cout << name << " (capacity " << capacity << "): "
+        << (kNumItems / seconds / 1e6) << "M items/s"
+        << (ordered ? "" : " [OUT OF ORDER]") << std::endl;
+}
+
+int main()
+{
+    auto popEach = [](auto& queue, auto&& onItem) {
+        uint64_t v;
+
+        while (queue.pop(v)) {
+            onItem(v);
+        }
+    };
+
+    // The pattern the nodes used to follow: check the size, then pop
+    auto sizeThenPop = [](auto& queue, auto&& onItem) {
+        uint64_t v;
+
+        while (queue.size() > 0) {
+            if (queue.pop(v)) {
+                onItem(v);
+            }
+        }
+    };
+
+    auto consumeAll = [](auto& queue, auto&& onItem) {
+        queue.consume([&](uint64_t& v) {
+            onItem(v);
+        });
+    };
+
+    for (size_t capacity : {32, 1024}) {
+        runBenchmark<LegacyQueue<uint64_t>>("Legacy, size() + pop()", capacity, sizeThenPop);
+        runBenchmark<LegacyQueue<uint64_t>>("Legacy, pop()", capacity, popEach);
+        runBenchmark<elem::SingleWriterSingleReaderQueue<uint64_t>>("Current, pop()", capacity, popEach);
+        runBenchmark<elem::SingleWriterSingleReaderQueue<uint64_t>>("Current, consume()", capacity, consumeAll);
+        std::cout << std::endl;
+    }
+
+    return 0;
+}
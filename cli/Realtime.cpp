@@ -1,5 +1,11 @@
-#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
 #include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include <choc_Files.h>
 #include <choc_javascript.h>
@@ -7,6 +13,8 @@
 
 #include <Runtime.h>
 
+#include "Interleave.h"
+#include "LoadMonitor.h"
 #include "Realtime.h"
 
 #define MINIAUDIO_IMPLEMENTATION
@@ -32,75 +40,183 @@ const auto* kConsoleShimScript = R"script(
 )script";
 
 // A simple struct to proxy between the audio device and the Elementary engine
+//
+// All of the buffers here are allocated up front for the largest callback the device
+// can make, so the audio callback itself never allocates.
 struct DeviceProxy {
-    DeviceProxy(double sampleRate, size_t blockSize)
-        : scratchData(2 * blockSize), runtime(sampleRate, blockSize)
-    {}
+    DeviceProxy(double sampleRate, size_t maxFrames, size_t numInputChannels, size_t numOutputChannels)
+        : inputData(numInputChannels * maxFrames)
+        , outputData(numOutputChannels * maxFrames)
+        , runtime(sampleRate, static_cast<int>(maxFrames))
+        , sampleRate(sampleRate)
+        , maxFrames(maxFrames)
+    {
+        for (size_t i = 0; i < numInputChannels; ++i)
+            inputPointers.push_back(inputData.data() + i * maxFrames);
 
-    void process(float* outputData, size_t numChannels, size_t numFrames)
+        for (size_t i = 0; i < numOutputChannels; ++i)
+            outputPointers.push_back(outputData.data() + i * maxFrames);
+    }
+
+    void process(float* output, float const* input, size_t numFrames)
     {
-        // We might hit this the first time around, but after that should be fine
-        if (scratchData.size() < (numChannels * numFrames))
-            scratchData.resize(numChannels * numFrames);
-
-        auto* deinterleaved = scratchData.data();
-        std::array<float*, 2> ptrs {deinterleaved, deinterleaved + numFrames};
-
-        // Elementary is happy to accept audio buffer data as an input to be
-        // processed dynamically, such as applying effects, but here for simplicity
-        // we're just going to produce output
-        runtime.process(
-            nullptr,
-            0,
-            ptrs.data(),
-            numChannels,
-            numFrames,
-            nullptr
-        );
-
-        for (size_t i = 0; i < numChannels; ++i)
-        {
-            for (size_t j = 0; j < numFrames; ++j)
-            {
-                outputData[i + numChannels * j] = deinterleaved[i * numFrames + j];
-            }
+        auto const start = LoadMonitor::Clock::now();
+
+        auto const numIns = (input != nullptr) ? inputPointers.size() : 0;
+        auto const numOuts = outputPointers.size();
+
+        // The device shouldn't hand us more frames than it told us to expect, but if it
+        // does we take them in pieces rather than growing our buffers here
+        for (size_t offset = 0; offset < numFrames; offset += maxFrames) {
+            auto const n = std::min(maxFrames, numFrames - offset);
+
+            if (numIns > 0)
+                deinterleave(input + offset * numIns, inputPointers.data(), numIns, n);
+
+            runtime.process(
+                const_cast<const float**>(inputPointers.data()),
+                numIns,
+                outputPointers.data(),
+                numOuts,
+                n,
+                nullptr
+            );
+
+            interleave(outputPointers.data(), output + offset * numOuts, numOuts, n);
         }
+
+        loadMonitor.recordCallback(start, LoadMonitor::Clock::now(), numFrames, sampleRate);
     }
 
-    std::vector<float> scratchData;
+    std::vector<float> inputData;
+    std::vector<float> outputData;
+    std::vector<float*> inputPointers;
+    std::vector<float*> outputPointers;
+
     elem::Runtime<float> runtime;
+    LoadMonitor loadMonitor;
+    double sampleRate;
+    size_t maxFrames;
+};
+
+// Prints a summary of the callback load every `intervalSeconds` until stopped, keeping
+// a running total across all of the intervals
+class LoadReporter
+{
+public:
+    LoadReporter(LoadMonitor& m, double intervalSeconds)
+        : monitor(m)
+    {
+        if (intervalSeconds > 0) {
+            thread = std::thread([this, intervalSeconds]() {
+                std::unique_lock<std::mutex> lock(mutex);
+                auto const interval = std::chrono::duration<double>(intervalSeconds);
+
+                while (!cv.wait_for(lock, interval, [this]() { return stopped; })) {
+                    auto const s = monitor.takeSummary();
+
+                    LoadMonitor::print("load", s);
+                    total.merge(s);
+                }
+            });
+        }
+    }
+
+    // Stops the periodic reports and prints the summary for the whole run
+    void finish()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopped = true;
+        }
+
+        cv.notify_all();
+
+        if (thread.joinable()) {
+            thread.join();
+        }
+
+        total.merge(monitor.takeSummary());
+        LoadMonitor::print("load total", total);
+    }
+
+private:
+    LoadMonitor& monitor;
+    LoadMonitor::Summary total;
+
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool stopped = false;
 };
 
 // Our main audio processing callback from the miniaudio device
-void audioCallback(ma_device* pDevice, void* pOutput, const void* /* pInput */, ma_uint32 frameCount)
+void audioCallback(ma_device* pDevice, void* pOutput, const void* pInput, ma_uint32 frameCount)
 {
     auto* proxy = static_cast<DeviceProxy*>(pDevice->pUserData);
 
-    auto numChannels = static_cast<size_t>(pDevice->playback.channels);
-    auto numFrames = static_cast<size_t>(frameCount);
-
-    proxy->process(static_cast<float*>(pOutput), numChannels, numFrames);
+    proxy->process(static_cast<float*>(pOutput), static_cast<float const*>(pInput), static_cast<size_t>(frameCount));
 }
 
 int RealtimeMain(int argc, char** argv, std::function<void(elem::Runtime<float>&)> initCallback) {
+    // Options come before the file to run:
+    //
+    //   --duplex               Also open the default capture device, whose channels feed
+    //                          the graph's `in` nodes
+    //   --block-size <frames>  The period size to ask the device for
+    //   --load-report <secs>   Print a summary of the callback load at this interval
+    //   --snapshot <file>      Start from a graph snapshot instead of running a JavaScript
+    //                          file, see Runtime::exportSnapshot
+    //   --write-snapshot <file>
+    //                          After running the JavaScript file, write a snapshot of the
+    //                          graph it rendered, for starting from with --snapshot later
+    double loadReportInterval = 0;
+    std::string snapshotPath;
+    std::string writeSnapshotPath;
+    bool duplex = false;
+    ma_uint32 periodSize = 0;
+    int argIndex = 1;
+
+    while (argIndex < argc) {
+        auto const arg = std::string(argv[argIndex]);
+
+        if (arg == "--duplex") {
+            duplex = true;
+            argIndex += 1;
+        } else if (arg == "--block-size" && argIndex + 1 < argc) {
+            periodSize = static_cast<ma_uint32>(std::stoi(argv[argIndex + 1]));
+            argIndex += 2;
+        } else if (arg == "--load-report" && argIndex + 1 < argc) {
+            loadReportInterval = std::stod(argv[argIndex + 1]);
+            argIndex += 2;
+        } else if (arg == "--snapshot" && argIndex + 1 < argc) {
+            snapshotPath = argv[argIndex + 1];
+            argIndex += 2;
+        } else if (arg == "--write-snapshot" && argIndex + 1 < argc) {
+            writeSnapshotPath = argv[argIndex + 1];
+            argIndex += 2;
+        } else {
+            break;
+        }
+    }
+
     // First, initialize our audio device
     ma_result result;
 
     ma_device_config deviceConfig;
     ma_device device;
 
-    // XXX: I don't see a way to ask miniaudio for a specific block size. Let's just allocate
-    // here for 1024 and resize in the first callback if we need to.
-    std::unique_ptr<DeviceProxy> proxy = std::make_unique<DeviceProxy>(44100.0, 1024);
-
-    deviceConfig = ma_device_config_init(ma_device_type_playback);
+    deviceConfig = ma_device_config_init(duplex ? ma_device_type_duplex : ma_device_type_playback);
 
     deviceConfig.playback.pDeviceID = nullptr;
     deviceConfig.playback.format    = ma_format_f32;
     deviceConfig.playback.channels  = 2;
+    deviceConfig.capture.pDeviceID  = nullptr;
+    deviceConfig.capture.format     = ma_format_f32;
+    deviceConfig.capture.channels   = 2;
     deviceConfig.sampleRate         = 44100;
+    deviceConfig.periodSizeInFrames = periodSize;
     deviceConfig.dataCallback       = audioCallback;
-    deviceConfig.pUserData          = proxy.get();
 
     result = ma_device_init(nullptr, &deviceConfig, &device);
 
@@ -109,12 +225,36 @@ int RealtimeMain(int argc, char** argv, std::function<void(elem::Runtime<float>&
         return 1;
     }
 
+    // With fixed size callbacks, which is miniaudio's default, the device never asks for
+    // more than its intermediary buffer holds, so that's what we size our buffers for.
+    // In duplex mode the capture side's buffer always matches the playback side's.
+    size_t maxFrames = device.playback.intermediaryBufferCap;
+
+    if (maxFrames == 0)
+        maxFrames = std::max(device.playback.internalPeriodSizeInFrames, 1024u);
+
+    auto proxy = std::make_unique<DeviceProxy>(
+        static_cast<double>(device.sampleRate),
+        maxFrames,
+        duplex ? static_cast<size_t>(device.capture.channels) : 0,
+        static_cast<size_t>(device.playback.channels));
+
+    // The device doesn't call back until it's started, below
+    device.pUserData = proxy.get();
+
     // Next, we'll initialize our JavaScript engine and establish a messaging channel by
     // defining a global callback function
     auto ctx = choc::javascript::createQuickJSContext();
 
+    // Batches are applied on the runtime's compiler thread, so that the script carries on
+    // while the graph builds, and any errors are reported from there
     ctx.registerFunction("__postNativeMessage__", [&](choc::javascript::ArgumentList args) {
-        proxy->runtime.applyInstructions(elem::js::parseJSON(args[0]->toString()));
+        proxy->runtime.applyInstructionsAsync(args[0]->toString(), [](auto const& result) {
+            if (!result.succeeded()) {
+                std::cout << "Failed to apply instructions: " << result.error << std::endl;
+            }
+        });
+
         return choc::value::Value();
     });
 
@@ -128,24 +268,46 @@ int RealtimeMain(int argc, char** argv, std::function<void(elem::Runtime<float>&
 
     initCallback(proxy->runtime);
 
-    // Shim the js environment for console logging
-    (void) ctx.evaluate(kConsoleShimScript);
+    // A snapshot holds the graph ready to apply, so there's no script to run
+    if (!snapshotPath.empty()) {
+        try {
+            auto const snapshot = choc::file::loadFileAsString(snapshotPath);
+            proxy->runtime.applyInstructions(reinterpret_cast<uint8_t const*>(snapshot.data()), snapshot.size());
+        } catch (std::exception const& e) {
+            std::cout << "Failed to load the snapshot: " << e.what() << std::endl;
+            return 1;
+        }
+    } else {
+        // Shim the js environment for console logging
+        (void) ctx.evaluate(kConsoleShimScript);
+
+        // Then we'll try to read the user's JavaScript file from disk
+        if (argIndex >= argc) {
+            std::cout << "Missing argument: what file do you want to run?" << std::endl;
+            return 1;
+        }
 
-    // Then we'll try to read the user's JavaScript file from disk
-    if (argc < 2) {
-        std::cout << "Missing argument: what file do you want to run?" << std::endl;
-        return 1;
-    }
+        auto contents = choc::file::loadFileAsString(argv[argIndex]);
+        auto rv = ctx.evaluate(contents);
+
+        if (!writeSnapshotPath.empty()) {
+            proxy->runtime.waitForCompilation();
 
-    auto contents = choc::file::loadFileAsString(argv[1]);
-    auto rv = ctx.evaluate(contents);
+            auto const snapshot = proxy->runtime.exportSnapshot();
+            choc::file::replaceFileWithContent(writeSnapshotPath, std::string_view(reinterpret_cast<char const*>(snapshot.data()), snapshot.size()));
+        }
+    }
 
     // Finally, run the audio device
     ma_device_start(&device);
 
+    LoadReporter loadReporter(proxy->loadMonitor, loadReportInterval);
+
     std::cout << "Press Enter to exit..." << std::endl;
     getchar();
 
     ma_device_uninit(&device);
+    loadReporter.finish();
+
     return 0;
 }
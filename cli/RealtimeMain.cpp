@@ -1,7 +1,15 @@
+#include <string>
+
+#include "OfflineRender.h"
 #include "Realtime.h"
 
 
 int main(int argc, char **argv)
 {
+    // `elemcli --offline [options] file.js...` renders to disk instead of the audio device
+    if (argc > 1 && std::string(argv[1]) == "--offline") {
+        return OfflineRenderMain(argc - 1, argv + 1, [](auto&) {});
+    }
+
     return RealtimeMain(argc, argv, [](auto&) {});
 }
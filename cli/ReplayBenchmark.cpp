@@ -0,0 +1,313 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "AllocationCounter.h"
+#include "GraphBuilder.h"
+#include "ReplayBenchmark.h"
+#include "Runtime.h"
+
+
+namespace
+{
+
+    //==============================================================================
+    // A scenario is a list of batches, run in order against a fresh runtime. Only the
+    // batches marked as measured count towards the results, which lets a scenario set
+    // up a graph before measuring updates against it.
+    struct Batch {
+        std::string json;
+        bool measured = true;
+    };
+
+    struct Scenario {
+        std::string name;
+        std::vector<Batch> batches;
+    };
+
+    std::string serializeBatch(GraphBuilder& builder)
+    {
+        return elem::js::serialize(builder.takeBatch());
+    }
+
+    // Adds `numVoices` sine voices, each of four nodes, summed by a tree of add nodes.
+    // Returns the sum, and fills in the id of each voice's frequency constant.
+    int32_t addVoices(GraphBuilder& g, size_t numVoices, std::vector<int32_t>& frequencyIds)
+    {
+        std::vector<int32_t> voices;
+
+        for (size_t i = 0; i < numVoices; ++i) {
+            auto const freq = g.constant(110.0 + (double) i);
+            auto const osc = g.node("sin", {}, {g.node("phasor", {}, {freq})});
+
+            frequencyIds.push_back(freq);
+            voices.push_back(g.node("mul", {}, {osc, g.constant(0.001)}));
+        }
+
+        return g.sum(voices);
+    }
+
+    std::vector<Scenario> getSyntheticScenarios()
+    {
+        std::vector<Scenario> scenarios;
+
+        // Creating a graph of roughly 10k nodes from nothing, in a single batch
+        {
+            GraphBuilder g;
+            std::vector<int32_t> freqs;
+
+            g.render(addVoices(g, 2400, freqs));
+            scenarios.push_back({"create-10k", {{serializeBatch(g), true}}});
+        }
+
+        // Batches of property changes against that graph, which leave its structure as is
+        {
+            GraphBuilder g;
+            std::vector<int32_t> freqs;
+            Scenario s { "prop-updates", {} };
+
+            g.render(addVoices(g, 2400, freqs));
+            s.batches.push_back({serializeBatch(g), false});
+
+            for (int i = 0; i < 100; ++i) {
+                for (size_t j = 0; j < 1000; ++j) {
+                    auto const id = freqs[(i * 1000 + j) % freqs.size()];
+                    g.setProperty(id, "value", elem::js::Number(220.0 + i + (double) j));
+                }
+
+                g.commit();
+                s.batches.push_back({serializeBatch(g), true});
+            }
+
+            scenarios.push_back(std::move(s));
+        }
+
+        // Replacing the whole graph in each batch: a new graph of roughly 1k nodes under
+        // a new root. Like the frontend's own garbage collection, each batch also deletes
+        // the graph from several batches back, by which point its root has faded out.
+        {
+            constexpr size_t kDeleteLag = 8;
+
+            GraphBuilder g;
+            std::vector<int32_t> freqs;
+            std::deque<std::pair<int32_t, int32_t>> generations;
+            Scenario s { "root-swap", {} };
+
+            for (int i = 0; i < 100 + (int) kDeleteLag; ++i) {
+                auto const first = g.getNextId();
+                g.render(addVoices(g, 240, freqs));
+                generations.push_back({first, g.getNextId()});
+
+                if (generations.size() > kDeleteLag) {
+                    for (auto id = generations.front().first; id < generations.front().second; ++id) {
+                        g.deleteNode(id);
+                    }
+
+                    generations.pop_front();
+                    g.commit();
+                }
+
+                s.batches.push_back({serializeBatch(g), i >= (int) kDeleteLag});
+            }
+
+            scenarios.push_back(std::move(s));
+        }
+
+        return scenarios;
+    }
+
+    bool loadRecording(std::string const& fileName, Scenario& scenario)
+    {
+        std::ifstream file(fileName);
+
+        if (!file) {
+            return false;
+        }
+
+        scenario.name = "replay:" + fileName;
+
+        for (std::string line; std::getline(file, line);) {
+            if (!line.empty()) {
+                scenario.batches.push_back({line, true});
+            }
+        }
+
+        return true;
+    }
+
+    //==============================================================================
+    struct BatchResult {
+        elem::Runtime<float>::BatchStats stats;
+        double totalUs;
+        size_t numAllocations;
+    };
+
+    struct ScenarioResult {
+        std::string name;
+        std::vector<BatchResult> batches;
+    };
+
+    ScenarioResult runScenario(Scenario const& scenario, ReplayBenchmarkOptions const& options)
+    {
+        ScenarioResult result { scenario.name, {} };
+
+        std::vector<std::vector<float>> outputs(2, std::vector<float>(options.blockSize));
+        std::vector<float*> outputPointers { outputs[0].data(), outputs[1].data() };
+
+        for (int i = 0; i < std::max(1, options.iterations); ++i) {
+            elem::Runtime<float> runtime(options.sampleRate, options.blockSize);
+
+            for (auto const& batch : scenario.batches) {
+                auto const allocationsBefore = getNumAllocations();
+                auto const t0 = std::chrono::steady_clock::now();
+
+                runtime.applyInstructions(std::string_view(batch.json));
+
+                auto const t1 = std::chrono::steady_clock::now();
+                auto const allocationsAfter = getNumAllocations();
+
+                if (batch.measured) {
+                    result.batches.push_back({
+                        runtime.getLastBatchStats(),
+                        std::chrono::duration<double, std::micro>(t1 - t0).count(),
+                        allocationsAfter - allocationsBefore,
+                    });
+                }
+
+                runtime.process(nullptr, 0, outputPointers.data(), outputPointers.size(), static_cast<size_t>(options.blockSize));
+            }
+        }
+
+        return result;
+    }
+
+    //==============================================================================
+    struct Summary {
+        double meanUs = 0;
+        double p50Us = 0;
+        double maxUs = 0;
+        double parseUs = 0;
+        double applyUs = 0;
+        double buildUs = 0;
+        double gcUs = 0;
+        double allocations = 0;
+        double instructions = 0;
+    };
+
+    Summary summarize(ScenarioResult const& result)
+    {
+        Summary s;
+
+        if (result.batches.empty())
+            return s;
+
+        std::vector<double> totals;
+
+        for (auto const& b : result.batches) {
+            totals.push_back(b.totalUs);
+
+            s.meanUs += b.totalUs;
+            s.parseUs += b.stats.parseUs;
+            s.applyUs += b.stats.applyUs;
+            s.buildUs += b.stats.buildRenderSequenceUs;
+            s.gcUs += b.stats.collectGarbageUs;
+            s.allocations += (double) b.numAllocations;
+            s.instructions += (double) b.stats.numInstructions;
+        }
+
+        auto const n = (double) result.batches.size();
+
+        for (auto* v : {&s.meanUs, &s.parseUs, &s.applyUs, &s.buildUs, &s.gcUs, &s.allocations, &s.instructions}) {
+            *v /= n;
+        }
+
+        std::sort(totals.begin(), totals.end());
+        s.p50Us = totals[totals.size() / 2];
+        s.maxUs = totals.back();
+
+        return s;
+    }
+
+    void printSummary(std::string const& name, Summary const& s)
+    {
+        std::printf("%-20s %10.0f %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f %10.0f\n",
+            name.c_str(), s.instructions, s.meanUs, s.p50Us, s.maxUs, s.parseUs, s.applyUs, s.buildUs, s.gcUs, s.allocations);
+        std::fflush(stdout);
+    }
+
+    elem::js::Value toJSON(std::string const& name, size_t numBatches, Summary const& s)
+    {
+        using namespace elem::js;
+
+        return Object({
+            {"name", String(name)},
+            {"batches", Number((double) numBatches)},
+            {"instructionsPerBatch", Number(s.instructions)},
+            {"meanUs", Number(s.meanUs)},
+            {"p50Us", Number(s.p50Us)},
+            {"maxUs", Number(s.maxUs)},
+            {"parseUs", Number(s.parseUs)},
+            {"applyUs", Number(s.applyUs)},
+            {"buildRenderSequenceUs", Number(s.buildUs)},
+            {"collectGarbageUs", Number(s.gcUs)},
+            {"allocationsPerBatch", Number(s.allocations)},
+        });
+    }
+
+} // namespace
+
+int runReplayBenchmark(ReplayBenchmarkOptions const& options)
+{
+    std::vector<Scenario> scenarios;
+
+    if (options.recordingFileName.empty()) {
+        scenarios = getSyntheticScenarios();
+    } else {
+        Scenario recording;
+
+        if (!loadRecording(options.recordingFileName, recording)) {
+            std::cout << "Failed to read " << options.recordingFileName << std::endl;
+            return 1;
+        }
+
+        scenarios.push_back(std::move(recording));
+    }
+
+    // All times are means per batch, in microseconds
+    std::printf("%-20s %10s %10s %10s %10s %10s %10s %10s %10s %10s\n",
+        "scenario", "instrs", "mean(us)", "p50(us)", "max(us)", "parse", "apply", "build", "gc", "allocs");
+
+    elem::js::Array entries;
+
+    for (auto const& scenario : scenarios) {
+        auto const result = runScenario(scenario, options);
+        auto const summary = summarize(result);
+
+        printSummary(scenario.name, summary);
+        entries.push_back(toJSON(scenario.name, result.batches.size(), summary));
+    }
+
+    if (!options.jsonOutputPath.empty()) {
+        std::ofstream file(options.jsonOutputPath);
+
+        if (!file) {
+            std::cout << "Failed to open " << options.jsonOutputPath << " for writing" << std::endl;
+            return 1;
+        }
+
+        file << elem::js::serialize(elem::js::Object({
+            {"sampleRate", elem::js::Number(options.sampleRate)},
+            {"blockSize", elem::js::Number(options.blockSize)},
+            {"results", entries},
+        })) << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+
+
+/*
+ * Options for the replay benchmark, which measures the non-realtime side of the
+ * runtime: parsing instruction batches, applying them, building render sequences,
+ * and collecting garbage.
+ *
+ * Given a recording, as written by `elembench --record`, the benchmark replays each
+ * of its batches in order against a fresh runtime. Otherwise it runs a set of
+ * synthetic scenarios: creating a 10k node graph in one batch, incremental property
+ * updates against that graph, and repeatedly swapping the active root for a newly
+ * created graph while deleting the old one.
+ *
+ * Every batch is given to the runtime as a JSON string, as it would arrive from the
+ * frontend, and one block is rendered between batches so that retired render
+ * sequences and deleted nodes flow back for collection.
+ */
+struct ReplayBenchmarkOptions
+{
+    double sampleRate = 44100.0;
+    int blockSize = 512;
+
+    // The recording to replay, one JSON instruction batch per line. If empty, the
+    // synthetic scenarios are run instead
+    std::string recordingFileName;
+
+    // The number of times to run each scenario, each time against a fresh runtime
+    int iterations = 10;
+
+    // If non-empty, the results are also written to this path as JSON
+    std::string jsonOutputPath;
+};
+
+/*
+ * Runs the replay benchmark, printing the cost of each phase per batch to stdout.
+ * Returns non-zero if the recording could not be read or the JSON output could not
+ * be written.
+ */
+int runReplayBenchmark(ReplayBenchmarkOptions const& options);
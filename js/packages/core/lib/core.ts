@@ -12,9 +12,19 @@ type OptionalKeyProps = {
   key?: string,
 };
 
+// For the nodes which may render at control rate. With a `controlRate` of N, the
+// node, and those of its inputs which allow it and which nothing else reads, render
+// once every N samples. The output is interpolated back up to the sample rate,
+// lagging by one period.
+type ControlRateProps = {
+  key?: string,
+  controlRate?: number,
+};
+
 // Const node and constant value nodes
 type ConstNodeProps = {
   key?: string,
+  controlRate?: number,
   value: number,
 };
 
@@ -54,7 +64,7 @@ export function accum(a, b, c?) {
 
 // Phasor node
 export function phasor(rate: NodeRepr_t | number, reset: NodeRepr_t | number): NodeRepr_t;
-export function phasor(props: OptionalKeyProps, rate: NodeRepr_t | number, reset: NodeRepr_t | number): NodeRepr_t;
+export function phasor(props: ControlRateProps, rate: NodeRepr_t | number, reset: NodeRepr_t | number): NodeRepr_t;
 export function phasor(a, b, c?) {
   if (typeof a === "number" || isNode(a)) {
     return createNode("phasor", {}, [resolve(a), resolve(b)]);
@@ -65,7 +75,7 @@ export function phasor(a, b, c?) {
 
 // Latch node
 export function latch(t: NodeRepr_t | number, x: NodeRepr_t | number): NodeRepr_t;
-export function latch(props: OptionalKeyProps, t: NodeRepr_t | number, x: NodeRepr_t | number): NodeRepr_t;
+export function latch(props: ControlRateProps, t: NodeRepr_t | number, x: NodeRepr_t | number): NodeRepr_t;
 export function latch(a, b, c?) {
   if (typeof a === "number" || isNode(a)) {
     return createNode("latch", {}, [resolve(a), resolve(b)]);
@@ -109,6 +119,7 @@ export function once(a, b?) {
 // Rand node
 type RandNodeProps = {
   key?: string,
+  controlRate?: number,
   seed?: number,
 };
 
@@ -142,9 +153,11 @@ export function metro(a?) {
 type SampleNodeProps = {
   key?: string,
   path?: string,
+  channel?: number,
   mode?: string,
   startOffset?: number,
   stopOffset?: number,
+  interpolation?: 'linear' | 'hermite' | 'sinc',
 };
 
 export function sample(props: SampleNodeProps, trigger: NodeRepr_t | number, rate: NodeRepr_t | number): NodeRepr_t {
@@ -155,6 +168,8 @@ export function sample(props: SampleNodeProps, trigger: NodeRepr_t | number, rat
 type TableNodeProps = {
   key?: string,
   path?: string,
+  channel?: number,
+  interpolation?: 'linear' | 'hermite' | 'sinc',
 };
 
 export function table(props: TableNodeProps, t: NodeRepr_t | number): NodeRepr_t {
@@ -165,15 +180,44 @@ export function table(props: TableNodeProps, t: NodeRepr_t | number): NodeRepr_t
 type ConvolveNodeProps = {
   key?: string,
   path?: string,
+  headSize?: number,
+  tailSize?: number,
 };
 
 export function convolve(props: ConvolveNodeProps, x: NodeRepr_t | number): NodeRepr_t {
   return createNode("convolve", props, [resolve(x)]);
 }
 
+// Spectral nodes
+type SpectralGateNodeProps = {
+  key?: string,
+  size?: number,
+  hop?: number,
+  window?: string,
+  threshold?: number,
+  floor?: number,
+};
+
+export function spectralgate(props: SpectralGateNodeProps, x: NodeRepr_t | number): NodeRepr_t {
+  return createNode("spectralgate", props, [resolve(x)]);
+}
+
+type SpectralFreezeNodeProps = {
+  key?: string,
+  size?: number,
+  hop?: number,
+  window?: string,
+  frozen?: boolean,
+};
+
+export function spectralfreeze(props: SpectralFreezeNodeProps, x: NodeRepr_t | number): NodeRepr_t {
+  return createNode("spectralfreeze", props, [resolve(x)]);
+}
+
 // Seq node
 type SeqNodeProps = {
   key?: string,
+  controlRate?: number,
   seq?: Array<number>,
   offset?: number,
   hold?: boolean,
@@ -187,6 +231,7 @@ export function seq(props: SeqNodeProps, trigger: NodeRepr_t | number, reset: No
 // Seq2 node
 type Seq2NodeProps = {
   key?: string,
+  controlRate?: number,
   seq?: Array<number>,
   offset?: number,
   hold?: boolean,
@@ -200,6 +245,7 @@ export function seq2(props: Seq2NodeProps, trigger: NodeRepr_t | number, reset:
 // SparSeq node
 type SparSeqNodeProps = {
   key?: string,
+  controlRate?: number,
   seq?: Array<{value: number, tickTime: number}>,
   offset?: number,
   loop?: boolean | Array<number>,
@@ -270,6 +316,21 @@ export function sdelay(props: DelayNodeProps, x: NodeRepr_t | number): NodeRepr_
   return createNode("sdelay", props, [resolve(x)]);
 }
 
+// Multi-tap delay node
+type MultiTapDelayNodeProps = {
+  key?: string,
+  size: number,
+  gains?: Array<number>,
+};
+
+export function multitap(
+  props: MultiTapDelayNodeProps,
+  x: NodeRepr_t | number,
+  ...lengths: Array<NodeRepr_t | number>
+): NodeRepr_t {
+  return createNode("multitap", props, [resolve(x), ...lengths.map(resolve)]);
+}
+
 // SVF
 export function svf(
   fc: NodeRepr_t | number,
@@ -388,6 +449,10 @@ type TapInNodeProps = {
 
 type TapOutNodeProps = {
   name: string,
+  // The latency of the feedback loop in samples, up to the block size. By default,
+  // or if any tapIn of the same name renders from another root than this tapOut,
+  // the loop has a latency of one block.
+  blockSize?: number,
 };
 
 export function tapIn(props: TapInNodeProps): NodeRepr_t {
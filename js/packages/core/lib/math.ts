@@ -9,6 +9,10 @@ import type {NodeRepr_t} from '../src/Reconciler.gen';
 
 type OptionalKeyProps = {
   key?: string,
+  // Renders the node, and those of its inputs which allow it and which nothing
+  // else reads, once every that many samples. The output is interpolated back up
+  // to the sample rate, lagging by one period.
+  controlRate?: number,
 }
 
 // Unary nodes
@@ -0,0 +1,35 @@
+import OfflineRenderer from '../index';
+
+
+// Copies a batch of words into the processor's staging buffer and applies it,
+// collecting any errors it reports
+function applyWords(core, words) {
+  const bytes = new Uint8Array(Uint32Array.from(words).buffer);
+  const staging = core._native.getInstructionBuffer(bytes.length);
+  const errors = [];
+
+  staging.set(bytes);
+  core._native.applyBinaryInstructions(bytes.length, (type, message) => {
+    errors.push(message);
+  });
+
+  return errors;
+}
+
+test('binary batch with a truncated string table', async function() {
+  let core = new OfflineRenderer();
+
+  await core.initialize({
+    numInputChannels: 1,
+    numOutputChannels: 1,
+  });
+
+  // Magic, version, one string of five characters with only one word of it left
+  // in the batch once padded out
+  const errors = applyWords(core, [0x49424c45, 1, 1, 5, 0x64636261]);
+
+  expect(errors).toEqual(['Invalid binary instruction batch string table.']);
+
+  // The same string in full is fine
+  expect(applyWords(core, [0x49424c45, 1, 1, 5, 0x64636261, 0x65])).toEqual([]);
+});
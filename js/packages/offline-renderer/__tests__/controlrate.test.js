@@ -0,0 +1,107 @@
+import OfflineRenderer from '../index';
+import { el } from '@elemaudio/core';
+
+
+// Posts a raw instruction batch, so that the test knows the ids of its nodes
+function postBatch(core, batch) {
+  const errors = [];
+
+  core._native.postMessageBatch(batch, (type, message) => {
+    errors.push(message);
+  });
+
+  return errors;
+}
+
+// Renders the given graph for ten blocks past the fade-in
+async function renderGraph(graph, blockSize = 512) {
+  let core = new OfflineRenderer();
+
+  await core.initialize({
+    numInputChannels: 0,
+    numOutputChannels: 1,
+    blockSize,
+  });
+
+  core.render(graph);
+
+  let outs = [new Float32Array(512 * 10)];
+
+  // Get past the fade-in
+  core.process([], outs);
+
+  outs = [new Float32Array(512 * 10)];
+  core.process([], outs);
+
+  return outs[0];
+}
+
+test('control rate output lags by one period', async function() {
+  // A slow phasor, which doesn't wrap within the test, is a ramp that the
+  // interpolation back up to the sample rate reproduces exactly
+  const ref = await renderGraph(el.mul(0.5, el.phasor(1, 0)));
+  const out = await renderGraph(el.mul({controlRate: 16}, 0.5, el.phasor(1, 0)));
+
+  for (let i = 16; i < out.length; ++i) {
+    expect(out[i]).toBeCloseTo(ref[i - 16], 4);
+  }
+});
+
+test('control rate output does not depend on the host block size', async function() {
+  const graph = () => el.mul({controlRate: 16}, el.sin(el.mul(2 * Math.PI, el.phasor(3, 0))));
+
+  // A block size which isn't a multiple of the period, but divides the length
+  // of each render so that both runtimes keep the same sample time
+  const a = await renderGraph(graph(), 512);
+  const b = await renderGraph(graph(), 40);
+
+  for (let i = 0; i < a.length; ++i) {
+    expect(b[i]).toBeCloseTo(a[i], 6);
+  }
+});
+
+test('control rate parameter events move to the next control sample', async function() {
+  let core = new OfflineRenderer();
+
+  await core.initialize({
+    numInputChannels: 0,
+    numOutputChannels: 1,
+  });
+
+  // A root reading a const node, id 2, at zero, rendered at control rate
+  expect(postBatch(core, [
+    [0, 1, 'root'],
+    [3, 1, 'channel', 0],
+    [0, 2, 'const'],
+    [3, 2, 'value', 0],
+    [3, 2, 'controlRate', 16],
+    [2, 1, 2],
+    [4, [1]],
+    [5],
+  ])).toEqual([]);
+
+  let outs = [new Float32Array(512 * 10)];
+
+  // Get past the fade-in
+  core.process([], outs);
+
+  // A step up to one, 1000 samples from now, which falls between control samples
+  const now = core._native.getSampleTime();
+  const start = now + 1000;
+  const next = Math.ceil(start / 16) * 16;
+
+  expect(start % 16).not.toBe(0);
+  expect(core._native.scheduleParameterEvent(2, 0, 1, start, 0)).toBe(true);
+
+  outs = [new Float32Array(512 * 4)];
+  core.process([], outs);
+
+  // The step lands on the next control sample, and the output ramps to it over
+  // the following period
+  for (let i = 0; i < outs[0].length; ++i) {
+    const j = now + i - next;
+    const expected = j < 0 ? 0 : Math.min(1, j / 16);
+
+    expect(outs[0][i]).toBeCloseTo(expected, 5);
+  }
+});
@@ -0,0 +1,61 @@
+import OfflineRenderer from '../index';
+import { el } from '@elemaudio/core';
+
+
+// The direct form convolution of x with the impulse response h
+function convolve(x, h) {
+  return x.map((_, n) => {
+    let acc = 0;
+
+    for (let k = 0; k < h.length && k <= n; ++k) {
+      acc += h[k] * x[n - k];
+    }
+
+    return acc;
+  });
+}
+
+test('convolve matches direct convolution', async function() {
+  // A short response, inside the first head partition, and a longer one which
+  // spans several head and tail partitions
+  const short = Float32Array.from([1, 0.5, 0.25, -0.125]);
+  const long = Float32Array.from({length: 1000}, (_, i) => Math.pow(0.995, i) * ((i % 7) - 3) / 3);
+
+  let core = new OfflineRenderer();
+
+  await core.initialize({
+    numInputChannels: 1,
+    numOutputChannels: 2,
+    virtualFileSystem: {
+      '/v/short': short,
+      '/v/long': long,
+    },
+  });
+
+  // Graph
+  core.render(
+    el.convolve({path: '/v/short'}, el.in({channel: 0})),
+    el.convolve({path: '/v/long', headSize: 64, tailSize: 256}, el.in({channel: 0})),
+  );
+
+  // Ten blocks of data
+  let inps = [new Float32Array(512 * 10)];
+  let outs = [new Float32Array(512 * 10), new Float32Array(512 * 10)];
+
+  // Get past the fade-in
+  core.process(inps, outs);
+
+  // Now a stretch of a sine followed by silence, to hear the tail ring out
+  inps = [Float32Array.from({length: 512 * 4}, (_, i) => i < 1500 ? Math.sin(0.1 * i) : 0)];
+  outs = [new Float32Array(inps[0].length), new Float32Array(inps[0].length)];
+
+  core.process(inps, outs);
+
+  const expectShort = convolve(inps[0], short);
+  const expectLong = convolve(inps[0], long);
+
+  for (let i = 0; i < inps[0].length; ++i) {
+    expect(outs[0][i]).toBeCloseTo(expectShort[i], 4);
+    expect(outs[1][i]).toBeCloseTo(expectLong[i], 4);
+  }
+});
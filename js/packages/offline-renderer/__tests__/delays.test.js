@@ -57,6 +57,70 @@ test('delay with zero delay time', async function() {
   expect(outs[0]).toMatchObject(inps[0]);
 });
 
+test('delay with an offset between zero and one', async function() {
+  let core = new OfflineRenderer();
+
+  await core.initialize({
+    numInputChannels: 1,
+    numOutputChannels: 1,
+  });
+
+  // Graph
+  core.render(el.delay({size: 10}, 0.25, 0, el.in({channel: 0})));
+
+  // Ten blocks of data
+  let inps = [new Float32Array(512 * 10)];
+  let outs = [new Float32Array(512 * 10)];
+
+  // Get past the fade-in
+  core.process(inps, outs);
+
+  inps = [Float32Array.from([1, 2, 3, 4])];
+  outs = [new Float32Array(inps[0].length)];
+
+  // Drive our delay
+  core.process(inps, outs);
+
+  // Offsets under one sample interpolate between the input and the sample before it
+  inps[0].forEach((x, i) => {
+    expect(outs[0][i]).toBeCloseTo(0.75 * x + 0.25 * (i > 0 ? inps[0][i - 1] : 0), 5);
+  });
+});
+
+test('multitap matches a sum of delays', async function() {
+  let core = new OfflineRenderer();
+
+  await core.initialize({
+    numInputChannels: 1,
+    numOutputChannels: 2,
+  });
+
+  // The same taps, fixed and modulated, read from one line and from three
+  const x = el.in({channel: 0});
+  const lengths = [10.5, 100.25, el.add(300, el.mul(50, el.cycle(2)))];
+
+  core.render(
+    el.multitap({size: 1000}, x, ...lengths),
+    el.add(...lengths.map((len) => el.delay({size: 1000}, len, 0, x))),
+  );
+
+  // Ten blocks of data
+  let inps = [new Float32Array(512 * 10)];
+  let outs = [new Float32Array(512 * 10), new Float32Array(512 * 10)];
+
+  // Get past the fade-in
+  core.process(inps, outs);
+
+  inps = [Float32Array.from({length: 512 * 4}, (_, i) => Math.sin(0.07 * i))];
+  outs = [new Float32Array(inps[0].length), new Float32Array(inps[0].length)];
+
+  core.process(inps, outs);
+
+  for (let i = 0; i < inps[0].length; ++i) {
+    expect(outs[0][i]).toBeCloseTo(outs[1][i], 5);
+  }
+});
+
 test('sdelay basics', async function() {
   let core = new OfflineRenderer();
 
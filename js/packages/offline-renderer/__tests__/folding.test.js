@@ -0,0 +1,123 @@
+import OfflineRenderer from '../index';
+import { el } from '@elemaudio/core';
+
+
+// Posts a raw instruction batch, so that the test knows the ids of its nodes
+function postBatch(core, batch) {
+  const errors = [];
+
+  core._native.postMessageBatch(batch, (type, message) => {
+    errors.push(message);
+  });
+
+  return errors;
+}
+
+test('folded constants render the same values', async function() {
+  let core = new OfflineRenderer();
+
+  await core.initialize({
+    numInputChannels: 1,
+    numOutputChannels: 2,
+  });
+
+  // The same subgraph, once over constants which fold away, and once over an
+  // input carrying the same value
+  core.render(
+    el.add(el.sin(el.mul(0.5, 2)), el.const({value: 0.25})),
+    el.add(el.sin(el.mul(el.in({channel: 0}), 2)), el.const({value: 0.25})),
+  );
+
+  let inps = [new Float32Array(512 * 10)];
+  let outs = [new Float32Array(512 * 10), new Float32Array(512 * 10)];
+
+  // Get past the fade-in
+  core.process(inps, outs);
+
+  inps = [new Float32Array(512).fill(0.5)];
+  outs = [new Float32Array(512), new Float32Array(512)];
+
+  core.process(inps, outs);
+
+  for (let i = 0; i < 512; ++i) {
+    expect(outs[0][i]).toBeCloseTo(Math.sin(1) + 0.25, 6);
+    expect(outs[0][i]).toBeCloseTo(outs[1][i], 6);
+  }
+});
+
+test('changing a folded constant rebuilds the render sequence', async function() {
+  let core = new OfflineRenderer();
+
+  await core.initialize({
+    numInputChannels: 0,
+    numOutputChannels: 1,
+  });
+
+  core.render(el.mul(el.const({key: 'gain', value: 0.5}), 2));
+
+  let outs = [new Float32Array(512 * 10)];
+
+  // Get past the fade-in
+  core.process([], outs);
+  expect(outs[0][512 * 10 - 1]).toBeCloseTo(1, 6);
+
+  // The new value is heard from the next block
+  core.render(el.mul(el.const({key: 'gain', value: 0.75}), 2));
+
+  outs = [new Float32Array(512)];
+  core.process([], outs);
+
+  for (let i = 0; i < 512; ++i) {
+    expect(outs[0][i]).toBeCloseTo(1.5, 6);
+  }
+});
+
+test('parameter events for a folded constant are applied after the rebuild', async function() {
+  let core = new OfflineRenderer();
+
+  await core.initialize({
+    numInputChannels: 0,
+    numOutputChannels: 1,
+  });
+
+  // sin(2 * x) + 2, for a const node x, id 2, at zero, all of which folds
+  expect(postBatch(core, [
+    [0, 1, 'root'],
+    [3, 1, 'channel', 0],
+    [0, 2, 'const'],
+    [3, 2, 'value', 0],
+    [0, 3, 'const'],
+    [3, 3, 'value', 2],
+    [0, 4, 'mul'],
+    [2, 4, 2],
+    [2, 4, 3],
+    [0, 5, 'sin'],
+    [2, 5, 4],
+    [0, 6, 'add'],
+    [2, 6, 5],
+    [2, 6, 3],
+    [2, 1, 6],
+    [4, [1]],
+    [5],
+  ])).toEqual([]);
+
+  let outs = [new Float32Array(512 * 10)];
+
+  // Get past the fade-in
+  core.process([], outs);
+
+  // A ramp of x up to a quarter over 100 samples, starting 1000 samples from now.
+  // The event asks for a new render sequence which doesn't fold x, and waits for it.
+  const start = core._native.getSampleTime() + 1000;
+  expect(core._native.scheduleParameterEvent(2, 0, 0.25, start, 100)).toBe(true);
+
+  outs = [new Float32Array(512 * 4)];
+  core.process([], outs);
+
+  for (let i = 0; i < outs[0].length; ++i) {
+    const j = i - 1000;
+    const x = j < 0 ? 0 : Math.min(1, (j + 1) / 100) * 0.25;
+
+    expect(outs[0][i]).toBeCloseTo(Math.sin(2 * x) + 2, 5);
+  }
+});
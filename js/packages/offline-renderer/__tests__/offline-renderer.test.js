@@ -74,3 +74,130 @@ test('switch and switch back', async function() {
 
   expect(outs[0].slice(512 * 8, 512 * 8 + 32)).toMatchSnapshot();
 });
+
+// A graph whose output depends only on the sample time and its input, and not on
+// where the blocks fall
+function blockInvariantGraph() {
+  return el.svf({mode: 'lowpass'}, 1200, 2, el.add(
+    el.cycle(440),
+    el.delay({size: 1000}, 300, 0.5, el.in({channel: 0})),
+  ));
+}
+
+test('host buffers larger than the block size', async function() {
+  const length = 3 * 512 + 17;
+  const inps = [Float32Array.from({length: length * 4}, (_, i) => 0.8 * Math.sin(0.07 * i))];
+
+  // One renderer takes the whole host buffer at once, and splits it into blocks
+  // of 512 samples and a last of 17
+  let split = new OfflineRenderer();
+
+  await split.initialize({
+    numInputChannels: 1,
+    numOutputChannels: 1,
+    blockSize: length,
+  });
+
+  split._native.setInternalBlockSize(512);
+  split.render(blockInvariantGraph());
+
+  // The other is given one block of 512 samples at a time
+  let blocks = new OfflineRenderer();
+
+  await blocks.initialize({
+    numInputChannels: 1,
+    numOutputChannels: 1,
+    blockSize: 512,
+  });
+
+  blocks.render(blockInvariantGraph());
+
+  let a = [new Float32Array(length * 4)];
+  let b = [new Float32Array(length * 4)];
+
+  split.process(inps, a);
+  blocks.process(inps, b);
+
+  for (let i = 0; i < a[0].length; ++i) {
+    expect(a[0][i]).toBeCloseTo(b[0][i], 6);
+  }
+});
+
+// Renders the given graph of the input for four blocks past the fade-in, and
+// returns the input and output
+async function renderInput(graph) {
+  let core = new OfflineRenderer();
+
+  await core.initialize({
+    numInputChannels: 1,
+    numOutputChannels: 1,
+  });
+
+  core.render(graph(el.in({channel: 0})));
+
+  // Get past the fade-in
+  core.process([new Float32Array(512 * 10)], [new Float32Array(512 * 10)]);
+
+  const inps = [Float32Array.from({length: 512 * 4}, (_, i) => 0.8 * Math.sin(0.07 * i))];
+  const outs = [new Float32Array(512 * 4)];
+
+  core.process(inps, outs);
+  return [inps[0], outs[0]];
+}
+
+test('a child shared across many siblings keeps its buffer', async function() {
+  // The sine is read by the first and last children of the sum, so its buffer
+  // must outlive those which the branches in between release and reuse
+  const [x, out] = await renderInput((x) => {
+    const s = el.sin(x);
+    const branches = Array.from({length: 12}, (_, k) => el.mul(el.add(x, 0.01 * (k + 1)), el.cos(el.mul(x, k + 1))));
+
+    return el.add(s, ...branches, el.mul(s, 2));
+  });
+
+  for (let i = 0; i < out.length; ++i) {
+    let expected = 3 * Math.sin(x[i]);
+
+    for (let k = 1; k <= 12; ++k) {
+      expected += (x[i] + 0.01 * k) * Math.cos(k * x[i]);
+    }
+
+    expect(out[i]).toBeCloseTo(expected, 4);
+  }
+});
+
+test('a deep pointwise chain with shared children', async function() {
+  // Fifty stages which collapse onto one buffer, each reading a child shared by
+  // all of them, and a stage half way up which the top reads too
+  const [x, out] = await renderInput((x) => {
+    const s = el.mul(x, 0.1);
+    let y = x;
+    let middle = null;
+
+    for (let k = 1; k <= 50; ++k) {
+      y = el.tanh(el.add(el.mul(y, 0.9), s));
+
+      if (k === 25) {
+        middle = y;
+      }
+    }
+
+    return el.add(y, s, el.mul(middle, -0.5));
+  });
+
+  for (let i = 0; i < out.length; ++i) {
+    const s = 0.1 * x[i];
+    let y = x[i];
+    let middle = 0;
+
+    for (let k = 1; k <= 50; ++k) {
+      y = Math.tanh(y * 0.9 + s);
+
+      if (k === 25) {
+        middle = y;
+      }
+    }
+
+    expect(out[i]).toBeCloseTo(y + s - 0.5 * middle, 5);
+  }
+});
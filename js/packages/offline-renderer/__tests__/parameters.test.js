@@ -0,0 +1,53 @@
+import OfflineRenderer from '../index';
+
+
+// Posts a raw instruction batch, so that the test knows the ids of its nodes
+function postBatch(core, batch) {
+  const errors = [];
+
+  core._native.postMessageBatch(batch, (type, message) => {
+    errors.push(message);
+  });
+
+  return errors;
+}
+
+test('const ramp through parameter events', async function() {
+  let core = new OfflineRenderer();
+
+  await core.initialize({
+    numInputChannels: 0,
+    numOutputChannels: 1,
+  });
+
+  // A root reading a const node, id 2, at zero
+  expect(postBatch(core, [
+    [0, 1, 'root'],
+    [3, 1, 'channel', 0],
+    [0, 2, 'const'],
+    [3, 2, 'value', 0],
+    [2, 1, 2],
+    [4, [1]],
+    [5],
+  ])).toEqual([]);
+
+  // Ten blocks of data
+  let outs = [new Float32Array(512 * 10)];
+
+  // Get past the fade-in
+  core.process([], outs);
+
+  // A ramp up to one over 100 samples, starting 1000 samples from now
+  const start = core._native.getSampleTime() + 1000;
+  expect(core._native.scheduleParameterEvent(2, 0, 1, start, 100)).toBe(true);
+
+  outs = [new Float32Array(512 * 4)];
+  core.process([], outs);
+
+  for (let i = 0; i < outs[0].length; ++i) {
+    const j = i - 1000;
+    const expected = j < 0 ? 0 : Math.min(1, (j + 1) / 100);
+
+    expect(outs[0][i]).toBeCloseTo(expected, 5);
+  }
+});
@@ -0,0 +1,36 @@
+import OfflineRenderer from '../index';
+import { el } from '@elemaudio/core';
+
+
+test('spectral identity round trip', async function() {
+  let core = new OfflineRenderer();
+
+  await core.initialize({
+    numInputChannels: 1,
+    numOutputChannels: 2,
+  });
+
+  // Neither an unfrozen freeze nor a gate with no attenuation touches the spectrum,
+  // so each should give back its input, one frame later
+  core.render(
+    el.spectralfreeze({size: 256, hop: 64, frozen: false}, el.in({channel: 0})),
+    el.spectralgate({size: 512, hop: 128, window: 'blackman-harris', threshold: -300, floor: 0}, el.in({channel: 0})),
+  );
+
+  // Ten blocks of data
+  let inps = [new Float32Array(512 * 10)];
+  let outs = [new Float32Array(512 * 10), new Float32Array(512 * 10)];
+
+  // Get past the fade-in
+  core.process(inps, outs);
+
+  inps = [Float32Array.from({length: 512 * 4}, (_, i) => 0.5 * Math.sin(0.05 * i) + 0.25 * Math.sin(0.31 * i))];
+  outs = [new Float32Array(inps[0].length), new Float32Array(inps[0].length)];
+
+  core.process(inps, outs);
+
+  for (let i = 0; i < inps[0].length; ++i) {
+    expect(outs[0][i]).toBeCloseTo(i >= 256 ? inps[0][i - 256] : 0, 4);
+    expect(outs[1][i]).toBeCloseTo(i >= 512 ? inps[0][i - 512] : 0, 4);
+  }
+});
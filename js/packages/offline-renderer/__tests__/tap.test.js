@@ -48,3 +48,69 @@ test('feedback taps', async function() {
   core.process(inps, outs);
   expect(outs[0]).toMatchSnapshot();
 });
+
+// Renders the impulse response of the given graph's first channel, after getting
+// past the fade-in
+async function impulseResponse(numOutputChannels, ...graph) {
+  let core = new OfflineRenderer();
+
+  await core.initialize({
+    numInputChannels: 1,
+    numOutputChannels,
+  });
+
+  core.render(...graph);
+
+  let inps = [new Float32Array(512 * 10)];
+  let outs = Array.from({length: numOutputChannels}, () => new Float32Array(512 * 10));
+
+  core.process(inps, outs);
+
+  inps = [new Float32Array(512)];
+  outs = Array.from({length: numOutputChannels}, () => new Float32Array(512));
+  inps[0][0] = 1;
+
+  core.process(inps, outs);
+  return outs;
+}
+
+function comb(blockSize) {
+  return el.tapOut({name: 'comb', blockSize}, el.add(
+    el.in({channel: 0}),
+    el.mul(0.5, el.tapIn({name: 'comb'})),
+  ));
+}
+
+test('feedback taps with a blockSize have that latency', async function() {
+  // A one sample loop
+  let [out] = await impulseResponse(1, comb(1));
+
+  for (let i = 0; i < 20; ++i) {
+    expect(out[i]).toBeCloseTo(Math.pow(0.5, i), 6);
+  }
+
+  // And a longer one, which echoes well within the host block
+  [out] = await impulseResponse(1, comb(16));
+
+  for (let i = 0; i < 64; ++i) {
+    expect(out[i]).toBeCloseTo(i % 16 === 0 ? Math.pow(0.5, i / 16) : 0, 6);
+  }
+});
+
+test('feedback taps with a blockSize read outside the loop', async function() {
+  // A tapIn in the same root but outside the loop reads the loop's output with
+  // the same latency
+  let [out] = await impulseResponse(1, el.add(comb(16), el.tapIn({name: 'comb'})));
+
+  expect(out[0]).toBeCloseTo(1, 6);
+  expect(out[16]).toBeCloseTo(1.5, 6);
+  expect(out[32]).toBeCloseTo(0.75, 6);
+  expect(out[17]).toBeCloseTo(0, 6);
+
+  // A tapIn in another root makes the loop fall back to the latency of a block
+  let [left, right] = await impulseResponse(2, comb(16), el.tapIn({name: 'comb'}));
+
+  expect(left[0]).toBeCloseTo(1, 6);
+  expect(left[16]).toBeCloseTo(0, 6);
+  expect(right.every(x => x === 0)).toBe(true);
+});
@@ -32,3 +32,41 @@ test('vfs sample', async function() {
 
   expect(outs[0]).toMatchSnapshot();
 });
+
+test('vfs table interpolation', async function() {
+  let core = new OfflineRenderer();
+
+  await core.initialize({
+    numInputChannels: 1,
+    numOutputChannels: 2,
+    virtualFileSystem: {
+      '/v/ramp': Float32Array.from({length: 17}, (_, i) => i),
+      '/v/flat': new Float32Array(17).fill(0.5),
+    },
+  });
+
+  // Hermite interpolation is exact on a straight line, and the windowed sinc
+  // has unity gain at DC
+  core.render(
+    el.table({path: '/v/ramp', interpolation: 'hermite'}, el.in({channel: 0})),
+    el.table({path: '/v/flat', interpolation: 'sinc'}, el.in({channel: 0})),
+  );
+
+  // Ten blocks of data
+  let inps = [new Float32Array(512 * 10)];
+  let outs = [new Float32Array(512 * 10), new Float32Array(512 * 10)];
+
+  // Get past the fade-in
+  core.process(inps, outs);
+
+  // Read positions away from the ends of the table, 16 samples long
+  inps = [Float32Array.from([0.3, 0.5, 0.55, 0.6125])];
+  outs = [new Float32Array(inps[0].length), new Float32Array(inps[0].length)];
+
+  core.process(inps, outs);
+
+  inps[0].forEach((t, i) => {
+    expect(outs[0][i]).toBeCloseTo(t * 16, 4);
+    expect(outs[1][i]).toBeCloseTo(0.5, 4);
+  });
+});
@@ -0,0 +1,50 @@
+import OfflineRenderer from '../index';
+import { el } from '@elemaudio/core';
+
+
+// A voice of a small synth, with a key for each of its stateful nodes so that
+// copies of it don't share them
+function voice(v, key) {
+  const gate = v % 4 === 3 ? 0 : 1;
+  const x = el.mul(gate, el.sub(el.phasor({key: `${key}:osc`}, 110 + 37 * v, 0), 0.5));
+  const y = el.svf({key: `${key}:svf`, mode: 'lowpass'}, 800 + 50 * v, 1.5 + 0.1 * v, x);
+  const z = el.biquad({key: `${key}:biquad`}, 0.2, 0.4, 0.2, -0.5, 0.3, y);
+
+  return el.mul(z, el.env({key: `${key}:env`}, 0.99, 0.999, x));
+}
+
+test('batched voices match the same voices rendered alone', async function() {
+  const numVoices = 8;
+  let core = new OfflineRenderer();
+
+  await core.initialize({
+    numInputChannels: 0,
+    numOutputChannels: numVoices + 1,
+  });
+
+  // The voices of the first channel sit side by side in one root, where their
+  // nodes render as batches. Each of the others renders one voice on its own.
+  const voices = Array.from({length: numVoices}, (_, v) => voice(v, `batched:${v}`));
+  const solos = Array.from({length: numVoices}, (_, v) => voice(v, `solo:${v}`));
+
+  core.render(el.add(...voices), ...solos);
+
+  // Ten blocks of data
+  let outs = Array.from({length: numVoices + 1}, () => new Float32Array(512 * 10));
+
+  // Get past the fade-in
+  core.process([], outs);
+
+  outs = Array.from({length: numVoices + 1}, () => new Float32Array(512 * 4));
+  core.process([], outs);
+
+  for (let i = 0; i < outs[0].length; ++i) {
+    let sum = 0;
+
+    for (let v = 0; v < numVoices; ++v) {
+      sum += outs[v + 1][i];
+    }
+
+    expect(outs[0][i]).toBeCloseTo(sum, 4);
+  }
+});
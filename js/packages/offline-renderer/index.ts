@@ -24,6 +24,7 @@ export default class OfflineRenderer extends events.EventEmitter {
       numOutputChannels: 2,
       sampleRate: 44100,
       blockSize: 512,
+      numRenderThreads: 0,
       virtualFileSystem: {},
     }, options);
 
@@ -33,6 +34,7 @@ export default class OfflineRenderer extends events.EventEmitter {
       numOutputChannels,
       sampleRate,
       blockSize,
+      numRenderThreads,
       virtualFileSystem,
     } = config;
 
@@ -41,9 +43,19 @@ export default class OfflineRenderer extends events.EventEmitter {
     this._blockSize = blockSize;
 
     try {
-      this._module = await Module();
+      // The loader picks the fastest build of the module that this environment supports,
+      // and parallel rendering needs the threaded one
+      this._module = await Module({threads: numRenderThreads > 0});
       this._native = new this._module.ElementaryAudioProcessor(numInputChannels, numOutputChannels);
       this._native.prepare(sampleRate, blockSize);
+
+      if (numRenderThreads > 0) {
+        if (typeof this._native.setNumRenderThreads === 'function') {
+          this._native.setNumRenderThreads(numRenderThreads);
+        } else {
+          this.emit('warning', 'Parallel rendering is unavailable in this build of the module; rendering on one thread.');
+        }
+      }
     } catch (e) {
       if (e instanceof WebAssembly.RuntimeError) {
         throw new Error('Failed to load the Elementary WASM backend. Running Elementary within Node.js requires Node v18, or Node v16 with --experimental-wasm-eh enabled.');
@@ -126,13 +138,13 @@ export default class OfflineRenderer extends events.EventEmitter {
   updateVirtualFileSystem(vfs) {
     const valid = typeof vfs === 'object' && vfs !== null;
 
-    invariant(valid, "Virtual file system must be an object mapping string type keys to Array|Float32Array type values");
+    invariant(valid, "Virtual file system must be an object mapping string type keys to Array|Float32Array|Array<Float32Array> type values");
 
     Object.keys(vfs).forEach(function(key) {
       const validValue = typeof vfs[key] === 'object' &&
         (Array.isArray(vfs[key]) || (vfs[key] instanceof Float32Array));
 
-      invariant(validValue, "Virtual file system must be an object mapping string type keys to Array|Float32Array type values");
+      invariant(validValue, "Virtual file system must be an object mapping string type keys to Array|Float32Array|Array<Float32Array> type values");
     });
 
     for (let [key, val] of Object.entries(vfs)) {
@@ -142,6 +154,13 @@ export default class OfflineRenderer extends events.EventEmitter {
     }
   }
 
+  // Removes every entry of the virtual file system that the current graph doesn't use,
+  // returning the names of those that remain
+  pruneVirtualFileSystem(): Array<string> {
+    this._native.pruneSharedResourceMap();
+    return this._native.listSharedResourceMap();
+  }
+
   reset() {
     this._native.reset();
   }
@@ -0,0 +1,284 @@
+// Encoders and decoders for the binary formats of the native runtime, see
+// runtime/BinaryInstructions.h and wasm/BinaryEvents.h.
+
+const kMagic = 0x49424c45; // "ELBI"
+const kVersion = 1;
+
+const ValueTag = {
+  Undefined: 0,
+  Null: 1,
+  Boolean: 2,
+  Number: 3,
+  String: 4,
+  Array: 5,
+  NumberArray: 6,
+  Float32Array: 7,
+  Object: 8,
+};
+
+const EventType = {
+  Value: 0,
+  Meter: 1,
+  Snapshot: 2,
+  Scope: 3,
+  FFT: 4,
+};
+
+const textEncoder = new TextEncoder();
+const textDecoder = new TextDecoder();
+
+class Writer {
+  private buffer = new ArrayBuffer(1024);
+  private view = new DataView(this.buffer);
+  private size = 0;
+
+  private reserve(n: number) {
+    if (this.size + n <= this.buffer.byteLength) {
+      return;
+    }
+
+    const next = new ArrayBuffer(Math.max(this.buffer.byteLength * 2, this.size + n));
+    new Uint8Array(next).set(new Uint8Array(this.buffer, 0, this.size));
+
+    this.buffer = next;
+    this.view = new DataView(next);
+  }
+
+  u32(x: number) {
+    this.reserve(4);
+    this.view.setUint32(this.size, x, true);
+    this.size += 4;
+  }
+
+  i32(x: number) {
+    this.reserve(4);
+    this.view.setInt32(this.size, x, true);
+    this.size += 4;
+  }
+
+  f32(x: number) {
+    this.reserve(4);
+    this.view.setFloat32(this.size, x, true);
+    this.size += 4;
+  }
+
+  f64(x: number) {
+    this.reserve(8);
+    this.view.setFloat64(this.size, x, true);
+    this.size += 8;
+  }
+
+  bytes(b: Uint8Array) {
+    const padded = Math.ceil(b.length / 4) * 4;
+
+    this.reserve(padded);
+    new Uint8Array(this.buffer, this.size, b.length).set(b);
+    this.size += padded;
+  }
+
+  finish(): Uint8Array {
+    return new Uint8Array(this.buffer, 0, this.size);
+  }
+}
+
+// Encodes an instruction batch, as produced by the Renderer, in the runtime's binary
+// instruction format. Returns null for batches which hold anything the format can't
+// represent, which should then be sent as they are.
+export function encodeInstructions(batch: Array<any>): Uint8Array | null {
+  const strings: Array<string> = [];
+  const stringIndices = new Map<string, number>();
+  const body = new Writer();
+
+  const intern = (s: string) => {
+    let index = stringIndices.get(s);
+
+    if (index === undefined) {
+      index = strings.length;
+      strings.push(s);
+      stringIndices.set(s, index);
+    }
+
+    return index;
+  };
+
+  const writeValue = (v: any): boolean => {
+    if (v === undefined) {
+      body.u32(ValueTag.Undefined);
+    } else if (v === null) {
+      body.u32(ValueTag.Null);
+    } else if (typeof v === 'boolean') {
+      body.u32(ValueTag.Boolean);
+      body.u32(v ? 1 : 0);
+    } else if (typeof v === 'number') {
+      body.u32(ValueTag.Number);
+      body.f64(v);
+    } else if (typeof v === 'string') {
+      body.u32(ValueTag.String);
+      body.u32(intern(v));
+    } else if (v instanceof Float32Array) {
+      body.u32(ValueTag.Float32Array);
+      body.u32(v.length);
+      v.forEach((x) => body.f32(x));
+    } else if (Array.isArray(v)) {
+      const allNumbers = v.every((x) => typeof x === 'number');
+
+      body.u32(allNumbers ? ValueTag.NumberArray : ValueTag.Array);
+      body.u32(v.length);
+
+      for (const x of v) {
+        if (allNumbers) {
+          body.f64(x);
+        } else if (!writeValue(x)) {
+          return false;
+        }
+      }
+    } else if (typeof v === 'object') {
+      const keys = Object.keys(v);
+
+      body.u32(ValueTag.Object);
+      body.u32(keys.length);
+
+      for (const k of keys) {
+        body.u32(intern(k));
+
+        if (!writeValue(v[k])) {
+          return false;
+        }
+      }
+    } else {
+      return false;
+    }
+
+    return true;
+  };
+
+  for (const [op, ...args] of batch) {
+    switch (op) {
+      case 0: // CREATE_NODE
+        body.u32(op);
+        body.i32(args[0]);
+        body.u32(intern(args[1]));
+        break;
+      case 1: // DELETE_NODE
+        body.u32(op);
+        body.i32(args[0]);
+        break;
+      case 2: // APPEND_CHILD
+        body.u32(op);
+        body.i32(args[0]);
+        body.i32(args[1]);
+        break;
+      case 3: // SET_PROPERTY
+        body.u32(op);
+        body.i32(args[0]);
+        body.u32(intern(args[1]));
+
+        if (!writeValue(args[2])) {
+          return null;
+        }
+
+        break;
+      case 4: // ACTIVATE_ROOTS
+        body.u32(op);
+        body.u32(args[0].length);
+        args[0].forEach((r) => body.i32(r));
+        break;
+      case 5: // COMMIT_UPDATES
+        body.u32(op);
+        break;
+      default:
+        return null;
+    }
+  }
+
+  const out = new Writer();
+
+  out.u32(kMagic);
+  out.u32(kVersion);
+  out.u32(strings.length);
+
+  for (const s of strings) {
+    const b = textEncoder.encode(s);
+
+    out.u32(b.length);
+    out.bytes(b);
+  }
+
+  out.bytes(body.finish());
+  return out.finish();
+}
+
+// Decodes a batch of events from the worklet into the [type, event] pairs which the
+// renderer emits, in the same shapes as the processQueuedEvents callback delivers them
+export function decodeEvents(bytes: Uint8Array): Array<[string, any]> {
+  const view = new DataView(bytes.buffer, bytes.byteOffset, bytes.byteLength);
+  const events: Array<[string, any]> = [];
+  let pos = 0;
+
+  const u32 = () => {
+    const x = view.getUint32(pos, true);
+    pos += 4;
+    return x;
+  };
+
+  const string = () => {
+    const length = u32();
+    const s = textDecoder.decode(bytes.subarray(pos, pos + length));
+    pos += Math.ceil(length / 4) * 4;
+    return s;
+  };
+
+  const frame = (size: number) => {
+    // Copied out, since the buffer is reused for the next batch
+    const f = new Float32Array(bytes.slice(pos, pos + size * 4).buffer);
+    pos += size * 4;
+    return f;
+  };
+
+  const numEvents = u32();
+
+  for (let n = 0; n < numEvents; ++n) {
+    const type = u32();
+    pos += 4; // The source node id
+    const numChannels = u32();
+    const frameSize = u32();
+    const value0 = view.getFloat64(pos, true);
+    const value1 = view.getFloat64(pos + 8, true);
+    pos += 16;
+
+    // Events from nodes without a name prop give their source as undefined
+    const nameString = string();
+    const name = nameString.length > 0 ? nameString : undefined;
+
+    switch (type) {
+      case EventType.Meter:
+        events.push(['meter', {min: value0, max: value1, source: name}]);
+        break;
+      case EventType.Snapshot:
+        events.push(['snapshot', {source: name, data: value0}]);
+        break;
+      case EventType.Scope: {
+        const data: Array<Float32Array> = [];
+
+        for (let i = 0; i < numChannels; ++i) {
+          data.push(frame(frameSize));
+        }
+
+        events.push(['scope', {source: name, data}]);
+        break;
+      }
+      case EventType.FFT: {
+        const real = frame(frameSize);
+        const imag = frame(frameSize);
+
+        events.push(['fft', {source: name, data: {real, imag}}]);
+        break;
+      }
+      default:
+        events.push(JSON.parse(string()));
+        break;
+    }
+  }
+
+  return events;
+}
@@ -0,0 +1,112 @@
+// A single producer, single consumer ring of byte messages over a SharedArrayBuffer,
+// for passing instruction batches and events between the main thread and the audio
+// worklet without posting a message for each.
+//
+// The buffer begins with two Int32 words, the write and read positions in bytes, and
+// the ring itself follows. Each message is written as a u32 byte length and its bytes,
+// padded to a multiple of four so that lengths never straddle the end of the ring.
+//
+// This class is also injected into the worklet scope as source text, so it must not
+// refer to anything outside of itself.
+export class SharedRingBuffer {
+  private header: Int32Array;
+  private data: Uint8Array;
+  private view: DataView;
+  private capacity: number;
+
+  static create(capacity: number): SharedArrayBuffer {
+    return new SharedArrayBuffer(8 + Math.ceil(capacity / 4) * 4);
+  }
+
+  constructor(buffer: SharedArrayBuffer) {
+    this.header = new Int32Array(buffer, 0, 2);
+    this.data = new Uint8Array(buffer, 8);
+    this.view = new DataView(buffer, 8);
+    this.capacity = this.data.length;
+  }
+
+  // The longest message the ring can ever hold
+  get maxMessageLength(): number {
+    return this.capacity - 8;
+  }
+
+  // Writes a message, returning false without writing anything if there isn't room
+  write(bytes: Uint8Array): boolean {
+    const length = bytes.length;
+    const size = 4 + Math.ceil(length / 4) * 4;
+
+    const w = Atomics.load(this.header, 0);
+    const r = Atomics.load(this.header, 1);
+
+    // One word always stays free so that a full ring can be told from an empty one
+    const free = (r - w - 4 + this.capacity) % this.capacity;
+
+    if (length === 0 || size > free) {
+      return false;
+    }
+
+    this.view.setUint32(w, length, true);
+    this.copyIn(bytes, (w + 4) % this.capacity);
+
+    Atomics.store(this.header, 0, (w + size) % this.capacity);
+    return true;
+  }
+
+  // Returns the byte length of the next message, or zero if there is none
+  nextLength(): number {
+    const r = Atomics.load(this.header, 1);
+
+    if (r === Atomics.load(this.header, 0)) {
+      return 0;
+    }
+
+    return this.view.getUint32(r, true);
+  }
+
+  // Reads the next message into `dest`, which must hold at least nextLength() bytes,
+  // and returns its length
+  readInto(dest: Uint8Array): number {
+    const length = this.nextLength();
+
+    if (length === 0) {
+      return 0;
+    }
+
+    const r = Atomics.load(this.header, 1);
+    const start = (r + 4) % this.capacity;
+    const first = Math.min(length, this.capacity - start);
+
+    dest.set(this.data.subarray(start, start + first));
+
+    if (first < length) {
+      dest.set(this.data.subarray(0, length - first), first);
+    }
+
+    Atomics.store(this.header, 1, (r + 4 + Math.ceil(length / 4) * 4) % this.capacity);
+    return length;
+  }
+
+  // Reads the next message into a new array, or returns null if there is none
+  read(): Uint8Array | null {
+    const length = this.nextLength();
+
+    if (length === 0) {
+      return null;
+    }
+
+    const dest = new Uint8Array(length);
+    this.readInto(dest);
+
+    return dest;
+  }
+
+  private copyIn(bytes: Uint8Array, start: number) {
+    const first = Math.min(bytes.length, this.capacity - start);
+
+    this.data.set(bytes.subarray(0, first), start);
+
+    if (first < bytes.length) {
+      this.data.set(bytes.subarray(first), 0);
+    }
+  }
+}
@@ -9,13 +9,27 @@ import {
 import WorkletProcessor from './raw/WorkletProcessor';
 import WasmModule from './raw/elementary-wasm';
 
+import { SharedRingBuffer } from './SharedRingBuffer';
+import { encodeInstructions, decodeEvents } from './BinaryInstructions';
+
+
+// The capacity in bytes of each of the shared memory rings
+const kSharedRingCapacity = 1 << 20;
+
 
 export default class WebAudioRenderer extends events.EventEmitter {
   private _worklet: any;
   private _renderer: Renderer;
   private _timer: any;
-
-  async initialize(audioContext: AudioContext, workletOptions: AudioWorkletNodeOptions = {}, eventInterval: number = 16): Promise<AudioWorkletNode> {
+  private _instructionRing: SharedRingBuffer | null = null;
+  private _eventRing: SharedRingBuffer | null = null;
+  private _pendingRingMessages: Array<Uint8Array> = [];
+
+  // Shared memory is used when the page is cross-origin isolated, so that SharedArrayBuffer
+  // is available, unless `useSharedMemory` is false. Instruction batches then reach the
+  // worklet through a shared ring in a compact binary form, and events come back the same
+  // way, without posting a message for each. Otherwise everything goes over the port.
+  async initialize(audioContext: AudioContext, workletOptions: AudioWorkletNodeOptions = {}, eventInterval: number = 16, useSharedMemory: boolean = true): Promise<AudioWorkletNode> {
     invariant(typeof audioContext === 'object' && audioContext !== null, 'First argument to initialize must be a valid AudioContext instance.');
     invariant(typeof workletOptions === 'object' && workletOptions !== null, 'The optional second argument to initialize must be an object.');
 
@@ -27,7 +41,11 @@ export default class WebAudioRenderer extends events.EventEmitter {
     //
     // @ts-ignore
     if (!audioContext.__elemRegistered) {
-      const blob = new Blob([WasmModule, WorkletProcessor], {type: 'text/javascript'});
+      const blob = new Blob([
+        WasmModule,
+        `const SharedRingBuffer = ${SharedRingBuffer.toString()};`,
+        WorkletProcessor,
+      ], {type: 'text/javascript'});
       const blobUrl = URL.createObjectURL(blob);
 
       // This neat trick with the Blob URL allows me to inject the module without
@@ -39,11 +57,29 @@ export default class WebAudioRenderer extends events.EventEmitter {
       audioContext.__elemRegistered = true;
     }
 
+    const canShareMemory = useSharedMemory &&
+      typeof SharedArrayBuffer !== 'undefined' &&
+      (window as any).crossOriginIsolated === true;
+
+    let processorOptions = workletOptions.processorOptions;
+
+    if (canShareMemory) {
+      const instructions = SharedRingBuffer.create(kSharedRingCapacity);
+      const events = SharedRingBuffer.create(kSharedRingCapacity);
+
+      this._instructionRing = new SharedRingBuffer(instructions);
+      this._eventRing = new SharedRingBuffer(events);
+
+      processorOptions = Object.assign({}, processorOptions, {
+        sharedMemory: {instructions, events, eventInterval},
+      });
+    }
+
     this._worklet = new AudioWorkletNode(audioContext, 'ElementaryAudioWorkletProcessor', Object.assign({
       numberOfInputs: 0,
       numberOfOutputs: 1,
       outputChannelCount: [2],
-    }, workletOptions));
+    }, workletOptions, {processorOptions}));
 
     // We defer the resolution of this method's result until we get the load
     // event back from the worklet. That way, if the user is awaiting the result
@@ -55,6 +91,10 @@ export default class WebAudioRenderer extends events.EventEmitter {
 
         if (type === 'load') {
           this._renderer = new Renderer(e.sampleRate, (batch) => {
+            if (this._instructionRing !== null) {
+              return this._sendSharedInstructions(batch);
+            }
+
             this._worklet.port.postMessage({
               type: 'renderInstructions',
               batch,
@@ -73,13 +113,66 @@ export default class WebAudioRenderer extends events.EventEmitter {
 
       // TODO: Clean up? Unsubscribe option?
       this._timer = window.setInterval(() => {
-        this._worklet.port.postMessage({
-          type: 'processQueuedEvents',
-        });
+        if (this._eventRing === null) {
+          return this._worklet.port.postMessage({
+            type: 'processQueuedEvents',
+          });
+        }
+
+        this._flushSharedInstructions();
+
+        let bytes;
+
+        while ((bytes = this._eventRing.read()) !== null) {
+          for (const [type, evt] of decodeEvents(bytes)) {
+            if (type === 'error') {
+              this.emit(type, new Error(evt));
+              continue;
+            }
+
+            this.emit(type, evt);
+          }
+        }
       }, eventInterval);
     });
   }
 
+  // Sends a batch through the instruction ring. Batches which can't be encoded, or which
+  // could never fit in the ring, go over the port instead.
+  private _sendSharedInstructions(batch) {
+    const bytes = encodeInstructions(batch);
+
+    if (bytes === null || bytes.length > this._instructionRing.maxMessageLength) {
+      return this._postMessage({
+        type: 'renderInstructions',
+        batch,
+      });
+    }
+
+    this._pendingRingMessages.push(bytes);
+    this._flushSharedInstructions();
+  }
+
+  // Posts a message to the worklet. With shared memory, the message also leaves a marker
+  // in the instruction ring which holds the worklet back until the message arrives, so
+  // that everything is applied in the order it was sent.
+  private _postMessage(message) {
+    this._worklet.port.postMessage(message);
+
+    if (this._instructionRing !== null) {
+      this._pendingRingMessages.push(new Uint8Array(4));
+      this._flushSharedInstructions();
+    }
+  }
+
+  // Writes whatever the instruction ring has room for. Messages which don't fit right
+  // now wait for the next event interval.
+  private _flushSharedInstructions() {
+    while (this._pendingRingMessages.length > 0 && this._instructionRing.write(this._pendingRingMessages[0])) {
+      this._pendingRingMessages.shift();
+    }
+  }
+
   render(...args) {
     return this._renderer.render(...args);
   }
@@ -87,24 +180,31 @@ export default class WebAudioRenderer extends events.EventEmitter {
   updateVirtualFileSystem(vfs) {
     const valid = typeof vfs === 'object' && vfs !== null;
 
-    invariant(valid, "Virtual file system must be an object mapping string type keys to Array|Float32Array type values");
+    invariant(valid, "Virtual file system must be an object mapping string type keys to Array|Float32Array|Array<Float32Array> type values");
 
     Object.keys(vfs).forEach(function(key) {
       const validValue = typeof vfs[key] === 'object' &&
         (Array.isArray(vfs[key]) || (vfs[key] instanceof Float32Array));
 
-      invariant(validValue, "Virtual file system must be an object mapping string type keys to Array|Float32Array type values");
+      invariant(validValue, "Virtual file system must be an object mapping string type keys to Array|Float32Array|Array<Float32Array> type values");
     });
 
-    this._worklet.port.postMessage({
+    this._postMessage({
       type: 'updateSharedResourceMap',
       resources: vfs,
     });
   }
 
+  // Removes every entry of the virtual file system that the current graph doesn't use
+  pruneVirtualFileSystem() {
+    this._postMessage({
+      type: 'pruneSharedResourceMap',
+    });
+  }
+
   reset() {
     if (this._worklet) {
-      this._worklet.port.postMessage({
+      this._postMessage({
         type: 'reset',
       });
     }
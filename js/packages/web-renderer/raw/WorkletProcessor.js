@@ -29,8 +29,27 @@ class ElementaryAudioWorkletProcessor extends AudioWorkletProcessor {
       typeof options.processorOptions === 'object' &&
       options.processorOptions !== null;
 
+    // Views onto the native input and output buffers, cached across calls to process
+    this._inputViews = [];
+    this._outputViews = [];
+
     if (hasProcOpts) {
-      const {virtualFileSystem, ...other} = options.processorOptions;
+      const {virtualFileSystem, sharedMemory, ...other} = options.processorOptions;
+
+      // When the renderer frontend supports it, instructions and events pass through a
+      // pair of SharedArrayBuffer rings instead of the message port. The SharedRingBuffer
+      // class is injected into this scope alongside the processor.
+      if (typeof sharedMemory === 'object' && sharedMemory !== null) {
+        this._instructionRing = new SharedRingBuffer(sharedMemory.instructions);
+        this._eventRing = new SharedRingBuffer(sharedMemory.events);
+        this._eventInterval = Math.max(1, Math.round(sampleRate * sharedMemory.eventInterval / 1000));
+        this._samplesSinceEvents = 0;
+
+        // Messages from the port, each of which waits for its marker in the instruction
+        // ring so that everything applies in the order the frontend sent it
+        this._portMessages = [];
+        this._markerScratch = new Uint8Array(4);
+      }
 
       const validVFS = typeof virtualFileSystem === 'object' &&
         virtualFileSystem !== null &&
@@ -49,37 +68,13 @@ class ElementaryAudioWorkletProcessor extends AudioWorkletProcessor {
     }
 
     this.port.onmessage = (e) => {
-      switch (e.data.type) {
-        case 'renderInstructions':
-          this._native.postMessageBatch(e.data.batch, (type, msg) => {
-            // This callback will only be called in the event of an error, we just relay
-            // it to the renderer frontend.
-            this.port.postMessage([type, msg]);
-          });
-
-          break;
-        case 'processQueuedEvents':
-          this._native.processQueuedEvents((evtBatch) => {
-            evtBatch.forEach((e) => {
-              this.port.postMessage(e);
-            });
-          });
-
-          break;
-        case 'updateSharedResourceMap':
-          for (let [key, val] of Object.entries(e.data.resources)) {
-            this._native.updateSharedResourceMap(key, val, (message) => {
-              this.port.postMessage(['error', message]);
-            });
-          }
-
-          break;
-        case 'reset':
-          this._native.reset();
-          break;
-        default:
-          break;
+      if (this._instructionRing && e.data.type !== 'processQueuedEvents') {
+        this._portMessages.push(e.data);
+        this._applySharedInstructions();
+        return;
       }
+
+      this._handleMessage(e.data);
     };
 
     this.port.postMessage(['load', {
@@ -90,20 +85,104 @@ class ElementaryAudioWorkletProcessor extends AudioWorkletProcessor {
     }]);
   }
 
+  _handleMessage(data) {
+    switch (data.type) {
+      case 'renderInstructions':
+        this._native.postMessageBatch(data.batch, (type, msg) => {
+          // This callback will only be called in the event of an error, we just relay
+          // it to the renderer frontend.
+          this.port.postMessage([type, msg]);
+        });
+
+        break;
+      case 'processQueuedEvents':
+        this._native.processQueuedEvents((evtBatch) => {
+          evtBatch.forEach((e) => {
+            this.port.postMessage(e);
+          });
+        });
+
+        break;
+      case 'updateSharedResourceMap':
+        for (let [key, val] of Object.entries(data.resources)) {
+          this._native.updateSharedResourceMap(key, val, (message) => {
+            this.port.postMessage(['error', message]);
+          });
+        }
+
+        break;
+      case 'pruneSharedResourceMap':
+        this._native.pruneSharedResourceMap();
+        break;
+      case 'reset':
+        this._native.reset();
+        break;
+      default:
+        break;
+    }
+  }
+
+  // Applies every instruction batch waiting in the shared instruction ring, in order
+  // with the messages sent over the port
+  _applySharedInstructions() {
+    const onError = (type, msg) => {
+      this.port.postMessage([type, msg]);
+    };
+
+    let length;
+
+    while ((length = this._instructionRing.nextLength()) > 0) {
+      // Every encoded batch is longer than its header, so a single word is a marker
+      // for the next message from the port, which may not have arrived yet
+      if (length === 4) {
+        if (this._portMessages.length === 0) {
+          break;
+        }
+
+        this._instructionRing.readInto(this._markerScratch);
+        this._handleMessage(this._portMessages.shift());
+        continue;
+      }
+
+      this._instructionRing.readInto(this._native.getInstructionBuffer(length));
+      this._native.applyBinaryInstructions(length, onError);
+    }
+  }
+
+  // Writes any queued events into the shared event ring. If the frontend has fallen so
+  // far behind that the ring is full, the batch is dropped rather than blocking.
+  _writeSharedEvents() {
+    const encoded = this._native.drainEncodedEvents();
+
+    if (encoded.length > 0) {
+      this._eventRing.write(encoded);
+    }
+  }
+
+  // Returns a view onto a native buffer, recreating it if the module's memory has grown
+  // since, which detaches every existing view
+  _getView(views, index, getter) {
+    let view = views[index];
+
+    if (view === undefined || view.byteLength === 0) {
+      view = views[index] = getter.call(this._native, index);
+    }
+
+    return view;
+  }
+
   process (inputs, outputs, parameters) {
+    if (this._instructionRing) {
+      this._applySharedInstructions();
+    }
+
     if (inputs.length > 0) {
       let m = 0;
 
-      // For each input
+      // For each channel on each input
       for (let i = 0; i < inputs.length; ++i) {
-        // For each channel on this input
         for (let j = 0; j < inputs[i].length; ++j) {
-          const internalInputData = this._native.getInputBufferData(m++);
-
-          // For each sample on this input channel
-          for (let k = 0; k < inputs[i][j].length; ++k) {
-            internalInputData[k] = inputs[i][j][k];
-          }
+          this._getView(this._inputViews, m++, this._native.getInputBufferData).set(inputs[i][j]);
         }
       }
     }
@@ -117,20 +196,24 @@ class ElementaryAudioWorkletProcessor extends AudioWorkletProcessor {
     if (outputs.length > 0) {
       let m = 0;
 
-      // For each output
+      // For each channel on each output
       for (let i = 0; i < outputs.length; ++i) {
-        // For each channel on this output
         for (let j = 0; j < outputs[i].length; ++j) {
-          const internalOutputData = this._native.getOutputBufferData(m++);
-
-          // For each sample on this input channel
-          for (let k = 0; k < outputs[i][j].length; ++k) {
-            outputs[i][j][k] = internalOutputData[k];
-          }
+          const internalOutputData = this._getView(this._outputViews, m++, this._native.getOutputBufferData);
+          outputs[i][j].set(internalOutputData.subarray(0, outputs[i][j].length));
         }
       }
     }
 
+    if (this._eventRing) {
+      this._samplesSinceEvents += numSamples;
+
+      if (this._samplesSinceEvents >= this._eventInterval) {
+        this._samplesSinceEvents = 0;
+        this._writeSharedEvents();
+      }
+    }
+
     // Tells the browser to keep this node alive and continue calling process
     return true;
   }
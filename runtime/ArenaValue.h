@@ -0,0 +1,362 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "./deps/json.hpp"
+#include "Invariant.h"
+#include "Value.h"
+
+
+namespace elem
+{
+
+    //==============================================================================
+    // A simple monotonic allocator: allocations bump a pointer through large blocks of
+    // memory, nothing is freed individually, and `reset` releases everything at once
+    // while keeping the memory around for reuse.
+    class MonotonicArena
+    {
+    public:
+        MonotonicArena(size_t initialSize = 64 * 1024)
+            : blockSize(initialSize) {}
+
+        void* allocate(size_t size, size_t alignment)
+        {
+            auto const offset = (used + alignment - 1) & ~(alignment - 1);
+
+            if (blocks.empty() || offset + size > blockSize) {
+                addBlock(size + alignment);
+                return allocate(size, alignment);
+            }
+
+            used = offset + size;
+            return blocks.back().get() + offset;
+        }
+
+        template <typename T>
+        T* allocateArray(size_t n)
+        {
+            return static_cast<T*>(allocate(n * sizeof(T), alignof(T)));
+        }
+
+        // Releases all allocations. If the last round of allocations overflowed into more
+        // than one block, we replace them with a single block large enough to hold them all
+        // so that subsequent rounds of a similar size never need to allocate.
+        void reset()
+        {
+            if (blocks.size() > 1) {
+                auto const total = blockSize * 2;
+
+                blocks.clear();
+                blockSize = total;
+                blocks.push_back(std::make_unique<std::byte[]>(blockSize));
+            }
+
+            used = 0;
+        }
+
+    private:
+        void addBlock(size_t minSize)
+        {
+            // Grow geometrically once we overflow the first block
+            blockSize = std::max(blocks.empty() ? blockSize : blockSize * 2, minSize);
+            blocks.push_back(std::make_unique<std::byte[]>(blockSize));
+            used = 0;
+        }
+
+        std::vector<std::unique_ptr<std::byte[]>> blocks;
+        size_t blockSize = 0;
+        size_t used = 0;
+    };
+
+namespace js
+{
+
+    //==============================================================================
+    // A read-only view of a parsed JSON value whose strings, arrays and objects all
+    // live in a MonotonicArena.
+    //
+    // This exists for transient data like instruction batches, where we only need to
+    // walk the structure once and pick out a few values. Individual values can be
+    // converted to a heap-backed js::Value where a longer lifetime is needed.
+    struct ArenaMember;
+
+    struct ArenaValue
+    {
+        enum class Type : uint8_t {
+            Undefined,
+            Null,
+            Boolean,
+            Number,
+            String,
+            Array,
+            Object,
+        };
+
+        Type type = Type::Undefined;
+        bool boolean = false;
+        double number = 0;
+
+        // For strings, the number of characters; for arrays and objects, the number of
+        // items or members respectively
+        size_t size = 0;
+
+        char const* chars = nullptr;
+        ArenaValue const* items = nullptr;
+        ArenaMember const* members = nullptr;
+
+        bool isUndefined()  const { return type == Type::Undefined; }
+        bool isNull()       const { return type == Type::Null; }
+        bool isBool()       const { return type == Type::Boolean; }
+        bool isNumber()     const { return type == Type::Number; }
+        bool isString()     const { return type == Type::String; }
+        bool isArray()      const { return type == Type::Array; }
+        bool isObject()     const { return type == Type::Object; }
+
+        std::string_view getString() const { return std::string_view(chars, size); }
+
+        // Bounds checked array element access
+        ArenaValue const& at(size_t i) const
+        {
+            invariant(isArray() && i < size, "Array index out of range.");
+            return items[i];
+        }
+
+        // Copies this value out of the arena into a regular js::Value
+        Value toValue() const;
+    };
+
+    struct ArenaMember
+    {
+        std::string_view key;
+        ArenaValue value;
+    };
+
+    inline Value ArenaValue::toValue() const
+    {
+        switch (type) {
+            case Type::Null:
+                return Null();
+            case Type::Boolean:
+                return Boolean(boolean);
+            case Type::Number:
+                return Number(number);
+            case Type::String:
+                return String(chars, size);
+            case Type::Array: {
+                Array a;
+                a.reserve(size);
+
+                for (size_t i = 0; i < size; ++i) {
+                    a.push_back(items[i].toValue());
+                }
+
+                return a;
+            }
+            case Type::Object: {
+                Object o;
+
+                for (size_t i = 0; i < size; ++i) {
+                    o.insert_or_assign(String(members[i].key), members[i].value.toValue());
+                }
+
+                return o;
+            }
+            default:
+                break;
+        }
+
+        return Undefined();
+    }
+
+    //==============================================================================
+    // Parses JSON strings into ArenaValues.
+    //
+    // Each call to `parse` resets the arena, invalidating the result of the previous
+    // call, and reuses both the arena memory and the parser's scratch space. After the
+    // first few calls, parsing a batch of a similar size makes no heap allocations beyond
+    // those made internally by the JSON tokenizer.
+    class ArenaJSONParser
+    {
+    public:
+        ArenaJSONParser() = default;
+
+        ArenaValue const& parse(std::string_view str)
+        {
+            arena.reset();
+
+            sax.frames.clear();
+            sax.values.clear();
+            sax.members.clear();
+            sax.top = ArenaValue();
+
+            if (!nlohmann::json::sax_parse(str.begin(), str.end(), &sax))
+                throw std::runtime_error("Failed to parse json string.");
+
+            return sax.top;
+        }
+
+    private:
+        struct SaxConsumer : public nlohmann::json::json_sax_t
+        {
+            SaxConsumer(MonotonicArena& a) : arena(a) {}
+
+            // Arrays and objects under construction accumulate their contents on the
+            // scratch stacks below, and are copied into the arena once complete
+            struct Frame {
+                bool isObject;
+                size_t start;
+
+                // The key under which this value will be written into its parent, if
+                // the parent is an object
+                std::string_view key;
+            };
+
+            MonotonicArena& arena;
+
+            std::vector<Frame> frames;
+            std::vector<ArenaValue> values;
+            std::vector<ArenaMember> members;
+            std::string_view pendingKey;
+            ArenaValue top;
+
+            std::string_view copyString(std::string const& s)
+            {
+                auto* chars = arena.allocateArray<char>(s.size() + 1);
+                std::memcpy(chars, s.data(), s.size());
+
+                return std::string_view(chars, s.size());
+            }
+
+            bool push(ArenaValue const& v)
+            {
+                if (frames.empty()) {
+                    top = v;
+                } else if (frames.back().isObject) {
+                    members.push_back({ pendingKey, v });
+                } else {
+                    values.push_back(v);
+                }
+
+                return true;
+            }
+
+            template <typename T>
+            T const* popInto(std::vector<T>& stack, size_t start)
+            {
+                auto const n = stack.size() - start;
+                auto* items = arena.allocateArray<T>(n > 0 ? n : 1);
+
+                std::uninitialized_copy(stack.begin() + start, stack.end(), items);
+                stack.resize(start);
+
+                return items;
+            }
+
+            bool null() override
+            {
+                ArenaValue v;
+                v.type = ArenaValue::Type::Null;
+                return push(v);
+            }
+
+            bool boolean(bool val) override
+            {
+                ArenaValue v;
+                v.type = ArenaValue::Type::Boolean;
+                v.boolean = val;
+                return push(v);
+            }
+
+            bool number(double val)
+            {
+                ArenaValue v;
+                v.type = ArenaValue::Type::Number;
+                v.number = val;
+                return push(v);
+            }
+
+            bool number_integer(number_integer_t val) override { return number((double) val); }
+            bool number_unsigned(number_unsigned_t val) override { return number((double) val); }
+            bool number_float(number_float_t val, const string_t& /* s */) override { return number((double) val); }
+
+            bool string(string_t& val) override
+            {
+                auto const s = copyString(val);
+
+                ArenaValue v;
+                v.type = ArenaValue::Type::String;
+                v.chars = s.data();
+                v.size = s.size();
+                return push(v);
+            }
+
+            bool start_object(std::size_t /* elements */) override
+            {
+                frames.push_back({ true, members.size(), pendingKey });
+                return true;
+            }
+
+            bool end_object() override
+            {
+                auto const frame = frames.back();
+                frames.pop_back();
+
+                ArenaValue v;
+                v.type = ArenaValue::Type::Object;
+                v.size = members.size() - frame.start;
+                v.members = popInto(members, frame.start);
+
+                pendingKey = frame.key;
+                return push(v);
+            }
+
+            bool start_array(std::size_t /* elements */) override
+            {
+                frames.push_back({ false, values.size(), pendingKey });
+                return true;
+            }
+
+            bool end_array() override
+            {
+                auto const frame = frames.back();
+                frames.pop_back();
+
+                ArenaValue v;
+                v.type = ArenaValue::Type::Array;
+                v.size = values.size() - frame.start;
+                v.items = popInto(values, frame.start);
+
+                pendingKey = frame.key;
+                return push(v);
+            }
+
+            bool key(string_t& val) override
+            {
+                pendingKey = copyString(val);
+                return true;
+            }
+
+            bool binary(nlohmann::json::binary_t& /* val */) override
+            {
+                throw std::runtime_error("Deserializing binary is not supported.");
+            }
+
+            bool parse_error(std::size_t /* position */, const std::string& /* last_token */, const nlohmann::json::exception& ex) override
+            {
+                throw std::runtime_error("Parse error:" + std::string(ex.what()));
+            }
+        };
+
+        MonotonicArena arena;
+        SaxConsumer sax { arena };
+    };
+
+} // namespace js
+} // namespace elem
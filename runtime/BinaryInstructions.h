@@ -0,0 +1,442 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Invariant.h"
+#include "Value.h"
+
+
+namespace elem
+{
+
+    //==============================================================================
+    // A compact binary encoding of an instruction batch, as an alternative to the
+    // nested arrays which `Runtime::applyInstructions` otherwise receives from JSON.
+    //
+    // All fields are 4-byte aligned little-endian words. A batch is laid out as:
+    //
+    //   u32 magic ("ELBI"), u32 version
+    //   u32 numStrings, then for each string: u32 byteLength, bytes padded to 4
+    //   instructions, until the end of the buffer
+    //
+    // Node types and property keys are written once into the string table and then
+    // referred to by index. Each instruction is a u32 opcode followed by its operands:
+    //
+    //   CREATE_NODE     i32 nodeId, u32 typeIndex
+    //   DELETE_NODE     i32 nodeId
+    //   APPEND_CHILD    i32 parentId, i32 childId
+    //   SET_PROPERTY    i32 nodeId, u32 keyIndex, value
+    //   ACTIVATE_ROOTS  u32 count, i32 nodeIds...
+    //   COMMIT_UPDATES
+    //
+    // And a value is a u32 tag followed by its payload, per the ValueTag enum below.
+    // Arrays made up entirely of numbers are written as a single packed block of doubles.
+    namespace binary
+    {
+        static constexpr uint32_t kMagic = 0x49424c45; // "ELBI"
+        static constexpr uint32_t kVersion = 1;
+
+        enum class Opcode : uint32_t {
+            CREATE_NODE = 0,
+            DELETE_NODE = 1,
+            APPEND_CHILD = 2,
+            SET_PROPERTY = 3,
+            ACTIVATE_ROOTS = 4,
+            COMMIT_UPDATES = 5,
+        };
+
+        enum class ValueTag : uint32_t {
+            Undefined = 0,      // no payload
+            Null = 1,           // no payload
+            Boolean = 2,        // u32
+            Number = 3,         // f64
+            String = 4,         // u32 string index
+            Array = 5,          // u32 count, values...
+            NumberArray = 6,    // u32 count, f64s...
+            Float32Array = 7,   // u32 count, f32s...
+            Object = 8,         // u32 count, (u32 key index, value)...
+        };
+    }
+
+    //==============================================================================
+    // Writes instructions into the binary batch format.
+    class BinaryInstructionWriter
+    {
+    public:
+        BinaryInstructionWriter() = default;
+
+        void createNode(int32_t nodeId, std::string const& type)
+        {
+            writeOpcode(binary::Opcode::CREATE_NODE);
+            write(nodeId);
+            write(intern(type));
+        }
+
+        void deleteNode(int32_t nodeId)
+        {
+            writeOpcode(binary::Opcode::DELETE_NODE);
+            write(nodeId);
+        }
+
+        void appendChild(int32_t parentId, int32_t childId)
+        {
+            writeOpcode(binary::Opcode::APPEND_CHILD);
+            write(parentId);
+            write(childId);
+        }
+
+        void setProperty(int32_t nodeId, std::string const& key, js::Value const& v)
+        {
+            writeOpcode(binary::Opcode::SET_PROPERTY);
+            write(nodeId);
+            write(intern(key));
+            writeValue(v);
+        }
+
+        void activateRoots(std::vector<int32_t> const& roots)
+        {
+            writeOpcode(binary::Opcode::ACTIVATE_ROOTS);
+            write(static_cast<uint32_t>(roots.size()));
+
+            for (auto const r : roots) {
+                write(r);
+            }
+        }
+
+        void commitUpdates()
+        {
+            writeOpcode(binary::Opcode::COMMIT_UPDATES);
+        }
+
+        // Returns the complete batch, leaving the writer empty and ready for the next one
+        std::vector<uint8_t> finish()
+        {
+            std::vector<uint8_t> result;
+
+            auto append = [&](void const* data, size_t size) {
+                auto const* bytes = static_cast<uint8_t const*>(data);
+                result.insert(result.end(), bytes, bytes + size);
+            };
+
+            auto appendWord = [&](uint32_t w) {
+                append(&w, sizeof(w));
+            };
+
+            appendWord(binary::kMagic);
+            appendWord(binary::kVersion);
+            appendWord(static_cast<uint32_t>(strings.size()));
+
+            for (auto const& s : strings) {
+                appendWord(static_cast<uint32_t>(s.size()));
+                append(s.data(), s.size());
+                result.resize((result.size() + 3) & ~size_t(3), 0);
+            }
+
+            append(body.data(), body.size());
+
+            strings.clear();
+            stringIndices.clear();
+            body.clear();
+
+            return result;
+        }
+
+        // Encodes a batch given in the same nested array form accepted by
+        // `Runtime::applyInstructions(js::Array const&)`
+        static std::vector<uint8_t> encode(js::Array const& batch)
+        {
+            BinaryInstructionWriter writer;
+
+            auto toId = [](js::Value const& v) {
+                invariant(v.isNumber(), "Expected a number type node identifier.");
+                return static_cast<int32_t>((js::Number) v);
+            };
+
+            for (auto const& next : batch) {
+                invariant(next.isArray(), "Expected a command array.");
+                auto const& ar = next.getArray();
+
+                invariant(ar.size() > 0 && ar[0].isNumber(), "Expected a number type command.");
+
+                switch (static_cast<binary::Opcode>(static_cast<int>((js::Number) ar[0]))) {
+                    case binary::Opcode::CREATE_NODE:
+                        writer.createNode(toId(ar.at(1)), (js::String) ar.at(2));
+                        break;
+                    case binary::Opcode::DELETE_NODE:
+                        writer.deleteNode(toId(ar.at(1)));
+                        break;
+                    case binary::Opcode::APPEND_CHILD:
+                        writer.appendChild(toId(ar.at(1)), toId(ar.at(2)));
+                        break;
+                    case binary::Opcode::SET_PROPERTY:
+                        writer.setProperty(toId(ar.at(1)), (js::String) ar.at(2), ar.at(3));
+                        break;
+                    case binary::Opcode::ACTIVATE_ROOTS: {
+                        std::vector<int32_t> roots;
+
+                        for (auto const& r : ar.at(1).getArray()) {
+                            roots.push_back(toId(r));
+                        }
+
+                        writer.activateRoots(roots);
+                        break;
+                    }
+                    case binary::Opcode::COMMIT_UPDATES:
+                        writer.commitUpdates();
+                        break;
+                    default:
+                        break;
+                }
+            }
+
+            return writer.finish();
+        }
+
+    private:
+        uint32_t intern(std::string const& s)
+        {
+            if (auto it = stringIndices.find(s); it != stringIndices.end()) {
+                return it->second;
+            }
+
+            auto const index = static_cast<uint32_t>(strings.size());
+
+            strings.push_back(s);
+            stringIndices.emplace(s, index);
+
+            return index;
+        }
+
+        template <typename T>
+        void write(T const& v)
+        {
+            static_assert(sizeof(T) % 4 == 0);
+
+            auto const* bytes = reinterpret_cast<uint8_t const*>(&v);
+            body.insert(body.end(), bytes, bytes + sizeof(T));
+        }
+
+        void writeOpcode(binary::Opcode op) { write(static_cast<uint32_t>(op)); }
+        void writeTag(binary::ValueTag tag) { write(static_cast<uint32_t>(tag)); }
+
+        void writeValue(js::Value const& v)
+        {
+            if (v.isUndefined()) { return writeTag(binary::ValueTag::Undefined); }
+            if (v.isNull()) { return writeTag(binary::ValueTag::Null); }
+
+            if (v.isBool()) {
+                writeTag(binary::ValueTag::Boolean);
+                return write(static_cast<uint32_t>((js::Boolean) v));
+            }
+
+            if (v.isNumber()) {
+                writeTag(binary::ValueTag::Number);
+                return write((js::Number) v);
+            }
+
+            if (v.isString()) {
+                writeTag(binary::ValueTag::String);
+                return write(intern((js::String) v));
+            }
+
+            if (v.isFloat32Array()) {
+                auto const& fa = v.getFloat32Array();
+
+                writeTag(binary::ValueTag::Float32Array);
+                write(static_cast<uint32_t>(fa.size()));
+
+                for (auto const x : fa) {
+                    write(x);
+                }
+
+                return;
+            }
+
+            if (v.isArray()) {
+                auto const& ar = v.getArray();
+                bool const allNumbers = std::all_of(ar.begin(), ar.end(), [](js::Value const& x) { return x.isNumber(); });
+
+                writeTag(allNumbers ? binary::ValueTag::NumberArray : binary::ValueTag::Array);
+                write(static_cast<uint32_t>(ar.size()));
+
+                for (auto const& x : ar) {
+                    if (allNumbers) {
+                        write((js::Number) x);
+                    } else {
+                        writeValue(x);
+                    }
+                }
+
+                return;
+            }
+
+            if (v.isObject()) {
+                auto const& o = v.getObject();
+
+                writeTag(binary::ValueTag::Object);
+                write(static_cast<uint32_t>(o.size()));
+
+                for (auto const& [k, x] : o) {
+                    write(intern(k));
+                    writeValue(x);
+                }
+
+                return;
+            }
+
+            invariant(false, "Unsupported value type for the binary instruction format.");
+        }
+
+        std::vector<std::string> strings;
+        std::unordered_map<std::string, uint32_t> stringIndices;
+        std::vector<uint8_t> body;
+    };
+
+    //==============================================================================
+    // Reads instructions directly out of a binary batch without first building an
+    // intermediate tree of values. Only property values are materialized as js::Value.
+    //
+    // The reader does not take a copy of the given buffer, which must outlive it.
+    class BinaryInstructionReader
+    {
+    public:
+        BinaryInstructionReader(uint8_t const* data, size_t size)
+            : data(data), size(size)
+        {
+            invariant(read<uint32_t>() == binary::kMagic, "Invalid binary instruction batch.");
+            invariant(read<uint32_t>() == binary::kVersion, "Unsupported binary instruction batch version.");
+
+            auto const numStrings = read<uint32_t>();
+            invariant(numStrings <= remaining() / 4, "Invalid binary instruction batch string table.");
+
+            strings.reserve(numStrings);
+
+            for (uint32_t i = 0; i < numStrings; ++i) {
+                // Each string is padded out to a whole word, and the padding has to fit
+                // as well or the cursor would run past the end of the batch
+                auto const length = read<uint32_t>();
+                auto const padded = (static_cast<size_t>(length) + 3) & ~size_t(3);
+                invariant(padded <= remaining(), "Invalid binary instruction batch string table.");
+
+                strings.emplace_back(reinterpret_cast<char const*>(data + pos), length);
+                pos += padded;
+            }
+        }
+
+        bool hasNext() const { return pos < size; }
+
+        binary::Opcode readOpcode() { return static_cast<binary::Opcode>(read<uint32_t>()); }
+        int32_t readNodeId() { return read<int32_t>(); }
+        uint32_t readCount() { return read<uint32_t>(); }
+
+        std::string const& readString()
+        {
+            auto const index = read<uint32_t>();
+            invariant(index < strings.size(), "Invalid string index in binary instruction batch.");
+
+            return strings[index];
+        }
+
+        js::Value readValue()
+        {
+            switch (static_cast<binary::ValueTag>(read<uint32_t>())) {
+                case binary::ValueTag::Undefined:
+                    return js::Undefined();
+                case binary::ValueTag::Null:
+                    return js::Null();
+                case binary::ValueTag::Boolean:
+                    return js::Boolean(read<uint32_t>() != 0);
+                case binary::ValueTag::Number:
+                    return js::Number(read<double>());
+                case binary::ValueTag::String:
+                    return readString();
+                case binary::ValueTag::Array: {
+                    auto const n = readBoundedCount(4);
+                    js::Array ar;
+                    ar.reserve(n);
+
+                    for (uint32_t i = 0; i < n; ++i) {
+                        ar.push_back(readValue());
+                    }
+
+                    return ar;
+                }
+                case binary::ValueTag::NumberArray: {
+                    auto const n = readBoundedCount(sizeof(double));
+                    js::Array ar;
+                    ar.reserve(n);
+
+                    for (uint32_t i = 0; i < n; ++i) {
+                        ar.push_back(js::Number(read<double>()));
+                    }
+
+                    return ar;
+                }
+                case binary::ValueTag::Float32Array: {
+                    auto const n = readBoundedCount(sizeof(float));
+                    js::Float32Array fa(n);
+
+                    if (n > 0) {
+                        std::memcpy(fa.data(), data + pos, n * sizeof(float));
+                        pos += n * sizeof(float);
+                    }
+
+                    return fa;
+                }
+                case binary::ValueTag::Object: {
+                    auto const n = readBoundedCount(8);
+                    js::Object o;
+
+                    for (uint32_t i = 0; i < n; ++i) {
+                        auto const& k = readString();
+                        o.insert_or_assign(k, readValue());
+                    }
+
+                    return o;
+                }
+                default:
+                    break;
+            }
+
+            invariant(false, "Invalid value tag in binary instruction batch.");
+            return js::Undefined();
+        }
+
+    private:
+        size_t remaining() const { return size - pos; }
+
+        template <typename T>
+        T read()
+        {
+            invariant(sizeof(T) <= remaining(), "Unexpected end of binary instruction batch.");
+
+            T v;
+            std::memcpy(&v, data + pos, sizeof(T));
+            pos += sizeof(T);
+
+            return v;
+        }
+
+        // Reads an element count, checking that the buffer is large enough to hold at
+        // least that many elements of the given minimum size before we allocate for them
+        uint32_t readBoundedCount(size_t minElementSize)
+        {
+            auto const n = read<uint32_t>();
+            invariant(n <= remaining() / minElementSize, "Unexpected end of binary instruction batch.");
+
+            return n;
+        }
+
+        uint8_t const* data;
+        size_t size;
+        size_t pos = 0;
+
+        std::vector<std::string> strings;
+    };
+
+} // namespace elem
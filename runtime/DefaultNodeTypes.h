@@ -2,7 +2,10 @@
 
 #include <cmath>
 
+#include "NodeArena.h"
+
 #include "builtins/Analyzers.h"
+#include "builtins/Convolve.h"
 #include "builtins/Core.h"
 #include "builtins/Delays.h"
 #include "builtins/Feedback.h"
@@ -14,6 +17,7 @@
 #include "builtins/Sample.h"
 #include "builtins/Seq2.h"
 #include "builtins/SparSeq.h"
+#include "builtins/Spectral.h"
 #include "builtins/Table.h"
 
 
@@ -22,13 +26,13 @@ namespace elem
 
     namespace detail
     {
-        /** A quick helper factory for default node types. */
+        /** A quick helper factory for default node types, which allocates from the runtime's NodeArena. */
         template <typename NodeType>
         struct GenericNodeFactory
         {
             template <typename NodeIdType>
             auto operator() (NodeIdType const id, double fs, int const blockSize) {
-                return std::make_shared<NodeType>(id, fs, blockSize);
+                return NodeArena::makeShared<NodeType>(id, fs, blockSize);
             }
         };
     }
@@ -42,18 +46,26 @@ namespace elem
 
             // Unary math nodes
             callback("in",        GenericNodeFactory<IdentityNode<FloatType>>());
+#ifdef ELEM_USE_FAST_MATH
+            callback("sin",       GenericNodeFactory<UnaryOperationNode<FloatType, fastmath::sin>>());
+            callback("cos",       GenericNodeFactory<UnaryOperationNode<FloatType, fastmath::cos>>());
+            callback("tanh",      GenericNodeFactory<UnaryOperationNode<FloatType, fastmath::tanh>>());
+            callback("ln",        GenericNodeFactory<UnaryOperationNode<FloatType, fastmath::log>>());
+            callback("exp",       GenericNodeFactory<UnaryOperationNode<FloatType, fastmath::exp>>());
+#else
             callback("sin",       GenericNodeFactory<UnaryOperationNode<FloatType, std::sin>>());
             callback("cos",       GenericNodeFactory<UnaryOperationNode<FloatType, std::cos>>());
-            callback("tan",       GenericNodeFactory<UnaryOperationNode<FloatType, std::tan>>());
             callback("tanh",      GenericNodeFactory<UnaryOperationNode<FloatType, std::tanh>>());
-            callback("asinh",     GenericNodeFactory<UnaryOperationNode<FloatType, std::asinh>>());
             callback("ln",        GenericNodeFactory<UnaryOperationNode<FloatType, std::log>>());
+            callback("exp",       GenericNodeFactory<UnaryOperationNode<FloatType, std::exp>>());
+#endif
+            callback("tan",       GenericNodeFactory<UnaryOperationNode<FloatType, std::tan>>());
+            callback("asinh",     GenericNodeFactory<UnaryOperationNode<FloatType, std::asinh>>());
             callback("log",       GenericNodeFactory<UnaryOperationNode<FloatType, std::log10>>());
             callback("log2",      GenericNodeFactory<UnaryOperationNode<FloatType, std::log2>>());
             callback("ceil",      GenericNodeFactory<UnaryOperationNode<FloatType, std::ceil>>());
             callback("floor",     GenericNodeFactory<UnaryOperationNode<FloatType, std::floor>>());
             callback("sqrt",      GenericNodeFactory<UnaryOperationNode<FloatType, std::sqrt>>());
-            callback("exp",       GenericNodeFactory<UnaryOperationNode<FloatType, std::exp>>());
             callback("abs",       GenericNodeFactory<UnaryOperationNode<FloatType, std::abs>>());
 
             // Binary math nodes
@@ -93,6 +105,7 @@ namespace elem
             // Delay nodes
             callback("delay",     GenericNodeFactory<VariableDelayNode<FloatType>>());
             callback("sdelay",    GenericNodeFactory<SampleDelayNode<FloatType>>());
+            callback("multitap",  GenericNodeFactory<MultiTapDelayNode<FloatType>>());
             callback("z",         GenericNodeFactory<SingleSampleDelayNode<FloatType>>());
 
             // Filter nodes
@@ -109,11 +122,17 @@ namespace elem
             // Sample/Buffer nodes
             callback("sample",    GenericNodeFactory<SampleNode<FloatType>>());
             callback("table",     GenericNodeFactory<TableNode<FloatType>>());
+            callback("convolve",  GenericNodeFactory<ConvolutionNode<FloatType>>());
+
+            // Spectral nodes
+            callback("spectralgate",    GenericNodeFactory<StftNode<FloatType, SpectralGateKernel<FloatType>>>());
+            callback("spectralfreeze",  GenericNodeFactory<StftNode<FloatType, SpectralFreezeKernel<FloatType>>>());
 
             // Analyzer nodes
             callback("meter",     GenericNodeFactory<MeterNode<FloatType>>());
             callback("scope",     GenericNodeFactory<ScopeNode<FloatType>>());
             callback("snapshot",  GenericNodeFactory<SnapshotNode<FloatType>>());
+            callback("fft",       GenericNodeFactory<FFTNode<FloatType>>());
         }
     };
 
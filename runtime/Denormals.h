@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+  #include <xmmintrin.h>
+  #define ELEM_HAS_FLUSH_TO_ZERO 1
+  #define ELEM_FLUSH_TO_ZERO_SSE 1
+#elif defined(__aarch64__) && !defined(_MSC_VER)
+  #define ELEM_HAS_FLUSH_TO_ZERO 1
+  #define ELEM_FLUSH_TO_ZERO_AARCH64 1
+#elif defined(__arm__) && defined(__ARM_FP) && !defined(_MSC_VER)
+  #define ELEM_HAS_FLUSH_TO_ZERO 1
+  #define ELEM_FLUSH_TO_ZERO_ARM 1
+#endif
+
+
+namespace elem
+{
+
+    //==============================================================================
+    // Arithmetic on subnormal numbers, those too small for the full precision of their
+    // type, is many times slower than on any other on most x86 CPUs. Decaying signals,
+    // like the state of a filter or the tail of a feedback loop, pass through them on
+    // their way to zero and can stall the render pass for as long as they do.
+    //
+    // Where the CPU allows it, the floating point unit can instead flush subnormal
+    // results to zero, and on x86 also read subnormal inputs as zero: the FTZ and DAZ
+    // modes. Those are part of each thread's state, and the runtime turns them on while
+    // it renders. Elsewhere, as on WebAssembly, there's no such mode, and the nodes which
+    // carry a decaying signal from one block to the next flush it themselves with
+    // `flushDenormal`, see kHasFlushToZero.
+    namespace detail
+    {
+        // Whether the calling thread flushes subnormals to zero
+        inline bool isFlushingDenormals()
+        {
+#if defined(ELEM_FLUSH_TO_ZERO_SSE)
+            return (_mm_getcsr() & 0x8040) == 0x8040;
+#elif defined(ELEM_FLUSH_TO_ZERO_AARCH64)
+            uint64_t fpcr;
+            asm volatile("mrs %0, fpcr" : "=r"(fpcr));
+            return (fpcr & (uint64_t(1) << 24)) != 0;
+#elif defined(ELEM_FLUSH_TO_ZERO_ARM)
+            uint32_t fpscr;
+            asm volatile("vmrs %0, fpscr" : "=r"(fpscr));
+            return (fpscr & (uint32_t(1) << 24)) != 0;
+#else
+            return false;
+#endif
+        }
+
+        inline void setFlushingDenormals(bool enabled)
+        {
+#if defined(ELEM_FLUSH_TO_ZERO_SSE)
+            auto const csr = _mm_getcsr();
+            _mm_setcsr(enabled ? (csr | 0x8040) : (csr & ~0x8040u));
+#elif defined(ELEM_FLUSH_TO_ZERO_AARCH64)
+            uint64_t fpcr;
+            asm volatile("mrs %0, fpcr" : "=r"(fpcr));
+            fpcr = enabled ? (fpcr | (uint64_t(1) << 24)) : (fpcr & ~(uint64_t(1) << 24));
+            asm volatile("msr fpcr, %0" : : "r"(fpcr));
+#elif defined(ELEM_FLUSH_TO_ZERO_ARM)
+            uint32_t fpscr;
+            asm volatile("vmrs %0, fpscr" : "=r"(fpscr));
+            fpscr = enabled ? (fpscr | (uint32_t(1) << 24)) : (fpscr & ~(uint32_t(1) << 24));
+            asm volatile("vmsr fpscr, %0" : : "r"(fpscr));
+#else
+            (void) enabled;
+#endif
+        }
+    }
+
+#if defined(ELEM_HAS_FLUSH_TO_ZERO)
+    inline constexpr bool kHasFlushToZero = true;
+#else
+    inline constexpr bool kHasFlushToZero = false;
+#endif
+
+    // Flushes subnormals to zero on the calling thread for as long as it's alive, if
+    // `enabled`, and then puts back the mode it found. Does nothing where the CPU has no
+    // such mode.
+    class ScopedFlushDenormals
+    {
+    public:
+        explicit ScopedFlushDenormals(bool enabled = true)
+            : previous(detail::isFlushingDenormals())
+            , changed(enabled != previous)
+        {
+            if (changed) {
+                detail::setFlushingDenormals(enabled);
+            }
+        }
+
+        ~ScopedFlushDenormals()
+        {
+            if (changed) {
+                detail::setFlushingDenormals(previous);
+            }
+        }
+
+        ScopedFlushDenormals(ScopedFlushDenormals const&) = delete;
+
+    private:
+        bool previous;
+        bool changed;
+    };
+
+    // Returns zero for a subnormal value, and the value itself otherwise. This is the
+    // fallback for the nodes which keep a recursive state, where the CPU can't flush
+    // subnormals itself, and is applied to that state once a block.
+    template <typename FloatType>
+    inline FloatType flushDenormal(FloatType x)
+    {
+        if constexpr (kHasFlushToZero) {
+            return x;
+        } else {
+            return std::abs(x) < std::numeric_limits<FloatType>::min() ? FloatType(0) : x;
+        }
+    }
+
+} // namespace elem
@@ -0,0 +1,275 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "NodeTypeRegistry.h"
+#include "RenderThreadPool.h"
+#include "Runtime.h"
+#include "Types.h"
+
+
+namespace elem
+{
+
+    //==============================================================================
+    // A host for many independent runtimes, say one per session on a server, which
+    // share what they can rather than each holding a copy of it.
+    //
+    // Every session's runtime creates its nodes through the engine's registry of node
+    // types, and plays resources from the engine's SharedResourceStore, so that a sample
+    // library added once is held in memory once however many sessions play from it.
+    // Sessions may still add resources of their own through their runtime.
+    //
+    // Rendering is driven by calls to `process`, which renders one block of every
+    // session across a pool of worker threads and the calling thread. Each session has
+    // its own input and output buffers, which the host fills and reads between calls,
+    // and a deadline by which its block should be done, counted from the start of the
+    // call. Sessions are started in order of their deadlines, earliest first, and the
+    // engine accounts for the time each one takes and how often it misses its deadline.
+    //
+    // Each session's runtime takes instructions and delivers events on the host's own
+    // non-realtime threads as usual. Its own render threads should be left off, since
+    // the engine's pool already spreads the sessions across cores.
+    template <typename FloatType>
+    class Engine
+    {
+    public:
+        //==============================================================================
+        // Timings for one session, accumulated since the last call to `takeLoadStats`
+        struct LoadStats {
+            uint64_t numBlocks = 0;
+            uint64_t numMissedDeadlines = 0;
+
+            // The time spent rendering, in total and for the slowest block
+            int64_t renderNanos = 0;
+            int64_t peakRenderNanos = 0;
+
+            // The time that the rendered audio represents, against which the render time
+            // gives the session's share of one core
+            int64_t audioNanos = 0;
+
+            double getLoad() const {
+                return audioNanos > 0 ? static_cast<double>(renderNanos) / static_cast<double>(audioNanos) : 0.0;
+            }
+        };
+
+        class Session
+        {
+        public:
+            Session(
+                double sampleRate,
+                int blockSize,
+                size_t numInputChannels,
+                size_t numOutputChannels,
+                std::shared_ptr<NodeTypeRegistry<FloatType> const> nodeTypes,
+                std::shared_ptr<SharedResourceStore<FloatType>> resourceStore
+            )
+                : runtime(sampleRate, blockSize, std::move(nodeTypes), std::move(resourceStore))
+                , blockSize(static_cast<size_t>(blockSize))
+                , inputData(numInputChannels * static_cast<size_t>(blockSize))
+                , outputData(numOutputChannels * static_cast<size_t>(blockSize))
+                , blockNanos(static_cast<int64_t>(1e9 * blockSize / sampleRate))
+                , deadlineNanos(blockNanos)
+            {
+                for (size_t i = 0; i < numInputChannels; ++i)
+                    inputPointers.push_back(inputData.data() + i * this->blockSize);
+
+                for (size_t i = 0; i < numOutputChannels; ++i)
+                    outputPointers.push_back(outputData.data() + i * this->blockSize);
+            }
+
+            Runtime<FloatType>& getRuntime() { return runtime; }
+            size_t getBlockSize() const { return blockSize; }
+
+            // The buffers of one block, which the host fills before each call to the
+            // engine's `process`, and reads after it
+            FloatType* getInputChannel(size_t i) { return inputPointers[i]; }
+            FloatType const* getOutputChannel(size_t i) const { return outputPointers[i]; }
+            size_t getNumInputChannels() const { return inputPointers.size(); }
+            size_t getNumOutputChannels() const { return outputPointers.size(); }
+
+            // Sets the time, from the start of each call to the engine's `process`, by which
+            // this session's block should be rendered. Defaults to the duration of a block.
+            void setDeadline(std::chrono::nanoseconds deadline) { deadlineNanos.store(deadline.count(), std::memory_order_relaxed); }
+            std::chrono::nanoseconds getDeadline() const { return std::chrono::nanoseconds(deadlineNanos.load(std::memory_order_relaxed)); }
+
+            // Returns the session's timings since the last call, and starts counting afresh.
+            // May be called from any thread.
+            LoadStats takeLoadStats()
+            {
+                LoadStats s;
+
+                s.numBlocks = numBlocks.exchange(0, std::memory_order_relaxed);
+                s.numMissedDeadlines = numMissedDeadlines.exchange(0, std::memory_order_relaxed);
+                s.renderNanos = renderNanos.exchange(0, std::memory_order_relaxed);
+                s.peakRenderNanos = peakRenderNanos.exchange(0, std::memory_order_relaxed);
+                s.audioNanos = static_cast<int64_t>(s.numBlocks) * blockNanos;
+
+                return s;
+            }
+
+        private:
+            friend class Engine;
+
+            template <typename TimePoint>
+            void render(TimePoint const& blockStart)
+            {
+                using Clock = typename TimePoint::clock;
+                auto const start = Clock::now();
+
+                runtime.process(
+                    const_cast<FloatType const**>(inputPointers.data()),
+                    inputPointers.size(),
+                    outputPointers.data(),
+                    outputPointers.size(),
+                    blockSize,
+                    nullptr
+                );
+
+                auto const end = Clock::now();
+                auto const nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+
+                numBlocks.fetch_add(1, std::memory_order_relaxed);
+                renderNanos.fetch_add(nanos, std::memory_order_relaxed);
+
+                if (nanos > peakRenderNanos.load(std::memory_order_relaxed))
+                    peakRenderNanos.store(nanos, std::memory_order_relaxed);
+
+                if (end - blockStart > std::chrono::nanoseconds(deadlineNanos.load(std::memory_order_relaxed)))
+                    numMissedDeadlines.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            Runtime<FloatType> runtime;
+            size_t blockSize;
+
+            std::vector<FloatType> inputData;
+            std::vector<FloatType> outputData;
+            std::vector<FloatType*> inputPointers;
+            std::vector<FloatType*> outputPointers;
+
+            int64_t blockNanos;
+            std::atomic<int64_t> deadlineNanos;
+
+            std::atomic<uint64_t> numBlocks = 0;
+            std::atomic<uint64_t> numMissedDeadlines = 0;
+            std::atomic<int64_t> renderNanos = 0;
+            std::atomic<int64_t> peakRenderNanos = 0;
+        };
+
+        //==============================================================================
+        // Renders across `numWorkerThreads` pre-spawned threads alongside the thread which
+        // calls `process`. Sessions create their nodes through `nodeTypes`, which defaults
+        // to the shared registry of the default node types.
+        Engine(size_t numWorkerThreads, std::shared_ptr<NodeTypeRegistry<FloatType> const> nodeTypes = nullptr)
+            : nodeTypes(nodeTypes != nullptr ? std::move(nodeTypes) : NodeTypeRegistry<FloatType>::getDefault())
+            , resourceStore(std::make_shared<SharedResourceStore<FloatType>>())
+            , threadPool(numWorkerThreads)
+        {
+        }
+
+        //==============================================================================
+        // Adds a resource which every session can play, see Runtime::updateSharedResourceMap.
+        // Replacing or removing a resource that sessions are still playing is safe: the
+        // old one is kept until they let go of it, and freed by a later `collectGarbage`.
+        void addSharedResource(std::string const& name, SharedResourceBuffer<FloatType>&& resource)
+        {
+            invariant(resource != nullptr, "cannot add an empty resource to the shared resource store");
+            resourceStore->insert(name, std::move(resource));
+        }
+
+        void removeSharedResource(std::string const& name)
+        {
+            resourceStore->remove(name);
+        }
+
+        // Frees the replaced and removed shared resources which no session refers to any
+        // more, returning how many were freed. Like Runtime::collectGarbage, this frees
+        // memory, so it should be called from a non-realtime thread.
+        size_t collectGarbage()
+        {
+            return resourceStore->releaseRetired();
+        }
+
+        std::shared_ptr<SharedResourceStore<FloatType>> const& getResourceStore() const { return resourceStore; }
+
+        //==============================================================================
+        // Creates a session, which renders from the next call to `process`. Adding and
+        // removing sessions waits for any call to `process` to finish.
+        std::shared_ptr<Session> createSession(double sampleRate, int blockSize, size_t numInputChannels, size_t numOutputChannels)
+        {
+            auto session = std::make_shared<Session>(sampleRate, blockSize, numInputChannels, numOutputChannels, nodeTypes, resourceStore);
+
+            std::lock_guard<std::mutex> lock(sessionsMutex);
+            sessions.push_back(session);
+
+            return session;
+        }
+
+        void removeSession(std::shared_ptr<Session> const& session)
+        {
+            std::lock_guard<std::mutex> lock(sessionsMutex);
+            sessions.erase(std::remove(sessions.begin(), sessions.end(), session), sessions.end());
+        }
+
+        size_t getNumSessions()
+        {
+            std::lock_guard<std::mutex> lock(sessionsMutex);
+            return sessions.size();
+        }
+
+        //==============================================================================
+        // Renders one block of every session, returning once they're all done.
+        //
+        // Must only be called from one thread at a time.
+        void process()
+        {
+            using Clock = std::chrono::steady_clock;
+
+            std::lock_guard<std::mutex> lock(sessionsMutex);
+
+            // Earliest deadline first. The sort is stable so that sessions with equal
+            // deadlines start in the order they were created.
+            order.clear();
+
+            for (auto const& s : sessions) {
+                order.push_back(s.get());
+            }
+
+            std::stable_sort(order.begin(), order.end(), [](Session const* a, Session const* b) {
+                return a->deadlineNanos.load(std::memory_order_relaxed) < b->deadlineNanos.load(std::memory_order_relaxed);
+            });
+
+            struct Job {
+                Engine* self;
+                Clock::time_point start;
+            };
+
+            Job job { this, Clock::now() };
+
+            threadPool.run(order.size(), [](void* context, size_t i) {
+                auto& j = *static_cast<Job*>(context);
+                j.self->order[i]->render(j.start);
+            }, &job);
+        }
+
+    private:
+        //==============================================================================
+        std::shared_ptr<NodeTypeRegistry<FloatType> const> nodeTypes;
+        std::shared_ptr<SharedResourceStore<FloatType>> resourceStore;
+
+        std::mutex sessionsMutex;
+        std::vector<std::shared_ptr<Session>> sessions;
+
+        // The sessions in the order of this block's tasks, kept to reuse its storage
+        std::vector<Session*> order;
+
+        RenderThreadPool threadPool;
+    };
+
+} // namespace elem
@@ -0,0 +1,229 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Types.h"
+#include "Value.h"
+
+
+namespace elem
+{
+
+    //==============================================================================
+    // The kinds of event a node can write to an EventBuffer directly.
+    enum class EventType : uint8_t {
+        // A js::Value event written through the compatibility path, see EventBuffer::pushValue
+        Value = 0,
+
+        // values[0] and values[1] hold the min and max of the latest block
+        Meter = 1,
+
+        // values[0] holds the latched value
+        Snapshot = 2,
+
+        // One frame per channel of `frameSize` samples
+        Scope = 3,
+
+        // Two frames of `frameSize` bins, the real parts then the imaginary parts
+        FFT = 4,
+    };
+
+    //==============================================================================
+    // A reusable, typed batch of events from the graph, filled by Runtime::processQueuedEvents.
+    //
+    // Nodes which support it write their events straight into the buffer: a small header
+    // per event, plus any sample frames laid out one after another in a single pool of
+    // floats. The buffer keeps its capacity when cleared, so once it has grown to fit the
+    // busiest batch, draining events makes no allocations at all. Hosts can then walk the
+    // headers, or hand the header and frame arrays across to another environment in bulk.
+    //
+    // Events from nodes which don't write typed events land here as js::Values, and
+    // `forEach` turns everything back into the (type, js::Value) pairs of the event
+    // callback, which keeps the two paths interchangeable.
+    //
+    // Every event names its source by the id of the node that raised it, and by a pointer
+    // to the node's `name` prop. That pointer is only valid until the next change to the
+    // graph, so a batch should be consumed before applying more instructions.
+    class EventBuffer
+    {
+    public:
+        struct Event {
+            EventType type = EventType::Value;
+            NodeId source = 0;
+            js::Value const* name = nullptr;
+
+            // Scalar payloads, see EventType
+            double values[2] = {0, 0};
+
+            // Sample frames, held at `offset` in the frame pool
+            uint32_t numChannels = 0;
+            uint32_t frameSize = 0;
+            size_t offset = 0;
+
+            // For events of type Value, the index into the value events
+            size_t valueIndex = 0;
+        };
+
+        EventBuffer() = default;
+
+        // Empties the buffer, keeping its capacity
+        void clear()
+        {
+            events.clear();
+            frames.clear();
+            values.clear();
+        }
+
+        size_t size() const { return events.size(); }
+        bool empty() const { return events.empty(); }
+
+        Event const& operator[](size_t i) const { return events[i]; }
+
+        std::vector<Event> const& getEvents() const { return events; }
+        std::vector<float> const& getFramePool() const { return frames; }
+
+        // The first frame of an event's samples, followed by the rest of its frames
+        float const* getFrameData(Event const& e) const { return frames.data() + e.offset; }
+
+        // Adds an event with no sample frames and returns its header
+        Event& push(EventType type, NodeId source, js::Value const& name)
+        {
+            auto& e = events.emplace_back();
+
+            e.type = type;
+            e.source = source;
+            e.name = &name;
+            e.offset = frames.size();
+
+            return e;
+        }
+
+        // Adds an event with `numChannels` frames of `frameSize` samples each, and returns
+        // a pointer to the first frame for the caller to fill. The pointer is invalidated
+        // by the next push.
+        float* pushFrames(EventType type, NodeId source, js::Value const& name, size_t numChannels, size_t frameSize)
+        {
+            auto& e = push(type, source, name);
+
+            e.numChannels = static_cast<uint32_t>(numChannels);
+            e.frameSize = static_cast<uint32_t>(frameSize);
+
+            frames.resize(frames.size() + numChannels * frameSize);
+            return frames.data() + e.offset;
+        }
+
+        // Removes the most recent event, for a node which finds it has nothing to
+        // report after all
+        void pop()
+        {
+            if (events.empty())
+                return;
+
+            auto const& e = events.back();
+
+            if (e.type == EventType::Value) {
+                values.pop_back();
+            } else {
+                frames.resize(e.offset);
+            }
+
+            events.pop_back();
+        }
+
+        // Adds an event for the js::Value callback path, which nodes without typed
+        // events use by default
+        void pushValue(NodeId source, std::string const& type, js::Value value)
+        {
+            auto& e = events.emplace_back();
+
+            e.type = EventType::Value;
+            e.source = source;
+            e.valueIndex = values.size();
+
+            values.emplace_back(type, std::move(value));
+        }
+
+        // Returns the name the event callback uses for an event of the given type
+        static char const* getTypeName(EventType type)
+        {
+            switch (type) {
+                case EventType::Meter: return "meter";
+                case EventType::Snapshot: return "snapshot";
+                case EventType::Scope: return "scope";
+                case EventType::FFT: return "fft";
+                case EventType::Value:
+                default:
+                    return "";
+            }
+        }
+
+        // Converts an event into the js::Value form the event callback has always
+        // delivered it in. This allocates; it's there for compatibility.
+        std::pair<std::string, js::Value> toValue(Event const& e) const
+        {
+            if (e.type == EventType::Value)
+                return values[e.valueIndex];
+
+            auto const& name = *e.name;
+            auto const* data = getFrameData(e);
+
+            switch (e.type) {
+                case EventType::Meter:
+                    return {"meter", js::Object({
+                        {"min", e.values[0]},
+                        {"max", e.values[1]},
+                        {"source", name},
+                    })};
+                case EventType::Snapshot:
+                    return {"snapshot", js::Object({
+                        {"source", name},
+                        {"data", e.values[0]},
+                    })};
+                case EventType::Scope:
+                {
+                    js::Array channels(e.numChannels);
+
+                    for (size_t i = 0; i < e.numChannels; ++i) {
+                        auto const* frame = data + i * e.frameSize;
+                        channels[i] = js::Float32Array(frame, frame + e.frameSize);
+                    }
+
+                    return {"scope", js::Object({
+                        {"source", name},
+                        {"data", std::move(channels)},
+                    })};
+                }
+                case EventType::FFT:
+                    return {"fft", js::Object({
+                        {"source", name},
+                        {"data", js::Object({
+                            {"real", js::Float32Array(data, data + e.frameSize)},
+                            {"imag", js::Float32Array(data + e.frameSize, data + 2 * e.frameSize)},
+                        })}
+                    })};
+                case EventType::Value:
+                default:
+                    return {};
+            }
+        }
+
+        // Delivers every event in the buffer, in order, to an event callback
+        void forEach(std::function<void(std::string const&, js::Value)> const& eventHandler) const
+        {
+            for (auto const& e : events) {
+                auto [type, value] = toValue(e);
+                eventHandler(type, std::move(value));
+            }
+        }
+
+    private:
+        std::vector<Event> events;
+        std::vector<float> frames;
+        std::vector<std::pair<std::string, js::Value>> values;
+    };
+
+} // namespace elem
@@ -1,14 +1,43 @@
 #pragma once
 
+#include "EventBuffer.h"
+#include "PropertyKey.h"
 #include "Types.h"
 #include "Value.h"
 
-#include <unordered_map>
+#include <algorithm>
+#include <atomic>
+#include <utility>
+#include <vector>
 
 
 namespace elem
 {
 
+    template <typename FloatType>
+    struct GraphNode;
+
+    //==============================================================================
+    // A lock free list of the nodes with events waiting to be processed, see
+    // GraphNode::notifyEventsPending.
+    //
+    // Any number of realtime threads may push nodes, and a single non-realtime thread
+    // takes the whole list at once. The links live in the nodes themselves, and each
+    // node's pending flag keeps it on the list at most once, so pushing never allocates.
+    template <typename FloatType>
+    class EventNotificationList
+    {
+    public:
+        void push(GraphNode<FloatType>* node);
+
+        // Detaches every node on the list, returning them in the order they were pushed
+        template <typename Fn>
+        void take(Fn&& fn);
+
+    private:
+        std::atomic<GraphNode<FloatType>*> head = nullptr;
+    };
+
     //==============================================================================
     // The GraphNode represents a single audio processing operation within the
     // larger audio graph.
@@ -34,9 +63,37 @@ namespace elem
         NodeId getId() { return nodeId; }
 
         //==============================================================================
-        double getSampleRate() { return sampleRate; }
+        // Returns the rate at which the node renders. That's the sample rate the node was
+        // created with, unless the node renders at control rate, in which case it's that
+        // divided by the control rate's period. Nodes which compute anything from the
+        // sample rate should do so in `process`, where it may have changed since the last
+        // block.
+        double getSampleRate() { return renderRate.load(std::memory_order_relaxed); }
         size_t getBlockSize() { return blockSize; }
 
+        //==============================================================================
+        // Whether the node may render at control rate, once per some period of samples,
+        // within a subgraph marked with the `controlRate` prop. A node which allows it must
+        // behave the same for a block of samples at the sample rate as for a shorter block
+        // at the node's reduced rate, taking the time between samples from `getSampleRate`.
+        //
+        // See RootRenderSequence::setControlRate.
+        virtual bool canRenderAtControlRate() { return false; }
+
+        // The period, in samples, at which the render sequence last rendered the node, and
+        // the state with which it interpolates the output of a control rate subgraph back up
+        // to the sample rate. Only for the render sequence, on the realtime thread.
+        void setControlRatePeriod(size_t period);
+        size_t getControlRatePeriod() const { return controlRatePeriod.load(std::memory_order_relaxed); }
+
+        struct ControlRateState {
+            FloatType from = 0;
+            FloatType to = 0;
+            bool primed = false;
+        };
+
+        ControlRateState& getControlRateState() { return controlRateState; }
+
         //==============================================================================
         // Sets a property onto the graph node.
         //
@@ -52,12 +109,39 @@ namespace elem
         // Retreives a property from the Node's props, falling back to the provided
         // default value if no property exists by the given name.
         //
-        // Properties are held in a map<std::string, js::Value>, but the ValueType template
-        // allows fetching a property by a given subtype such as js::Number. If an entry is
-        // found in the props map, its value will be returned by casting to ValueType, therefore
-        // if the cast fails, this method will throw.
+        // Properties are held as js::Values keyed by their interned PropertyKey, but the
+        // ValueType template allows fetching a property by a given subtype such as js::Number.
+        // If an entry is found in the props, its value will be returned by casting to ValueType,
+        // therefore if the cast fails, this method will throw.
         template <typename ValueType>
-        ValueType getPropertyWithDefault(std::string const& key, ValueType const& df);
+        ValueType getPropertyWithDefault(PropertyKey const& key, ValueType const& df);
+
+        // Binds a member of the derived class to a property, so that every time the property
+        // is set the member receives a copy of the new value cast to ValueType. If the property
+        // was already set, the member is assigned right away.
+        //
+        // This is intended for properties which are read often, e.g. on every call to
+        // `processEvents`, where reading a member is cheaper than a property lookup. Bound
+        // members are written from within `GraphNode::setProperty`, so derived classes which
+        // override `setProperty` must still call through to it, and the same thread safety
+        // rules apply: bound members must not be read from the realtime thread.
+        template <typename ValueType>
+        void bindProperty(PropertyKey const& key, ValueType& target);
+
+        // Calls `fn` with the name and value of each property, in the order in which they
+        // were first set. Used by the runtime to snapshot the graph.
+        template <typename Fn>
+        void forEachProperty(Fn&& fn) const {
+            for (auto const& [key, value] : props) {
+                fn(key.toString(), value);
+            }
+        }
+
+        // Returns the value of the property by the given name, or nullptr if it isn't set,
+        // and removes one from the props. Used by the runtime to undo a batch of instructions
+        // which failed part way through.
+        js::Value const* getProperty(std::string const& key) const { return findProperty(PropertyKey(key)); }
+        void removeProperty(std::string const& key);
 
         // Process the next block of audio data.
         //
@@ -74,7 +158,41 @@ namespace elem
         // event handler callback provided.
         //
         // Thread safety must be managed by the user.
-        virtual void processEvents(std::function<void(std::string const&, js::Value)>& /* eventHandler */) {}
+        virtual void processEvents(std::function<void(std::string const&, js::Value)>& eventHandler);
+
+        // Derived classes may also override this method to write typed events straight
+        // into an EventBuffer, which avoids building a js::Value for each event.
+        //
+        // This is called in place of the method above by the overload of Runtime's
+        // `processQueuedEvents` taking an EventBuffer. Each default implementation relays
+        // through the other, so a node need only override one of the two to raise the
+        // same events on both paths.
+        virtual void processEvents(EventBuffer& events);
+
+        // By default, a node which relays events is visited on every call to the runtime's
+        // `processQueuedEvents`, whether or not it has anything to relay. A node may instead
+        // ask to be visited only when it does, by calling `enableEventNotifications` from
+        // its constructor, and then `notifyEventsPending` from the realtime thread each time
+        // it queues something new for `processEvents`.
+        //
+        // Nodes which don't override either `processEvents` are visited once after they're
+        // created, and never again.
+        void enableEventNotifications() { notifiesEvents = true; }
+        bool usesEventNotifications() const { return notifiesEvents; }
+
+        // May be called from any realtime thread. Doesn't block or allocate.
+        void notifyEventsPending();
+
+        // For the runtime, which holds the list of nodes with pending events, and which
+        // stops visiting nodes which turn out never to relay events
+        void setEventNotificationList(EventNotificationList<FloatType>* list) { eventList = list; }
+
+        // For the runtime, which lends every node the same buffer for the default callback
+        // overload of `processEvents` to relay typed events through, so that relaying them
+        // doesn't allocate. Nodes without one use a buffer of their own each time.
+        void setEventScratch(EventBuffer* scratch) { eventScratch = scratch; }
+        bool hasEventsPending() const { return eventsPending.load(std::memory_order_acquire); }
+        bool mayRelayEvents() const { return relaysEvents; }
 
         // Derived classes may override this method to reset themselves.
         //
@@ -84,11 +202,41 @@ namespace elem
 
     private:
         //==============================================================================
+        js::Value const* findProperty(PropertyKey const& key) const;
+
+        struct PropertyBinding {
+            PropertyKey key;
+            void* target;
+            void (*assign)(void*, js::Value const&);
+        };
+
         NodeId nodeId;
-        std::unordered_map<std::string, js::Value> props;
+
+        // Nodes carry only a handful of props, for which a linear scan over integer
+        // keys beats hashing
+        std::vector<std::pair<PropertyKey, js::Value>> props;
+        std::vector<PropertyBinding> bindings;
 
         double sampleRate;
+        std::atomic<double> renderRate;
+        std::atomic<size_t> controlRatePeriod = 1;
+        ControlRateState controlRateState;
         size_t blockSize;
+
+        // Event notification state, see notifyEventsPending
+        friend class EventNotificationList<FloatType>;
+
+        EventNotificationList<FloatType>* eventList = nullptr;
+        GraphNode<FloatType>* nextPending = nullptr;
+        std::atomic<bool> eventsPending = false;
+        bool notifiesEvents = false;
+        bool relaysEvents = true;
+
+        // Set while the default EventBuffer overload of `processEvents` calls through to
+        // the callback overload, which then knows that neither was overridden
+        bool relayingToCallback = false;
+
+        EventBuffer* eventScratch = nullptr;
     };
 
     //==============================================================================
@@ -97,13 +245,34 @@ namespace elem
     GraphNode<FloatType>::GraphNode(NodeId id, double sr, size_t bs)
         : nodeId(id)
         , sampleRate(sr)
+        , renderRate(sr)
         , blockSize(bs)
     {
     }
 
+    template <typename FloatType>
+    void GraphNode<FloatType>::setControlRatePeriod(size_t period) {
+        controlRatePeriod.store(period, std::memory_order_relaxed);
+        renderRate.store(sampleRate / static_cast<double>(period), std::memory_order_relaxed);
+    }
+
     template <typename FloatType>
     void GraphNode<FloatType>::setProperty(std::string const& key, js::Value const& val) {
-        props.insert_or_assign(key, val);
+        PropertyKey const k(key);
+
+        auto it = std::find_if(props.begin(), props.end(), [&](auto const& p) { return p.first == k; });
+
+        if (it != props.end()) {
+            it->second = val;
+        } else {
+            props.emplace_back(k, val);
+        }
+
+        for (auto const& b : bindings) {
+            if (b.key == k) {
+                b.assign(b.target, val);
+            }
+        }
     }
 
     template <typename FloatType>
@@ -111,14 +280,127 @@ namespace elem
         setProperty(key, val);
     }
 
+    template <typename FloatType>
+    void GraphNode<FloatType>::notifyEventsPending() {
+        if (eventList != nullptr && !eventsPending.exchange(true, std::memory_order_acq_rel)) {
+            eventList->push(this);
+        }
+    }
+
+    template <typename FloatType>
+    void EventNotificationList<FloatType>::push(GraphNode<FloatType>* node) {
+        auto* next = head.load(std::memory_order_relaxed);
+
+        do {
+            node->nextPending = next;
+        } while (!head.compare_exchange_weak(next, node, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    template <typename FloatType>
+    template <typename Fn>
+    void EventNotificationList<FloatType>::take(Fn&& fn) {
+        // The list comes off newest first, so we reverse it to hand the nodes out in order
+        GraphNode<FloatType>* node = head.exchange(nullptr, std::memory_order_acquire);
+        GraphNode<FloatType>* reversed = nullptr;
+
+        while (node != nullptr) {
+            auto* next = node->nextPending;
+            node->nextPending = reversed;
+            reversed = node;
+            node = next;
+        }
+
+        while (reversed != nullptr) {
+            auto* next = reversed->nextPending;
+
+            // Clearing the flag before the node is processed means that anything the
+            // realtime thread queues from here on puts the node back on the list
+            reversed->nextPending = nullptr;
+            reversed->eventsPending.store(false, std::memory_order_release);
+
+            fn(reversed);
+            reversed = next;
+        }
+    }
+
+    template <typename FloatType>
+    void GraphNode<FloatType>::processEvents(std::function<void(std::string const&, js::Value)>& eventHandler) {
+        // Called back from the default below, so there's nothing to relay
+        if (relayingToCallback) {
+            relaysEvents = false;
+            return;
+        }
+
+        // The scratch buffer is emptied after each use, so should the event handler call
+        // back into the runtime and reach here again, we find it still in use
+        if (eventScratch == nullptr || !eventScratch->empty()) {
+            EventBuffer events;
+            processEvents(events);
+            events.forEach(eventHandler);
+            return;
+        }
+
+        struct ClearOnExit {
+            EventBuffer& events;
+            ~ClearOnExit() { events.clear(); }
+        } scope { *eventScratch };
+
+        processEvents(scope.events);
+        scope.events.forEach(eventHandler);
+    }
+
+    template <typename FloatType>
+    void GraphNode<FloatType>::processEvents(EventBuffer& events) {
+        std::function<void(std::string const&, js::Value)> relay = [this, &events](std::string const& type, js::Value v) {
+            events.pushValue(nodeId, type, std::move(v));
+        };
+
+        struct RelayScope {
+            bool& relaying;
+            RelayScope(bool& r) : relaying(r) { relaying = true; }
+            ~RelayScope() { relaying = false; }
+        } scope { relayingToCallback };
+
+        processEvents(relay);
+    }
+
     template <typename FloatType>
     template <typename ValueType>
-    ValueType GraphNode<FloatType>::getPropertyWithDefault(std::string const& key, ValueType const& df) {
-        if (props.count(key) > 0) {
-            return static_cast<ValueType>(props.at(key));
+    ValueType GraphNode<FloatType>::getPropertyWithDefault(PropertyKey const& key, ValueType const& df) {
+        if (auto const* v = findProperty(key)) {
+            return static_cast<ValueType>(*v);
         }
 
         return df;
     }
 
+    template <typename FloatType>
+    template <typename ValueType>
+    void GraphNode<FloatType>::bindProperty(PropertyKey const& key, ValueType& target) {
+        bindings.push_back({ key, &target, [](void* t, js::Value const& v) {
+            *static_cast<ValueType*>(t) = static_cast<ValueType>(v);
+        }});
+
+        if (auto const* v = findProperty(key)) {
+            target = static_cast<ValueType>(*v);
+        }
+    }
+
+    template <typename FloatType>
+    void GraphNode<FloatType>::removeProperty(std::string const& key) {
+        PropertyKey const k(key);
+        props.erase(std::remove_if(props.begin(), props.end(), [&](auto const& p) { return p.first == k; }), props.end());
+    }
+
+    template <typename FloatType>
+    js::Value const* GraphNode<FloatType>::findProperty(PropertyKey const& key) const {
+        for (auto const& p : props) {
+            if (p.first == key) {
+                return &p.second;
+            }
+        }
+
+        return nullptr;
+    }
+
 } // namespace elem
@@ -1,9 +1,16 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <deque>
 #include <list>
+#include <memory>
 #include <unordered_map>
 
 #include "DefaultNodeTypes.h"
+#include "RenderThreadPool.h"
 #include "Types.h"
 
 
@@ -22,6 +29,26 @@ namespace elem
         size_t numOutputChannels;
         size_t numSamples;
         void* userData;
+
+        // Whether to time each node as it renders, see `Runtime::setProfilingEnabled`
+        bool profiling = false;
+
+        // The time of the block's first sample, in samples of the runtime's own clock
+        int64_t sampleTime = 0;
+
+        // Whether to count the NaN, infinite and subnormal samples each node outputs, see
+        // `Runtime::setNumericChecksEnabled`
+        bool checkNumerics = false;
+    };
+
+    //==============================================================================
+    // A node's output buffer, along with the flag through which the node may report
+    // that the buffer holds a constant value for the current block.
+    template <typename FloatType>
+    struct RenderBuffer
+    {
+        FloatType* data = nullptr;
+        bool* isConstant = nullptr;
     };
 
     template <typename FloatType>
@@ -32,30 +59,60 @@ namespace elem
             : blockSize(blockSize)
         {
             // We allocate buffer storage in chunks of 32 blocks
-            storage.push_back(std::vector<FloatType>(32u * blockSize));
+            storage.push_back(Chunk(blockSize));
         }
 
         void reset()
         {
             nextChunk = 0;
             chunkOffset = 0;
+            numBuffers = 0;
+            freeList.clear();
+        }
+
+        // Returns a buffer to the allocator once its last reader has been assigned,
+        // making it available to a subsequent call to `next`.
+        void release(RenderBuffer<FloatType> buffer)
+        {
+            freeList.push_back(buffer);
+        }
+
+        void clearFreeList()
+        {
+            freeList.clear();
         }
 
-        FloatType* next()
+        // The number of distinct buffers handed out since the last reset, which is the
+        // size of the working set that a render sequence built from them touches.
+        size_t getNumBuffers() const
         {
+            return numBuffers;
+        }
+
+        RenderBuffer<FloatType> next()
+        {
+            // Most recently released first, as it's most likely still in cache
+            if (!freeList.empty()) {
+                auto result = freeList.back();
+                freeList.pop_back();
+                return result;
+            }
+
+            numBuffers++;
+
             if (nextChunk >= storage.size()) {
-                storage.push_back(std::vector<FloatType>(32u * blockSize));
+                storage.push_back(Chunk(blockSize));
             }
 
             auto it = storage.begin();
             std::advance(it, nextChunk);
 
             auto& chunk = *it;
-            auto* result = chunk.data() + chunkOffset;
+            RenderBuffer<FloatType> result { chunk.data.data() + chunkOffset * blockSize, chunk.flags.get() + chunkOffset };
 
-            chunkOffset += blockSize;
+            chunkOffset++;
 
-            if (chunkOffset >= chunk.size()) {
+            if (chunkOffset >= kBlocksPerChunk) {
                 nextChunk++;
                 chunkOffset = 0;
             }
@@ -64,95 +121,681 @@ namespace elem
         }
 
     private:
-        std::list<std::vector<FloatType>> storage;
+        static constexpr size_t kBlocksPerChunk = 32;
+
+        struct Chunk
+        {
+            Chunk(size_t blockSize)
+                : data(kBlocksPerChunk * blockSize)
+                , flags(new bool[kBlocksPerChunk]())
+            {}
+
+            std::vector<FloatType> data;
+            std::unique_ptr<bool[]> flags;
+        };
+
+        std::list<Chunk> storage;
+        std::vector<RenderBuffer<FloatType>> freeList;
 
         size_t blockSize = 0;
         size_t nextChunk = 0;
         size_t chunkOffset = 0;
+        size_t numBuffers = 0;
     };
 
     template <typename FloatType>
     class RootRenderSequence
     {
     public:
-        RootRenderSequence(std::unordered_map<NodeId, FloatType*>& bm, std::shared_ptr<RootNode<FloatType>>& root)
+        RootRenderSequence(std::unordered_map<NodeId, RenderBuffer<FloatType>>& bm, std::shared_ptr<RootNode<FloatType>>& root)
             : rootPtr(root)
             , bufferMap(bm)
-        {}
+        {
+            // If the root was already visited from another root's traversal, its
+            // output buffer has already been assigned.
+            if (auto it = bufferMap.find(root->getId()); it != bufferMap.end()) {
+                rootData = it->second.data;
+                rootIsConstant = it->second.isConstant;
+            }
+        }
 
         void push(BufferAllocator<FloatType>& ba, std::shared_ptr<GraphNode<FloatType>>& node)
         {
-            bufferMap.emplace(node->getId(), ba.next());
+            auto output = assignOutputBuffer(node, ba.next());
+
+            // Nodes without children receive the host input data; this is how
+            // the `in` node reads from the host's input channels.
+            renderOps.push_back({ node.get(), output, 0, 0, false });
+            opNanos.emplace_back(0);
+            opNumerics.emplace_back();
+            nodes.push_back(node);
+            batchStart = renderOps.size();
+            applyControlRate();
+        }
+
+        void push(BufferAllocator<FloatType>& ba, std::shared_ptr<GraphNode<FloatType>>& node, std::vector<NodeId> const& children)
+        {
+            push(node, children, ba.next());
+        }
+
+        // Pushes a node which renders into the given buffer. This may be the buffer of one
+        // of its own children, for nodes which are able to process in place.
+        void push(std::shared_ptr<GraphNode<FloatType>>& node, std::vector<NodeId> const& children, RenderBuffer<FloatType> buffer)
+        {
+            auto output = assignOutputBuffer(node, buffer);
+            auto const childOffset = childPointers.size();
+
+            // Our children have always been visited before their parent, so we resolve
+            // their buffers right here rather than looking them up on every block.
+            for (size_t i = 0; i < children.size(); ++i) {
+                auto const& buffer = bufferMap.at(children[i]);
+
+                childPointers.push_back(buffer.data);
+                childConstantFlags.push_back(buffer.isConstant);
+                childAtControlRate.push_back(i < nextControlRate.children.size() && nextControlRate.children[i]);
+            }
+
+            if (children.size() > maxChildren) {
+                maxChildren = children.size();
+                inputConstantFlags.reset(new bool[maxChildren]());
+            }
+
+            renderOps.push_back({ node.get(), output, childOffset, children.size(), true });
+            opNanos.emplace_back(0);
+            opNumerics.emplace_back();
+            nodes.push_back(node);
+
+            if (children.size() > loopChildPointers.size()) {
+                loopChildPointers.resize(children.size());
+            }
+
+            // Ops within a feedback loop render a sub-block at a time, and ops at control
+            // rate render fewer samples than the rest, so neither render in batches
+            if (auto* batchable = dynamic_cast<BatchableNode<FloatType>*>(node.get()); batchable != nullptr && !inLoop && nextControlRate.period == 0) {
+                renderOps.back().batchFn = batchable->getBatchFunction();
+                extendBatch();
+            } else {
+                batchStart = renderOps.size();
+            }
+
+            applyControlRate();
+        }
+
+        // Renders the next op pushed at control rate, one sample for every `period` samples
+        // of the block, where the period is at least 2, at those sample times which are multiples of the period. The op's
+        // output buffer then holds only as many samples as it rendered, as does the buffer
+        // of each child marked in `children`, the op's other children being sampled at the
+        // op's sample times. An op which `expands` is the top of its control rate subgraph,
+        // and interpolates its output back up to the sample rate after it renders, linearly
+        // from each of its samples to the next. Its output so lags the op by one period.
+        // Ops at control rate can't be part of a feedback loop.
+        void setControlRate(size_t period, bool expands, std::vector<bool>&& children, size_t blockSize)
+        {
+            nextControlRate = { period, expands, std::move(children) };
+
+            auto const maxPoints = blockSize / period + 1;
+
+            controlStride = std::max(controlStride, maxPoints);
+            controlChildPointers.resize(std::max(controlChildPointers.size(), nextControlRate.children.size()));
+            controlScratch.resize(controlStride * controlChildPointers.size());
+
+            if (expands) {
+                controlValues.resize(std::max(controlValues.size(), maxPoints));
+            }
+        }
+
+        // For a node pushed at the sample rate which rendered at control rate in an earlier
+        // sequence, and needs to be told that it no longer does before it next renders
+        void restoreSampleRate(GraphNode<FloatType>* node)
+        {
+            restoredNodes.push_back(node);
+        }
+
+        // Marks the ops pushed between a call to `beginFeedbackLoop` and `endFeedbackLoop` as
+        // a feedback loop, which renders in sub-blocks of at most `subBlockSize` samples.
+        // Before each sub-block, each of the given taps fills its tap line from its own
+        // latency, which must be at least `subBlockSize`.
+        //
+        // The loop must hold every op which both reads from one of the loop's tapIns and
+        // feeds into one of its tapOuts, and those tapIns must not be read outside of it.
+        // A subsequence holds at most one loop.
+        void beginFeedbackLoop(size_t subBlockSize, std::vector<std::pair<std::shared_ptr<TapOutNode<FloatType>>, size_t>>&& taps)
+        {
+            loopBegin = renderOps.size();
+            loopSubBlockSize = subBlockSize;
+            loopTaps = std::move(taps);
+            batchStart = renderOps.size();
+            inLoop = true;
+        }
+
+        void endFeedbackLoop()
+        {
+            loopEnd = renderOps.size();
+            batchStart = renderOps.size();
+            inLoop = false;
+        }
+
+        // Runs the render ops of this subsequence, returning false if there was nothing
+        // to do because this root has stopped running or is aimed at an invalid output channel.
+        bool render(HostContext<FloatType>& ctx)
+        {
+            size_t const outChan = rootPtr->getChannelNumber();
+
+            if (!rootPtr->stillRunning() || outChan < 0u || outChan >= ctx.numOutputChannels || rootData == nullptr)
+                return false;
+
+            auto** childData = childPointers.data();
+
+            // When profiling, each op is timed from the end of the one before it, which
+            // costs a single clock read per op
+            using Clock = std::chrono::steady_clock;
+            auto opStart = ctx.profiling ? Clock::now() : Clock::time_point();
+
+            for (auto* node : restoredNodes) {
+                if (node->getControlRatePeriod() != 1) {
+                    node->setControlRatePeriod(1);
+                }
+            }
 
-            renderOps.push_back([=, bufferMap = this->bufferMap](HostContext<FloatType>& ctx) {
-                auto* outputData = bufferMap.at(node->getId());
+            for (size_t k = 0; k < renderOps.size(); ++k) {
+                auto const& op = renderOps[k];
+                bool const* inputIsConstant = nullptr;
 
-                node->process(BlockContext<FloatType> {
-                    ctx.inputData,
-                    ctx.numInputChannels,
-                    outputData,
+                if (k == loopBegin && loopSubBlockSize > 0 && loopEnd > loopBegin) {
+                    renderLoop(ctx, opStart);
+                    k = loopEnd - 1;
+                    continue;
+                }
+
+                if (op.controlRatePeriod > 0) {
+                    renderControlRate(ctx, k, opStart);
+                    continue;
+                }
+
+                if (op.batchSize > 1) {
+                    renderBatch(ctx, k, opStart);
+                    k += op.batchSize - 1;
+                    continue;
+                }
+
+                // We know nothing about the host input, so leaf nodes get no hints
+                if (op.hasChildren) {
+                    for (size_t i = 0; i < op.numChildren; ++i) {
+                        inputConstantFlags[i] = *childConstantFlags[op.childOffset + i];
+                    }
+
+                    inputIsConstant = inputConstantFlags.get();
+                }
+
+                *op.output.isConstant = false;
+
+                op.node->process(BlockContext<FloatType> {
+                    op.hasChildren ? childData + op.childOffset : ctx.inputData,
+                    op.hasChildren ? op.numChildren : ctx.numInputChannels,
+                    op.output.data,
                     ctx.numSamples,
                     ctx.userData,
+                    inputIsConstant,
+                    op.output.isConstant,
                 });
-            });
+
+                if (ctx.checkNumerics) {
+                    checkNumerics(k, op.output, ctx.numSamples);
+                }
+
+                if (ctx.profiling) {
+                    auto const opEnd = Clock::now();
+                    opNanos[k].fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(opEnd - opStart).count(), std::memory_order_relaxed);
+                    opStart = opEnd;
+                }
+            }
+
+            return true;
         }
 
-        void push(BufferAllocator<FloatType>& ba, std::shared_ptr<GraphNode<FloatType>>& node, std::vector<NodeId> const& children)
+        // Calls `fn` with the id of each node in this subsequence and the time, in
+        // nanoseconds, that it has spent rendering since the last drain. May be called
+        // from the non-realtime thread while this sequence is rendering.
+        template <typename Fn>
+        void drainProfile(Fn&& fn)
+        {
+            for (size_t k = 0; k < renderOps.size(); ++k) {
+                fn(renderOps[k].node->getId(), opNanos[k].exchange(0, std::memory_order_relaxed));
+            }
+        }
+
+        // Calls `fn` with the id of each node in this subsequence which has output any NaN,
+        // infinite or subnormal samples since the last drain, and the number of each. May
+        // be called from the non-realtime thread while this sequence is rendering.
+        template <typename Fn>
+        void drainNumerics(Fn&& fn)
+        {
+            for (size_t k = 0; k < renderOps.size(); ++k) {
+                auto& counts = opNumerics[k];
+
+                if (counts.any.exchange(false, std::memory_order_acquire)) {
+                    fn(renderOps[k].node->getId(),
+                        counts.nan.exchange(0, std::memory_order_relaxed),
+                        counts.inf.exchange(0, std::memory_order_relaxed),
+                        counts.subnormal.exchange(0, std::memory_order_relaxed));
+                }
+            }
+        }
+
+        // Sums the root's output into the appropriate host output channel
+        void accumulate(HostContext<FloatType>& ctx)
+        {
+            size_t const outChan = rootPtr->getChannelNumber();
+
+            // Silent roots, such as idle voices, contribute nothing
+            if (rootIsConstant != nullptr && *rootIsConstant && rootData[0] == FloatType(0))
+                return;
+
+            for (size_t j = 0; j < ctx.numSamples; ++j) {
+                ctx.outputData[outChan][j] += rootData[j];
+            }
+        }
+
+        void process(HostContext<FloatType>& ctx)
+        {
+            if (render(ctx)) {
+                accumulate(ctx);
+            }
+        }
+
+    private:
+        RenderBuffer<FloatType> assignOutputBuffer(std::shared_ptr<GraphNode<FloatType>>& node, RenderBuffer<FloatType> output)
+        {
+            bufferMap.emplace(node->getId(), output);
+
+            if (node.get() == rootPtr.get()) {
+                rootData = output.data;
+                rootIsConstant = output.isConstant;
+            }
+
+            return output;
+        }
+
+        // Adds the op just pushed to the batch at the end of the table if it can join it,
+        // or otherwise starts a new batch with it. A batch only takes ops which run the same
+        // batch function on the same number of inputs, and which neither read from nor
+        // write over the buffers of the ops already in it.
+        void extendBatch()
         {
-            bufferMap.emplace(node->getId(), ba.next());
+            auto const index = renderOps.size() - 1;
+            auto const& op = renderOps[index];
+
+            auto const reads = [this](RenderOperation const& o, FloatType const* data) {
+                auto const* begin = childPointers.data() + o.childOffset;
+                return std::find(begin, begin + o.numChildren, data) != begin + o.numChildren;
+            };
+
+            bool joins = batchStart < index
+                && renderOps[batchStart].batchFn == op.batchFn
+                && renderOps[batchStart].numChildren == op.numChildren
+                && renderOps[batchStart].batchSize < kMaxBatchSize;
+
+            for (size_t k = batchStart; joins && k < index; ++k) {
+                joins = !reads(renderOps[k], op.output.data) && !reads(op, renderOps[k].output.data);
+            }
 
-            renderOps.push_back([=, bufferMap = this->bufferMap](HostContext<FloatType>& ctx) {
-                auto* outputData = bufferMap.at(node->getId());
-                auto const numChildren = children.size();
+            if (!joins) {
+                batchStart = index;
+                return;
+            }
+
+            auto const size = ++renderOps[batchStart].batchSize;
+
+            // Scratch space for the batch's block contexts, allocated here rather than
+            // on the realtime thread
+            if (size > batchNodes.size()) {
+                batchNodes.resize(size);
+                batchContexts.resize(size);
+            }
+
+            if (size * maxChildren > batchConstantFlagsSize) {
+                batchConstantFlagsSize = size * maxChildren;
+                batchConstantFlags.reset(new bool[batchConstantFlagsSize]());
+            }
+        }
+
+        // Renders the batch of ops starting at index `k` with a single call to their batch
+        // function. When profiling, the time is split evenly between the ops.
+        template <typename TimePoint>
+        void renderBatch(HostContext<FloatType>& ctx, size_t k, TimePoint& opStart)
+        {
+            auto const& lead = renderOps[k];
+            auto** childData = childPointers.data();
 
-                // This might actually be a great time for choc's SmallVector. We can allocate it outside the
-                // lambda but capture it by copy (move). Initialize it with `numChildren` so that if `numChildren` exceeds
-                // the stack-allocated space of choc's SmallVector then it performs its heap allocation before being
-                // copied (moved) into the lambda capture group.
-                std::array<FloatType*, 128> ptrs;
+            for (size_t j = 0; j < lead.batchSize; ++j) {
+                auto const& op = renderOps[k + j];
+                auto* flags = batchConstantFlags.get() + j * lead.numChildren;
 
-                for (size_t j = 0; j < numChildren; ++j) {
-                    ptrs[j] = bufferMap.at(children[j]);
+                for (size_t i = 0; i < op.numChildren; ++i) {
+                    flags[i] = *childConstantFlags[op.childOffset + i];
                 }
 
-                node->process(BlockContext<FloatType> {
-                    const_cast<const FloatType**>(ptrs.data()),
-                    numChildren,
-                    outputData,
+                *op.output.isConstant = false;
+
+                batchNodes[j] = static_cast<BatchableNode<FloatType>*>(op.node);
+                batchContexts[j] = BlockContext<FloatType> {
+                    childData + op.childOffset,
+                    op.numChildren,
+                    op.output.data,
                     ctx.numSamples,
                     ctx.userData,
-                });
-            });
+                    flags,
+                    op.output.isConstant,
+                };
+            }
+
+            lead.batchFn(batchNodes.data(), batchContexts.data(), lead.batchSize);
+
+            if (ctx.checkNumerics) {
+                for (size_t j = 0; j < lead.batchSize; ++j) {
+                    checkNumerics(k + j, renderOps[k + j].output, ctx.numSamples);
+                }
+            }
+
+            if (ctx.profiling) {
+                auto const opEnd = TimePoint::clock::now();
+                auto const nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(opEnd - opStart).count();
+
+                for (size_t j = 0; j < lead.batchSize; ++j) {
+                    opNanos[k + j].fetch_add(nanos / static_cast<int64_t>(lead.batchSize), std::memory_order_relaxed);
+                }
+
+                opStart = opEnd;
+            }
         }
 
-        void process(HostContext<FloatType>& ctx)
+        // Counts the NaN, infinite and subnormal samples among the first `numSamples` of
+        // the given output of op `k`
+        void checkNumerics(size_t k, RenderBuffer<FloatType> output, size_t numSamples)
         {
-            size_t const outChan = rootPtr->getChannelNumber();
+            int64_t nan = 0;
+            int64_t inf = 0;
+            int64_t subnormal = 0;
+
+            auto const count = [&](FloatType x, int64_t n) {
+                switch (std::fpclassify(x)) {
+                    case FP_NAN: nan += n; break;
+                    case FP_INFINITE: inf += n; break;
+                    case FP_SUBNORMAL: subnormal += n; break;
+                    default: break;
+                }
+            };
+
+            if (numSamples > 0 && *output.isConstant) {
+                count(output.data[0], static_cast<int64_t>(numSamples));
+            } else {
+                for (size_t j = 0; j < numSamples; ++j) {
+                    count(output.data[j], 1);
+                }
+            }
 
-            // Nothing to do if this root has stopped running or if it's aimed at
-            // an invalid output channel
-            if (!rootPtr->stillRunning() || outChan < 0u || outChan >= ctx.numOutputChannels)
+            if (nan == 0 && inf == 0 && subnormal == 0)
                 return;
 
-            // Run the subsequence
-            for (size_t i = 0; i < renderOps.size(); ++i) {
-                renderOps[i](ctx);
+            auto& counts = opNumerics[k];
+
+            counts.nan.fetch_add(nan, std::memory_order_relaxed);
+            counts.inf.fetch_add(inf, std::memory_order_relaxed);
+            counts.subnormal.fetch_add(subnormal, std::memory_order_relaxed);
+            counts.any.store(true, std::memory_order_release);
+        }
+
+        void applyControlRate()
+        {
+            auto& op = renderOps.back();
+
+            op.controlRatePeriod = nextControlRate.period;
+            op.expandsControlRate = nextControlRate.expands;
+            nextControlRate = {};
+        }
+
+        // Renders an op at control rate, see `setControlRate`
+        template <typename TimePoint>
+        void renderControlRate(HostContext<FloatType>& ctx, size_t k, TimePoint& opStart)
+        {
+            auto const& op = renderOps[k];
+            auto const period = op.controlRatePeriod;
+
+            // The offset of the block's first sample time which is a multiple of the period,
+            // and how many of those there are within the block
+            auto const phase = static_cast<size_t>(((ctx.sampleTime % static_cast<int64_t>(period)) + static_cast<int64_t>(period)) % static_cast<int64_t>(period));
+            auto const first = (period - phase) % period;
+            auto const numPoints = first < ctx.numSamples ? (ctx.numSamples - first - 1) / period + 1 : 0;
+
+            if (op.node->getControlRatePeriod() != period) {
+                op.node->setControlRatePeriod(period);
             }
 
-            // Sum into the output buffer
-            auto* data = bufferMap.at(rootPtr->getId());
+            if (numPoints > 0) {
+                for (size_t i = 0; i < op.numChildren; ++i) {
+                    auto const* data = childPointers[op.childOffset + i];
 
-            for (size_t j = 0; j < ctx.numSamples; ++j) {
-                ctx.outputData[outChan][j] += data[j];
+                    if (!childAtControlRate[op.childOffset + i]) {
+                        auto* gathered = controlScratch.data() + i * controlStride;
+
+                        for (size_t j = 0; j < numPoints; ++j) {
+                            gathered[j] = data[first + j * period];
+                        }
+
+                        data = gathered;
+                    }
+
+                    controlChildPointers[i] = data;
+                    inputConstantFlags[i] = *childConstantFlags[op.childOffset + i];
+                }
+
+                *op.output.isConstant = false;
+
+                // As in a feedback loop, leaves at control rate don't read the host input
+                op.node->process(BlockContext<FloatType> {
+                    op.hasChildren ? controlChildPointers.data() : nullptr,
+                    op.numChildren,
+                    op.output.data,
+                    numPoints,
+                    ctx.userData,
+                    op.hasChildren ? inputConstantFlags.get() : nullptr,
+                    op.output.isConstant,
+                });
+            }
+
+            if (op.expandsControlRate) {
+                expandControlRate(k, phase, first, numPoints, ctx.numSamples);
+            }
+
+            if (ctx.checkNumerics) {
+                checkNumerics(k, op.output, op.expandsControlRate ? ctx.numSamples : numPoints);
+            }
+
+            if (ctx.profiling) {
+                auto const opEnd = TimePoint::clock::now();
+                opNanos[k].fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(opEnd - opStart).count(), std::memory_order_relaxed);
+                opStart = opEnd;
             }
         }
 
-    private:
+        // Interpolates the samples an op rendered at control rate up to the sample rate, in
+        // place. Each sample starts a segment which ramps to it from the sample before over
+        // one period, and the node's control rate state carries the segment in progress
+        // from one block to the next.
+        void expandControlRate(size_t k, size_t phase, size_t first, size_t numPoints, size_t numSamples)
+        {
+            auto const& op = renderOps[k];
+            auto& state = op.node->getControlRateState();
+            auto* out = op.output.data;
+            auto const period = op.controlRatePeriod;
+            auto const scale = FloatType(1) / static_cast<FloatType>(period);
+
+            std::copy_n(out, numPoints, controlValues.data());
+
+            if (!state.primed && numPoints > 0) {
+                state.from = state.to = controlValues[0];
+                state.primed = true;
+            }
+
+            bool isConstant = state.from == state.to;
+            size_t position = phase;
+            size_t j = 0;
+
+            for (size_t p = 0; p <= numPoints; ++p) {
+                auto const end = p < numPoints ? first + p * period : numSamples;
+                auto const step = (state.to - state.from) * scale;
+
+                for (; j < end; ++j, ++position) {
+                    out[j] = state.from + step * static_cast<FloatType>(position);
+                }
+
+                if (p < numPoints) {
+                    state.from = state.to;
+                    state.to = controlValues[p];
+                    isConstant = isConstant && state.from == state.to;
+                    position = 0;
+                }
+            }
+
+            *op.output.isConstant = isConstant;
+        }
+
+        // Renders the ops of the feedback loop one sub-block at a time, each reading and
+        // writing its buffers at the sub-block's offset into the block. The loop's outputs
+        // are only constant for as long as a sub-block, so we clear their flags at the end.
+        template <typename TimePoint>
+        void renderLoop(HostContext<FloatType>& ctx, TimePoint& opStart)
+        {
+            for (size_t offset = 0; offset < ctx.numSamples; offset += loopSubBlockSize) {
+                auto const n = std::min(loopSubBlockSize, ctx.numSamples - offset);
+
+                for (auto& [tap, latency] : loopTaps) {
+                    tap->promoteLoopTapBuffer(n, latency);
+                }
+
+                for (size_t k = loopBegin; k < loopEnd; ++k) {
+                    auto const& op = renderOps[k];
+
+                    for (size_t i = 0; i < op.numChildren; ++i) {
+                        loopChildPointers[i] = childPointers[op.childOffset + i] + offset;
+                        inputConstantFlags[i] = *childConstantFlags[op.childOffset + i];
+                    }
+
+                    *op.output.isConstant = false;
+
+                    // The only leaves in a loop are its tapIns, which don't read the host input
+                    op.node->process(BlockContext<FloatType> {
+                        op.hasChildren ? loopChildPointers.data() : nullptr,
+                        op.numChildren,
+                        op.output.data + offset,
+                        n,
+                        ctx.userData,
+                        op.hasChildren ? inputConstantFlags.get() : nullptr,
+                        op.output.isConstant,
+                    });
+
+                    if (ctx.checkNumerics) {
+                        checkNumerics(k, { op.output.data + offset, op.output.isConstant }, n);
+                    }
+
+                    if (ctx.profiling) {
+                        auto const opEnd = TimePoint::clock::now();
+                        opNanos[k].fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(opEnd - opStart).count(), std::memory_order_relaxed);
+                        opStart = opEnd;
+                    }
+                }
+            }
+
+            for (size_t k = loopBegin; k < loopEnd; ++k) {
+                *renderOps[k].output.isConstant = false;
+            }
+        }
+
+        // A single entry in the flattened render table. All pointers are resolved at
+        // build time so that the realtime pass is a linear walk over this array.
+        struct RenderOperation {
+            GraphNode<FloatType>* node;
+            RenderBuffer<FloatType> output;
+            size_t childOffset;
+            size_t numChildren;
+            bool hasChildren;
+
+            // For batchable nodes, the function which renders a batch of them. The first op
+            // of a batch holds the number of ops in it, and renders them all.
+            typename BatchableNode<FloatType>::BatchFn batchFn = nullptr;
+            size_t batchSize = 1;
+
+            // For ops at control rate, the period and whether the op expands its output
+            // back up to the sample rate, see `setControlRate`. Zero for all other ops.
+            size_t controlRatePeriod = 0;
+            bool expandsControlRate = false;
+        };
+
+        static constexpr size_t kMaxBatchSize = 256;
+
         std::shared_ptr<RootNode<FloatType>> rootPtr;
-        std::unordered_map<NodeId, FloatType*>& bufferMap;
+        std::unordered_map<NodeId, RenderBuffer<FloatType>>& bufferMap;
+        FloatType* rootData = nullptr;
+        bool* rootIsConstant = nullptr;
 
-        using RenderOperation = std::function<void(HostContext<FloatType>& context)>;
+        // The render ops hold raw node pointers; we keep the nodes alive here
+        std::vector<std::shared_ptr<GraphNode<FloatType>>> nodes;
         std::vector<RenderOperation> renderOps;
+        std::vector<FloatType const*> childPointers;
+
+        // Time spent in each render op while profiling, accumulated on the realtime thread.
+        // A deque because atomics can't be moved when a vector grows.
+        std::deque<std::atomic<int64_t>> opNanos;
+
+        // The numbers of NaN, infinite and subnormal samples output by each render op while
+        // checking numerics, likewise
+        struct NumericCounts {
+            std::atomic<int64_t> nan = 0;
+            std::atomic<int64_t> inf = 0;
+            std::atomic<int64_t> subnormal = 0;
+            std::atomic<bool> any = false;
+        };
+
+        std::deque<NumericCounts> opNumerics;
+        std::vector<bool const*> childConstantFlags;
+
+        // Scratch space for gathering the constant flags of one op's inputs
+        std::unique_ptr<bool[]> inputConstantFlags;
+        size_t maxChildren = 0;
+
+        // The index of the first op of the batch at the end of the render table, and
+        // the scratch space for rendering batches
+        size_t batchStart = 0;
+        std::vector<BatchableNode<FloatType>*> batchNodes;
+        std::vector<BlockContext<FloatType>> batchContexts;
+        std::unique_ptr<bool[]> batchConstantFlags;
+        size_t batchConstantFlagsSize = 0;
+
+        // The range of ops in the feedback loop, if any, its taps and sub-block size, and
+        // scratch space for the offset input pointers of one op
+        size_t loopBegin = 0;
+        size_t loopEnd = 0;
+        size_t loopSubBlockSize = 0;
+        bool inLoop = false;
+        std::vector<std::pair<std::shared_ptr<TapOutNode<FloatType>>, size_t>> loopTaps;
+        std::vector<FloatType const*> loopChildPointers;
+
+        // The control rate of the next op pushed, whether each input of each op is at
+        // control rate, and scratch space for the inputs of one op at control rate, which
+        // are gathered at intervals of `controlStride`, and the output of one which expands
+        struct ControlRate {
+            size_t period = 0;
+            bool expands = false;
+            std::vector<bool> children;
+        };
+
+        ControlRate nextControlRate;
+        std::vector<bool> childAtControlRate;
+        std::vector<GraphNode<FloatType>*> restoredNodes;
+        std::vector<FloatType const*> controlChildPointers;
+        std::vector<FloatType> controlScratch;
+        std::vector<FloatType> controlValues;
+        size_t controlStride = 0;
     };
 
     template <typename FloatType>
@@ -163,26 +806,159 @@ namespace elem
 
         void reset()
         {
+            taps.clear();
+            parameterNodes.clear();
+            hasFoldedParameterNodes = false;
+            retainedNodes.clear();
+            builtForNumChannels = 0;
+            numChannelsUsed = 0;
             subseqs.clear();
+            dependencies.clear();
+            completedBlock.clear();
+            didRender.clear();
             bufferMap.clear();
+            numBuffers = 0;
         }
 
+        // Records the number of distinct node output buffers used by this sequence
+        void setNumBuffers(size_t n) { numBuffers = n; }
+        size_t getNumBuffers() const { return numBuffers; }
+
         void pushTap(std::shared_ptr<TapOutNode<FloatType>> t) {
             taps.push_back(t);
         }
 
-        void push(RootRenderSequence<FloatType>&& sq)
+        // Records a node rendered by this sequence which takes parameter events. Nodes
+        // may be pushed in any order, but must be pushed before the sequence is handed
+        // to the realtime thread.
+        //
+        // Nodes whose output the sequence folded into a constant, or merged with another's,
+        // are pushed as `folded`, whether or not they're still rendered. Events can't apply
+        // to those as they should, so they wait on the list until a new sequence renders
+        // the node on its own, which they ask for as soon as they arrive.
+        //
+        // Nodes rendered at control rate are pushed with their period, and the sequence
+        // moves their events to the next of the node's samples, and their ramps to the
+        // nearest number of its samples.
+        void pushParameterNode(NodeId id, ParameterEventNode<FloatType>* node, bool folded = false, size_t controlRatePeriod = 1) {
+            auto it = std::lower_bound(parameterNodes.begin(), parameterNodes.end(), id, [](auto const& p, NodeId n) {
+                return p.id < n;
+            });
+
+            parameterNodes.insert(it, { id, node, folded, std::max<size_t>(1, controlRatePeriod) });
+            hasFoldedParameterNodes = hasFoldedParameterNodes || folded;
+        }
+
+        // Hands each of the pending events which falls before the end of the block starting
+        // at `blockStartTime` to its node, removing those from the list. Events for nodes
+        // this sequence doesn't render are dropped, as are events which the node has no
+        // room for, and either way are counted in `numDropped`. Events which are already
+        // late apply at the start of the block.
+        //
+        // Events for folded nodes stay on the list, and set `rebuildRequested`.
+        void scheduleParameterEvents(std::vector<ParameterEvent<FloatType>>& pending, int64_t blockStartTime, size_t numSamples, uint64_t& numDropped, bool& rebuildRequested)
         {
+            auto const blockEndTime = blockStartTime + static_cast<int64_t>(numSamples);
+            size_t kept = 0;
+
+            auto const find = [this](NodeId nodeId) {
+                return std::lower_bound(parameterNodes.begin(), parameterNodes.end(), nodeId, [](auto const& p, NodeId id) {
+                    return p.id < id;
+                });
+            };
+
+            for (auto const& e : pending) {
+                if (hasFoldedParameterNodes) {
+                    if (auto it = find(e.nodeId); it != parameterNodes.end() && it->id == e.nodeId && it->folded) {
+                        it->node->markAutomated();
+                        rebuildRequested = true;
+                        pending[kept++] = e;
+                        continue;
+                    }
+                }
+
+                if (e.sampleTime >= blockEndTime) {
+                    pending[kept++] = e;
+                    continue;
+                }
+
+                auto it = find(e.nodeId);
+                auto offset = static_cast<size_t>(std::max<int64_t>(0, e.sampleTime - blockStartTime));
+                auto ramp = e.rampSamples;
+
+                if (it == parameterNodes.end() || it->id != e.nodeId) {
+                    numDropped++;
+                    continue;
+                }
+
+                if (auto const period = static_cast<int64_t>(it->controlRatePeriod); period > 1) {
+                    // The number of the node's sample times from the start of the block
+                    // up to the event's
+                    auto const samplesBefore = [period](int64_t t) {
+                        return t >= 0 ? (t + period - 1) / period : -((-t) / period);
+                    };
+
+                    offset = static_cast<size_t>(samplesBefore(blockStartTime + static_cast<int64_t>(offset)) - samplesBefore(blockStartTime));
+                    ramp = static_cast<uint32_t>((static_cast<int64_t>(ramp) + period / 2) / period);
+                }
+
+                if (!it->node->scheduleParameterEvent(offset, e.slot, e.value, ramp)) {
+                    numDropped++;
+                }
+            }
+
+            pending.resize(kept);
+        }
+
+        // Keeps a node alive for as long as this sequence, for nodes it refers to without
+        // rendering them, such as folded nodes pushed above
+        void retain(std::shared_ptr<GraphNode<FloatType>> node) {
+            retainedNodes.push_back(std::move(node));
+        }
+
+        // Records the number of host output channels this sequence was built for, or zero
+        // if that wasn't known, and the number of channels its roots write to. The roots of
+        // any channels beyond the host's are left out of the sequence.
+        void setOutputChannels(size_t numHostChannels, size_t numRootChannels) {
+            builtForNumChannels = numHostChannels;
+            numChannelsUsed = numRootChannels;
+        }
+
+        // Whether rendering to the given number of host channels would leave out a different
+        // set of roots than this sequence does, which then needs rebuilding
+        bool needsRebuildFor(size_t numHostChannels) const {
+            auto const built = builtForNumChannels > 0 ? std::min(builtForNumChannels, numChannelsUsed) : numChannelsUsed;
+            return std::min(numHostChannels, numChannelsUsed) != built;
+        }
+
+        // Pushes a new subsequence, along with the indices of any previously pushed
+        // subsequences which render buffers that this one reads from.
+        void push(RootRenderSequence<FloatType>&& sq, std::vector<size_t> const& deps = {})
+        {
+            dependencies.push_back(deps);
             subseqs.push_back(std::move(sq));
         }
 
+        // Sizes the completion flags for the parallel render path once every subsequence
+        // has been pushed. The runtime calls this before handing the sequence to the
+        // realtime thread, after which the flags are never resized.
+        void finalize()
+        {
+            completedBlock = std::vector<std::atomic<uint64_t>>(subseqs.size());
+            didRender.assign(subseqs.size(), 0);
+        }
+
         void process(
             const FloatType** inputChannelData,
             size_t numInputChannels,
             FloatType** outputChannelData,
             size_t numOutputChannels,
             size_t numSamples,
-            void* userData)
+            void* userData,
+            RenderThreadPool* threadPool = nullptr,
+            bool profiling = false,
+            int64_t sampleTime = 0,
+            bool checkNumerics = false)
         {
             HostContext<FloatType> ctx {
                 inputChannelData,
@@ -191,6 +967,9 @@ namespace elem
                 numOutputChannels,
                 numSamples,
                 userData,
+                profiling,
+                sampleTime,
+                checkNumerics,
             };
 
             // Clear the output channels
@@ -206,16 +985,98 @@ namespace elem
             }
 
             // Process subsequences
-            std::for_each(subseqs.begin(), subseqs.end(), [&](RootRenderSequence<FloatType>& sq) {
-                sq.process(ctx);
-            });
+            if (threadPool == nullptr || subseqs.size() < 2) {
+                std::for_each(subseqs.begin(), subseqs.end(), [&](RootRenderSequence<FloatType>& sq) {
+                    sq.process(ctx);
+                });
+
+                return;
+            }
+
+            processParallel(ctx, *threadPool);
         }
 
-        std::unordered_map<NodeId, FloatType*> bufferMap;
+        // See RootRenderSequence::drainProfile
+        template <typename Fn>
+        void drainProfile(Fn&& fn)
+        {
+            for (auto& sq : subseqs) {
+                sq.drainProfile(fn);
+            }
+        }
+
+        // See RootRenderSequence::drainNumerics
+        template <typename Fn>
+        void drainNumerics(Fn&& fn)
+        {
+            for (auto& sq : subseqs) {
+                sq.drainNumerics(fn);
+            }
+        }
+
+        std::unordered_map<NodeId, RenderBuffer<FloatType>> bufferMap;
 
     private:
+        //==============================================================================
+        // Renders each subsequence as a task on the thread pool, where a task first waits
+        // for the subsequences it depends on. Subsequences are pushed in dependency order,
+        // so every dependency has a lower task index and has already been claimed by
+        // a running thread by the time we wait on it.
+        //
+        // The root outputs are then summed on the calling thread in the same order as the
+        // serial path so that the result does not depend on the thread count.
+        void processParallel(HostContext<FloatType>& ctx, RenderThreadPool& threadPool)
+        {
+            struct Job {
+                GraphRenderSequence* self;
+                HostContext<FloatType>* ctx;
+                uint64_t block;
+            };
+
+            Job job { this, &ctx, ++blockCounter };
+
+            threadPool.run(subseqs.size(), [](void* context, size_t i) {
+                auto& j = *static_cast<Job*>(context);
+                auto& self = *j.self;
+
+                for (auto const d : self.dependencies[i]) {
+                    while (self.completedBlock[d].load(std::memory_order_acquire) != j.block) {
+                        std::this_thread::yield();
+                    }
+                }
+
+                self.didRender[i] = self.subseqs[i].render(*j.ctx);
+                self.completedBlock[i].store(j.block, std::memory_order_release);
+            }, &job);
+
+            for (size_t i = 0; i < subseqs.size(); ++i) {
+                if (didRender[i]) {
+                    subseqs[i].accumulate(ctx);
+                }
+            }
+        }
+
+        //==============================================================================
         std::vector<std::shared_ptr<TapOutNode<FloatType>>> taps;
+        struct ParameterNodeEntry {
+            NodeId id;
+            ParameterEventNode<FloatType>* node;
+            bool folded;
+            size_t controlRatePeriod;
+        };
+
+        std::vector<ParameterNodeEntry> parameterNodes;
+        bool hasFoldedParameterNodes = false;
+        std::vector<std::shared_ptr<GraphNode<FloatType>>> retainedNodes;
+        size_t builtForNumChannels = 0;
+        size_t numChannelsUsed = 0;
         std::vector<RootRenderSequence<FloatType>> subseqs;
+
+        std::vector<std::vector<size_t>> dependencies;
+        std::vector<std::atomic<uint64_t>> completedBlock;
+        std::vector<uint8_t> didRender;
+        uint64_t blockCounter = 0;
+        size_t numBuffers = 0;
     };
 
 } // namespace elem
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+
+namespace elem
+{
+
+    //==============================================================================
+    // A slab allocator for graph nodes.
+    //
+    // Nodes made by `std::make_shared` land wherever the heap has room at the time, among
+    // everything else the process allocates, so rendering a large graph chases pointers
+    // all over memory. A runtime instead creates its nodes in its own arena, which packs
+    // them one after another into large slabs, in the order they're created, along with
+    // the control blocks of their shared pointers. A batch from the frontend creates a
+    // graph's nodes together, so its nodes end up neighbours in memory as well, which
+    // keeps the render pass to fewer cache lines and pages.
+    //
+    // Allocations are rounded up to whole cache lines, which also keeps any two nodes from
+    // sharing a line when they render on different threads. The memory of a freed node is
+    // kept on a free list for the next node of the same size, and slabs are only returned
+    // when the arena goes, which is once every node it holds has gone. Anything too big
+    // for a slab comes from the heap as usual.
+    //
+    // Nodes are allocated and freed on the non-realtime thread, but the arena takes a lock
+    // for both in case the last reference to a node is dropped elsewhere.
+    class NodeArena : public std::enable_shared_from_this<NodeArena>
+    {
+    public:
+        static constexpr size_t kSlabSize = 256 * 1024;
+        static constexpr size_t kAlignment = 64;
+
+        // The largest allocation made in a slab
+        static constexpr size_t kMaxSlabAllocation = kSlabSize / 8;
+
+        NodeArena() = default;
+        NodeArena(NodeArena const&) = delete;
+
+        ~NodeArena()
+        {
+            for (auto* slab : slabs) {
+                ::operator delete(slab, std::align_val_t(kAlignment));
+            }
+        }
+
+        void* allocate(size_t size, size_t alignment)
+        {
+            if (size > kMaxSlabAllocation || alignment > kAlignment)
+                return ::operator new(size, std::align_val_t(std::max(alignment, kAlignment)));
+
+            auto const sizeClass = (size + kAlignment - 1) / kAlignment;
+            std::lock_guard<std::mutex> lock(mutex);
+
+            if (auto& freeList = freeLists[sizeClass]; !freeList.empty()) {
+                auto* p = freeList.back();
+                freeList.pop_back();
+                return p;
+            }
+
+            auto const bytes = sizeClass * kAlignment;
+
+            if (slabs.empty() || slabUsed + bytes > kSlabSize) {
+                slabs.push_back(static_cast<std::byte*>(::operator new(kSlabSize, std::align_val_t(kAlignment))));
+                slabUsed = 0;
+            }
+
+            auto* p = slabs.back() + slabUsed;
+            slabUsed += bytes;
+
+            return p;
+        }
+
+        void deallocate(void* p, size_t size, size_t alignment)
+        {
+            if (size > kMaxSlabAllocation || alignment > kAlignment) {
+                ::operator delete(p, std::align_val_t(std::max(alignment, kAlignment)));
+                return;
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            freeLists[(size + kAlignment - 1) / kAlignment].push_back(p);
+        }
+
+        size_t getNumSlabs() const
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return slabs.size();
+        }
+
+        //==============================================================================
+        // While a Scope is alive, `makeShared` on the same thread creates its objects in
+        // the given arena. The runtime opens one around each call to a node factory, which
+        // leaves the signature of factories untouched: those which go through `makeShared`,
+        // as the default node types do, allocate from the arena, and the rest allocate
+        // however they like.
+        class Scope
+        {
+        public:
+            explicit Scope(NodeArena& arena)
+                : previous(current)
+            {
+                current = &arena;
+            }
+
+            ~Scope()
+            {
+                current = previous;
+            }
+
+            Scope(Scope const&) = delete;
+
+        private:
+            NodeArena* previous;
+        };
+
+        template <typename T>
+        struct Allocator
+        {
+            using value_type = T;
+
+            explicit Allocator(std::shared_ptr<NodeArena> a) : arena(std::move(a)) {}
+
+            template <typename U>
+            Allocator(Allocator<U> const& other) : arena(other.arena) {}
+
+            T* allocate(size_t n) { return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T))); }
+            void deallocate(T* p, size_t n) { arena->deallocate(p, n * sizeof(T), alignof(T)); }
+
+            template <typename U>
+            bool operator==(Allocator<U> const& other) const { return arena == other.arena; }
+
+            template <typename U>
+            bool operator!=(Allocator<U> const& other) const { return arena != other.arena; }
+
+            // Every node holds onto the arena through its control block's copy of the
+            // allocator, so the arena outlives the last of its nodes
+            std::shared_ptr<NodeArena> arena;
+        };
+
+        // Like `std::make_shared`, but in the current Scope's arena if there is one
+        template <typename T, typename... Args>
+        static std::shared_ptr<T> makeShared(Args&&... args)
+        {
+            if (current == nullptr)
+                return std::make_shared<T>(std::forward<Args>(args)...);
+
+            return std::allocate_shared<T>(Allocator<T>(current->shared_from_this()), std::forward<Args>(args)...);
+        }
+
+    private:
+        static inline thread_local NodeArena* current = nullptr;
+
+        mutable std::mutex mutex;
+        std::vector<std::byte*> slabs;
+        size_t slabUsed = 0;
+        std::vector<void*> freeLists[kMaxSlabAllocation / kAlignment + 1];
+    };
+
+} // namespace elem
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "DefaultNodeTypes.h"
+#include "GraphNode.h"
+#include "Invariant.h"
+
+
+namespace elem
+{
+
+    //==============================================================================
+    // A table of the factory functions for each node type, by name.
+    //
+    // Every Runtime creates its nodes through a registry, which may be shared by any
+    // number of runtimes once it's been filled in: a shared registry is read only, so
+    // sharing one costs nothing per runtime, and a runtime's own `registerNodeType`
+    // adds to a table of its own on top. By default, runtimes share the registry of
+    // the default node types returned by `getDefault`.
+    template <typename FloatType>
+    class NodeTypeRegistry
+    {
+    public:
+        using NodeFactoryFn = std::function<std::shared_ptr<GraphNode<FloatType>>(NodeId const id, double sampleRate, int const blockSize)>;
+
+        NodeTypeRegistry() = default;
+
+        // Returns a new registry holding the default node types, to which custom node
+        // types may be added before it's shared
+        static std::shared_ptr<NodeTypeRegistry> createDefault()
+        {
+            auto registry = std::make_shared<NodeTypeRegistry>();
+
+            DefaultNodeTypes<FloatType>::forEach([&](std::string const& type, NodeFactoryFn&& fn) {
+                registry->add(type, std::move(fn));
+            });
+
+            return registry;
+        }
+
+        // The registry of default node types which runtimes share unless given another
+        static std::shared_ptr<NodeTypeRegistry const> const& getDefault()
+        {
+            static std::shared_ptr<NodeTypeRegistry const> const registry = createDefault();
+            return registry;
+        }
+
+        void add(std::string const& type, NodeFactoryFn&& fn)
+        {
+            invariant(factories.find(type) == factories.end(), "Trying to install a node type which already exists");
+            factories.emplace(type, std::move(fn));
+        }
+
+        // Returns the factory for the given type, or nullptr if there is none
+        NodeFactoryFn const* find(std::string const& type) const
+        {
+            auto it = factories.find(type);
+            return (it != factories.end()) ? &it->second : nullptr;
+        }
+
+    private:
+        std::unordered_map<std::string, NodeFactoryFn> factories;
+    };
+
+} // namespace elem
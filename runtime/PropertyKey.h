@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+
+namespace elem
+{
+
+    //==============================================================================
+    // An interned property name.
+    //
+    // Every distinct property name is assigned a small integer id the first time it
+    // is seen, and that id is shared by every node of every runtime in the process.
+    // Comparing two keys is then an integer comparison, and nodes can look up their
+    // properties without hashing strings.
+    //
+    // Construction from a string takes a lock on the intern table, so hot paths should
+    // hold onto a key (e.g. in a static) rather than constructing one on every call.
+    class PropertyKey
+    {
+    public:
+        PropertyKey(std::string_view name)
+            : id(intern(name)) {}
+
+        PropertyKey(std::string const& name)
+            : PropertyKey(std::string_view(name)) {}
+
+        PropertyKey(char const* name)
+            : PropertyKey(std::string_view(name)) {}
+
+        uint32_t getId() const { return id; }
+
+        std::string const& toString() const
+        {
+            auto& t = table();
+            std::lock_guard<std::mutex> lock(t.mutex);
+
+            return t.names[id];
+        }
+
+        bool operator==(PropertyKey const& other) const { return id == other.id; }
+        bool operator!=(PropertyKey const& other) const { return id != other.id; }
+
+    private:
+        struct InternTable
+        {
+            std::mutex mutex;
+
+            // A deque so that the strings never move, which lets the index below
+            // key on views into them
+            std::deque<std::string> names;
+            std::unordered_map<std::string_view, uint32_t> ids;
+        };
+
+        static InternTable& table()
+        {
+            static InternTable t;
+            return t;
+        }
+
+        static uint32_t intern(std::string_view name)
+        {
+            auto& t = table();
+            std::lock_guard<std::mutex> lock(t.mutex);
+
+            if (auto it = t.ids.find(name); it != t.ids.end())
+                return it->second;
+
+            auto const nextId = static_cast<uint32_t>(t.names.size());
+
+            t.names.emplace_back(name);
+            t.ids.emplace(std::string_view(t.names.back()), nextId);
+
+            return nextId;
+        }
+
+        uint32_t id;
+    };
+
+} // namespace elem
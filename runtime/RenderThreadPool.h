@@ -0,0 +1,182 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "Denormals.h"
+#include "ElemAssert.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+  #include <immintrin.h>
+  #define ELEM_CPU_PAUSE() _mm_pause()
+#elif defined(__aarch64__) && !defined(_MSC_VER)
+  #define ELEM_CPU_PAUSE() asm volatile("yield")
+#else
+  #define ELEM_CPU_PAUSE()
+#endif
+
+
+namespace elem
+{
+
+    //==============================================================================
+    // A fixed pool of pre-spawned worker threads for rendering independent parts of
+    // the graph in parallel.
+    //
+    // The pool is driven from the realtime thread via `run`, which publishes a set of
+    // tasks that the workers and the calling thread then claim, in order, from a single
+    // shared counter. The calling thread always participates, so every task set makes
+    // progress even if no worker is awake. Neither `run` nor the worker loop allocates
+    // or takes a lock.
+    //
+    // Because tasks are claimed in increasing index order, a task may safely wait on
+    // the completion of any task with a lower index: that task has necessarily already
+    // been claimed by a running thread.
+    //
+    // The workers run each task set with the calling thread's denormal mode, see
+    // ScopedFlushDenormals, so that its tasks see the same arithmetic wherever they run.
+    class RenderThreadPool
+    {
+    public:
+        //==============================================================================
+        using TaskFn = void(*)(void* context, size_t taskIndex);
+
+        RenderThreadPool(size_t numWorkers)
+        {
+            for (size_t i = 0; i < numWorkers; ++i) {
+                workers.emplace_back([this]() { workerLoop(); });
+            }
+        }
+
+        ~RenderThreadPool()
+        {
+            shouldExit.store(true, std::memory_order_release);
+
+            for (auto& t : workers) {
+                t.join();
+            }
+        }
+
+        size_t getNumWorkers() const { return workers.size(); }
+
+        //==============================================================================
+        // Runs `fn(context, i)` for each i in [0, numTasks) across the pool and the
+        // calling thread, returning once every task has completed.
+        //
+        // Must only be called from one thread at a time (the realtime thread).
+        void run(size_t numTasks, TaskFn fn, void* context)
+        {
+            ELEM_ASSERT(numTasks < kMaxTasks);
+
+            if (numTasks == 0)
+                return;
+
+            taskFn.store(fn, std::memory_order_relaxed);
+            taskContext.store(context, std::memory_order_relaxed);
+            flushDenormals.store(detail::isFlushingDenormals(), std::memory_order_relaxed);
+            numCompleted.store(0, std::memory_order_relaxed);
+
+            // Publishing the new state releases the job description above to any
+            // thread that successfully claims a task from it
+            auto const epoch = (unpackEpoch(state.load(std::memory_order_relaxed)) + 1) & kEpochMask;
+            state.store(pack(epoch, numTasks, 0), std::memory_order_release);
+
+            // Help out until there's nothing left to claim
+            while (tryRunNextTask()) {}
+
+            // Then wait for any tasks still running on the workers
+            while (numCompleted.load(std::memory_order_acquire) < numTasks) {
+                pause();
+            }
+        }
+
+    private:
+        //==============================================================================
+        // The whole scheduling state lives in one atomic word so that a claim can
+        // never observe the task count of one job and the counter of another.
+        static constexpr uint64_t kIndexBits = 20;
+        static constexpr uint64_t kIndexMask = (uint64_t(1) << kIndexBits) - 1;
+        static constexpr uint64_t kEpochMask = (uint64_t(1) << 24) - 1;
+        static constexpr size_t kMaxTasks = kIndexMask;
+
+        static uint64_t pack(uint64_t epoch, uint64_t numTasks, uint64_t next) {
+            return (epoch << (2 * kIndexBits)) | (numTasks << kIndexBits) | next;
+        }
+
+        static uint64_t unpackEpoch(uint64_t s) { return s >> (2 * kIndexBits); }
+        static uint64_t unpackNumTasks(uint64_t s) { return (s >> kIndexBits) & kIndexMask; }
+        static uint64_t unpackNext(uint64_t s) { return s & kIndexMask; }
+
+        static void pause() {
+            ELEM_CPU_PAUSE();
+        }
+
+        // Workers pass in the denormal mode they're in, which they bring in line with the
+        // job's before running a task from it
+        bool tryRunNextTask(bool* workerFlushesDenormals = nullptr)
+        {
+            auto s = state.load(std::memory_order_acquire);
+
+            while (unpackNext(s) < unpackNumTasks(s)) {
+                if (state.compare_exchange_weak(s, s + 1, std::memory_order_acq_rel, std::memory_order_acquire)) {
+                    // Having claimed a task, the current job cannot complete (and thus cannot
+                    // be replaced) until we report back, so the job description is stable here.
+                    auto const fn = taskFn.load(std::memory_order_relaxed);
+                    auto* const ctx = taskContext.load(std::memory_order_relaxed);
+
+                    if (workerFlushesDenormals != nullptr) {
+                        if (auto const flush = flushDenormals.load(std::memory_order_relaxed); flush != *workerFlushesDenormals) {
+                            detail::setFlushingDenormals(flush);
+                            *workerFlushesDenormals = flush;
+                        }
+                    }
+
+                    fn(ctx, static_cast<size_t>(unpackNext(s)));
+                    numCompleted.fetch_add(1, std::memory_order_acq_rel);
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        void workerLoop()
+        {
+            using Clock = std::chrono::steady_clock;
+            auto lastWork = Clock::now();
+            auto flushesDenormals = detail::isFlushingDenormals();
+
+            while (!shouldExit.load(std::memory_order_acquire)) {
+                if (tryRunNextTask(&flushesDenormals)) {
+                    lastWork = Clock::now();
+                    continue;
+                }
+
+                // Spin briefly, then yield, then back off to short sleeps once we've been
+                // idle for a while so that an idle pool doesn't keep cores busy.
+                for (int i = 0; i < 64; ++i)
+                    pause();
+
+                if (Clock::now() - lastWork < std::chrono::milliseconds(5)) {
+                    std::this_thread::yield();
+                } else {
+                    std::this_thread::sleep_for(std::chrono::microseconds(100));
+                }
+            }
+        }
+
+        //==============================================================================
+        std::vector<std::thread> workers;
+
+        alignas(64) std::atomic<uint64_t> state = 0;
+        alignas(64) std::atomic<size_t> numCompleted = 0;
+        std::atomic<TaskFn> taskFn = nullptr;
+        std::atomic<void*> taskContext = nullptr;
+        std::atomic<bool> flushDenormals = false;
+        std::atomic<bool> shouldExit = false;
+    };
+
+} // namespace elem
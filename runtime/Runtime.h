@@ -1,16 +1,34 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <numeric>
 #include <set>
+#include <thread>
+#include <type_traits>
 #include <unordered_map>
+#include <unordered_set>
+#include <variant>
 
-#include "builtins/helpers/RefCountedPool.h"
+#include "ArenaValue.h"
+#include "BinaryInstructions.h"
 #include "DefaultNodeTypes.h"
+#include "Denormals.h"
 #include "GraphNode.h"
 #include "GraphRenderSequence.h"
 #include "Invariant.h"
+#include "SampleStream.h"
 #include "Types.h"
 #include "Value.h"
 #include "JSON.h"
+#include "NodeArena.h"
+#include "NodeTypeRegistry.h"
 
 
 #ifndef ELEM_DBG
@@ -41,13 +59,60 @@ namespace elem
     {
     public:
         //==============================================================================
-        Runtime(double sampleRate, int blockSize);
+        // Runtimes create their nodes through the given registry of node types, which
+        // defaults to the shared registry of the default types, and may fall back to a
+        // store of resources shared with other runtimes for any resource not added to
+        // their own map. See Engine.h for a host of many runtimes sharing both.
+        Runtime(
+            double sampleRate,
+            int blockSize,
+            std::shared_ptr<NodeTypeRegistry<FloatType> const> nodeTypes = nullptr,
+            std::shared_ptr<SharedResourceStore<FloatType>> resourceStore = nullptr
+        );
+
+        ~Runtime();
 
         //==============================================================================
         // Apply graph rendering instructions
+        //
+        // The whole batch is checked against the graph before any of it is applied, so a
+        // batch which refers to unknown nodes or node types, or is malformed, throws and
+        // leaves the graph untouched. A batch which fails while it's being applied, because
+        // a node rejects a property's value or the commit fails, throws once the changes it
+        // had made are undone. See `applyInstructionsAsync` for applying a batch without
+        // waiting for it.
         void applyInstructions(js::Array const& batch);
 
+        // Apply a batch of instructions encoded in the binary format described in
+        // BinaryInstructions.h, decoding directly from the given buffer.
+        //
+        // This behaves identically to the js::Array method above, but without the cost
+        // of parsing and allocating an intermediate tree of values from JSON.
+        void applyInstructions(uint8_t const* data, size_t size);
+
+        // Apply a batch of instructions given as a JSON string.
+        //
+        // This is equivalent to `applyInstructions(js::parseJSON(json).getArray())`, except
+        // that the batch is parsed into an arena owned by the runtime which is reused from one
+        // batch to the next, rather than into a tree of individually allocated values.
+        void applyInstructions(std::string_view json);
+
+        // Encodes the current graph as a batch in the binary instruction format: every node
+        // with its type and props, its edges, the active roots, and a commit. Applying the
+        // snapshot to a fresh runtime through `applyInstructions(data, size)` recreates the
+        // graph and builds its render sequence without any help from the JavaScript side.
+        //
+        // Snapshots hold the graph and not node state, such as delay lines or sequence
+        // positions. Shared resources are held by reference, through the props which name
+        // them, so the host must add the same resources before loading a snapshot.
+        std::vector<uint8_t> exportSnapshot();
+
         // Run the internal audio processing callback
+        //
+        // The host may pass any number of samples. Buffers longer than the internal block
+        // size, which is the blockSize given at construction unless changed through
+        // `setInternalBlockSize`, are rendered as a series of blocks of at most that size.
+        // The userData pointer is given unchanged to every one of those blocks.
         void process(
             const FloatType** inputChannelData,
             size_t numInputChannels,
@@ -63,19 +128,168 @@ namespace elem
         // or errors encountered while processing.
         void processQueuedEvents(std::function<void(std::string const&, js::Value)> evtCallback);
 
+        // Process queued events into a typed event buffer
+        //
+        // This clears the buffer and fills it with the same events as the callback overload
+        // would raise, in the same order. Nodes which support it, such as the analyzers,
+        // write their data straight into the buffer's preallocated frames, so that a host
+        // which reuses one buffer for every call does no allocation for those events.
+        void processQueuedEvents(EventBuffer& events);
+
         // Reset the internal graph nodes
         //
         // This allows each node to optionally reset any internal state, such as
         // delay buffers or sample readers.
         void reset();
 
+        // Reclaims render sequences that the realtime thread has retired, and deallocates
+        // any deleted nodes they were keeping alive.
+        //
+        // The realtime thread never frees memory itself: when it picks up a new render
+        // sequence it hands the previous one back to be released here instead. This is
+        // called at the start of each `applyInstructions`, but hosts which may go a long
+        // time between instruction batches can also call it periodically from the same
+        // non-realtime thread.
+        void collectGarbage();
+
+        // Timings for the phases of the most recent call to `applyInstructions`, in
+        // microseconds, for measuring the cost of graph updates on the non-realtime thread.
+        struct BatchStats {
+            // Parsing the batch, which is only done for batches given as a JSON string
+            double parseUs = 0;
+
+            // Applying the instructions themselves, excluding building render sequences
+            double applyUs = 0;
+
+            // Building new render sequences on commit
+            double buildRenderSequenceUs = 0;
+
+            // Reclaiming retired render sequences and pruning deleted nodes, before the
+            // batch and after it
+            double collectGarbageUs = 0;
+
+            size_t numInstructions = 0;
+            size_t numRenderSequenceBuilds = 0;
+        };
+
+        // Hosts applying batches through `applyInstructionsAsync` should take each batch's
+        // stats from its BatchResult instead, as the compiler thread writes these.
+        BatchStats const& getLastBatchStats() const { return lastBatchStats; }
+
+        // The outcome of a batch given to `applyInstructionsAsync`: the message of the
+        // error which stopped it, if any, and its timings
+        struct BatchResult {
+            std::string error;
+            BatchStats stats;
+
+            bool succeeded() const { return error.empty(); }
+        };
+
+        using BatchCompletionFn = std::function<void(BatchResult const&)>;
+
+        // Applies a batch of instructions on the runtime's compiler thread, returning as
+        // soon as the batch has been handed over, so that the caller never waits for the
+        // graph to be traversed and its render sequence built. The realtime thread carries
+        // on with the current render sequence until the new one is published.
+        //
+        // Batches are applied in the order they're given, and each is validated as a whole
+        // before any of it is applied, as in `applyInstructions`. Batches which queue up
+        // while the compiler is busy are applied together, and build a single render
+        // sequence once the last has been applied. `onComplete` is then called on the
+        // compiler thread with each batch's result, after its render sequence has been
+        // handed to the realtime thread.
+        //
+        // The other non-realtime methods may still be called from the caller's thread
+        // meanwhile. Those which touch the graph wait for the compiler to finish, apart
+        // from `processQueuedEvents`, which skips relaying events while the compiler is
+        // busy, and `applyInstructions`, which first waits for every batch given here.
+        void applyInstructionsAsync(js::Array batch, BatchCompletionFn onComplete = nullptr);
+        void applyInstructionsAsync(std::vector<uint8_t> data, BatchCompletionFn onComplete = nullptr);
+        void applyInstructionsAsync(std::string json, BatchCompletionFn onComplete = nullptr);
+
+        // Waits until every batch given to `applyInstructionsAsync` has been applied
+        void waitForCompilation();
+
+        // Enables profiling of the realtime render pass.
+        //
+        // While enabled, the realtime thread accumulates the time spent rendering each node,
+        // and in each call to `process` overall. Each call to `processQueuedEvents` then
+        // reports and resets those totals with a "profile" event, which gives the time spent
+        // in each node along with its id and type, and the total callback time as a share
+        // of the time available for the blocks it rendered. When disabled, the render pass
+        // does no timing at all.
+        //
+        // This may be called from the non-realtime thread at any time.
+        void setProfilingEnabled(bool enabled);
+
+        // Sets whether `process` flushes subnormal numbers to zero while it renders, which
+        // it does by default. Decaying signals, like filter states and the tails of
+        // feedback loops, otherwise pass through subnormals on their way to zero, and on
+        // most x86 CPUs arithmetic on those is many times slower than on any other.
+        //
+        // The mode is the CPU's, see ScopedFlushDenormals, and applies to the render threads
+        // as well. Where the CPU has no such mode, as on WebAssembly, the nodes with a
+        // recursive state flush it themselves once a block whatever the setting.
+        //
+        // This may be called from the non-realtime thread at any time.
+        void setFlushDenormalsEnabled(bool enabled);
+
+        // Enables checking the render pass for NaN, infinite and subnormal samples.
+        //
+        // While enabled, the realtime thread counts those samples in the output of each
+        // node, and each call to `processQueuedEvents` then reports and resets the counts
+        // with a "numerics" event, which gives the id, type and counts of each node which
+        // output any. Nothing is reported while no node does. Subnormals only show up
+        // with `setFlushDenormalsEnabled(false)`, or where the CPU can't flush them.
+        //
+        // This may be called from the non-realtime thread at any time.
+        void setNumericChecksEnabled(bool enabled);
+
         //==============================================================================
         // Loads a shared buffer into memory.
         //
         // This method populates an internal map from which any GraphNode can request a
-        // shared pointer to the data.
+        // shared pointer to the data. This overload copies the given mono data.
         void updateSharedResourceMap(std::string const& name, FloatType const* data, size_t size);
 
+        // Adds a resource made by one of SharedResource's `copy`, `adopt` or `borrow`
+        // methods, which lets the caller hand over its memory without a copy and supply
+        // multichannel data.
+        //
+        // Replacing a resource that nodes are still playing is safe: the old one is kept
+        // until they let go of it, and freed on this thread by a later `collectGarbage`.
+        void updateSharedResourceMap(std::string const& name, SharedResourceBuffer<FloatType>&& resource);
+
+        // Removes the named resource from the map, to be freed once no node refers to it.
+        void removeSharedResource(std::string const& name);
+
+        // Removes every resource in the map that no node currently refers to, returning
+        // the number removed. Like `collectGarbage`, this frees memory, so it must be
+        // called from the non-realtime thread.
+        size_t pruneSharedResourceMap();
+
+        // The names of the resources in the map
+        std::vector<std::string> getSharedResourceMapKeys() const;
+
+        // Adds a sample that is streamed from disk as it plays, rather than loaded into
+        // memory, under the given name.
+        //
+        // Sample nodes whose path names the stream read from it just as they would from
+        // a shared buffer. The first `preloadSize` samples are read into memory up front so
+        // that playback can start immediately, and a background I/O thread, started with
+        // the first stream, reads the rest into a ring buffer of `bufferSize` samples
+        // ahead of each playing voice. See SampleStream.h for the available backends.
+        void addSampleStream(
+            std::string const& name,
+            std::unique_ptr<SampleStreamBackend<FloatType>>&& backend,
+            size_t preloadSize = 32768,
+            size_t bufferSize = 65536
+        );
+
+        // The number of samples that streaming voices have played as silence because the
+        // I/O thread had not yet read them from disk.
+        uint64_t getNumSampleStreamUnderruns() const;
+
         // For registering custom GraphNode factory functions.
         //
         // New node types must inherit GraphNode, and the factory function must produce a shared
@@ -84,9 +298,59 @@ namespace elem
         // After registering your node type, the runtime instance will be ready to receive
         // instructions for your new type, such as those produced by the frontend
         // from, e.g., `core.render(createNode("myNewNodeType", props, [children]))`
-        using NodeFactoryFn = std::function<std::shared_ptr<GraphNode<FloatType>>(NodeId const id, double sampleRate, int const blockSize)>;
+        //
+        // Types registered here belong to this runtime alone, on top of those of its registry.
+        using NodeFactoryFn = typename NodeTypeRegistry<FloatType>::NodeFactoryFn;
         void registerNodeType (std::string const& type, NodeFactoryFn && fn);
 
+        // Enables parallel rendering across a pool of worker threads.
+        //
+        // When enabled, independent root subsequences of the graph are rendered
+        // concurrently on `numWorkerThreads` pre-spawned threads alongside the realtime
+        // thread itself. Passing 0 returns to serial rendering on the calling thread.
+        //
+        // This is not realtime safe, and must not be called while another thread
+        // may be calling `process`.
+        void setNumRenderThreads (size_t numWorkerThreads);
+
+        // Sets the largest block that `process` renders the graph in, which may be smaller
+        // than the blockSize given at construction but not larger. Smaller blocks cost more
+        // per sample, but let things like feedback loops and control signals which update
+        // once per block respond sooner. Passing 0 returns to the constructed blockSize.
+        //
+        // This may be called from the non-realtime thread at any time.
+        void setInternalBlockSize (int size);
+
+        //==============================================================================
+        // Schedules a sample accurate change to one of a node's parameters, such as the
+        // value of a `const` node on slot 0, without an instruction batch. This is the
+        // cheap path for fine grained automation: the event goes through a lock free queue
+        // to the realtime thread, which applies it at exactly `sampleTime`, ramping
+        // linearly to the new value over `rampSamples` if given. See ParameterEventNode.
+        //
+        // Times are in samples since the runtime started rendering, see `getSampleTime`.
+        // Events due before the block in which they arrive apply at its start, and
+        // events for nodes which don't take them, or which aren't being rendered, are
+        // dropped. Returns false, dropping the event, if the queue is full.
+        //
+        // A const node which the render sequence folded into a constant, or merged with
+        // another, can't apply its first event until the sequence is rebuilt with the
+        // node rendering on its own. The first event asks for that as soon as it reaches
+        // the realtime thread, and the rebuild happens on the next call to `collectGarbage`
+        // or `processQueuedEvents`; events wait until then, applying late if they must.
+        // Scheduling the first event for a node a little ahead of time avoids that.
+        //
+        // Events may be scheduled from any one thread at a time, which needn't be the
+        // thread that applies instructions.
+        bool scheduleParameterEvent(NodeId nodeId, uint32_t slot, FloatType value, int64_t sampleTime, uint32_t rampSamples = 0);
+
+        // The number of samples rendered so far, as of the last call to `process`
+        int64_t getSampleTime() const { return sampleTime.load(std::memory_order_acquire); }
+
+        // The number of events scheduled through `scheduleParameterEvent` which the
+        // realtime thread has dropped
+        uint64_t getNumDroppedParameterEvents() const { return numDroppedParameterEvents.load(std::memory_order_relaxed); }
+
     private:
         //==============================================================================
         // The rendering interface
@@ -99,29 +363,451 @@ namespace elem
           COMMIT_UPDATES = 5,
         };
 
+        // Each form of instruction batch decodes into calls on a sink, which is either
+        // the validator, checking the batch against the graph and the nodes it stages, or
+        // the applier, which makes the changes. Applying a batch returns whether it
+        // asked for a commit, which is left to the caller when the commit is deferred.
+        bool applyBatch(js::Array const& batch, bool deferCommit);
+        bool applyBatch(uint8_t const* data, size_t size, bool deferCommit);
+        bool applyBatch(std::string_view json, bool deferCommit);
+
+        template <typename Sink>
+        void decodeBatch(js::Array const& batch, Sink& sink);
+        template <typename Sink>
+        size_t decodeBatch(uint8_t const* data, size_t size, Sink& sink);
+        template <typename Sink>
+        void decodeBatch(js::ArenaValue const& batch, Sink& sink);
+
+        struct BatchValidator {
+            Runtime& rt;
+
+            // The nodes this batch has created, true, or deleted, false, so far
+            std::unordered_map<NodeId, bool>& staged;
+
+            BatchValidator(Runtime& r, std::unordered_map<NodeId, bool>& s) : rt(r), staged(s) { staged.clear(); }
+
+            bool exists(NodeId id) const {
+                auto const it = staged.find(id);
+                return it != staged.end() ? it->second : rt.nodeTable.count(id) > 0;
+            }
+
+            void createNode(NodeId id, std::string const& type) {
+                invariant(rt.nodeFactory.count(type) > 0 || rt.nodeTypes->find(type) != nullptr, "Unknown node type " + type);
+                invariant(!exists(id), "Trying to create a node which already exists.");
+                staged.insert_or_assign(id, true);
+            }
+
+            void deleteNode(NodeId id) {
+                invariant(exists(id), "Trying to delete an unrecognized node.");
+                staged.insert_or_assign(id, false);
+            }
+
+            template <typename Value>
+            void setProperty(NodeId id, std::string const&, Value const&) {
+                invariant(exists(id), "Trying to set a property for an unrecognized node.");
+            }
+
+            void appendChild(NodeId parentId, NodeId childId) {
+                invariant(exists(parentId), "Trying to append a child to an unknown parent.");
+                invariant(exists(childId), "Trying to append an unknown child to a parent.");
+            }
+
+            void activateRoots(std::vector<NodeId> const& roots) {
+                for (auto const nodeId : roots) {
+                    invariant(exists(nodeId), "Trying to activate an unrecognized root node.");
+                }
+            }
+
+            void commitUpdates() {}
+        };
+
+        // Applies a batch which has passed the BatchValidator. Nodes may still reject the
+        // values of their props, and the commit may fail, so the applier keeps a log with
+        // which to undo each change it has made, newest first, leaving the graph as it was.
+        // Changes to the nodes which the batch itself created need no entry of their own.
+        struct BatchApplier {
+            Runtime& rt;
+            bool deferCommit = false;
+            bool commitRequested = false;
+
+            std::vector<std::function<void()>> undoLog;
+            std::unordered_set<NodeId> created;
+
+            void createNode(NodeId id, std::string const& type) {
+                rt.createNode(id, type);
+                created.insert(id);
+
+                undoLog.push_back([this, id]() {
+                    rt.polledEventNodes.erase(rt.nodeTable.at(id).get());
+                    rt.tapOutTable.erase(id);
+                    rt.edgeTable.erase(id);
+                    rt.nodeTypeTable.erase(id);
+                    rt.dirtyNodes.erase(id);
+                    rt.nodeTable.erase(id);
+                });
+            }
+
+            void deleteNode(NodeId id) {
+                auto node = rt.nodeTable.at(id);
+                auto edges = rt.edgeTable.at(id);
+                auto type = rt.nodeTypeTable.at(id);
+
+                rt.deleteNode(id);
+
+                undoLog.push_back([this, id, node = std::move(node), edges = std::move(edges), type = std::move(type)]() {
+                    auto const it = rt.garbageTable.find(id);
+
+                    if (it != rt.garbageTable.end() && it->second == node) {
+                        rt.garbageTable.erase(it);
+                    }
+
+                    rt.nodeTable.insert({id, node});
+                    rt.edgeTable.insert({id, edges});
+                    rt.nodeTypeTable.insert_or_assign(id, type);
+
+                    if (!node->usesEventNotifications() && node->mayRelayEvents()) {
+                        rt.polledEventNodes.insert(node.get());
+                    }
+
+                    if (auto ptr = std::dynamic_pointer_cast<TapOutNode<FloatType>>(node)) {
+                        rt.tapOutTable.insert({id, ptr});
+                    }
+
+                    rt.dirtyNodes.insert(id);
+                    rt.renderSequenceDirty = true;
+                });
+            }
+
+            void setProperty(NodeId id, std::string const& key, js::Value const& v) {
+                if (created.count(id) == 0) {
+                    auto const* previous = rt.nodeTable.at(id)->getProperty(key);
+
+                    undoLog.push_back([this, id, key, hadValue = previous != nullptr, value = previous ? *previous : js::Value()]() {
+                        if (hadValue) {
+                            rt.setProperty(id, key, value);
+                        } else {
+                            rt.nodeTable.at(id)->removeProperty(key);
+                            rt.renderSequenceDirty = true;
+                        }
+                    });
+                }
+
+                rt.setProperty(id, key, v);
+            }
+
+            void setProperty(NodeId id, std::string const& key, js::ArenaValue const& v) { setProperty(id, key, v.toValue()); }
+
+            void appendChild(NodeId parentId, NodeId childId) {
+                rt.appendChild(parentId, childId);
+
+                if (created.count(parentId) == 0) {
+                    undoLog.push_back([this, parentId]() {
+                        rt.edgeTable.at(parentId).pop_back();
+                        rt.dirtyNodes.insert(parentId);
+                    });
+                }
+            }
+
+            void activateRoots(std::vector<NodeId> const& roots) {
+                // Activating the new roots deactivates the others, so we note the state of both
+                std::vector<std::pair<NodeId, bool>> wasActive;
+
+                auto note = [&](NodeId id) {
+                    if (created.count(id) == 0) {
+                        if (auto ptr = std::dynamic_pointer_cast<RootNode<FloatType>>(rt.nodeTable.at(id))) {
+                            wasActive.push_back({id, ptr->isActive()});
+                        }
+                    }
+                };
+
+                for (auto const id : roots) {
+                    note(id);
+                }
+
+                for (auto const id : rt.currentRoots) {
+                    note(id);
+                }
+
+                undoLog.push_back([this, previousRoots = rt.currentRoots, wasActive = std::move(wasActive)]() {
+                    for (auto const& [id, active] : wasActive) {
+                        rt.nodeTable.at(id)->setProperty("active", active);
+                    }
+
+                    rt.currentRoots = previousRoots;
+                    rt.renderSequenceDirty = true;
+                });
+
+                rt.activateRoots(roots);
+            }
+
+            void commitUpdates() {
+                commitRequested = true;
+
+                if (!deferCommit) {
+                    rt.commitUpdates();
+                }
+            }
+
+            void undo() {
+                for (auto it = undoLog.rbegin(); it != undoLog.rend(); ++it) {
+                    (*it)();
+                }
+
+                undoLog.clear();
+            }
+        };
+
+        std::unordered_map<NodeId, bool> stagingTable;
+
+        // The compiler thread, started with the first asynchronous batch, takes every batch
+        // staged since it last looked, and applies them under the graphMutex. That mutex
+        // guards all of the state which the non-realtime methods share, and is recursive
+        // so that a completion handler or event callback may call back into the runtime.
+        struct StagedBatch {
+            std::variant<js::Array, std::vector<uint8_t>, std::string> instructions;
+            BatchCompletionFn onComplete;
+        };
+
+        void stageBatch(StagedBatch&& batch);
+        void runCompiler();
+        void compileBatches(std::vector<StagedBatch>& batches);
+
+        mutable std::recursive_mutex graphMutex;
+
+        std::mutex stagingMutex;
+        std::condition_variable stagingCv;
+        std::vector<StagedBatch> stagedBatches;
+        std::thread compilerThread;
+        bool compiling = false;
+        bool stopCompiler = false;
+
         void createNode(int32_t const& nodeId, std::string const& type);
         void deleteNode(int32_t const& nodeId);
         void setProperty(int32_t const& nodeId, std::string const& prop, js::Value const& v);
         void appendChild(int32_t const& parentId, int32_t const& childId);
-        void activateRoots(js::Array const& v);
+        void activateRoots(std::vector<NodeId> const& roots);
+        void commitUpdates();
+        void pruneGarbage();
+
+        // Clears the sequences the realtime thread has retired and keeps them for reuse
+        void drainRetiredSequences();
+
+        // Builds a new render sequence if the realtime thread asked for one
+        void commitRequestedRebuild();
+
+        // Bracket each call to `applyInstructions`, collecting garbage and keeping the
+        // lastBatchStats
+        void beginBatch();
+        void endBatch(size_t numInstructions);
+
+        void processProfile(std::function<void(std::string const&, js::Value)>& evtCallback);
+        void processNumerics(std::function<void(std::string const&, js::Value)>& evtCallback);
+
+        // Calls `fn` for each node which may have events to relay, see
+        // GraphNode::notifyEventsPending
+        template <typename Fn>
+        void visitEventNodes(Fn&& fn);
+
+        // Nodes using event notifications are pushed onto this list by the realtime thread
+        // when they have events pending. Garbage collection takes the list early if a node
+        // on it is about to be freed, holding the rest in pendingEventNodes until they're
+        // next visited.
+        EventNotificationList<FloatType> eventNotifications;
+        std::vector<GraphNode<FloatType>*> pendingEventNodes;
+
+        // Nodes without event notifications, which are visited every time until we find
+        // that they never relay events
+        std::unordered_set<GraphNode<FloatType>*> polledEventNodes;
+
+        // Lent to every node, see GraphNode::setEventScratch
+        EventBuffer eventScratch;
+
+        using Clock = std::chrono::steady_clock;
+
+        static double elapsedUs(Clock::time_point t0, Clock::time_point t1) {
+            return std::chrono::duration<double, std::micro>(t1 - t0).count();
+        }
+
+        BatchStats lastBatchStats;
+        Clock::time_point phaseStartTime;
+
+        // Renders one block of at most the internal block size
+        void processBlock(const FloatType** inputChannelData, size_t numInputChannels, FloatType** outputChannelData, size_t numOutputChannels, size_t numSamples, void* userData, bool profiling, bool checkNumerics);
+
+        std::atomic<size_t> internalBlockSize = 0;
+
+        // The channel pointers for each sub-block when splitting a host buffer, reserved
+        // up front for a generous number of channels
+        std::vector<FloatType const*> subBlockInputs;
+        std::vector<FloatType*> subBlockOutputs;
+
+        // Parameter events on their way to the realtime thread, which holds the ones that
+        // have arrived in pendingParameterEvents until the block they fall in. That list
+        // is reserved up front, and events are left in the queue while it's full.
+        SingleWriterSingleReaderQueue<ParameterEvent<FloatType>> parameterEventQueue { 1024 };
+        std::vector<ParameterEvent<FloatType>> pendingParameterEvents;
+        std::atomic<uint64_t> numDroppedParameterEvents = 0;
+
+        // The realtime thread's sample clock, and a copy of it for other threads
+        int64_t rtSampleTime = 0;
+        std::atomic<int64_t> sampleTime = 0;
+
+        // Totals for the profile, written by the realtime thread and drained by
+        // `processProfile`. The peak load is in parts per million of the block deadline.
+        std::atomic<bool> profilingEnabled = false;
+        std::atomic<int64_t> profiledCallbackNanos = 0;
+        std::atomic<int64_t> profiledNumSamples = 0;
+        std::atomic<int64_t> profiledNumBlocks = 0;
+        std::atomic<int64_t> profiledPeakLoadPpm = 0;
+
+        std::atomic<bool> flushDenormalsEnabled = true;
+        std::atomic<bool> numericChecksEnabled = false;
 
         BufferAllocator<FloatType> bufferAllocator;
+        js::ArenaJSONParser batchParser;
         std::shared_ptr<GraphRenderSequence<FloatType>> rtRenderSeq;
         std::shared_ptr<GraphRenderSequence<FloatType>> buildRenderSequence();
-        void traverse(std::set<NodeId>& visited, std::vector<NodeId>& visitOrder, NodeId const& n);
+
+        // Returns the index of the child whose buffer the given node may render into, or
+        // the number of children if there is no such child
+        size_t findInPlaceChild(
+            std::shared_ptr<GraphNode<FloatType>>& node,
+            std::vector<NodeId> const& children,
+            size_t seqIndex,
+            size_t visitIndex,
+            std::unordered_map<NodeId, size_t> const& owners,
+            std::unordered_map<NodeId, size_t> const& lastReader,
+            std::unordered_set<NodeId> const& pinned);
+        void traverse(std::unordered_set<NodeId>& visited, std::vector<NodeId>& visitOrder, std::vector<NodeId>& skipped, NodeId const& n);
+
+        // Reorders a traversal so that nodes which can render as a batch, such as the
+        // oscillators and filters of each voice in a synth, sit next to one another.
+        // See BatchableNode.
+        void scheduleBatches(std::vector<NodeId>& visitOrder);
+        static typename BatchableNode<FloatType>::BatchFn getBatchFunction(std::shared_ptr<GraphNode<FloatType>>& node);
+
+        // We keep the traversal of each root from the last render sequence build so that
+        // a commit which only touches part of the graph doesn't re-walk all of it. Since a
+        // traversal skips the nodes already visited from the roots sorted before it, the
+        // one kept for a root holds both the nodes it visited and those it skipped, and
+        // stands for as long as none of the former has changed or been visited first, and
+        // all of the latter still have. Only the traversals are kept; the ops and buffer
+        // assignments of the render sequence are built anew from them on each commit that
+        // changes the graph.
+        struct RootTraversal {
+            NodeId rootId;
+            bool active;
+            std::vector<NodeId> visitOrder;
+            std::vector<NodeId> skipped;
+        };
+
+        std::vector<RootTraversal> traversalCache;
+
+        // A range of a traversal's visit order which renders in sub-blocks, for feedback
+        // loops through tapOuts with a `blockSize` prop, along with those taps and their
+        // latencies. See TapOutNode.
+        struct FeedbackLoop {
+            size_t begin = 0;
+            size_t end = 0;
+            size_t subBlockSize = 0;
+            std::vector<std::pair<std::shared_ptr<TapOutNode<FloatType>>, size_t>> taps;
+        };
+
+        // Reorders each traversal so that the nodes of its feedback loop, if it has one, are
+        // contiguous, and returns the loop of each traversal. Loops which can't be rendered
+        // within one subsequence keep the default latency of a block.
+        std::vector<FeedbackLoop> scheduleFeedbackLoops(std::vector<RootTraversal>& traversals);
+
+        // What the render sequence makes of the graph after constant folding, merging, and
+        // dead node elimination. See planRenderSequence.
+        struct RenderPlan {
+            // The nodes to render from each traversal, in order, where every traversal
+            // after the first `numLiveRoots` renders nothing
+            std::vector<std::vector<NodeId>> visitOrders;
+
+            // The children of nodes which read a merged node, in place of their own
+            std::unordered_map<NodeId, std::vector<NodeId>> edges;
+
+            // The nodes which render as a constant, and their values
+            std::unordered_map<NodeId, FloatType> folded;
+
+            // The nodes which the plan leaves out of the traversals they were in
+            std::vector<NodeId> absorbed;
+
+            // The nodes whose props and events the plan depends on
+            std::unordered_set<NodeId> sources;
+
+            // The nodes which render at control rate, with their periods, and the tops of
+            // their subgraphs, which expand their output back up to the sample rate
+            std::unordered_map<NodeId, size_t> controlRates;
+            std::unordered_set<NodeId> controlRateTops;
+        };
+
+        // Plans the render sequence for the given traversals and their feedback loops,
+        // whose ranges it adjusts to match. Pointwise nodes whose inputs are all constant
+        // fold into a constant, identical pointwise and constant nodes merge into one, and
+        // those stateless nodes which nothing reads any more are left out. Nodes within a
+        // feedback loop are left as they are.
+        //
+        // A node with a `controlRate` prop of at least 2 then renders at control rate, once
+        // every that many samples, along with those of its descendants in the same traversal
+        // which allow it and which nothing else reads. See RootRenderSequence::setControlRate.
+        RenderPlan planRenderSequence(std::vector<RootTraversal> const& traversals, std::vector<FeedbackLoop>& loops, size_t numLiveRoots);
+
+        // Nodes whose edges have changed, or who have been deleted, since the last build
+        std::unordered_set<NodeId> dirtyNodes;
+
+        // Set for any change which requires a new render sequence regardless of dirtyNodes:
+        // changes to the set of roots or their active state, and to the set of tap nodes
+        bool renderSequenceDirty = false;
+
+        // The nodes whose props the last build folded or merged, any change to which
+        // needs a new render sequence too
+        std::unordered_set<NodeId> foldSources;
+
+        // The nodes which any build has rendered at control rate, whose rate later builds
+        // restore when they render them at the sample rate again
+        std::unordered_set<NodeId> controlRateNodes;
+
+        // Set on the realtime thread when the current render sequence asks to be rebuilt:
+        // after an event for a node it folded, or when the host's channel count changes
+        // which roots it may leave out. Picked up by the next collectGarbage or
+        // processQueuedEvents.
+        std::atomic<bool> rebuildRequested = false;
+        std::atomic<size_t> hostNumOutputChannels = 0;
 
         SingleWriterSingleReaderQueue<std::shared_ptr<GraphRenderSequence<FloatType>>> rseqQueue;
 
+        // Render sequences the realtime thread has finished with, on their way back to
+        // the non-realtime thread, which drains them before it pushes each new sequence.
+        // Should the queue still be full, the realtime thread holds onto the sequences it
+        // retires in rtUnretiredSeqs, whose capacity is reserved up front, and stops taking
+        // new ones once that's full too, so that it never drops a sequence itself.
+        SingleWriterSingleReaderQueue<std::shared_ptr<GraphRenderSequence<FloatType>>> retiredSeqQueue { 64 };
+        std::vector<std::shared_ptr<GraphRenderSequence<FloatType>>> rtUnretiredSeqs;
+
+        // Retired sequences which have been cleared and are ready to be rebuilt
+        std::vector<std::shared_ptr<GraphRenderSequence<FloatType>>> freeRenderSeqs;
+
+        // The most recently built sequence, whose per node timings the profile reports, and
+        // whose per node counts the numeric checks report
+        std::shared_ptr<GraphRenderSequence<FloatType>> latestRenderSeq;
+        std::unique_ptr<RenderThreadPool> renderThreadPool;
+
         //==============================================================================
+        std::shared_ptr<NodeTypeRegistry<FloatType> const> nodeTypes;
         std::unordered_map<std::string, NodeFactoryFn> nodeFactory;
+        std::shared_ptr<NodeArena> nodeArena = std::make_shared<NodeArena>();
         std::unordered_map<NodeId, std::shared_ptr<GraphNode<FloatType>>> nodeTable;
         std::unordered_map<NodeId, std::vector<NodeId>> edgeTable;
         std::unordered_map<NodeId, std::shared_ptr<GraphNode<FloatType>>> garbageTable;
+        std::unordered_map<NodeId, std::shared_ptr<TapOutNode<FloatType>>> tapOutTable;
+        std::unordered_map<NodeId, std::string> nodeTypeTable;
 
         std::set<NodeId> currentRoots;
-        RefCountedPool<GraphRenderSequence<FloatType>> renderSeqPool;
 
         SharedResourceMap<FloatType> sharedResourceMap;
+        std::unique_ptr<SampleStreamer<FloatType>> sampleStreamer;
 
         double sampleRate;
         int blockSize;
@@ -130,160 +816,844 @@ namespace elem
     //==============================================================================
     // Details...
     template <typename FloatType>
-    Runtime<FloatType>::Runtime(double sampleRate, int blockSize)
+    Runtime<FloatType>::Runtime(
+        double sampleRate,
+        int blockSize,
+        std::shared_ptr<NodeTypeRegistry<FloatType> const> nodeTypes,
+        std::shared_ptr<SharedResourceStore<FloatType>> resourceStore
+    )
         : bufferAllocator(blockSize)
+        , nodeTypes(nodeTypes != nullptr ? std::move(nodeTypes) : NodeTypeRegistry<FloatType>::getDefault())
         , sampleRate(sampleRate)
         , blockSize(blockSize)
     {
-        DefaultNodeTypes<FloatType>::forEach([this](std::string const& type, NodeFactoryFn&& fn) {
-            registerNodeType(type, std::move(fn));
-        });
+        internalBlockSize.store(static_cast<size_t>(blockSize));
+        subBlockInputs.reserve(64);
+        subBlockOutputs.reserve(64);
+        pendingParameterEvents.reserve(1024);
+        rtUnretiredSeqs.reserve(64);
+
+        sharedResourceMap.setStore(std::move(resourceStore));
     }
 
     //==============================================================================
     template <typename FloatType>
-    void Runtime<FloatType>::applyInstructions(elem::js::Array const& batch)
+    Runtime<FloatType>::~Runtime()
     {
-        // TODO: For correct transaction semantics here, we should createNode into a separate
-        // map that only gets merged into the actual nodeMap on commitUpdaes
-        for (auto& next : batch) {
-            invariant(next.isArray(), "Expected a command array.");
-            auto const& ar = next.getArray();
-
-            invariant(ar[0].isNumber(), "Expected a number type command.");
-            auto const cmd = static_cast<InstructionType>(static_cast<int>((elem::js::Number) ar[0]));
+        {
+            std::lock_guard<std::mutex> lock(stagingMutex);
+            stopCompiler = true;
+        }
 
-            auto varToInt = [](elem::js::Value const& v) -> int32_t {
-                invariant(v.isNumber(), "Expected a number type node identifier. Make sure you are using @elemaudio/core@v2.0+");
-                return static_cast<int32_t>((elem::js::Number) v);
-            };
+        stagingCv.notify_all();
 
-            switch (cmd) {
-                case InstructionType::CREATE_NODE:
-                    createNode(varToInt(ar[1]), (elem::js::String) ar[2]);
-                    break;
-                case InstructionType::DELETE_NODE:
-                    deleteNode(varToInt(ar[1]));
-                    break;
-                case InstructionType::SET_PROPERTY:
-                    setProperty(varToInt(ar[1]), (elem::js::String) ar[2], ar[3]);
-                    break;
-                case InstructionType::APPEND_CHILD:
-                    appendChild(varToInt(ar[1]), varToInt(ar[2]));
-                    break;
-                case InstructionType::ACTIVATE_ROOTS:
-                    activateRoots(ar[1].getArray());
-                    break;
-                case InstructionType::COMMIT_UPDATES:
-                    rseqQueue.push(buildRenderSequence());
-                    break;
-                default:
-                    break;
-            }
+        if (compilerThread.joinable()) {
+            compilerThread.join();
         }
 
-        // While we're here, we scan the garbageTable to see if we can deallocate
-        // any nodes who are only held by the garbageTable. That means that the realtime
-        // thread has already seen the corresponding DeleteNode events and dropped its references
-        for (auto it = garbageTable.begin(); it != garbageTable.end();) {
-            if (it->second.use_count() == 1) {
-                ELEM_DBG("[Native] pruneNode " << nodeIdToHex(it->second->getId()));
-                it = garbageTable.erase(it);
-            } else {
-                it++;
+        for (auto& b : stagedBatches) {
+            if (b.onComplete) {
+                BatchResult result;
+                result.error = "The runtime was destroyed before the batch was applied.";
+                b.onComplete(result);
             }
         }
     }
 
+    //==============================================================================
     template <typename FloatType>
-    void Runtime<FloatType>::process(const FloatType** inputChannelData, size_t numInputChannels, FloatType** outputChannelData, size_t numOutputChannels, size_t numSamples, void* userData)
+    void Runtime<FloatType>::applyInstructions(elem::js::Array const& batch)
     {
-        while (rseqQueue.size() > 0) {
-            rseqQueue.pop(rtRenderSeq);
-        }
+        waitForCompilation();
 
-        if (rtRenderSeq) {
-            rtRenderSeq->process(inputChannelData, numInputChannels, outputChannelData, numOutputChannels, numSamples, userData);
-        }
+        std::lock_guard<std::recursive_mutex> lock(graphMutex);
+        applyBatch(batch, false);
     }
 
-    //==============================================================================
     template <typename FloatType>
-    void Runtime<FloatType>::createNode(int32_t const& nodeId, std::string const& type)
+    void Runtime<FloatType>::applyInstructions(uint8_t const* data, size_t size)
     {
-        ELEM_DBG("[Native] createNode " << type << "#" << nodeIdToHex(nodeId));
+        waitForCompilation();
 
-        invariant(nodeFactory.find(type) != nodeFactory.end(), "Unknown node type " + type);
-        invariant(nodeTable.find(nodeId) == nodeTable.end(), "Trying to create a node which already exists.");
-        invariant(edgeTable.find(nodeId) == edgeTable.end(), "Trying to create a node which already exists.");
+        std::lock_guard<std::recursive_mutex> lock(graphMutex);
+        applyBatch(data, size, false);
+    }
 
-        auto node = nodeFactory[type](nodeId, sampleRate, blockSize);
-        nodeTable.insert({nodeId, node});
-        edgeTable.insert({nodeId, {}});
+    template <typename FloatType>
+    void Runtime<FloatType>::applyInstructions(std::string_view json)
+    {
+        waitForCompilation();
+
+        std::lock_guard<std::recursive_mutex> lock(graphMutex);
+        applyBatch(json, false);
     }
 
     template <typename FloatType>
-    void Runtime<FloatType>::deleteNode(int32_t const& nodeId)
+    void Runtime<FloatType>::applyInstructionsAsync(js::Array batch, BatchCompletionFn onComplete)
     {
-        ELEM_DBG("[Native] deleteNode " << nodeIdToHex(nodeId));
+        stageBatch({ std::move(batch), std::move(onComplete) });
+    }
 
-        invariant(nodeTable.find(nodeId) != nodeTable.end(), "Trying to delete an unrecognized node.");
-        invariant(edgeTable.find(nodeId) != edgeTable.end(), "Trying to delete an unrecognized node.");
+    template <typename FloatType>
+    void Runtime<FloatType>::applyInstructionsAsync(std::vector<uint8_t> data, BatchCompletionFn onComplete)
+    {
+        stageBatch({ std::move(data), std::move(onComplete) });
+    }
 
-        // Move the node out of the nodeTable. It will be pruned from the garbageTable
-        // asynchronously after the renderer has dropped its references.
-        garbageTable.insert(nodeTable.extract(nodeId));
-        edgeTable.erase(nodeId);
+    template <typename FloatType>
+    void Runtime<FloatType>::applyInstructionsAsync(std::string json, BatchCompletionFn onComplete)
+    {
+        stageBatch({ std::move(json), std::move(onComplete) });
     }
 
     template <typename FloatType>
-    void Runtime<FloatType>::setProperty(int32_t const& nodeId, std::string const& prop, js::Value const& v)
+    void Runtime<FloatType>::waitForCompilation()
     {
-        ELEM_DBG("[Native] setProperty " << nodeIdToHex(nodeId) << " " << prop << " " << v.toString());
+        std::unique_lock<std::mutex> lock(stagingMutex);
 
-        invariant(nodeTable.find(nodeId) != nodeTable.end(), "Trying to set a property for an unrecognized node.");
+        // A completion handler which applies a batch of its own runs on the compiler
+        // thread, which can't wait for itself
+        if (std::this_thread::get_id() == compilerThread.get_id())
+            return;
 
-        // This is intentionally called on the non-realtime thread. It is the job
-        // of the GraphNode to ensure thread safety between calls to setProperty
-        // and calls to its own proces function
-        nodeTable.at(nodeId)->setProperty(prop, v, sharedResourceMap);
+        stagingCv.wait(lock, [this]() { return stagedBatches.empty() && !compiling; });
     }
 
     template <typename FloatType>
-    void Runtime<FloatType>::appendChild(int32_t const& parentId, int32_t const& childId)
+    void Runtime<FloatType>::stageBatch(StagedBatch&& batch)
     {
-        ELEM_DBG("[Native] appendChild " << nodeIdToHex(childId) << " to parent " << nodeIdToHex(parentId));
+        {
+            std::lock_guard<std::mutex> lock(stagingMutex);
+            stagedBatches.push_back(std::move(batch));
 
-        invariant(nodeTable.find(parentId) != nodeTable.end(), "Trying to append a child to an unknown parent.");
-        invariant(edgeTable.find(parentId) != edgeTable.end(), "Trying to append a child to an unknown parent.");
-        invariant(nodeTable.find(childId) != nodeTable.end(), "Trying to append an unknown child to a parent.");
+            if (!compilerThread.joinable()) {
+                compilerThread = std::thread([this]() { runCompiler(); });
+            }
+        }
 
-        edgeTable.at(parentId).push_back(childId);
+        stagingCv.notify_all();
     }
 
     template <typename FloatType>
-    void Runtime<FloatType>::activateRoots(js::Array const& roots)
+    void Runtime<FloatType>::runCompiler()
     {
-        // Populate and activate from the incoming event
-        std::set<NodeId> active;
+        std::unique_lock<std::mutex> lock(stagingMutex);
+        std::vector<StagedBatch> batches;
 
-        for (auto const& v : roots) {
-            int32_t nodeId = static_cast<int32_t>((js::Number) v);
-            ELEM_DBG("[Native] activateRoot " << nodeIdToHex(nodeId));
+        while (true) {
+            stagingCv.wait(lock, [this]() { return stopCompiler || !stagedBatches.empty(); });
 
-            invariant(nodeTable.find(nodeId) != nodeTable.end(), "Trying to activate an unrecognized root node.");
+            if (stopCompiler)
+                return;
 
-            if (auto ptr = std::dynamic_pointer_cast<RootNode<FloatType>>(nodeTable.at(nodeId))) {
-                ptr->setProperty("active", true);
-                active.insert(nodeId);
-            }
+            std::swap(batches, stagedBatches);
+            compiling = true;
+            lock.unlock();
+
+            compileBatches(batches);
+            batches.clear();
+
+            lock.lock();
+            compiling = false;
+            stagingCv.notify_all();
         }
+    }
 
-        // Deactivate any prior roots
-        for (auto const& n : currentRoots) {
+    template <typename FloatType>
+    void Runtime<FloatType>::compileBatches(std::vector<StagedBatch>& batches)
+    {
+        std::vector<BatchResult> results(batches.size());
+
+        {
+            std::lock_guard<std::recursive_mutex> lock(graphMutex);
+
+            // Batches which arrived together are applied in order, with their commits held
+            // back to build one render sequence for them all once the last has been applied
+            size_t lastCommit = batches.size();
+
+            for (size_t i = 0; i < batches.size(); ++i) {
+                try {
+                    auto const committed = std::visit([this](auto const& b) {
+                        using T = std::decay_t<decltype(b)>;
+
+                        if constexpr (std::is_same_v<T, std::vector<uint8_t>>) {
+                            return applyBatch(b.data(), b.size(), true);
+                        } else if constexpr (std::is_same_v<T, std::string>) {
+                            return applyBatch(std::string_view(b), true);
+                        } else {
+                            return applyBatch(b, true);
+                        }
+                    }, batches[i].instructions);
+
+                    if (committed) {
+                        lastCommit = i;
+                    }
+                } catch (std::exception const& e) {
+                    results[i].error = e.what();
+                }
+
+                results[i].stats = lastBatchStats;
+            }
+
+            if (lastCommit < batches.size()) {
+                lastBatchStats = results[lastCommit].stats;
+
+                // The commit builds the render sequence for every batch up to the last one
+                // which asked for it, so if it fails, each of them has failed
+                try {
+                    commitUpdates();
+                } catch (std::exception const& e) {
+                    for (size_t i = 0; i <= lastCommit; ++i) {
+                        if (results[i].succeeded()) {
+                            results[i].error = e.what();
+                        }
+                    }
+                }
+
+                results[lastCommit].stats = lastBatchStats;
+            }
+        }
+
+        for (size_t i = 0; i < batches.size(); ++i) {
+            if (batches[i].onComplete) {
+                batches[i].onComplete(results[i]);
+            }
+        }
+    }
+
+    //==============================================================================
+    template <typename FloatType>
+    bool Runtime<FloatType>::applyBatch(js::Array const& batch, bool deferCommit)
+    {
+        beginBatch();
+
+        // Validating the whole batch before applying any of it means that a malformed
+        // batch is turned away before it touches the graph. One which fails while it's
+        // being applied, say on a prop value which its node rejects, is undone.
+        BatchValidator validator { *this, stagingTable };
+        decodeBatch(batch, validator);
+
+        BatchApplier applier { *this, deferCommit };
+
+        try {
+            decodeBatch(batch, applier);
+        } catch (...) {
+            applier.undo();
+            throw;
+        }
+
+        endBatch(batch.size());
+        return applier.commitRequested;
+    }
+
+    template <typename FloatType>
+    bool Runtime<FloatType>::applyBatch(uint8_t const* data, size_t size, bool deferCommit)
+    {
+        beginBatch();
+
+        BatchValidator validator { *this, stagingTable };
+        decodeBatch(data, size, validator);
+
+        BatchApplier applier { *this, deferCommit };
+        size_t numInstructions = 0;
+
+        try {
+            numInstructions = decodeBatch(data, size, applier);
+        } catch (...) {
+            applier.undo();
+            throw;
+        }
+
+        endBatch(numInstructions);
+        return applier.commitRequested;
+    }
+
+    template <typename FloatType>
+    bool Runtime<FloatType>::applyBatch(std::string_view json, bool deferCommit)
+    {
+        beginBatch();
+
+        auto const& batch = batchParser.parse(json);
+        invariant(batch.isArray(), "Expected an array of commands.");
+
+        auto const parsedTime = Clock::now();
+        lastBatchStats.parseUs = elapsedUs(phaseStartTime, parsedTime);
+        phaseStartTime = parsedTime;
+
+        BatchValidator validator { *this, stagingTable };
+        decodeBatch(batch, validator);
+
+        BatchApplier applier { *this, deferCommit };
+
+        try {
+            decodeBatch(batch, applier);
+        } catch (...) {
+            applier.undo();
+            throw;
+        }
+
+        endBatch(batch.size);
+        return applier.commitRequested;
+    }
+
+    template <typename FloatType>
+    template <typename Sink>
+    void Runtime<FloatType>::decodeBatch(js::Array const& batch, Sink& sink)
+    {
+        for (auto& next : batch) {
+            invariant(next.isArray(), "Expected a command array.");
+            auto const& ar = next.getArray();
+
+            invariant(ar[0].isNumber(), "Expected a number type command.");
+            auto const cmd = static_cast<InstructionType>(static_cast<int>((elem::js::Number) ar[0]));
+
+            auto varToInt = [](elem::js::Value const& v) -> int32_t {
+                invariant(v.isNumber(), "Expected a number type node identifier. Make sure you are using @elemaudio/core@v2.0+");
+                return static_cast<int32_t>((elem::js::Number) v);
+            };
+
+            switch (cmd) {
+                case InstructionType::CREATE_NODE:
+                    sink.createNode(varToInt(ar[1]), (elem::js::String) ar[2]);
+                    break;
+                case InstructionType::DELETE_NODE:
+                    sink.deleteNode(varToInt(ar[1]));
+                    break;
+                case InstructionType::SET_PROPERTY:
+                    sink.setProperty(varToInt(ar[1]), (elem::js::String) ar[2], ar[3]);
+                    break;
+                case InstructionType::APPEND_CHILD:
+                    sink.appendChild(varToInt(ar[1]), varToInt(ar[2]));
+                    break;
+                case InstructionType::ACTIVATE_ROOTS: {
+                    std::vector<NodeId> roots;
+
+                    for (auto const& v : ar[1].getArray()) {
+                        roots.push_back(static_cast<NodeId>((elem::js::Number) v));
+                    }
+
+                    sink.activateRoots(roots);
+                    break;
+                }
+                case InstructionType::COMMIT_UPDATES:
+                    sink.commitUpdates();
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+
+    template <typename FloatType>
+    template <typename Sink>
+    size_t Runtime<FloatType>::decodeBatch(uint8_t const* data, size_t size, Sink& sink)
+    {
+        BinaryInstructionReader reader(data, size);
+        std::vector<NodeId> roots;
+        size_t numInstructions = 0;
+
+        while (reader.hasNext()) {
+            numInstructions++;
+
+            switch (reader.readOpcode()) {
+                case binary::Opcode::CREATE_NODE: {
+                    auto const nodeId = reader.readNodeId();
+                    sink.createNode(nodeId, reader.readString());
+                    break;
+                }
+                case binary::Opcode::DELETE_NODE:
+                    sink.deleteNode(reader.readNodeId());
+                    break;
+                case binary::Opcode::SET_PROPERTY: {
+                    auto const nodeId = reader.readNodeId();
+                    auto const& key = reader.readString();
+                    sink.setProperty(nodeId, key, reader.readValue());
+                    break;
+                }
+                case binary::Opcode::APPEND_CHILD: {
+                    auto const parentId = reader.readNodeId();
+                    sink.appendChild(parentId, reader.readNodeId());
+                    break;
+                }
+                case binary::Opcode::ACTIVATE_ROOTS: {
+                    auto const n = reader.readCount();
+                    roots.clear();
+
+                    for (uint32_t i = 0; i < n; ++i) {
+                        roots.push_back(reader.readNodeId());
+                    }
+
+                    sink.activateRoots(roots);
+                    break;
+                }
+                case binary::Opcode::COMMIT_UPDATES:
+                    sink.commitUpdates();
+                    break;
+                default:
+                    // Unlike the array form, every instruction here must be understood
+                    // in order to know where the next one begins
+                    invariant(false, "Unknown opcode in binary instruction batch.");
+                    break;
+            }
+        }
+
+        return numInstructions;
+    }
+
+    template <typename FloatType>
+    template <typename Sink>
+    void Runtime<FloatType>::decodeBatch(js::ArenaValue const& batch, Sink& sink)
+    {
+        auto varToInt = [](js::ArenaValue const& v) -> int32_t {
+            invariant(v.isNumber(), "Expected a number type node identifier. Make sure you are using @elemaudio/core@v2.0+");
+            return static_cast<int32_t>(v.number);
+        };
+
+        auto varToString = [](js::ArenaValue const& v) -> std::string {
+            invariant(v.isString(), "Expected a string type argument.");
+            return std::string(v.getString());
+        };
+
+        std::vector<NodeId> roots;
+
+        for (size_t i = 0; i < batch.size; ++i) {
+            auto const& ar = batch.at(i);
+
+            invariant(ar.isArray(), "Expected a command array.");
+            invariant(ar.at(0).isNumber(), "Expected a number type command.");
+
+            switch (static_cast<InstructionType>(static_cast<int>(ar.at(0).number))) {
+                case InstructionType::CREATE_NODE:
+                    sink.createNode(varToInt(ar.at(1)), varToString(ar.at(2)));
+                    break;
+                case InstructionType::DELETE_NODE:
+                    sink.deleteNode(varToInt(ar.at(1)));
+                    break;
+                case InstructionType::SET_PROPERTY:
+                    sink.setProperty(varToInt(ar.at(1)), varToString(ar.at(2)), ar.at(3));
+                    break;
+                case InstructionType::APPEND_CHILD:
+                    sink.appendChild(varToInt(ar.at(1)), varToInt(ar.at(2)));
+                    break;
+                case InstructionType::ACTIVATE_ROOTS: {
+                    auto const& ids = ar.at(1);
+                    invariant(ids.isArray(), "Expected an array of root node identifiers.");
+
+                    roots.clear();
+
+                    for (size_t j = 0; j < ids.size; ++j) {
+                        roots.push_back(varToInt(ids.at(j)));
+                    }
+
+                    sink.activateRoots(roots);
+                    break;
+                }
+                case InstructionType::COMMIT_UPDATES:
+                    sink.commitUpdates();
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+
+    template <typename FloatType>
+    std::vector<uint8_t> Runtime<FloatType>::exportSnapshot()
+    {
+        std::lock_guard<std::recursive_mutex> lock(graphMutex);
+
+        BinaryInstructionWriter writer;
+
+        // Sorted for a stable encoding of the same graph
+        std::vector<NodeId> ids;
+
+        for (auto const& [nid, node] : nodeTable) {
+            ids.push_back(nid);
+        }
+
+        std::sort(ids.begin(), ids.end());
+
+        // Every node is created before any edge is added, and the props of each are set in
+        // the order in which they first arrived
+        for (auto const& nid : ids) {
+            writer.createNode(nid, nodeTypeTable.at(nid));
+
+            nodeTable.at(nid)->forEachProperty([&](std::string const& key, js::Value const& value) {
+                writer.setProperty(nid, key, value);
+            });
+        }
+
+        for (auto const& nid : ids) {
+            for (auto const& child : edgeTable.at(nid)) {
+                writer.appendChild(nid, child);
+            }
+        }
+
+        // Roots which are still fading out are left inactive
+        std::vector<NodeId> roots;
+
+        for (auto const& nid : currentRoots) {
+            if (auto ptr = std::dynamic_pointer_cast<RootNode<FloatType>>(nodeTable.at(nid)); ptr && ptr->isActive()) {
+                roots.push_back(nid);
+            }
+        }
+
+        writer.activateRoots(roots);
+        writer.commitUpdates();
+
+        return writer.finish();
+    }
+
+    template <typename FloatType>
+    void Runtime<FloatType>::beginBatch()
+    {
+        lastBatchStats = {};
+
+        auto const t0 = Clock::now();
+        collectGarbage();
+        phaseStartTime = Clock::now();
+
+        lastBatchStats.collectGarbageUs = elapsedUs(t0, phaseStartTime);
+    }
+
+    template <typename FloatType>
+    void Runtime<FloatType>::endBatch(size_t numInstructions)
+    {
+        auto const t0 = Clock::now();
+        pruneGarbage();
+        auto const t1 = Clock::now();
+
+        lastBatchStats.applyUs = elapsedUs(phaseStartTime, t0) - lastBatchStats.buildRenderSequenceUs;
+        lastBatchStats.collectGarbageUs += elapsedUs(t0, t1);
+        lastBatchStats.numInstructions = numInstructions;
+    }
+
+    template <typename FloatType>
+    void Runtime<FloatType>::commitUpdates()
+    {
+        // A batch of only property changes leaves the render sequence as it is
+        if (renderSequenceDirty || !dirtyNodes.empty()) {
+            auto const t0 = Clock::now();
+            auto seq = buildRenderSequence();
+
+            lastBatchStats.buildRenderSequenceUs += elapsedUs(t0, Clock::now());
+            lastBatchStats.numRenderSequenceBuilds++;
+
+            latestRenderSeq = seq;
+
+            // Making room for whatever the realtime thread retires on taking this one
+            drainRetiredSequences();
+            rseqQueue.push(std::move(seq));
+        }
+    }
+
+    template <typename FloatType>
+    void Runtime<FloatType>::drainRetiredSequences()
+    {
+        std::shared_ptr<GraphRenderSequence<FloatType>> seq;
+
+        // Clearing a retired sequence drops its references to the nodes it rendered, which
+        // may leave deleted nodes held only by the garbageTable, ready to be pruned
+        while (retiredSeqQueue.pop(seq)) {
+            seq->reset();
+            freeRenderSeqs.push_back(std::move(seq));
+        }
+    }
+
+    template <typename FloatType>
+    void Runtime<FloatType>::collectGarbage()
+    {
+        std::lock_guard<std::recursive_mutex> lock(graphMutex);
+
+        drainRetiredSequences();
+        pruneGarbage();
+
+        // With deleted nodes gone, resources that only they were holding can go too
+        sharedResourceMap.releaseRetired();
+
+        commitRequestedRebuild();
+    }
+
+    template <typename FloatType>
+    void Runtime<FloatType>::commitRequestedRebuild()
+    {
+        if (rebuildRequested.exchange(false)) {
+            renderSequenceDirty = true;
+            commitUpdates();
+        }
+    }
+
+    template <typename FloatType>
+    void Runtime<FloatType>::pruneGarbage()
+    {
+        // While we're here, we scan the garbageTable to see if we can deallocate
+        // any nodes who are only held by the garbageTable. That means that the realtime
+        // thread has already seen the corresponding DeleteNode events and dropped its references
+        for (auto it = garbageTable.begin(); it != garbageTable.end();) {
+            if (it->second.use_count() == 1) {
+                ELEM_DBG("[Native] pruneNode " << nodeIdToHex(it->second->getId()));
+
+                // Make sure the node isn't left on the list of those with events pending
+                auto* node = it->second.get();
+
+                if (node->hasEventsPending()) {
+                    eventNotifications.take([this](GraphNode<FloatType>* n) { pendingEventNodes.push_back(n); });
+                }
+
+                pendingEventNodes.erase(std::remove(pendingEventNodes.begin(), pendingEventNodes.end(), node), pendingEventNodes.end());
+
+                nodeTypeTable.erase(it->first);
+                controlRateNodes.erase(it->first);
+                it = garbageTable.erase(it);
+            } else {
+                it++;
+            }
+        }
+    }
+
+    template <typename FloatType>
+    void Runtime<FloatType>::process(const FloatType** inputChannelData, size_t numInputChannels, FloatType** outputChannelData, size_t numOutputChannels, size_t numSamples, void* userData)
+    {
+        auto const profiling = profilingEnabled.load(std::memory_order_relaxed);
+        auto const checkNumerics = numericChecksEnabled.load(std::memory_order_relaxed);
+        auto const t0 = profiling ? Clock::now() : Clock::time_point();
+
+        ScopedFlushDenormals flushDenormals(flushDenormalsEnabled.load(std::memory_order_relaxed));
+
+        // Hand each previous sequence back rather than dropping it here, where dropping the
+        // last reference would free it, and possibly deleted nodes, on the realtime thread
+        while (!rtUnretiredSeqs.empty() && retiredSeqQueue.push(std::move(rtUnretiredSeqs.back()))) {
+            rtUnretiredSeqs.pop_back();
+        }
+
+        std::shared_ptr<GraphRenderSequence<FloatType>> next;
+
+        while (rtUnretiredSeqs.size() < rtUnretiredSeqs.capacity() && rseqQueue.pop(next)) {
+            if (rtRenderSeq && !retiredSeqQueue.push(std::move(rtRenderSeq))) {
+                rtUnretiredSeqs.push_back(std::move(rtRenderSeq));
+            }
+
+            rtRenderSeq = std::move(next);
+        }
+
+        hostNumOutputChannels.store(numOutputChannels, std::memory_order_relaxed);
+
+        if (rtRenderSeq && rtRenderSeq->needsRebuildFor(numOutputChannels)) {
+            rebuildRequested.store(true, std::memory_order_relaxed);
+        }
+
+        auto const maxBlockSize = internalBlockSize.load(std::memory_order_relaxed);
+
+        if (numSamples <= maxBlockSize) {
+            processBlock(inputChannelData, numInputChannels, outputChannelData, numOutputChannels, numSamples, userData, profiling, checkNumerics);
+        } else {
+            // Only a host with more channels than we reserved for would allocate here
+            subBlockInputs.resize(numInputChannels);
+            subBlockOutputs.resize(numOutputChannels);
+
+            for (size_t offset = 0; offset < numSamples; offset += maxBlockSize) {
+                auto const n = std::min(maxBlockSize, numSamples - offset);
+
+                for (size_t i = 0; i < numInputChannels; ++i)
+                    subBlockInputs[i] = inputChannelData[i] + offset;
+
+                for (size_t i = 0; i < numOutputChannels; ++i)
+                    subBlockOutputs[i] = outputChannelData[i] + offset;
+
+                processBlock(subBlockInputs.data(), numInputChannels, subBlockOutputs.data(), numOutputChannels, n, userData, profiling, checkNumerics);
+            }
+        }
+
+        if (profiling && numSamples > 0) {
+            auto const nanos = static_cast<int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t0).count());
+            auto const deadlineNanos = static_cast<double>(numSamples) / sampleRate * 1e9;
+            auto const loadPpm = static_cast<int64_t>(static_cast<double>(nanos) / deadlineNanos * 1e6);
+
+            profiledCallbackNanos.fetch_add(nanos, std::memory_order_relaxed);
+            profiledNumSamples.fetch_add(static_cast<int64_t>(numSamples), std::memory_order_relaxed);
+            profiledNumBlocks.fetch_add(1, std::memory_order_relaxed);
+
+            auto peak = profiledPeakLoadPpm.load(std::memory_order_relaxed);
+
+            while (loadPpm > peak && !profiledPeakLoadPpm.compare_exchange_weak(peak, loadPpm, std::memory_order_relaxed)) {}
+        }
+    }
+
+    template <typename FloatType>
+    void Runtime<FloatType>::processBlock(const FloatType** inputChannelData, size_t numInputChannels, FloatType** outputChannelData, size_t numOutputChannels, size_t numSamples, void* userData, bool profiling, bool checkNumerics)
+    {
+        ParameterEvent<FloatType> e;
+
+        while (pendingParameterEvents.size() < pendingParameterEvents.capacity() && parameterEventQueue.pop(e)) {
+            pendingParameterEvents.push_back(e);
+        }
+
+        if (rtRenderSeq) {
+            if (!pendingParameterEvents.empty()) {
+                uint64_t numDropped = 0;
+                bool rebuild = false;
+                rtRenderSeq->scheduleParameterEvents(pendingParameterEvents, rtSampleTime, numSamples, numDropped, rebuild);
+
+                if (numDropped > 0) {
+                    numDroppedParameterEvents.fetch_add(numDropped, std::memory_order_relaxed);
+                }
+
+                if (rebuild) {
+                    rebuildRequested.store(true, std::memory_order_relaxed);
+                }
+            }
+
+            rtRenderSeq->process(inputChannelData, numInputChannels, outputChannelData, numOutputChannels, numSamples, userData, renderThreadPool.get(), profiling, rtSampleTime, checkNumerics);
+        }
+
+        rtSampleTime += static_cast<int64_t>(numSamples);
+        sampleTime.store(rtSampleTime, std::memory_order_release);
+    }
+
+    template <typename FloatType>
+    bool Runtime<FloatType>::scheduleParameterEvent(NodeId nodeId, uint32_t slot, FloatType value, int64_t time, uint32_t rampSamples)
+    {
+        return parameterEventQueue.push({ nodeId, slot, value, time, rampSamples });
+    }
+
+    template <typename FloatType>
+    void Runtime<FloatType>::setInternalBlockSize(int size)
+    {
+        invariant(size >= 0 && size <= blockSize, "Internal block size must be between 0 and the runtime's blockSize.");
+        internalBlockSize.store(static_cast<size_t>(size > 0 ? size : blockSize), std::memory_order_relaxed);
+    }
+
+    //==============================================================================
+    template <typename FloatType>
+    void Runtime<FloatType>::createNode(int32_t const& nodeId, std::string const& type)
+    {
+        ELEM_DBG("[Native] createNode " << type << "#" << nodeIdToHex(nodeId));
+
+        auto const it = nodeFactory.find(type);
+        auto const* factory = (it != nodeFactory.end()) ? &it->second : nodeTypes->find(type);
+
+        invariant(factory != nullptr, "Unknown node type " + type);
+        invariant(nodeTable.find(nodeId) == nodeTable.end(), "Trying to create a node which already exists.");
+        invariant(edgeTable.find(nodeId) == edgeTable.end(), "Trying to create a node which already exists.");
+
+        // Factories which use NodeArena::makeShared, as the default ones do, allocate the
+        // node from this runtime's arena
+        NodeArena::Scope arenaScope(*nodeArena);
+
+        auto node = (*factory)(nodeId, sampleRate, blockSize);
+        nodeTable.insert({nodeId, node});
+
+        node->setEventNotificationList(&eventNotifications);
+        node->setEventScratch(&eventScratch);
+
+        if (!node->usesEventNotifications()) {
+            polledEventNodes.insert(node.get());
+        }
+
+        edgeTable.insert({nodeId, {}});
+        nodeTypeTable.insert_or_assign(nodeId, type);
+
+        // Tap nodes are serviced by the render sequence whether or not they're reachable
+        if (auto ptr = std::dynamic_pointer_cast<TapOutNode<FloatType>>(node)) {
+            tapOutTable.insert({nodeId, ptr});
+            renderSequenceDirty = true;
+        }
+    }
+
+    template <typename FloatType>
+    void Runtime<FloatType>::deleteNode(int32_t const& nodeId)
+    {
+        ELEM_DBG("[Native] deleteNode " << nodeIdToHex(nodeId));
+
+        invariant(nodeTable.find(nodeId) != nodeTable.end(), "Trying to delete an unrecognized node.");
+        invariant(edgeTable.find(nodeId) != edgeTable.end(), "Trying to delete an unrecognized node.");
+
+        // Move the node out of the nodeTable. It will be pruned from the garbageTable
+        // asynchronously after the renderer has dropped its references.
+        polledEventNodes.erase(nodeTable.at(nodeId).get());
+
+        garbageTable.insert(nodeTable.extract(nodeId));
+        edgeTable.erase(nodeId);
+        dirtyNodes.insert(nodeId);
+
+        if (tapOutTable.erase(nodeId) > 0 || currentRoots.count(nodeId) > 0) {
+            renderSequenceDirty = true;
+        }
+    }
+
+    template <typename FloatType>
+    void Runtime<FloatType>::setProperty(int32_t const& nodeId, std::string const& prop, js::Value const& v)
+    {
+        ELEM_DBG("[Native] setProperty " << nodeIdToHex(nodeId) << " " << prop << " " << v.toString());
+
+        invariant(nodeTable.find(nodeId) != nodeTable.end(), "Trying to set a property for an unrecognized node.");
+
+        // This is intentionally called on the non-realtime thread. It is the job
+        // of the GraphNode to ensure thread safety between calls to setProperty
+        // and calls to its own proces function
+        auto& node = nodeTable.at(nodeId);
+        node->setProperty(prop, v, sharedResourceMap);
+
+        // The tap names and latencies decide which nodes render as a feedback loop
+        if ((prop == "name" || prop == "blockSize") && (tapOutTable.count(nodeId) > 0 || std::dynamic_pointer_cast<TapInNode<FloatType>>(node))) {
+            renderSequenceDirty = true;
+        }
+
+        // As do the values of folded and merged nodes, and the channels of the roots, some
+        // of which may be left out
+        if (foldSources.count(nodeId) > 0 || (prop == "channel" && currentRoots.count(nodeId) > 0)) {
+            renderSequenceDirty = true;
+        }
+
+        // And the control rate of any node
+        if (prop == "controlRate") {
+            renderSequenceDirty = true;
+        }
+    }
+
+    template <typename FloatType>
+    void Runtime<FloatType>::appendChild(int32_t const& parentId, int32_t const& childId)
+    {
+        ELEM_DBG("[Native] appendChild " << nodeIdToHex(childId) << " to parent " << nodeIdToHex(parentId));
+
+        invariant(nodeTable.find(parentId) != nodeTable.end(), "Trying to append a child to an unknown parent.");
+        invariant(edgeTable.find(parentId) != edgeTable.end(), "Trying to append a child to an unknown parent.");
+        invariant(nodeTable.find(childId) != nodeTable.end(), "Trying to append an unknown child to a parent.");
+
+        edgeTable.at(parentId).push_back(childId);
+        dirtyNodes.insert(parentId);
+    }
+
+    template <typename FloatType>
+    void Runtime<FloatType>::activateRoots(std::vector<NodeId> const& roots)
+    {
+        // Populate and activate from the incoming event
+        std::set<NodeId> active;
+
+        for (auto const nodeId : roots) {
+            ELEM_DBG("[Native] activateRoot " << nodeIdToHex(nodeId));
+
+            invariant(nodeTable.find(nodeId) != nodeTable.end(), "Trying to activate an unrecognized root node.");
+
+            if (auto ptr = std::dynamic_pointer_cast<RootNode<FloatType>>(nodeTable.at(nodeId))) {
+                if (!ptr->isActive()) {
+                    renderSequenceDirty = true;
+                }
+
+                ptr->setProperty("active", true);
+                active.insert(nodeId);
+            }
+        }
+
+        // Deactivate any prior roots
+        for (auto const& n : currentRoots) {
             if (auto ptr = std::dynamic_pointer_cast<RootNode<FloatType>>(nodeTable.at(n))) {
                 // If any current root was not marked active in this event, we deactivate it
                 if (active.count(n) == 0) {
+                    if (ptr->isActive()) {
+                        renderSequenceDirty = true;
+                    }
+
                     ptr->setProperty("active", false);
                 }
 
@@ -295,6 +1665,10 @@ namespace elem
         }
 
         // Merge
+        if (active != currentRoots) {
+            renderSequenceDirty = true;
+        }
+
         currentRoots = active;
     }
 
@@ -302,59 +1676,292 @@ namespace elem
     template <typename FloatType>
     void Runtime<FloatType>::processQueuedEvents(std::function<void(std::string const&, js::Value)> evtCallback)
     {
+        // While the compiler thread is applying a batch, events wait in their nodes
+        // until the next call
+        std::unique_lock<std::recursive_mutex> lock(graphMutex, std::try_to_lock);
+
+        if (!lock.owns_lock())
+            return;
+
         // TODO: Before the runtime refactor, we would use this opportunity to check to see if the graphRenderer
         // had raised any process flags to signal a realtime rendering issue. That was originally implemented
         // before the rendering procedure became iterative. Now that it's iterative, let's refactor that side
         // to return a boolean from its process call, then we can handle flag raising and error dispatching
         // here easily.
 
-        // Visit all nodes to service any events they may want to relay
-        for (auto it = nodeTable.begin(); it != nodeTable.end(); ++it) {
-            it->second->processEvents(evtCallback);
-        }
+        // Visit the nodes which may have events to relay
+        visitEventNodes([&](GraphNode<FloatType>* node) {
+            node->processEvents(evtCallback);
+        });
+
+        commitRequestedRebuild();
+
+        if (profilingEnabled.load(std::memory_order_relaxed)) {
+            processProfile(evtCallback);
+        }
+
+        if (numericChecksEnabled.load(std::memory_order_relaxed)) {
+            processNumerics(evtCallback);
+        }
+    }
+
+    template <typename FloatType>
+    void Runtime<FloatType>::processQueuedEvents(EventBuffer& events)
+    {
+        events.clear();
+
+        // While the compiler thread is applying a batch, events wait in their nodes
+        // until the next call
+        std::unique_lock<std::recursive_mutex> lock(graphMutex, std::try_to_lock);
+
+        if (!lock.owns_lock())
+            return;
+
+        visitEventNodes([&](GraphNode<FloatType>* node) {
+            node->processEvents(events);
+        });
+
+        commitRequestedRebuild();
+
+        std::function<void(std::string const&, js::Value)> relay = [&events](std::string const& type, js::Value v) {
+            events.pushValue(0, type, std::move(v));
+        };
+
+        if (profilingEnabled.load(std::memory_order_relaxed)) {
+            processProfile(relay);
+        }
+
+        if (numericChecksEnabled.load(std::memory_order_relaxed)) {
+            processNumerics(relay);
+        }
+    }
+
+    template <typename FloatType>
+    template <typename Fn>
+    void Runtime<FloatType>::visitEventNodes(Fn&& fn)
+    {
+        // First those with notifications pending, including any taken off the list early by
+        // garbage collection
+        for (auto* node : pendingEventNodes) {
+            fn(node);
+        }
+
+        pendingEventNodes.clear();
+        eventNotifications.take(fn);
+
+        // Then the rest, dropping any which turn out never to relay events
+        for (auto it = polledEventNodes.begin(); it != polledEventNodes.end();) {
+            fn(*it);
+            it = (*it)->mayRelayEvents() ? std::next(it) : polledEventNodes.erase(it);
+        }
+    }
+
+    template <typename FloatType>
+    void Runtime<FloatType>::setProfilingEnabled(bool enabled)
+    {
+        profilingEnabled.store(enabled, std::memory_order_relaxed);
+    }
+
+    template <typename FloatType>
+    void Runtime<FloatType>::setFlushDenormalsEnabled(bool enabled)
+    {
+        flushDenormalsEnabled.store(enabled, std::memory_order_relaxed);
+    }
+
+    template <typename FloatType>
+    void Runtime<FloatType>::setNumericChecksEnabled(bool enabled)
+    {
+        numericChecksEnabled.store(enabled, std::memory_order_relaxed);
+    }
+
+    template <typename FloatType>
+    void Runtime<FloatType>::processNumerics(std::function<void(std::string const&, js::Value)>& evtCallback)
+    {
+        if (!latestRenderSeq)
+            return;
+
+        js::Array nodes;
+
+        latestRenderSeq->drainNumerics([&](NodeId id, int64_t nan, int64_t inf, int64_t subnormal) {
+            auto const it = nodeTypeTable.find(id);
+
+            nodes.push_back(js::Object({
+                {"id", js::Number(id)},
+                {"type", js::String(it != nodeTypeTable.end() ? it->second : "")},
+                {"nan", js::Number(static_cast<double>(nan))},
+                {"inf", js::Number(static_cast<double>(inf))},
+                {"subnormal", js::Number(static_cast<double>(subnormal))},
+            }));
+        });
+
+        if (nodes.empty())
+            return;
+
+        evtCallback("numerics", js::Object({
+            {"nodes", std::move(nodes)},
+        }));
+    }
+
+    template <typename FloatType>
+    void Runtime<FloatType>::processProfile(std::function<void(std::string const&, js::Value)>& evtCallback)
+    {
+        auto const numSamples = profiledNumSamples.exchange(0, std::memory_order_relaxed);
+
+        // Nothing rendered since the last report
+        if (numSamples == 0)
+            return;
+
+        auto const callbackNanos = profiledCallbackNanos.exchange(0, std::memory_order_relaxed);
+        auto const numBlocks = profiledNumBlocks.exchange(0, std::memory_order_relaxed);
+        auto const peakLoadPpm = profiledPeakLoadPpm.exchange(0, std::memory_order_relaxed);
+        auto const budgetNanos = static_cast<double>(numSamples) / sampleRate * 1e9;
+
+        std::vector<std::pair<NodeId, int64_t>> timings;
+
+        if (latestRenderSeq) {
+            latestRenderSeq->drainProfile([&](NodeId id, int64_t nanos) {
+                timings.push_back({id, nanos});
+            });
+        }
+
+        // Most expensive first
+        std::sort(timings.begin(), timings.end(), [](auto const& a, auto const& b) {
+            return a.second > b.second;
+        });
+
+        js::Array nodes;
+
+        for (auto const& [id, nanos] : timings) {
+            auto const it = nodeTypeTable.find(id);
+
+            nodes.push_back(js::Object({
+                {"id", js::Number(id)},
+                {"type", js::String(it != nodeTypeTable.end() ? it->second : "")},
+                {"us", js::Number(static_cast<double>(nanos) / 1e3)},
+            }));
+        }
+
+        evtCallback("profile", js::Object({
+            {"blocks", js::Number(static_cast<double>(numBlocks))},
+            {"callbackUs", js::Number(static_cast<double>(callbackNanos) / 1e3)},
+            {"budgetUs", js::Number(budgetNanos / 1e3)},
+            {"loadPercent", js::Number(static_cast<double>(callbackNanos) / budgetNanos * 100.0)},
+            {"peakLoadPercent", js::Number(static_cast<double>(peakLoadPpm) / 1e4)},
+            {"nodes", std::move(nodes)},
+        }));
+    }
+
+    template <typename FloatType>
+    void Runtime<FloatType>::reset()
+    {
+        std::lock_guard<std::recursive_mutex> lock(graphMutex);
+
+        // TODO: Right now only the SampleNode actually does anything with reset(). Need
+        // to add this behavior to nodes like delay and convolve and then should also do
+        // a pass here through the tapTable bufers. Edit: wait, don't need that, just need
+        // the TapOut nodes to zero themselves out, w00t
+        for (auto it = nodeTable.begin(); it != nodeTable.end(); ++it) {
+            it->second->reset();
+        }
+    }
+
+    //==============================================================================
+    template <typename FloatType>
+    void Runtime<FloatType>::updateSharedResourceMap(std::string const& name, FloatType const* data, size_t size)
+    {
+        std::lock_guard<std::recursive_mutex> lock(graphMutex);
+
+        sharedResourceMap.insert(name, SharedResource<FloatType>::copy(data, size));
+    }
+
+    template <typename FloatType>
+    void Runtime<FloatType>::updateSharedResourceMap(std::string const& name, SharedResourceBuffer<FloatType>&& resource)
+    {
+        std::lock_guard<std::recursive_mutex> lock(graphMutex);
+
+        invariant(resource != nullptr, "cannot add an empty resource to the shared resource map");
+        sharedResourceMap.insert(name, std::move(resource));
+    }
+
+    template <typename FloatType>
+    void Runtime<FloatType>::removeSharedResource(std::string const& name)
+    {
+        std::lock_guard<std::recursive_mutex> lock(graphMutex);
+
+        sharedResourceMap.remove(name);
+    }
+
+    template <typename FloatType>
+    size_t Runtime<FloatType>::pruneSharedResourceMap()
+    {
+        std::lock_guard<std::recursive_mutex> lock(graphMutex);
+
+        // Retired render sequences may still be holding deleted nodes, and those nodes
+        // their resources, so let them go first
+        collectGarbage();
+        return sharedResourceMap.prune();
     }
 
     template <typename FloatType>
-    void Runtime<FloatType>::reset()
+    std::vector<std::string> Runtime<FloatType>::getSharedResourceMapKeys() const
     {
-        // TODO: Right now only the SampleNode actually does anything with reset(). Need
-        // to add this behavior to nodes like delay and convolve and then should also do
-        // a pass here through the tapTable bufers. Edit: wait, don't need that, just need
-        // the TapOut nodes to zero themselves out, w00t
-        for (auto it = nodeTable.begin(); it != nodeTable.end(); ++it) {
-            it->second->reset();
-        }
+        std::lock_guard<std::recursive_mutex> lock(graphMutex);
+
+        return sharedResourceMap.keys();
     }
 
-    //==============================================================================
     template <typename FloatType>
-    void Runtime<FloatType>::updateSharedResourceMap(std::string const& name, FloatType const* data, size_t size)
+    void Runtime<FloatType>::addSampleStream(std::string const& name, std::unique_ptr<SampleStreamBackend<FloatType>>&& backend, size_t preloadSize, size_t bufferSize)
     {
-        sharedResourceMap.insert(
+        std::lock_guard<std::recursive_mutex> lock(graphMutex);
+
+        if (sampleStreamer == nullptr) {
+            sampleStreamer = std::make_unique<SampleStreamer<FloatType>>();
+        }
+
+        sharedResourceMap.insertStream(
             name,
-            std::make_shared<typename SharedResourceBuffer<FloatType>::element_type>(data, data + size)
+            std::make_shared<SampleStream<FloatType>>(std::move(backend), preloadSize, bufferSize, *sampleStreamer)
         );
     }
 
+    template <typename FloatType>
+    uint64_t Runtime<FloatType>::getNumSampleStreamUnderruns() const
+    {
+        return sampleStreamer != nullptr ? sampleStreamer->getNumUnderruns() : 0;
+    }
+
     template <typename FloatType>
     void Runtime<FloatType>::registerNodeType(std::string const& type, Runtime::NodeFactoryFn && fn)
     {
-        invariant(nodeFactory.find(type) == nodeFactory.end(), "Trying to install a node type which already exists");
+        std::lock_guard<std::recursive_mutex> lock(graphMutex);
+
+        invariant(nodeFactory.find(type) == nodeFactory.end() && nodeTypes->find(type) == nullptr, "Trying to install a node type which already exists");
         nodeFactory.emplace(type, std::move(fn));
     }
 
+    template <typename FloatType>
+    void Runtime<FloatType>::setNumRenderThreads(size_t numWorkerThreads)
+    {
+        renderThreadPool.reset();
+
+        if (numWorkerThreads > 0) {
+            renderThreadPool = std::make_unique<RenderThreadPool>(numWorkerThreads);
+        }
+    }
+
     //==============================================================================
     template <typename FloatType>
-    void Runtime<FloatType>::traverse(std::set<NodeId>& visited, std::vector<NodeId>& visitOrder, NodeId const& n) {
+    void Runtime<FloatType>::traverse(std::unordered_set<NodeId>& visited, std::vector<NodeId>& visitOrder, std::vector<NodeId>& skipped, NodeId const& n) {
         // If we've already visited this node, skip
         if (visited.count(n) > 0)
-            return;
+            return (void) skipped.push_back(n);
 
         auto& children = edgeTable.at(n);
         auto const numChildren = children.size();
 
         for (size_t i = 0; i < numChildren; ++i) {
-            traverse(visited, visitOrder, children.at(i));
+            traverse(visited, visitOrder, skipped, children.at(i));
         }
 
         visitOrder.push_back(n);
@@ -362,22 +1969,517 @@ namespace elem
     }
 
     template <typename FloatType>
-    std::shared_ptr<GraphRenderSequence<FloatType>> Runtime<FloatType>::buildRenderSequence()
+    size_t Runtime<FloatType>::findInPlaceChild(
+        std::shared_ptr<GraphNode<FloatType>>& node,
+        std::vector<NodeId> const& children,
+        size_t seqIndex,
+        size_t visitIndex,
+        std::unordered_map<NodeId, size_t> const& owners,
+        std::unordered_map<NodeId, size_t> const& lastReader,
+        std::unordered_set<NodeId> const& pinned)
+    {
+        auto* pointwise = dynamic_cast<PointwiseNode<FloatType>*>(node.get());
+
+        if (pointwise == nullptr)
+            return children.size();
+
+        for (size_t i = 0; i < children.size(); ++i) {
+            auto const& child = children[i];
+
+            // The child's buffer must be free for the taking once this node has run, and
+            // mustn't also be read through one of this node's other inputs
+            bool const available = pointwise->canProcessInPlace(i)
+                && owners.at(child) == seqIndex
+                && pinned.count(child) == 0
+                && lastReader.at(child) == visitIndex
+                && std::count(children.begin(), children.end(), child) == 1;
+
+            if (available)
+                return i;
+        }
+
+        return children.size();
+    }
+
+    template <typename FloatType>
+    typename BatchableNode<FloatType>::BatchFn Runtime<FloatType>::getBatchFunction(std::shared_ptr<GraphNode<FloatType>>& node)
+    {
+        if (auto* batchable = dynamic_cast<BatchableNode<FloatType>*>(node.get()))
+            return batchable->getBatchFunction();
+
+        return nullptr;
+    }
+
+    template <typename FloatType>
+    void Runtime<FloatType>::scheduleBatches(std::vector<NodeId>& visitOrder)
+    {
+        // Each node's depth is the length of the longest path to it from a node without
+        // children in this traversal, so that no node depends on another of the same depth
+        std::unordered_map<NodeId, size_t> depths;
+
+        // Batchable nodes are grouped by their batch function and number of inputs, in
+        // order of first appearance. Group zero holds the nodes which can't be batched.
+        std::map<std::pair<typename BatchableNode<FloatType>::BatchFn, size_t>, size_t> groups;
+        std::map<std::pair<size_t, size_t>, size_t> counts;
+        std::vector<std::pair<size_t, size_t>> keys;
+        bool worthwhile = false;
+
+        for (auto const& nid : visitOrder) {
+            auto& node = nodeTable.at(nid);
+            auto const& children = edgeTable.at(nid);
+            size_t depth = 0;
+
+            for (auto const& child : children) {
+                if (auto it = depths.find(child); it != depths.end()) {
+                    depth = std::max(depth, it->second + 1);
+                }
+            }
+
+            depths.emplace(nid, depth);
+
+            size_t group = 0;
+
+            if (auto const fn = getBatchFunction(node); fn != nullptr && children.size() > 0) {
+                group = groups.emplace(std::make_pair(fn, children.size()), groups.size() + 1).first->second;
+                worthwhile = worthwhile || ++counts[{depth, group}] > 1;
+            }
+
+            keys.push_back({depth, group});
+        }
+
+        // A depth first visit order keeps each voice's nodes together, which suits the
+        // buffer allocator best, so we only reorder where there's something to batch
+        if (!worthwhile)
+            return;
+
+        std::vector<size_t> order(visitOrder.size());
+        std::iota(order.begin(), order.end(), 0);
+
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return keys[a] < keys[b];
+        });
+
+        std::vector<NodeId> scheduled;
+        scheduled.reserve(visitOrder.size());
+
+        for (auto const i : order) {
+            scheduled.push_back(visitOrder[i]);
+        }
+
+        visitOrder = std::move(scheduled);
+    }
+
+    template <typename FloatType>
+    std::vector<typename Runtime<FloatType>::FeedbackLoop> Runtime<FloatType>::scheduleFeedbackLoops(std::vector<RootTraversal>& traversals)
+    {
+        std::vector<FeedbackLoop> loops(traversals.size());
+
+        // The taps which ask for a loop latency shorter than a block, by name
+        std::unordered_map<std::string, std::shared_ptr<TapOutNode<FloatType>>> loopTaps;
+
+        for (auto const& [nid, ptr] : tapOutTable) {
+            if (ptr->getLoopLatency() > 0) {
+                loopTaps.emplace(ptr->template getPropertyWithDefault<js::String>(PropertyKey("name"), js::String()), ptr);
+            }
+        }
+
+        if (loopTaps.empty()) {
+            return loops;
+        }
+
+        // Every tap of a loop must render in the same subsequence, since a subsequence
+        // renders all of its sub-blocks before the next one starts. We collect the taps
+        // of each name, then the subsequences which hold them.
+        std::unordered_map<NodeId, size_t> owners;
+        std::unordered_map<std::string, std::vector<NodeId>> namedTaps;
+        std::unordered_map<std::string, std::set<size_t>> nameOwners;
+        std::vector<NodeId> order;
+
+        for (size_t seqIndex = 0; seqIndex < traversals.size(); ++seqIndex) {
+            for (auto const& nid : traversals[seqIndex].visitOrder) {
+                auto& node = nodeTable.at(nid);
+
+                owners.emplace(nid, seqIndex);
+                order.push_back(nid);
+
+                if (tapOutTable.count(nid) == 0 && !std::dynamic_pointer_cast<TapInNode<FloatType>>(node))
+                    continue;
+
+                auto const name = node->template getPropertyWithDefault<js::String>(PropertyKey("name"), js::String());
+
+                if (auto it = loopTaps.find(name); it != loopTaps.end() && (tapOutTable.count(nid) == 0 || it->second->getId() == nid)) {
+                    namedTaps[name].push_back(nid);
+                    nameOwners[name].insert(seqIndex);
+                }
+            }
+        }
+
+        // The tapIns and tapOut of each loop seed the search for the nodes in between
+        std::unordered_set<NodeId> seeds;
+
+        for (auto const& [name, nids] : namedTaps) {
+            auto const tapOutId = loopTaps.at(name)->getId();
+
+            // A tapIn rendered from another root would read the tap line part way through
+            // the loop's sub-blocks, so then the loop falls back to the latency of a block,
+            // as for a tapOut without a blockSize prop
+            if (nameOwners.at(name).size() == 1 && owners.count(tapOutId) > 0) {
+                seeds.insert(nids.begin(), nids.end());
+            }
+        }
+
+        if (seeds.empty()) {
+            return loops;
+        }
+
+        // The loop holds the nodes which both depend on a seed and feed into one. The
+        // traversals concatenated are in dependency order, so we find the former walking
+        // forward, and the latter walking back.
+        std::unordered_set<NodeId> dependents;
+        std::unordered_set<NodeId> inputs(seeds);
+
+        for (auto const& nid : order) {
+            auto const& children = edgeTable.at(nid);
+
+            if (seeds.count(nid) > 0 || std::any_of(children.begin(), children.end(), [&](NodeId const& c) { return dependents.count(c) > 0; })) {
+                dependents.insert(nid);
+            }
+        }
+
+        for (auto it = order.rbegin(); it != order.rend(); ++it) {
+            if (inputs.count(*it) > 0) {
+                inputs.insert(edgeTable.at(*it).begin(), edgeTable.at(*it).end());
+            }
+        }
+
+        std::unordered_set<NodeId> members;
+        std::unordered_set<NodeId> downstream;
+
+        for (auto const& nid : order) {
+            auto const& children = edgeTable.at(nid);
+
+            if (dependents.count(nid) > 0 && inputs.count(nid) > 0) {
+                members.insert(nid);
+
+                // Should a loop reach across subsequences, we give up on them all, which
+                // leaves each with the latency of a block
+                for (auto const& c : children) {
+                    if (members.count(c) > 0 && owners.at(c) != owners.at(nid)) {
+                        return loops;
+                    }
+                }
+
+                continue;
+            }
+
+            if (std::any_of(children.begin(), children.end(), [&](NodeId const& c) { return members.count(c) > 0 || downstream.count(c) > 0; })) {
+                downstream.insert(nid);
+            }
+        }
+
+        // Each traversal is then split into the nodes that the loop doesn't depend on, the
+        // loop, and the nodes after it, which keeps each part in dependency order
+        for (size_t seqIndex = 0; seqIndex < traversals.size(); ++seqIndex) {
+            auto& visitOrder = traversals[seqIndex].visitOrder;
+            auto& loop = loops[seqIndex];
+
+            auto const loopBegin = std::stable_partition(visitOrder.begin(), visitOrder.end(), [&](NodeId const& nid) {
+                return members.count(nid) == 0 && downstream.count(nid) == 0;
+            });
+
+            auto const loopEnd = std::stable_partition(loopBegin, visitOrder.end(), [&](NodeId const& nid) {
+                return members.count(nid) > 0;
+            });
+
+            if (loopBegin == loopEnd)
+                continue;
+
+            for (auto it = loopBegin; it != loopEnd; ++it) {
+                if (auto t = tapOutTable.find(*it); t != tapOutTable.end() && seeds.count(*it) > 0) {
+                    auto const latency = t->second->getLoopLatency();
+
+                    loop.taps.push_back({ t->second, latency });
+                    loop.subBlockSize = (loop.subBlockSize == 0) ? latency : std::min(loop.subBlockSize, latency);
+                }
+            }
+
+            loop.begin = static_cast<size_t>(loopBegin - visitOrder.begin());
+            loop.end = static_cast<size_t>(loopEnd - visitOrder.begin());
+        }
+
+        return loops;
+    }
+
+    template <typename FloatType>
+    typename Runtime<FloatType>::RenderPlan Runtime<FloatType>::planRenderSequence(std::vector<RootTraversal> const& traversals, std::vector<FeedbackLoop>& loops, size_t numLiveRoots)
     {
-        // Grab a fresh render sequence
-        auto rseq = renderSeqPool.allocate();
+        RenderPlan plan;
+
+        // The value of each node known to be constant, and the node which each merged
+        // node is replaced by
+        std::unordered_map<NodeId, FloatType> constants;
+        std::unordered_map<NodeId, NodeId> merged;
+        std::unordered_map<std::string, NodeId> canonical;
+        std::unordered_map<NodeId, size_t> owners;
+
+        auto const inLoop = [&](size_t seqIndex, size_t i) {
+            return loops[seqIndex].subBlockSize > 0 && i >= loops[seqIndex].begin && i < loops[seqIndex].end;
+        };
 
-        // Clear in case it was already used
-        rseq->reset();
+        auto const childrenOf = [&](NodeId nid) -> std::vector<NodeId> const& {
+            auto it = plan.edges.find(nid);
+            return (it != plan.edges.end()) ? it->second : edgeTable.at(nid);
+        };
+
+        // Constants merge by the bits of their value, so that, say, 0 and -0 stay apart
+        auto const constantKey = [](FloatType v) {
+            std::conditional_t<sizeof(FloatType) == 8, uint64_t, uint32_t> bits;
+            std::memcpy(&bits, &v, sizeof(v));
+            return "const:" + std::to_string(bits);
+        };
+
+        std::vector<FloatType> inputValues;
+        std::vector<FloatType const*> inputPointers;
+        std::vector<char> inputFlags;
+
+        // Walking forward, every child is planned before the nodes which read it
+        for (size_t seqIndex = 0; seqIndex < numLiveRoots; ++seqIndex) {
+            auto const& visitOrder = traversals[seqIndex].visitOrder;
+
+            for (size_t i = 0; i < visitOrder.size(); ++i) {
+                auto const nid = visitOrder[i];
+                owners.emplace(nid, seqIndex);
+
+                if (inLoop(seqIndex, i))
+                    continue;
+
+                auto* node = nodeTable.at(nid).get();
+                auto const& children = edgeTable.at(nid);
+
+                std::vector<NodeId> resolved(children);
+                bool remapped = false;
+
+                for (auto& c : resolved) {
+                    if (auto it = merged.find(c); it != merged.end()) {
+                        c = it->second;
+                        remapped = true;
+                    }
+                }
+
+                std::string key;
+
+                if (auto* c = dynamic_cast<ConstNode<FloatType>*>(node); c && !c->isAutomated()) {
+                    constants.emplace(nid, c->value.load());
+                    key = constantKey(constants.at(nid));
+                } else if (dynamic_cast<SampleRateNode<FloatType>*>(node)) {
+                    constants.emplace(nid, FloatType(sampleRate));
+                    key = constantKey(constants.at(nid));
+                } else if (auto* p = dynamic_cast<PointwiseNode<FloatType>*>(node)) {
+                    auto const allConstant = !resolved.empty() && std::all_of(resolved.begin(), resolved.end(), [&](NodeId c) {
+                        return constants.count(c) > 0;
+                    });
+
+                    if (allConstant) {
+                        // A constant input is a single sample repeated, and a pointwise node
+                        // treats every sample alike, so one sample gives its whole output
+                        inputValues.resize(resolved.size());
+                        inputPointers.resize(resolved.size());
+                        inputFlags.assign(resolved.size(), 1);
+
+                        for (size_t j = 0; j < resolved.size(); ++j) {
+                            inputValues[j] = constants.at(resolved[j]);
+                            inputPointers[j] = &inputValues[j];
+                        }
+
+                        FloatType out = 0;
+                        bool outIsConstant = false;
+
+                        p->process(BlockContext<FloatType> {
+                            inputPointers.data(),
+                            resolved.size(),
+                            &out,
+                            1,
+                            nullptr,
+                            reinterpret_cast<bool const*>(inputFlags.data()),
+                            &outIsConstant,
+                        });
+
+                        constants.emplace(nid, out);
+                        plan.folded.emplace(nid, out);
+                        plan.edges[nid] = {};
+                        plan.sources.insert(nid);
+                        plan.sources.insert(children.begin(), children.end());
+                        plan.sources.insert(resolved.begin(), resolved.end());
+                        key = constantKey(out);
+                    } else {
+                        key = nodeTypeTable.at(nid) + "(";
+
+                        for (auto const c : resolved) {
+                            key += std::to_string(c) + ",";
+                        }
+
+                        key += ")";
+
+                        node->forEachProperty([&](std::string const& k, js::Value const& v) {
+                            if (k != "key") {
+                                key += k + "=" + v.toString() + ";";
+                            }
+                        });
+                    }
+                }
+
+                if (!key.empty()) {
+                    auto const [it, inserted] = canonical.emplace(key, nid);
+                    auto const other = it->second;
+                    auto const otherSeq = owners.at(other);
+
+                    // A node may only be replaced by one which renders for at least as long
+                    if (!inserted && (otherSeq == seqIndex || traversals[otherSeq].active)) {
+                        merged.emplace(nid, other);
+                        plan.folded.erase(nid);
+                        plan.edges.erase(nid);
+                        plan.sources.insert(nid);
+                        plan.sources.insert(other);
+                        continue;
+                    }
+                }
+
+                if (remapped && plan.folded.count(nid) == 0) {
+                    plan.edges[nid] = std::move(resolved);
+                }
+            }
+        }
+
+        // Then walking back, every node is reached before its children, so we can tell
+        // which of the stateless nodes anything still reads. Every other node renders as
+        // before, whether or not its output is read.
+        std::unordered_set<NodeId> live;
+        plan.visitOrders.resize(traversals.size());
+
+        for (size_t seqIndex = numLiveRoots; seqIndex-- > 0;) {
+            auto const& visitOrder = traversals[seqIndex].visitOrder;
+            auto& loop = loops[seqIndex];
+            auto& kept = plan.visitOrders[seqIndex];
+
+            live.insert(traversals[seqIndex].rootId);
+            std::vector<bool> keep(visitOrder.size());
+
+            for (size_t i = visitOrder.size(); i-- > 0;) {
+                auto const nid = visitOrder[i];
+                auto* node = nodeTable.at(nid).get();
+
+                auto const removable = merged.count(nid) > 0
+                    || dynamic_cast<PointwiseNode<FloatType>*>(node)
+                    || dynamic_cast<ConstNode<FloatType>*>(node)
+                    || dynamic_cast<SampleRateNode<FloatType>*>(node);
+
+                keep[i] = live.count(nid) > 0 || !removable || inLoop(seqIndex, i);
+
+                if (!keep[i]) {
+                    plan.absorbed.push_back(nid);
+                    continue;
+                }
+
+                for (auto const c : childrenOf(nid)) {
+                    live.insert(c);
+                }
+            }
+
+            size_t loopBegin = 0;
+            size_t loopEnd = 0;
+
+            for (size_t i = 0; i < visitOrder.size(); ++i) {
+                if (i == loop.begin)
+                    loopBegin = kept.size();
+
+                if (keep[i])
+                    kept.push_back(visitOrder[i]);
+
+                if (i + 1 == loop.end)
+                    loopEnd = kept.size();
+            }
+
+            if (loop.subBlockSize > 0) {
+                loop.begin = loopBegin;
+                loop.end = loopEnd;
+            }
+        }
+
+        // The roots of channels the host doesn't have render nothing at all
+        for (size_t seqIndex = numLiveRoots; seqIndex < traversals.size(); ++seqIndex) {
+            loops[seqIndex] = FeedbackLoop();
+        }
+
+        // Last, the control rate subgraphs. Walking back again, each node's readers are
+        // reached before it, and a node joins the subgraph of its readers if they're all in
+        // the same one, or otherwise starts its own if it's marked
+        std::unordered_map<NodeId, std::vector<NodeId>> readers;
+        std::unordered_map<NodeId, NodeId> controlRateTop;
+
+        for (size_t seqIndex = 0; seqIndex < numLiveRoots; ++seqIndex) {
+            for (auto const nid : plan.visitOrders[seqIndex]) {
+                for (auto const c : childrenOf(nid)) {
+                    readers[c].push_back(nid);
+                }
+            }
+        }
+
+        for (size_t seqIndex = numLiveRoots; seqIndex-- > 0;) {
+            auto const& visitOrder = plan.visitOrders[seqIndex];
+
+            for (size_t i = visitOrder.size(); i-- > 0;) {
+                auto const nid = visitOrder[i];
+
+                if (inLoop(seqIndex, i) || (plan.folded.count(nid) == 0 && !nodeTable.at(nid)->canRenderAtControlRate()))
+                    continue;
+
+                auto const& rs = readers[nid];
+                auto const first = rs.empty() ? controlRateTop.end() : controlRateTop.find(rs[0]);
+
+                auto const joins = first != controlRateTop.end() && owners.at(first->second) == seqIndex && std::all_of(rs.begin(), rs.end(), [&](NodeId r) {
+                    auto it = controlRateTop.find(r);
+                    return it != controlRateTop.end() && it->second == first->second;
+                });
+
+                if (joins) {
+                    controlRateTop.emplace(nid, first->second);
+                    plan.controlRates.emplace(nid, plan.controlRates.at(first->second));
+                    continue;
+                }
+
+                auto const period = nodeTable.at(nid)->template getPropertyWithDefault<js::Number>(PropertyKey("controlRate"), 0);
+
+                if (period >= 2) {
+                    controlRateTop.emplace(nid, nid);
+                    plan.controlRates.emplace(nid, static_cast<size_t>(period));
+                    plan.controlRateTops.insert(nid);
+                }
+            }
+        }
+
+        return plan;
+    }
+
+    template <typename FloatType>
+    std::shared_ptr<GraphRenderSequence<FloatType>> Runtime<FloatType>::buildRenderSequence()
+    {
+        // Grab a fresh render sequence, reusing a retired one if we can. Those have already
+        // been cleared in collectGarbage.
+        std::shared_ptr<GraphRenderSequence<FloatType>> rseq;
+
+        if (freeRenderSeqs.empty()) {
+            rseq = std::make_shared<GraphRenderSequence<FloatType>>();
+        } else {
+            rseq = std::move(freeRenderSeqs.back());
+            freeRenderSeqs.pop_back();
+        }
 
         // Reset our buffer allocator
         bufferAllocator.reset();
 
         // Capture tap nodes for the pre-processing step
-        for (auto const& [nid, node] : nodeTable) {
-            if (auto ptr = std::dynamic_pointer_cast<TapOutNode<FloatType>>(node)) {
-                rseq->pushTap(ptr);
-            }
+        for (auto const& [nid, ptr] : tapOutTable) {
+            rseq->pushTap(ptr);
         }
 
         // Here we iterate all current roots and visit the graph from each
@@ -392,16 +2494,30 @@ namespace elem
         // To put that another way, we make sure that all "live" nodes are associated with
         // the RootRenderSequences of the active roots, and any nodes which will be "dead" after
         // the associated root has finished its fade can be safely skipped.
+        //
+        // Roots of channels beyond those the host last rendered come after all of those,
+        // and render nothing.
         std::list<std::shared_ptr<RootNode<FloatType>>> sortedRoots;
+        std::vector<std::shared_ptr<RootNode<FloatType>>> deadRoots;
 
         // Keep track of visits
-        std::set<NodeId> visited;
+        std::unordered_set<NodeId> visited;
+
+        auto const numHostChannels = hostNumOutputChannels.load(std::memory_order_relaxed);
+        size_t numRootChannels = 0;
 
         for (auto const& n : currentRoots) {
             if (auto ptr = std::dynamic_pointer_cast<RootNode<FloatType>>(nodeTable.at(n))) {
-                auto isActive = ptr->getPropertyWithDefault("active", (js::Boolean) false);
+                auto isActive = ptr->isActive();
+                auto const channel = ptr->getChannelNumber();
 
-                if (isActive) {
+                if (channel >= 0) {
+                    numRootChannels = std::max(numRootChannels, static_cast<size_t>(channel) + 1);
+                }
+
+                if (numHostChannels > 0 && channel >= 0 && static_cast<size_t>(channel) >= numHostChannels) {
+                    deadRoots.push_back(ptr);
+                } else if (isActive) {
                     sortedRoots.push_front(ptr);
                 } else {
                     sortedRoots.push_back(ptr);
@@ -409,26 +2525,215 @@ namespace elem
             }
         }
 
+        auto const numLiveRoots = sortedRoots.size();
+        sortedRoots.insert(sortedRoots.end(), deadRoots.begin(), deadRoots.end());
+
+        // The previous traversals are taken out of the cache as we go, so should the build
+        // fail part way the next one starts over
+        auto previousTraversals = std::move(traversalCache);
+        std::unordered_map<NodeId, size_t> cachedTraversals;
+
+        traversalCache.clear();
+
+        for (size_t i = 0; i < previousTraversals.size(); ++i) {
+            cachedTraversals.emplace(previousTraversals[i].rootId, i);
+        }
+
+        std::vector<RootTraversal> nextTraversals;
+
         for (auto& ptr : sortedRoots) {
-            RootRenderSequence<FloatType> rrs(rseq->bufferMap, ptr);
+            auto const rootId = ptr->getId();
+            auto const isActive = ptr->isActive();
+
+            // We can reuse the previous traversal from this root if walking it again would
+            // visit and skip the same nodes, see RootTraversal
+            auto const it = cachedTraversals.find(rootId);
+            auto* cached = (it != cachedTraversals.end()) ? &previousTraversals[it->second] : nullptr;
+
+            bool const reusable = cached != nullptr
+                && std::none_of(cached->visitOrder.begin(), cached->visitOrder.end(), [&](NodeId const& nid) {
+                    return dirtyNodes.count(nid) > 0 || visited.count(nid) > 0;
+                })
+                && std::all_of(cached->skipped.begin(), cached->skipped.end(), [&](NodeId const& nid) {
+                    return visited.count(nid) > 0;
+                });
 
             std::vector<NodeId> visitOrder;
-            traverse(visited, visitOrder, ptr->getId());
+            std::vector<NodeId> skipped;
 
-            std::for_each(visitOrder.begin(), visitOrder.end(), [&](NodeId const& nid) {
-                auto& node = nodeTable.at(nid);
-                auto& children = edgeTable.at(nid);
+            if (reusable) {
+                visitOrder = std::move(cached->visitOrder);
+                skipped = std::move(cached->skipped);
+                visited.insert(visitOrder.begin(), visitOrder.end());
+            } else {
+                traverse(visited, visitOrder, skipped, rootId);
+                scheduleBatches(visitOrder);
+            }
+
+            nextTraversals.push_back({ rootId, isActive, std::move(visitOrder), std::move(skipped) });
+        }
+
+        auto loops = scheduleFeedbackLoops(nextTraversals);
+        auto plan = planRenderSequence(nextTraversals, loops, numLiveRoots);
+
+        foldSources = std::move(plan.sources);
+        rseq->setOutputChannels(numHostChannels, numRootChannels);
+
+        auto const childrenOf = [&](NodeId nid) -> std::vector<NodeId> const& {
+            auto it = plan.edges.find(nid);
+            return (it != plan.edges.end()) ? it->second : edgeTable.at(nid);
+        };
+
+        // Nodes left out of the sequence still hear about their parameter events
+        for (auto const nid : plan.absorbed) {
+            auto& node = nodeTable.at(nid);
+
+            if (auto* p = dynamic_cast<ParameterEventNode<FloatType>*>(node.get())) {
+                rseq->pushParameterNode(nid, p, true);
+                rseq->retain(node);
+            }
+        }
+
+        // Before assigning buffers we run a liveness pass over the traversals, finding for
+        // each node the position of the last node that reads its output. A buffer can be
+        // handed back to the allocator once its last reader has been pushed. Each node's
+        // owner is the subsequence that renders it; any node read from another subsequence
+        // keeps its buffer for the whole block, as do the roots, whose buffers are read
+        // after the render ops have run.
+        std::unordered_map<NodeId, size_t> owners;
+        std::unordered_map<NodeId, size_t> lastReader;
+        std::unordered_set<NodeId> pinned;
+
+        for (size_t seqIndex = 0; seqIndex < nextTraversals.size(); ++seqIndex) {
+            auto const& visitOrder = plan.visitOrders[seqIndex];
+            pinned.insert(nextTraversals[seqIndex].rootId);
+
+            for (size_t i = 0; i < visitOrder.size(); ++i) {
+                for (auto const& child : childrenOf(visitOrder[i])) {
+                    if (auto it = owners.find(child); it != owners.end() && it->second != seqIndex) {
+                        pinned.insert(child);
+                    }
+
+                    lastReader[child] = i;
+                }
+
+                owners.emplace(visitOrder[i], seqIndex);
+            }
+        }
+
+        for (size_t seqIndex = 0; seqIndex < nextTraversals.size(); ++seqIndex) {
+            auto const& visitOrder = plan.visitOrders[seqIndex];
+            auto root = std::static_pointer_cast<RootNode<FloatType>>(nodeTable.at(nextTraversals[seqIndex].rootId));
+
+            RootRenderSequence<FloatType> rrs(rseq->bufferMap, root);
+            std::set<size_t> deps;
 
-                if (children.size() > 0) {
+            // Subsequences may render in parallel, so released buffers are only ever
+            // reused within the subsequence that released them
+            bufferAllocator.clearFreeList();
+
+            // Buffers released by one member of a potential batch are held back until the
+            // batch ends, since its members render side by side
+            std::vector<RenderBuffer<FloatType>> pendingRelease;
+            typename BatchableNode<FloatType>::BatchFn prevBatchFn = nullptr;
+            size_t prevNumChildren = 0;
+
+            auto loop = loops[seqIndex];
+
+            for (size_t i = 0; i < visitOrder.size(); ++i) {
+                auto const& nid = visitOrder[i];
+                auto& children = childrenOf(nid);
+                std::shared_ptr<GraphNode<FloatType>> node = nodeTable.at(nid);
+
+                if (auto it = plan.folded.find(nid); it != plan.folded.end()) {
+                    node = std::make_shared<FoldedConstantNode<FloatType>>(nid, sampleRate, static_cast<size_t>(blockSize), it->second);
+                    rseq->retain(node);
+                }
+
+                if (loop.subBlockSize > 0 && i == loop.begin) {
+                    rrs.beginFeedbackLoop(loop.subBlockSize, std::move(loop.taps));
+                }
+
+                auto const batchFn = getBatchFunction(node);
+
+                if (batchFn == nullptr || batchFn != prevBatchFn || children.size() != prevNumChildren) {
+                    for (auto const& buffer : pendingRelease) {
+                        bufferAllocator.release(buffer);
+                    }
+
+                    pendingRelease.clear();
+                }
+
+                prevBatchFn = batchFn;
+                prevNumChildren = children.size();
+
+                auto const controlRate = plan.controlRates.find(nid);
+                auto const period = controlRate != plan.controlRates.end() ? controlRate->second : 1;
+
+                if (auto* p = dynamic_cast<ParameterEventNode<FloatType>*>(node.get())) {
+                    rseq->pushParameterNode(nid, p, foldSources.count(nid) > 0, period);
+                }
+
+                if (period > 1) {
+                    std::vector<bool> childAtControlRate(children.size());
+
+                    for (size_t j = 0; j < children.size(); ++j) {
+                        childAtControlRate[j] = plan.controlRates.count(children[j]) > 0;
+                    }
+
+                    rrs.setControlRate(period, plan.controlRateTops.count(nid) > 0, std::move(childAtControlRate), static_cast<size_t>(blockSize));
+                    controlRateNodes.insert(nid);
+                } else if (controlRateNodes.count(nid) > 0) {
+                    rrs.restoreSampleRate(node.get());
+                }
+
+                // Pointwise nodes can take over the buffer of a child that nothing else
+                // reads, so a chain of them collapses onto a single buffer
+                auto const inPlaceChild = findInPlaceChild(node, children, seqIndex, i, owners, lastReader, pinned);
+
+                if (inPlaceChild < children.size()) {
+                    auto const& childId = children[inPlaceChild];
+
+                    rrs.push(node, children, rseq->bufferMap.at(childId));
+                    pinned.insert(childId);
+                } else if (children.size() > 0) {
                     rrs.push(bufferAllocator, node, children);
                 } else {
                     rrs.push(bufferAllocator, node);
                 }
-            });
 
-            rseq->push(std::move(rrs));
+                // Otherwise, the node's output buffer was assigned above, before releasing
+                // any of its children, so that a node never writes into one of its own inputs
+                for (auto const& child : children) {
+                    if (owners.at(child) != seqIndex) {
+                        deps.insert(owners.at(child));
+                        continue;
+                    }
+
+                    if (pinned.count(child) == 0 && lastReader.at(child) == i) {
+                        pendingRelease.push_back(rseq->bufferMap.at(child));
+
+                        // The same child may appear more than once in the list
+                        pinned.insert(child);
+                    }
+                }
+
+                if (loop.subBlockSize > 0 && i + 1 == loop.end) {
+                    rrs.endFeedbackLoop();
+                }
+            }
+
+            rseq->push(std::move(rrs), std::vector<size_t>(deps.begin(), deps.end()));
         }
 
+        rseq->setNumBuffers(bufferAllocator.getNumBuffers());
+        rseq->finalize();
+        ELEM_DBG("[Native] buildRenderSequence " << visited.size() << " nodes, " << bufferAllocator.getNumBuffers() << " buffers");
+
+        traversalCache = std::move(nextTraversals);
+        dirtyNodes.clear();
+        renderSequenceDirty = false;
+
         return rseq;
     }
 
@@ -0,0 +1,512 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Invariant.h"
+
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(__EMSCRIPTEN__)
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+  #define ELEM_HAS_MMAP 1
+#endif
+
+
+namespace elem
+{
+
+    //==============================================================================
+    // Sample streaming plays sample data that lives on disk rather than in memory, for
+    // sample libraries too big to load whole into the SharedResourceMap.
+    //
+    // A stream keeps a short "head" of each sample resident so that a voice can start
+    // playing the moment it is triggered. A background I/O thread reads the rest ahead
+    // of each playing voice into that voice's ring buffer, which the realtime thread
+    // reads from without taking a lock or allocating. If the I/O thread falls behind,
+    // the voice plays silence for the samples it missed and the stream counts an
+    // underrun.
+    //
+    // Playback through a stream is forward only: a voice that moves backwards, or jumps
+    // outside of the data it has buffered, asks the I/O thread to start again from its
+    // new position. Start offsets and loop points that fall within the head are gapless.
+
+    //==============================================================================
+    // Where the data of a stream comes from.
+    //
+    // A backend holds mono samples of FloatType. Its `read` is only ever called from
+    // the I/O thread, or from the non-realtime thread while a stream is created.
+    template <typename FloatType>
+    class SampleStreamBackend
+    {
+    public:
+        virtual ~SampleStreamBackend() = default;
+
+        // The length of the sample, in samples
+        virtual size_t size() const = 0;
+
+        // Copies `numSamples` samples from `offset` into `dest`
+        virtual void read(size_t offset, FloatType* dest, size_t numSamples) = 0;
+
+        // If the whole sample is addressable in memory, as with a memory mapped file,
+        // this returns a pointer to it and voices read from it directly. The I/O thread
+        // then only hints ahead of each voice via `prefetch`.
+        virtual FloatType const* data() const { return nullptr; }
+        virtual void prefetch(size_t /* offset */, size_t /* numSamples */) {}
+    };
+
+    // Reads raw samples from a file with ordinary buffered reads.
+    //
+    // The file holds native endian, mono samples of FloatType, starting at `byteOffset`.
+    // For 32-bit float WAV files, for example, that's the start of the data chunk. A
+    // `numSamples` of zero means everything up to the end of the file.
+    template <typename FloatType>
+    class FileSampleStreamBackend : public SampleStreamBackend<FloatType>
+    {
+    public:
+        FileSampleStreamBackend(std::string const& path, size_t byteOffset = 0, size_t numSamples = 0)
+            : file(path, std::ios::binary), byteOffset(byteOffset)
+        {
+            invariant(file.is_open(), "failed to open the sample file at " + path);
+
+            file.seekg(0, std::ios::end);
+            auto const fileSize = static_cast<size_t>(file.tellg());
+
+            invariant(byteOffset <= fileSize, "sample file byte offset is beyond the end of the file");
+            auto const available = (fileSize - byteOffset) / sizeof(FloatType);
+
+            length = numSamples > 0 ? std::min(numSamples, available) : available;
+        }
+
+        size_t size() const override { return length; }
+
+        void read(size_t offset, FloatType* dest, size_t numSamples) override
+        {
+            file.clear();
+            file.seekg(static_cast<std::streamoff>(byteOffset + offset * sizeof(FloatType)));
+            file.read(reinterpret_cast<char*>(dest), static_cast<std::streamsize>(numSamples * sizeof(FloatType)));
+
+            // A short read leaves silence rather than whatever was in the ring before
+            auto const numRead = static_cast<size_t>(std::max<std::streamsize>(0, file.gcount())) / sizeof(FloatType);
+            std::fill(dest + numRead, dest + numSamples, FloatType(0));
+        }
+
+    private:
+        std::ifstream file;
+        size_t byteOffset = 0;
+        size_t length = 0;
+    };
+
+#if defined(ELEM_HAS_MMAP)
+    // Maps a file of raw samples into memory, in the same layout as FileSampleStreamBackend
+    // expects, and leaves the paging to the operating system.
+    //
+    // This suits samples that the OS page cache can hold, where it avoids both the copy
+    // into a ring and the I/O thread's reads. A voice that reaches a page which isn't
+    // resident yet will fault on the realtime thread, however, so the I/O thread asks
+    // the kernel to read ahead of each voice.
+    template <typename FloatType>
+    class MappedSampleStreamBackend : public SampleStreamBackend<FloatType>
+    {
+    public:
+        MappedSampleStreamBackend(std::string const& path, size_t byteOffset = 0, size_t numSamples = 0)
+        {
+            auto const fd = ::open(path.c_str(), O_RDONLY);
+            invariant(fd >= 0, "failed to open the sample file at " + path);
+
+            struct stat st {};
+            auto const statResult = ::fstat(fd, &st);
+            auto const fileSize = statResult == 0 ? static_cast<size_t>(st.st_size) : size_t(0);
+
+            if (statResult != 0 || byteOffset >= fileSize) {
+                ::close(fd);
+                invariant(false, "failed to read a sample from the file at " + path);
+            }
+
+            mappingSize = fileSize;
+            mapping = ::mmap(nullptr, mappingSize, PROT_READ, MAP_SHARED, fd, 0);
+            ::close(fd);
+
+            invariant(mapping != MAP_FAILED, "failed to map the sample file at " + path);
+
+            auto const available = (fileSize - byteOffset) / sizeof(FloatType);
+
+            samples = reinterpret_cast<FloatType const*>(static_cast<char const*>(mapping) + byteOffset);
+            length = numSamples > 0 ? std::min(numSamples, available) : available;
+        }
+
+        ~MappedSampleStreamBackend() override
+        {
+            ::munmap(mapping, mappingSize);
+        }
+
+        size_t size() const override { return length; }
+
+        void read(size_t offset, FloatType* dest, size_t numSamples) override
+        {
+            std::copy_n(samples + offset, numSamples, dest);
+        }
+
+        FloatType const* data() const override { return samples; }
+
+        void prefetch(size_t offset, size_t numSamples) override
+        {
+            static long const pageSize = ::sysconf(_SC_PAGESIZE);
+
+            auto const begin = reinterpret_cast<uintptr_t>(samples + offset);
+            auto const end = reinterpret_cast<uintptr_t>(samples + std::min(length, offset + numSamples));
+            auto const alignedBegin = begin & ~static_cast<uintptr_t>(pageSize - 1);
+
+            if (end > alignedBegin) {
+                ::madvise(reinterpret_cast<void*>(alignedBegin), end - alignedBegin, MADV_WILLNEED);
+            }
+        }
+
+    private:
+        void* mapping = nullptr;
+        size_t mappingSize = 0;
+
+        FloatType const* samples = nullptr;
+        size_t length = 0;
+    };
+#endif
+
+    template <typename FloatType>
+    class SampleStreamer;
+
+    template <typename FloatType>
+    class SampleStreamVoice;
+
+    //==============================================================================
+    // The data for one stream: its backend and resident head, shared by every voice
+    // that plays it.
+    template <typename FloatType>
+    class SampleStream : public std::enable_shared_from_this<SampleStream<FloatType>>
+    {
+    public:
+        SampleStream(std::unique_ptr<SampleStreamBackend<FloatType>>&& b, size_t preloadSize, size_t bufferSize, SampleStreamer<FloatType>& s)
+            : backend(std::move(b)), streamer(s)
+        {
+            invariant(backend != nullptr, "a sample stream needs a backend");
+
+            head.resize(std::min(preloadSize, backend->size()));
+            backend->read(0, head.data(), head.size());
+
+            // The ring is a power of two so that positions wrap with a mask
+            ringSize = 1;
+
+            while (ringSize < bufferSize)
+                ringSize <<= 1;
+        }
+
+        size_t size() const { return backend->size(); }
+
+        // Creates a new reader of this stream and hands it to the I/O thread. Must be
+        // called on the non-realtime thread, with the stream held by a shared_ptr.
+        std::shared_ptr<SampleStreamVoice<FloatType>> createVoice();
+
+        std::unique_ptr<SampleStreamBackend<FloatType>> backend;
+        std::vector<FloatType> head;
+        size_t ringSize = 0;
+
+        SampleStreamer<FloatType>& streamer;
+    };
+
+    //==============================================================================
+    // The playback state of one reader of a stream.
+    //
+    // The realtime thread owns the read side and the I/O thread the write side. Within
+    // a generation, which begins each time the realtime thread repositions the voice,
+    // the ring holds valid data for every position in [consumePos, fillEnd).
+    template <typename FloatType>
+    class SampleStreamVoice
+    {
+    public:
+        SampleStreamVoice(std::shared_ptr<SampleStream<FloatType>> s)
+            : stream(std::move(s))
+            , mapped(stream->backend->data())
+            , headSize(stream->head.size())
+            , length(stream->size())
+        {
+            if (mapped == nullptr) {
+                ring.resize(stream->ringSize, FloatType(0));
+                mask = ring.size() - 1;
+            }
+
+            consumePos.store(headSize);
+            requestPos.store(headSize);
+            fillEnd.store(headSize);
+
+            localConsumePos = headSize;
+            writerPos = headSize;
+        }
+
+        size_t size() const { return length; }
+
+        //==============================================================================
+        // Realtime thread
+
+        // Returns the sample at `i`, or silence if it isn't available yet
+        FloatType read(size_t i)
+        {
+            if (i < headSize)
+                return stream->head[i];
+
+            if (mapped != nullptr)
+                return mapped[i];
+
+            if (fillGeneration.load(std::memory_order_acquire) == generation && i >= localConsumePos && i < fillEnd.load(std::memory_order_acquire))
+                return ring[i & mask];
+
+            stream->streamer.recordUnderrun();
+            return FloatType(0);
+        }
+
+        // Tells the I/O thread that nothing below `pos` will be read again, until the
+        // next `seek`. Moving backwards repositions the voice.
+        void release(size_t pos)
+        {
+            if (pos < localConsumePos) {
+                return seek(pos);
+            }
+
+            if (pos > localConsumePos) {
+                localConsumePos = pos;
+                consumePos.store(pos, std::memory_order_release);
+            }
+        }
+
+        // Moves the voice to `pos`, keeping what's already buffered if it can
+        void seek(size_t pos)
+        {
+            auto const start = std::max(pos, headSize);
+
+            if (start >= localConsumePos && start < writerEndHint())
+                return release(start);
+
+            localConsumePos = start;
+            consumePos.store(start, std::memory_order_relaxed);
+            requestPos.store(start, std::memory_order_relaxed);
+            requestGeneration.store(++generation, std::memory_order_release);
+        }
+
+        //==============================================================================
+        // I/O thread
+
+        // Reads up to `maxSamples` ahead of the voice, returning the number read
+        size_t fill(size_t maxSamples)
+        {
+            auto& backend = *stream->backend;
+            auto const g = requestGeneration.load(std::memory_order_acquire);
+
+            if (g != writerGeneration) {
+                writerGeneration = g;
+                writerPos = requestPos.load(std::memory_order_relaxed);
+                fillEnd.store(writerPos, std::memory_order_relaxed);
+                fillGeneration.store(g, std::memory_order_release);
+            }
+
+            auto const consumed = consumePos.load(std::memory_order_acquire);
+
+            if (mapped != nullptr) {
+                // Nothing to copy, but keep the pages ahead of the voice warm. This
+                // isn't counted as work, so the thread still sleeps between hints.
+                auto const prefetchSize = stream->ringSize;
+
+                if (!hasPrefetched || consumed < lastPrefetchPos || consumed >= lastPrefetchPos + prefetchSize / 2) {
+                    backend.prefetch(consumed, prefetchSize);
+                    lastPrefetchPos = consumed;
+                    hasPrefetched = true;
+                }
+
+                return 0;
+            }
+
+            // If the voice has run past everything we've read, skip ahead to it. This
+            // claims no new data since the voice never reads below its consume position.
+            if (consumed > writerPos) {
+                writerPos = consumed;
+                fillEnd.store(writerPos, std::memory_order_release);
+            }
+
+            auto const buffered = writerPos - std::min(consumed, writerPos);
+            auto const space = ring.size() - std::min(buffered, ring.size());
+            auto const n = std::min({ space, maxSamples, length - std::min(length, writerPos) });
+
+            if (n == 0)
+                return 0;
+
+            // The ring may wrap in the middle of this read
+            auto const offset = writerPos & mask;
+            auto const first = std::min(n, ring.size() - offset);
+
+            backend.read(writerPos, ring.data() + offset, first);
+
+            if (first < n)
+                backend.read(writerPos + first, ring.data(), n - first);
+
+            writerPos += n;
+            fillEnd.store(writerPos, std::memory_order_release);
+
+            return n;
+        }
+
+    private:
+        // A conservative view of how far the I/O thread has buffered for the current
+        // generation, used to avoid repositioning when a seek lands in buffered data
+        size_t writerEndHint() const
+        {
+            if (mapped != nullptr)
+                return length;
+
+            if (fillGeneration.load(std::memory_order_acquire) != generation)
+                return 0;
+
+            return fillEnd.load(std::memory_order_acquire);
+        }
+
+        std::shared_ptr<SampleStream<FloatType>> stream;
+        FloatType const* mapped = nullptr;
+        size_t headSize = 0;
+        size_t length = 0;
+
+        std::vector<FloatType> ring;
+        size_t mask = 0;
+
+        // Written by the realtime thread
+        std::atomic<uint32_t> requestGeneration = 0;
+        std::atomic<size_t> requestPos = 0;
+        std::atomic<size_t> consumePos = 0;
+
+        // Written by the I/O thread
+        std::atomic<uint32_t> fillGeneration = 0;
+        std::atomic<size_t> fillEnd = 0;
+
+        // Only touched by the realtime thread
+        uint32_t generation = 0;
+        size_t localConsumePos = 0;
+
+        // Only touched by the I/O thread
+        uint32_t writerGeneration = 0;
+        size_t writerPos = 0;
+        size_t lastPrefetchPos = 0;
+        bool hasPrefetched = false;
+    };
+
+    template <typename FloatType>
+    std::shared_ptr<SampleStreamVoice<FloatType>> SampleStream<FloatType>::createVoice()
+    {
+        auto voice = std::make_shared<SampleStreamVoice<FloatType>>(this->shared_from_this());
+        streamer.addVoice(voice);
+        return voice;
+    }
+
+    //==============================================================================
+    // The background I/O thread that keeps every voice's ring topped up.
+    //
+    // New voices are handed to the thread through a locked inbox on the non-realtime
+    // thread. The I/O thread then holds on to each voice until it holds the last
+    // reference, so a voice is always freed on the I/O thread and never on the
+    // realtime thread.
+    template <typename FloatType>
+    class SampleStreamer
+    {
+    public:
+        // The most the I/O thread reads for one voice before moving on to the next
+        static constexpr size_t kReadChunkSize = 8192;
+
+        SampleStreamer()
+            : thread([this]() { run(); })
+        {
+        }
+
+        ~SampleStreamer()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                shouldExit = true;
+            }
+
+            cv.notify_one();
+            thread.join();
+        }
+
+        void addVoice(std::shared_ptr<SampleStreamVoice<FloatType>> const& voice)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                inbox.push_back(voice);
+            }
+
+            cv.notify_one();
+        }
+
+        void recordUnderrun()
+        {
+            numUnderruns.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // The number of samples that voices have had to play as silence because the
+        // I/O thread hadn't read them yet
+        uint64_t getNumUnderruns() const
+        {
+            return numUnderruns.load(std::memory_order_relaxed);
+        }
+
+    private:
+        void run()
+        {
+            std::vector<std::shared_ptr<SampleStreamVoice<FloatType>>> voices;
+
+            while (true) {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+
+                    if (shouldExit)
+                        break;
+
+                    std::move(inbox.begin(), inbox.end(), std::back_inserter(voices));
+                    inbox.clear();
+                }
+
+                // Drop the voices whose readers have gone away
+                voices.erase(std::remove_if(voices.begin(), voices.end(), [](auto const& v) {
+                    return v.use_count() == 1;
+                }), voices.end());
+
+                size_t numRead = 0;
+
+                for (auto& v : voices) {
+                    numRead += v->fill(kReadChunkSize);
+                }
+
+                // Only sleep when nobody needs anything, otherwise carry on reading
+                if (numRead == 0) {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    cv.wait_for(lock, std::chrono::milliseconds(1), [this]() { return shouldExit || !inbox.empty(); });
+                }
+            }
+        }
+
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::vector<std::shared_ptr<SampleStreamVoice<FloatType>>> inbox;
+        bool shouldExit = false;
+
+        std::atomic<uint64_t> numUnderruns = 0;
+
+        std::thread thread;
+    };
+
+} // namespace elem
@@ -1,6 +1,8 @@
 #pragma once
 
-#include <optional>
+#include <atomic>
+#include <cstddef>
+#include <vector>
 
 #include "ElemAssert.h"
 
@@ -10,13 +12,18 @@ namespace elem
 
     //==============================================================================
     // This is a simple lock-free single producer, single consumer queue.
+    //
+    // A queue of capacity n holds up to n - 1 elements. The read and write positions
+    // live on separate cache lines, and each side keeps a cached copy of the other side's
+    // position so that it only touches the other side's cache line when its cached
+    // copy says the queue is full (for the writer) or empty (for the reader).
     template <typename T>
     class SingleWriterSingleReaderQueue
     {
     public:
         //==============================================================================
         SingleWriterSingleReaderQueue(size_t capacity = 32)
-            : maxElements(capacity), indexMask(capacity - 1)
+            : indexMask(capacity - 1)
         {
             // We need the queue length to be non-zero and a power of two so
             // that our bit masking trick will work. Enforce that here with
@@ -28,96 +35,147 @@ namespace elem
         ~SingleWriterSingleReaderQueue() = default;
 
         //==============================================================================
+        // Writer side
         bool push (T && el)
         {
-            auto const w = writePos.load();
-            auto const r = readPos.load();
+            auto const w = writer.pos.load(std::memory_order_relaxed);
 
-            if (numFreeSlots(r, w) > 0)
+            if (numFreeSlots(writer.cachedOtherPos, w) == 0)
             {
-                queue[w] = std::move(el);
-                auto const desiredWritePosition = (w + 1u) & indexMask;
-                writePos.store(desiredWritePosition);
-                return true;
+                writer.cachedOtherPos = reader.pos.load(std::memory_order_acquire);
+
+                if (numFreeSlots(writer.cachedOtherPos, w) == 0)
+                    return false;
             }
 
-            return false;
+            queue[w] = std::move(el);
+            writer.pos.store((w + 1u) & indexMask, std::memory_order_release);
+            return true;
         }
 
+        // Pushes all of the given elements, or none of them if there isn't room
         bool push (std::vector<T>& els)
         {
-            auto const w = writePos.load();
-            auto const r = readPos.load();
+            auto const w = writer.pos.load(std::memory_order_relaxed);
 
-            if (els.size() >= numFreeSlots(r, w))
-                return false;
+            if (numFreeSlots(writer.cachedOtherPos, w) < els.size())
+            {
+                writer.cachedOtherPos = reader.pos.load(std::memory_order_acquire);
+
+                if (numFreeSlots(writer.cachedOtherPos, w) < els.size())
+                    return false;
+            }
 
             for (size_t i = 0; i < els.size(); ++i)
                 queue[(w + i) & indexMask] = std::move(els[i]);
 
-            auto const desiredWritePosition = (w + els.size()) & indexMask;
-            writePos.store(desiredWritePosition);
+            writer.pos.store((w + els.size()) & indexMask, std::memory_order_release);
             return true;
         }
 
+        //==============================================================================
+        // Reader side
         bool pop (T& el)
         {
-            auto const r = readPos.load();
-            auto const w = writePos.load();
+            auto const r = reader.pos.load(std::memory_order_relaxed);
 
-            if (numFullSlots(r, w) > 0)
+            if (numFullSlots(r, reader.cachedOtherPos) == 0)
             {
-                el = std::move(queue[r]);
-                auto const desiredReadPosition = (r + 1u) & indexMask;
-                readPos.store(desiredReadPosition);
-                return true;
+                reader.cachedOtherPos = writer.pos.load(std::memory_order_acquire);
+
+                if (numFullSlots(r, reader.cachedOtherPos) == 0)
+                    return false;
             }
 
-            return false;
+            el = std::move(queue[r]);
+            reader.pos.store((r + 1u) & indexMask, std::memory_order_release);
+            return true;
         }
 
+        // Empties the queue, moving only the most recently pushed element into `el`, and
+        // returns whether there was anything to pop.
+        //
+        // This suits the common case of a reader which only cares about the latest value.
+        // The elements skipped over are reset here, so that a slot never keeps what it held
+        // alive after it's been popped. Those are then destroyed on the reading thread, so
+        // a writer whose elements may hold the last reference to anything costly to free
+        // should have the reader `pop` them one at a time and hand them back instead.
+        bool popAll (T& el)
+        {
+            auto const r = reader.pos.load(std::memory_order_relaxed);
+            auto const w = writer.pos.load(std::memory_order_acquire);
+            auto const n = numFullSlots(r, w);
+
+            reader.cachedOtherPos = w;
+
+            if (n == 0)
+                return false;
+
+            for (size_t i = 0; i + 1 < n; ++i)
+                queue[(r + i) & indexMask] = T();
+
+            el = std::move(queue[(w - 1u) & indexMask]);
+            queue[(w - 1u) & indexMask] = T();
+
+            reader.pos.store(w, std::memory_order_release);
+            return true;
+        }
+
+        // Calls `fn` with a reference to each element currently in the queue, in order,
+        // and then marks them all as consumed at once. Returns the number of elements
+        // consumed.
+        template <typename Fn>
+        size_t consume (Fn&& fn)
+        {
+            auto const r = reader.pos.load(std::memory_order_relaxed);
+            auto const w = writer.pos.load(std::memory_order_acquire);
+            auto const n = numFullSlots(r, w);
+
+            reader.cachedOtherPos = w;
+
+            for (size_t i = 0; i < n; ++i)
+                fn(queue[(r + i) & indexMask]);
+
+            if (n > 0)
+                reader.pos.store(w, std::memory_order_release);
+
+            return n;
+        }
+
+        //==============================================================================
+        // May be called from either side, though the result is only a snapshot
         size_t size()
         {
-            auto const r = readPos.load();
-            auto const w = writePos.load();
+            auto const r = reader.pos.load(std::memory_order_acquire);
+            auto const w = writer.pos.load(std::memory_order_acquire);
 
             return numFullSlots(r, w);
         }
 
     private:
-        size_t numFullSlots(size_t const r, size_t const w)
+        size_t numFullSlots(size_t const r, size_t const w) const
         {
-            // If the writer is ahead of the reader, then the full slots are
-            // the ones ahead of the reader and behind the writer.
-            if (w > r)
-                return w - r;
-
-            // Else, the writer has already wrapped around, so the free space is
-            // what's ahead of the writer and behind the reader, and the full space
-            // is what's left.
-            return (maxElements - (r - w)) & indexMask;
+            return (w - r) & indexMask;
         }
 
-        size_t numFreeSlots(size_t const r, size_t const w)
+        size_t numFreeSlots(size_t const r, size_t const w) const
         {
-            // If the reader is ahead of the writer, then the writer must have
-            // wrapped around already, so the only space available is whats ahead
-            // of the writer, behind the reader.
-            if (r > w)
-                return r - w;
-
-            // Else, the only full slots are ahead of the reader and behind the
-            // writer, so the free slots are what's left.
-            return maxElements - (w - r);
+            // One slot always stays empty so that a full queue can be told apart
+            // from an empty one
+            return indexMask - numFullSlots(r, w);
         }
 
-        std::atomic<size_t> maxElements = 0;
-        std::atomic<size_t> readPos = 0;
-        std::atomic<size_t> writePos = 0;
-        std::vector<T> queue;
+        // Each side's position, along with that side's cached copy of the other's
+        struct alignas(64) Position {
+            std::atomic<size_t> pos = 0;
+            size_t cachedOtherPos = 0;
+        };
 
         size_t indexMask = 0;
+        std::vector<T> queue;
+
+        Position writer;
+        Position reader;
     };
 
 } // namespace elem
-
@@ -1,8 +1,15 @@
 #pragma once
 
+#include <algorithm>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <sstream>
+#include <string>
 #include <unordered_map>
+#include <vector>
+
+#include "Invariant.h"
 
 
 namespace elem
@@ -37,58 +44,359 @@ namespace elem
         FloatType* outputData;
         size_t numSamples;
         void* userData;
+
+        // Optional hints for skipping redundant work. When non-null, `inputIsConstant[i]`
+        // is true if every sample of `inputData[i]` in this block equals its first sample.
+        // A node may likewise set `*outputIsConstant` to report the same of its own output,
+        // which is reset to false before each block. Either way, every input buffer is fully
+        // written, so nodes which ignore these hints see no difference.
+        bool const* inputIsConstant = nullptr;
+        bool* outputIsConstant = nullptr;
+
+        bool isInputConstant(size_t i) const {
+            return inputIsConstant != nullptr && inputIsConstant[i];
+        }
+
+        void markOutputConstant() const {
+            if (outputIsConstant != nullptr) {
+                *outputIsConstant = true;
+            }
+        }
     };
 
     //==============================================================================
+    // A block of sample data that nodes can share by name through the SharedResourceMap,
+    // such as a decoded sample or an impulse response, with one or more channels.
+    //
+    // A resource never changes once made. It can either copy the data it's given, adopt
+    // a vector without copying, or borrow memory that the caller owns, in which case
+    // the caller's release function runs once nothing refers to the resource anymore.
+    // The SharedResourceMap makes sure that happens on the non-realtime thread.
+    //
+    // Multichannel data may be planar, one channel after another, or interleaved. In
+    // either case it's read in place, through a view of each channel with a stride.
     template <typename FloatType>
-    using SharedResourceBuffer = std::shared_ptr<std::vector<FloatType> const>;
+    class SharedResource
+    {
+    public:
+        //==============================================================================
+        enum class Layout { Planar, Interleaved };
+
+        using ReleaseFn = std::function<void()>;
+
+        // A view of one channel of a resource. Interleaved channels have a stride of the
+        // number of channels; planar ones are contiguous.
+        struct Channel {
+            FloatType const* data = nullptr;
+            size_t stride = 1;
+            size_t size = 0;
+
+            FloatType operator[] (size_t i) const { return data[i * stride]; }
+            bool isContiguous() const { return stride == 1; }
+        };
+
+        //==============================================================================
+        // Copies `numFrames` frames of `numChannels` channels
+        static std::shared_ptr<SharedResource const> copy(FloatType const* data, size_t numFrames, size_t numChannels = 1, Layout layout = Layout::Planar)
+        {
+            return adopt(std::vector<FloatType>(data, data + numFrames * numChannels), numChannels, layout);
+        }
+
+        // Takes ownership of the given data without copying it
+        static std::shared_ptr<SharedResource const> adopt(std::vector<FloatType>&& data, size_t numChannels = 1, Layout layout = Layout::Planar)
+        {
+            invariant(numChannels > 0 && data.size() % numChannels == 0, "resource data must hold a whole number of frames");
+
+            auto r = std::shared_ptr<SharedResource>(new SharedResource());
+            r->setChannels(data.data(), data.size() / numChannels, numChannels, layout);
+            r->storage.push_back(std::move(data));
+            return r;
+        }
+
+        // Takes ownership of one vector per channel, all of the same length, without copying
+        static std::shared_ptr<SharedResource const> adopt(std::vector<std::vector<FloatType>>&& channelData)
+        {
+            invariant(!channelData.empty(), "a resource needs at least one channel");
+
+            auto r = std::shared_ptr<SharedResource>(new SharedResource());
+            r->numFrames = channelData[0].size();
+
+            for (auto const& c : channelData) {
+                invariant(c.size() == r->numFrames, "every channel of a resource must be the same length");
+                r->channels.push_back({c.data(), 1, c.size()});
+            }
+
+            r->storage = std::move(channelData);
+            return r;
+        }
+
+        // References memory owned by the caller, which must stay valid until `release` is
+        // called. That happens once neither the resource map nor any node refers to the
+        // resource, on the non-realtime thread.
+        static std::shared_ptr<SharedResource const> borrow(FloatType const* data, size_t numFrames, size_t numChannels, Layout layout, ReleaseFn&& release)
+        {
+            invariant(numChannels > 0, "a resource needs at least one channel");
+
+            auto r = std::shared_ptr<SharedResource>(new SharedResource());
+            r->setChannels(data, numFrames, numChannels, layout);
+            r->release = std::move(release);
+            return r;
+        }
+
+        ~SharedResource()
+        {
+            if (release) {
+                release();
+            }
+        }
+
+        //==============================================================================
+        size_t getNumChannels() const { return channels.size(); }
+        size_t getNumFrames() const { return numFrames; }
+
+        Channel const& getChannel(size_t i) const { return channels[i]; }
+
+    private:
+        SharedResource() = default;
+
+        void setChannels(FloatType const* data, size_t frames, size_t numChannels, Layout layout)
+        {
+            numFrames = frames;
+
+            for (size_t i = 0; i < numChannels; ++i) {
+                if (layout == Layout::Interleaved) {
+                    channels.push_back({data + i, numChannels, frames});
+                } else {
+                    channels.push_back({data + i * frames, 1, frames});
+                }
+            }
+        }
+
+        std::vector<std::vector<FloatType>> storage;
+        std::vector<Channel> channels;
+        size_t numFrames = 0;
+        ReleaseFn release;
+    };
+
+    template <typename FloatType>
+    using SharedResourceBuffer = std::shared_ptr<SharedResource<FloatType> const>;
 
     template <typename FloatType>
     using MutableSharedResourceBuffer = std::shared_ptr<std::vector<FloatType>>;
 
+    template <typename FloatType>
+    class SampleStream;
+
+    template <typename FloatType>
+    using SharedSampleStream = std::shared_ptr<SampleStream<FloatType>>;
+
+    //==============================================================================
+    // A store of immutable resources shared by many runtimes, such as a sample library
+    // which every session on a server plays from, so that each resource is held in
+    // memory once. See Engine.h.
+    //
+    // A SharedResourceMap given a store falls back to it for any resource it doesn't
+    // hold itself. The store may be used from the non-realtime threads of any number of
+    // runtimes at once, and takes a lock to do so; it's never touched by a realtime thread.
+    template <typename FloatType>
+    class SharedResourceStore {
+    public:
+        //==============================================================================
+        SharedResourceStore() = default;
+
+        // Adds a resource, replacing any by the same name. As with the SharedResourceMap,
+        // a replaced resource is kept until no runtime refers to it.
+        void insert(std::string const& p, SharedResourceBuffer<FloatType>&& srb) {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            if (auto it = imms.find(p); it != imms.end()) {
+                retired.push_back(std::move(it->second));
+                imms.erase(it);
+            }
+
+            imms.emplace(p, std::move(srb));
+        }
+
+        void remove(std::string const& p) {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            if (auto it = imms.find(p); it != imms.end()) {
+                retired.push_back(std::move(it->second));
+                imms.erase(it);
+            }
+        }
+
+        // Returns the named resource, or nullptr if there is none
+        SharedResourceBuffer<FloatType> find(std::string const& p) const {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            auto it = imms.find(p);
+            return (it != imms.end()) ? it->second : nullptr;
+        }
+
+        std::vector<std::string> keys() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::vector<std::string> ks;
+
+            for (auto const& [k, v] : imms) {
+                ks.push_back(k);
+            }
+
+            return ks;
+        }
+
+        // Frees the replaced and removed resources which no runtime refers to any more,
+        // returning how many were freed. Any release callbacks run here.
+        size_t releaseRetired() {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto const before = retired.size();
+
+            retired.erase(std::remove_if(retired.begin(), retired.end(), [](auto const& r) {
+                return r.use_count() == 1;
+            }), retired.end());
+
+            return before - retired.size();
+        }
+
+    private:
+        mutable std::mutex mutex;
+        std::unordered_map<std::string, SharedResourceBuffer<FloatType>> imms;
+        std::vector<SharedResourceBuffer<FloatType>> retired;
+    };
+
     template <typename FloatType>
     class SharedResourceMap {
     public:
         //==============================================================================
         SharedResourceMap() = default;
 
+        // Sets a store of resources to fall back to for any name this map doesn't hold,
+        // see SharedResourceStore
+        void setStore(std::shared_ptr<SharedResourceStore<FloatType>> s) { store = std::move(s); }
+
         //==============================================================================
         // Accessor methods for immutable resources
         void insert(std::string const& p, SharedResourceBuffer<FloatType>&& srb);
         bool has(std::string const& p);
-        SharedResourceBuffer<FloatType> const& get(std::string const& p);
+        SharedResourceBuffer<FloatType> get(std::string const& p);
+
+        // Removes the named resource from the map. Nodes already playing it keep it
+        // until they move on, and it's then freed by `releaseRetired`.
+        void remove(std::string const& p);
+
+        // Removes every resource which no node refers to, returning how many were removed
+        size_t prune();
+
+        // Frees resources which were replaced or removed while nodes still held them, once
+        // those nodes have let go. Any release callbacks run here.
+        void releaseRetired();
+
+        std::vector<std::string> keys() const;
 
         //==============================================================================
         // Accessor methods for mutable resources
         MutableSharedResourceBuffer<FloatType> const& getOrCreateMutable(std::string const& p, size_t blockSize);
 
+        //==============================================================================
+        // Accessor methods for sample streams, which are read from disk during playback
+        // rather than held in memory. See SampleStream.h.
+        void insertStream(std::string const& p, SharedSampleStream<FloatType>&& stream);
+        bool hasStream(std::string const& p);
+        SharedSampleStream<FloatType> const& getStream(std::string const& p);
+
     private:
         std::unordered_map<std::string, SharedResourceBuffer<FloatType>> imms;
         std::unordered_map<std::string, MutableSharedResourceBuffer<FloatType>> muts;
+        std::unordered_map<std::string, SharedSampleStream<FloatType>> streams;
+
+        // Resources which have left the map but may still be held on the realtime thread
+        std::vector<SharedResourceBuffer<FloatType>> retired;
+
+        std::shared_ptr<SharedResourceStore<FloatType>> store;
     };
 
     //==============================================================================
     // Details...
     template <typename FloatType>
     void SharedResourceMap<FloatType>::insert (std::string const& p, SharedResourceBuffer<FloatType>&& srb) {
-        // TODO: This is risky. In the case that a key is already present and we assign to it, it could be
-        // that there's a realtime node somewhere who is also holding a shared_ptr to the existing resource.
-        // If the resource map then drops its reference, it may leave the realtime node holding the last one,
-        // in which case a dealloc there could cause memory troubles on the realtime thread.
-        //
-        // Is there any reason not to enforce that this map is itself immutable? I.e. you can only ever add to it, you can't
-        // change existing entries? That would give the guarantees we need here.
-        imms.insert_or_assign(p, std::move(srb));
+        // A realtime node may still hold the resource we're replacing, and if we dropped
+        // our reference here it could be left holding the last one, and free it on the
+        // realtime thread. So the old resource waits in `retired` until it's unused.
+        remove(p);
+        imms.emplace(p, std::move(srb));
     }
 
     template <typename FloatType>
     bool SharedResourceMap<FloatType>::has (std::string const& p) {
-        return imms.count(p) > 0;
+        return imms.count(p) > 0 || (store != nullptr && store->find(p) != nullptr);
     }
 
     template <typename FloatType>
-    SharedResourceBuffer<FloatType> const& SharedResourceMap<FloatType>::get (std::string const& p) {
-        return imms.at(p);
+    SharedResourceBuffer<FloatType> SharedResourceMap<FloatType>::get (std::string const& p) {
+        if (auto it = imms.find(p); it != imms.end() || store == nullptr) {
+            return imms.at(p);
+        }
+
+        // Our own resources shadow those of the store
+        auto srb = store->find(p);
+        invariant(srb != nullptr, "failed to find a resource at the given path");
+
+        return srb;
+    }
+
+    template <typename FloatType>
+    void SharedResourceMap<FloatType>::remove (std::string const& p) {
+        auto it = imms.find(p);
+
+        if (it != imms.end()) {
+            retired.push_back(std::move(it->second));
+            imms.erase(it);
+        }
+    }
+
+    template <typename FloatType>
+    size_t SharedResourceMap<FloatType>::prune () {
+        size_t numRemoved = 0;
+
+        // Only the realtime thread's copies could be keeping a count above one, and it can
+        // only get new ones from this thread, so a count of one can't go back up
+        for (auto it = imms.begin(); it != imms.end();) {
+            if (it->second.use_count() == 1) {
+                it = imms.erase(it);
+                numRemoved++;
+            } else {
+                it++;
+            }
+        }
+
+        releaseRetired();
+        return numRemoved;
+    }
+
+    template <typename FloatType>
+    void SharedResourceMap<FloatType>::releaseRetired () {
+        retired.erase(std::remove_if(retired.begin(), retired.end(), [](auto const& r) {
+            return r.use_count() == 1;
+        }), retired.end());
+    }
+
+    template <typename FloatType>
+    std::vector<std::string> SharedResourceMap<FloatType>::keys () const {
+        std::vector<std::string> ks;
+
+        for (auto const& [k, v] : imms) {
+            ks.push_back(k);
+        }
+
+        if (store != nullptr) {
+            for (auto& k : store->keys()) {
+                if (imms.count(k) == 0) {
+                    ks.push_back(std::move(k));
+                }
+            }
+        }
+
+        return ks;
     }
 
     template <typename FloatType>
@@ -102,4 +410,21 @@ namespace elem
         return muts.at(p);
     }
 
+    template <typename FloatType>
+    void SharedResourceMap<FloatType>::insertStream (std::string const& p, SharedSampleStream<FloatType>&& stream) {
+        // Replacing a stream is safe where replacing a buffer isn't: every reader of the
+        // old stream holds it through a voice, which the I/O thread frees
+        streams.insert_or_assign(p, std::move(stream));
+    }
+
+    template <typename FloatType>
+    bool SharedResourceMap<FloatType>::hasStream (std::string const& p) {
+        return streams.count(p) > 0;
+    }
+
+    template <typename FloatType>
+    SharedSampleStream<FloatType> const& SharedResourceMap<FloatType>::getStream (std::string const& p) {
+        return streams.at(p);
+    }
+
 } // namespace elem
@@ -93,6 +93,7 @@ namespace js
         operator Array()    const { return mpark::get<Array>(var); }
 
         // Object value getters
+        String const& getString()               const { return mpark::get<String>(var); }
         Array const& getArray()                 const { return mpark::get<Array>(var); }
         Float32Array const& getFloat32Array()   const { return mpark::get<Float32Array>(var); }
         Object const& getObject()               const { return mpark::get<Object>(var); }
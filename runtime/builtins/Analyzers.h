@@ -7,6 +7,8 @@
 #include "../SingleWriterSingleReaderQueue.h"
 #include "../MultiChannelRingBuffer.h"
 
+#include "helpers/TypedEvents.h"
+
 
 namespace elem
 {
@@ -18,8 +20,13 @@ namespace elem
     //
     // Helpful for metering audio streams for things like drawing gain meters.
     template <typename FloatType>
-    struct MeterNode : public GraphNode<FloatType> {
-        using GraphNode<FloatType>::GraphNode;
+    struct MeterNode : public TypedEventNode<FloatType> {
+        MeterNode(NodeId id, FloatType const sr, int const blockSize)
+            : TypedEventNode<FloatType>::TypedEventNode(id, sr, blockSize)
+        {
+            GraphNode<FloatType>::bindProperty("name", name);
+            GraphNode<FloatType>::enableEventNotifications();
+        }
 
         void process (BlockContext<FloatType> const& ctx) override {
             auto** inputData = ctx.inputData;
@@ -38,28 +45,22 @@ namespace elem
             // Report the maximum value this block
             auto const [min, max] = std::minmax_element(inputData[0], inputData[0] + numSamples);
             (void) readoutQueue.push({ *min, *max });
+            GraphNode<FloatType>::notifyEventsPending();
         }
 
-        void processEvents(std::function<void(std::string const&, js::Value)>& eventHandler) override {
-            if (readoutQueue.size() <= 0)
-                return;
-
+        void processEvents(EventBuffer& events) override {
             // Clear the readoutQueue into a local struct here. This way the readout
             // we propagate is the latest one and empties the queue for the processing thread
             ValueReadout ro;
 
-            while (readoutQueue.size() > 0) {
-                if (!readoutQueue.pop(ro)) {
-                    return;
-                }
-            }
+            if (!readoutQueue.popAll(ro))
+                return;
 
             // Now we propagate the latest value
-            eventHandler("meter", js::Object({
-                {"min", ro.min},
-                {"max", ro.max},
-                {"source", GraphNode<FloatType>::getPropertyWithDefault("name", js::Value())},
-            }));
+            auto& e = events.push(EventType::Meter, GraphNode<FloatType>::getId(), name);
+
+            e.values[0] = ro.min;
+            e.values[1] = ro.max;
         }
 
         struct ValueReadout {
@@ -68,6 +69,7 @@ namespace elem
         };
 
         SingleWriterSingleReaderQueue<ValueReadout> readoutQueue;
+        js::Value name;
     };
 
     // A simple value metering node whose callback is triggered on the rising
@@ -76,8 +78,13 @@ namespace elem
     // Will pass its input through unaffected, but report the value captured at
     // exactly the time of the rising edge.
     template <typename FloatType>
-    struct SnapshotNode : public GraphNode<FloatType> {
-        using GraphNode<FloatType>::GraphNode;
+    struct SnapshotNode : public TypedEventNode<FloatType> {
+        SnapshotNode(NodeId id, FloatType const sr, int const blockSize)
+            : TypedEventNode<FloatType>::TypedEventNode(id, sr, blockSize)
+        {
+            GraphNode<FloatType>::bindProperty("name", name);
+            GraphNode<FloatType>::enableEventNotifications();
+        }
 
         void process (BlockContext<FloatType> const& ctx) override {
             auto** inputData = ctx.inputData;
@@ -102,6 +109,7 @@ namespace elem
                 // value.
                 if (std::abs(z) <= eps && l > eps) {
                     (void) readoutQueue.push({ x });
+                    GraphNode<FloatType>::notifyEventsPending();
                 }
 
                 z = l;
@@ -109,25 +117,16 @@ namespace elem
             }
         }
 
-        void processEvents(std::function<void(std::string const&, js::Value)>& eventHandler) override {
-            // Now we propagate the latest value if we have one.
-            if (readoutQueue.size() <= 0)
-                return;
-
+        void processEvents(EventBuffer& events) override {
             // Clear the readoutQueue into a local struct here. This way the readout
             // we propagate is the latest one and empties the queue for the processing thread
             ValueReadout ro;
 
-            while (readoutQueue.size() > 0) {
-                if (!readoutQueue.pop(ro)) {
-                    return;
-                }
-            }
+            // Now we propagate the latest value if we have one.
+            if (!readoutQueue.popAll(ro))
+                return;
 
-            eventHandler("snapshot", js::Object({
-                {"source", GraphNode<FloatType>::getPropertyWithDefault("name", js::Value())},
-                {"data", ro.val},
-            }));
+            events.push(EventType::Snapshot, GraphNode<FloatType>::getId(), name).values[0] = ro.val;
         }
 
         struct ValueReadout {
@@ -136,6 +135,7 @@ namespace elem
 
         SingleWriterSingleReaderQueue<ValueReadout> readoutQueue;
         FloatType z = 0;
+        js::Value name;
     };
 
     // An oscilloscope node which reports Float32Array buffers through
@@ -144,11 +144,16 @@ namespace elem
     // Expecting potentially n > 1 children, will assemble an array of arrays representing each
     // child's buffer, so that we have coordinated streams
     template <typename FloatType>
-    struct ScopeNode : public GraphNode<FloatType> {
+    struct ScopeNode : public TypedEventNode<FloatType> {
         ScopeNode(NodeId id, FloatType const sr, int const blockSize)
-            : GraphNode<FloatType>::GraphNode(id, sr, blockSize)
+            : TypedEventNode<FloatType>::TypedEventNode(id, sr, blockSize)
             , ringBuffer(4)
         {
+            GraphNode<FloatType>::bindProperty("size", size);
+            GraphNode<FloatType>::bindProperty("channels", channels);
+            GraphNode<FloatType>::bindProperty("name", name);
+            GraphNode<FloatType>::enableEventNotifications();
+
             setProperty("channels", js::Value((js::Number) 1));
             setProperty("size", js::Value((js::Number) 512));
         }
@@ -192,64 +197,57 @@ namespace elem
 
             // Fill our ring buffer
             ringBuffer.write(inputData, numChannels, numSamples);
+            GraphNode<FloatType>::notifyEventsPending();
         }
 
-        void processEvents(std::function<void(std::string const&, js::Value)>& eventHandler) override {
-            auto const size = static_cast<size_t>((js::Number) GraphNode<FloatType>::getPropertyWithDefault("size", js::Number(512)));
-            auto const channels = static_cast<size_t>((js::Number) GraphNode<FloatType>::getPropertyWithDefault("channels", js::Number(1)));
-
-            if (ringBuffer.size() > size) {
-                // Retreive the scope data. Could improve the efficiency here using something
-                // like a pmr pool allocator so that on each call to processEvents here we're
-                // not actually allocating and deallocating new memory
-                js::Array scopeData (channels);
-
-                // If our ScopeNode instance is templated on `float` then we can read from the
-                // ring buffer directly into a js::Float32Array value type
-                if constexpr (std::is_same_v<FloatType, float>) {
-                    for (size_t i = 0; i < channels; ++i) {
-                        scopeData[i] = js::Float32Array(size);
-                        scratchPointers[i] = scopeData[i].getFloat32Array().data();
-                    }
+        void processEvents(EventBuffer& events) override {
+            auto const size = static_cast<size_t>(this->size);
+            auto const channels = static_cast<size_t>(this->channels);
 
-                    if (ringBuffer.read(scratchPointers.data(), channels, size)) {
-                        eventHandler("scope", js::Object({
-                            {"source", GraphNode<FloatType>::getPropertyWithDefault("name", js::Value())},
-                            {"data", std::move(scopeData)}
-                        }));
-                    }
+            if (ringBuffer.size() <= size)
+                return;
+
+            // If our ScopeNode instance is templated on `float` then we can read from the
+            // ring buffer directly into the event's frames
+            if constexpr (std::is_same_v<FloatType, float>) {
+                auto* frames = events.pushFrames(EventType::Scope, GraphNode<FloatType>::getId(), name, channels, size);
+
+                for (size_t i = 0; i < channels; ++i) {
+                    scratchPointers[i] = frames + (i * size);
                 }
 
-                // If our ScopeNode instance is templated on `double` then we read into a temporary
-                // vector of doubles before copying (and casting) to a js::Float32Array value
-                if constexpr (std::is_same_v<FloatType, double>) {
-                    std::vector<double> temp(channels * size);
+                if (!ringBuffer.read(scratchPointers.data(), channels, size)) {
+                    events.pop();
+                }
+            }
 
-                    for (size_t i = 0; i < channels; ++i) {
-                        scopeData[i] = js::Float32Array(size);
-                        scratchPointers[i] = temp.data() + (i * size);
-                    }
+            // Otherwise we read into a scratch buffer, which we keep between calls, before
+            // copying (and casting) into the event's frames
+            if constexpr (!std::is_same_v<FloatType, float>) {
+                scratchData.resize(channels * size);
 
-                    if (ringBuffer.read(scratchPointers.data(), channels, size)) {
-                        for (size_t i = 0; i < channels; ++i) {
-                            auto* dest = scopeData[i].getFloat32Array().data();
+                for (size_t i = 0; i < channels; ++i) {
+                    scratchPointers[i] = scratchData.data() + (i * size);
+                }
 
-                            for (size_t j = 0; j < size; ++j) {
-                                dest[j] = static_cast<float>(temp[(i * size) + j]);
-                            }
-                        }
+                if (ringBuffer.read(scratchPointers.data(), channels, size)) {
+                    auto* frames = events.pushFrames(EventType::Scope, GraphNode<FloatType>::getId(), name, channels, size);
 
-                        eventHandler("scope", js::Object({
-                            {"source", GraphNode<FloatType>::getPropertyWithDefault("name", js::Value())},
-                            {"data", std::move(scopeData)}
-                        }));
+                    for (size_t i = 0; i < channels * size; ++i) {
+                        frames[i] = static_cast<float>(scratchData[i]);
                     }
                 }
             }
         }
 
+        std::vector<FloatType> scratchData;
         std::array<FloatType*, 8> scratchPointers;
         MultiChannelRingBuffer<FloatType> ringBuffer;
+
+        // Bound to the node's props
+        js::Number size = 512;
+        js::Number channels = 1;
+        js::Value name;
     };
 
 } // namespace elem
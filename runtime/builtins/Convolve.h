@@ -0,0 +1,136 @@
+#pragma once
+
+#include "../GraphNode.h"
+#include "../Invariant.h"
+#include "../SingleWriterSingleReaderQueue.h"
+
+#include "helpers/Convolver.h"
+
+
+namespace elem
+{
+
+    // Convolves its input with an impulse response from the shared resource map, given
+    // by the `path` prop, without adding latency.
+    //
+    // The response is split into a head convolved in partitions of `headSize` samples and
+    // a tail in partitions of `tailSize` samples, 512 and 4096 by default, and the bulk
+    // of a long tail is convolved on a background thread. See TwoStageConvolver. Smaller
+    // partitions spread the work more evenly over each block at a higher total cost.
+    //
+    // The convolver is rebuilt, on the non-realtime thread, whenever any of these props
+    // change. Changing the response while playing will cause a discontinuity.
+    template <typename FloatType>
+    struct ConvolutionNode : public GraphNode<FloatType> {
+        ConvolutionNode(NodeId id, FloatType const sr, int const blockSize)
+            : GraphNode<FloatType>::GraphNode(id, sr, blockSize)
+        {
+            // We only need visiting on the non-realtime thread to free retired convolvers
+            GraphNode<FloatType>::enableEventNotifications();
+        }
+
+        using Convolver = TwoStageConvolver<FloatType>;
+
+        void setProperty(std::string const& key, js::Value const& val, SharedResourceMap<FloatType>& resources) override
+        {
+            GraphNode<FloatType>::setProperty(key, val);
+
+            if (key == "path") {
+                invariant(val.isString(), "path prop must be a string");
+                invariant(resources.has((js::String) val), "failed to find a resource at the given path");
+
+                ir = resources.get((js::String) val);
+            }
+
+            if (key == "headSize" || key == "tailSize") {
+                invariant(val.isNumber(), key + " prop must be a number");
+
+                auto const size = static_cast<int>((js::Number) val);
+                invariant(size >= 16 && size <= 65536 && (size & (size - 1)) == 0, key + " prop must be a power of two between 16 and 65536");
+
+                (key == "headSize" ? headSize : tailSize) = static_cast<size_t>(size);
+            }
+
+            if (key == "path" || key == "headSize" || key == "tailSize") {
+                releaseRetired();
+
+                if (ir != nullptr) {
+                    convolverQueue.push(createConvolver());
+                }
+            }
+        }
+
+        std::shared_ptr<Convolver> createConvolver()
+        {
+            // The convolver wants a contiguous impulse response, so an interleaved
+            // resource is copied out here first
+            auto const& channel = ir->getChannel(0);
+            std::vector<FloatType> contiguous;
+
+            if (!channel.isContiguous()) {
+                contiguous.resize(channel.size);
+
+                for (size_t i = 0; i < channel.size; ++i) {
+                    contiguous[i] = channel[i];
+                }
+            }
+
+            // The tail partitions can't be smaller than the head's, whichever order the
+            // two props arrive in
+            return std::make_shared<Convolver>(
+                headSize,
+                std::max(headSize, tailSize),
+                channel.isContiguous() ? channel.data : contiguous.data(),
+                channel.size
+            );
+        }
+
+        void process (BlockContext<FloatType> const& ctx) override {
+            auto** inputData = ctx.inputData;
+            auto* outputData = ctx.outputData;
+            auto numChannels = ctx.numInputChannels;
+            auto numSamples = ctx.numSamples;
+
+            // First order of business: take each convolver in the queue in turn, keeping
+            // the most recent. Each one replaced goes back to the non-realtime thread to be
+            // freed, along with its background thread.
+            std::shared_ptr<Convolver> next;
+
+            while (convolverQueue.pop(next)) {
+                if (convolver != nullptr) {
+                    (void) retiredQueue.push(std::move(convolver));
+                    GraphNode<FloatType>::notifyEventsPending();
+                }
+
+                convolver = std::move(next);
+            }
+
+            if (numChannels == 0 || convolver == nullptr)
+                return (void) std::fill_n(outputData, numSamples, FloatType(0));
+
+            convolver->process(inputData[0], outputData, numSamples);
+        }
+
+        void processEvents(std::function<void(std::string const&, js::Value)>&) override {
+            releaseRetired();
+        }
+
+        void releaseRetired()
+        {
+            std::shared_ptr<Convolver> retired;
+
+            while (retiredQueue.pop(retired)) {
+                retired.reset();
+            }
+        }
+
+        SharedResourceBuffer<FloatType> ir;
+        size_t headSize = 512;
+        size_t tailSize = 4096;
+
+        SingleWriterSingleReaderQueue<std::shared_ptr<Convolver>> convolverQueue;
+        SingleWriterSingleReaderQueue<std::shared_ptr<Convolver>> retiredQueue;
+        std::shared_ptr<Convolver> convolver;
+    };
+
+} // namespace elem
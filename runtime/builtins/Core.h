@@ -5,7 +5,9 @@
 #include "../SingleWriterSingleReaderQueue.h"
 
 #include "helpers/Change.h"
-#include "helpers/RefCountedPool.h"
+#include "helpers/ObjectPool.h"
+#include "helpers/ParameterEvents.h"
+#include "helpers/VoiceBatch.h"
 
 
 namespace elem
@@ -13,10 +15,18 @@ namespace elem
 
     template <typename FloatType>
     struct RootNode : public GraphNode<FloatType> {
-        using GraphNode<FloatType>::GraphNode;
+        RootNode(NodeId id, FloatType const sr, int const blockSize)
+            : GraphNode<FloatType>::GraphNode(id, sr, blockSize)
+        {
+            GraphNode<FloatType>::bindProperty("active", active);
+        }
 
         int getChannelNumber() { return channelIndex.load(); }
 
+        // Whether the root was marked active by the most recent activateRoots call.
+        // Only to be read from the non-realtime thread.
+        bool isActive() { return active; }
+
         bool stillRunning()
         {
             auto const t = targetGain.load();
@@ -56,6 +66,12 @@ namespace elem
             auto const direction = (t < c) ? FloatType(-1) : FloatType(1);
             auto const step = direction * FloatType(20) / FloatType(GraphNode<FloatType>::getSampleRate());
 
+            // With the gain settled at either end of the fade, a constant input
+            // makes for a constant output
+            if (c == t && ctx.isInputConstant(0)) {
+                ctx.markOutputConstant();
+            }
+
             for (size_t i = 0; i < numSamples; ++i) {
                 outputData[i] = inputData[0][i] * c;
                 c = std::clamp(c + step, FloatType(0), FloatType(1));
@@ -67,11 +83,14 @@ namespace elem
         std::atomic<FloatType> targetGain = 1;
         std::atomic<FloatType> currentGain = 0;
         std::atomic<int> channelIndex = -1;
+        js::Boolean active = false;
     };
 
     template <typename FloatType>
-    struct PhasorNode : public GraphNode<FloatType> {
-        using GraphNode<FloatType>::GraphNode;
+    struct PhasorNode : public BatchableNode<FloatType> {
+        using BatchableNode<FloatType>::BatchableNode;
+
+        bool canRenderAtControlRate() override { return true; }
 
         FloatType tick (FloatType freq) {
             FloatType step = freq * (FloatType(1.0) / FloatType(GraphNode<FloatType>::getSampleRate()));
@@ -113,16 +132,99 @@ namespace elem
             }
         }
 
+        // A running phasor never sleeps
+        bool trySleep(BlockContext<FloatType> const&) { return false; }
+
+        typename BatchableNode<FloatType>::BatchFn getBatchFunction() override {
+            return &processBatch;
+        }
+
+        static void processBatch(BatchableNode<FloatType>* const* nodes, BlockContext<FloatType> const* contexts, size_t count) {
+            if (contexts[0].numInputChannels < 1) {
+                for (size_t i = 0; i < count; ++i) {
+                    nodes[i]->process(contexts[i]);
+                }
+
+                return;
+            }
+
+            batch::forEachGroup<PhasorNode>(nodes, contexts, count, [](PhasorNode* const* group, BlockContext<FloatType> const* const* lanes, size_t n) {
+                using namespace batch;
+
+                FloatType phase[kLanes] = {};
+                FloatType lastReset[kLanes] = {};
+                FloatType period[kLanes] = {};
+
+                for (size_t l = 0; l < n; ++l) {
+                    phase[l] = group[l]->phase;
+                    lastReset[l] = group[l]->change.lastIn;
+                    period[l] = FloatType(1.0) / FloatType(group[l]->getSampleRate());
+                }
+
+                bool const hasReset = lanes[0]->numInputChannels >= 2;
+                auto const numSamples = lanes[0]->numSamples;
+
+                Tile<FloatType> freq, reset, out;
+
+                for (size_t start = 0; start < numSamples; start += kTileSize) {
+                    auto const len = std::min(kTileSize, numSamples - start);
+
+                    load(freq, lanes, n, 0, start, len);
+
+                    if (hasReset) {
+                        load(reset, lanes, n, 1, start, len);
+
+                        for (size_t i = 0; i < len; ++i) {
+                            for (size_t l = 0; l < kLanes; ++l) {
+                                auto const dt = reset[i][l] - lastReset[l];
+                                lastReset[l] = reset[i][l];
+                                phase[l] = dt > FloatType(0) ? FloatType(0) : phase[l];
+
+                                auto const next = phase[l] + freq[i][l] * period[l];
+                                out[i][l] = phase[l];
+                                phase[l] = next - std::floor(next);
+                            }
+                        }
+                    } else {
+                        for (size_t i = 0; i < len; ++i) {
+                            for (size_t l = 0; l < kLanes; ++l) {
+                                auto const next = phase[l] + freq[i][l] * period[l];
+                                out[i][l] = phase[l];
+                                phase[l] = next - std::floor(next);
+                            }
+                        }
+                    }
+
+                    store(out, lanes, n, start, len);
+                }
+
+                for (size_t l = 0; l < n; ++l) {
+                    group[l]->phase = phase[l];
+
+                    if (hasReset) {
+                        group[l]->change.lastIn = lastReset[l];
+                    }
+                }
+            });
+        }
+
         Change<FloatType> change;
         FloatType phase = 0;
     };
 
+    // The const node's value may also be automated with parameter events on slot 0,
+    // which step or ramp it at exact sample offsets. A new `value` prop replaces any
+    // automated value, and cancels a ramp in progress.
     template <typename FloatType>
-    struct ConstNode : public GraphNode<FloatType> {
-        using GraphNode<FloatType>::GraphNode;
+    struct ConstNode : public ParameterEventNode<FloatType> {
+        using ParameterEventNode<FloatType>::ParameterEventNode;
+
+        bool canRenderAtControlRate() override { return true; }
 
         void setProperty(std::string const& key, js::Value const& val) override
         {
+            GraphNode<FloatType>::setProperty(key, val);
+
             if (key == "value") {
                 invariant(val.isNumber(), "value prop for const node must be a number type");
                 value.store(FloatType((js::Number) val));
@@ -135,13 +237,91 @@ namespace elem
 
             auto const v = value.load();
 
-            for (size_t i = 0; i < numSamples; ++i) {
-                outputData[i] = v;
+            if (v != propValue) {
+                propValue = v;
+                current = v;
+                rampRemaining = 0;
+            }
+
+            auto const isConstant = rampRemaining == 0 && this->nextParameterEventOffset(numSamples) == numSamples;
+
+            for (size_t i = 0; i < numSamples;) {
+                this->takeParameterEvents(i, [this](auto const& e) {
+                    if (e.slot != 0)
+                        return;
+
+                    if (e.rampSamples > 0) {
+                        target = e.value;
+                        step = (e.value - current) / FloatType(e.rampSamples);
+                        rampRemaining = e.rampSamples;
+                    } else {
+                        current = e.value;
+                        rampRemaining = 0;
+                    }
+                });
+
+                auto const end = std::max(i + 1, this->nextParameterEventOffset(numSamples));
+
+                if (rampRemaining > 0) {
+                    auto const n = std::min(end - i, rampRemaining);
+
+                    for (size_t j = 0; j < n; ++j) {
+                        current += step;
+                        outputData[i + j] = current;
+                    }
+
+                    // Land exactly on the target, however the steps have rounded
+                    if ((rampRemaining -= n) == 0) {
+                        current = target;
+                        outputData[i + n - 1] = current;
+                    }
+
+                    i += n;
+                } else {
+                    for (; i < end; ++i) {
+                        outputData[i] = current;
+                    }
+                }
+            }
+
+            this->advanceParameterEvents(numSamples);
+
+            if (isConstant) {
+                ctx.markOutputConstant();
             }
         }
 
         static_assert(std::atomic<FloatType>::is_always_lock_free);
         std::atomic<FloatType> value = 1;
+
+        // The realtime thread's view of the value, which parameter events move away from
+        // the prop
+        FloatType propValue = 1;
+        FloatType current = 1;
+        FloatType target = 1;
+        FloatType step = 0;
+        size_t rampRemaining = 0;
+    };
+
+    // Renders in place of a subgraph which the runtime has folded to a constant, see
+    // Runtime::planRenderSequence. This isn't a node type of its own; the runtime makes
+    // a fresh one for each render sequence, which takes the id of the node it replaces.
+    template <typename FloatType>
+    struct FoldedConstantNode : public GraphNode<FloatType> {
+        FoldedConstantNode(NodeId id, double sr, size_t blockSize, FloatType v)
+            : GraphNode<FloatType>::GraphNode(id, sr, blockSize)
+            , value(v)
+        {
+        }
+
+        bool canRenderAtControlRate() override { return true; }
+
+        void process (BlockContext<FloatType> const& ctx) override {
+            std::fill_n(ctx.outputData, ctx.numSamples, value);
+            ctx.markOutputConstant();
+        }
+
+        FloatType const value;
     };
 
     template <typename FloatType>
@@ -155,6 +335,8 @@ namespace elem
             for (size_t i = 0; i < numSamples; ++i) {
                 outputData[i] = FloatType(GraphNode<FloatType>::getSampleRate());
             }
+
+            ctx.markOutputConstant();
         }
     };
 
@@ -229,6 +411,8 @@ namespace elem
     struct LatchNode : public GraphNode<FloatType> {
         using GraphNode<FloatType>::GraphNode;
 
+        bool canRenderAtControlRate() override { return true; }
+
         void process (BlockContext<FloatType> const& ctx) override {
             auto** inputData = ctx.inputData;
             auto* outputData = ctx.outputData;
@@ -382,6 +566,8 @@ namespace elem
     struct SequenceNode : public GraphNode<FloatType> {
         using GraphNode<FloatType>::GraphNode;
 
+        bool canRenderAtControlRate() override { return true; }
+
         void setProperty(std::string const& key, js::Value const& val) override
         {
             GraphNode<FloatType>::setProperty(key, val);
@@ -405,7 +591,13 @@ namespace elem
             if (key == "seq") {
                 invariant(val.isArray(), "seq prop for seq node must be an array type.");
                 auto& seq = val.getArray();
-                auto data = sequencePool.allocate();
+                auto* data = sequencePool.allocate();
+
+                // If every pooled element is in use, the realtime thread hasn't caught up with
+                // our previous updates, or isn't rendering this node at all. As with a full
+                // queue, we drop the update; the pool keeps count of these failures.
+                if (data == nullptr)
+                    return;
 
                 // The data array that we get from the pool may have been
                 // previously used to represent a different sequence. Need to
@@ -429,11 +621,12 @@ namespace elem
 
             // First order of business: grab the most recent sequence buffer to use if
             // there's anything in the queue
-            if (sequenceQueue.size() > 0) {
-                while (sequenceQueue.size() > 0) {
-                    sequenceQueue.pop(activeSequence);
-                }
+            auto const numReceived = sequenceQueue.consume([this](SequenceData* next) {
+                sequencePool.release(activeSequence);
+                activeSequence = next;
+            });
 
+            if (numReceived > 0) {
                 // Here we want to catch the case where the new sequence we pulled in has a different
                 // length. If the new length is smaller than the prior length, we modulo our current read
                 // index around, attempting to provide a nice default behavior. Otherwise, the index
@@ -520,9 +713,9 @@ namespace elem
 
         using SequenceData = std::vector<FloatType>;
 
-        RefCountedPool<SequenceData> sequencePool;
-        SingleWriterSingleReaderQueue<std::shared_ptr<SequenceData>> sequenceQueue;
-        std::shared_ptr<SequenceData> activeSequence;
+        ObjectPool<SequenceData> sequencePool;
+        SingleWriterSingleReaderQueue<SequenceData*> sequenceQueue;
+        SequenceData* activeSequence = nullptr;
 
         Change<FloatType> change;
         Change<FloatType> resetChange;
@@ -1,11 +1,12 @@
 #pragma once
 
+#include "../Denormals.h"
 #include "../GraphNode.h"
 #include "../Invariant.h"
 #include "../SingleWriterSingleReaderQueue.h"
 
 #include "helpers/Change.h"
-#include "helpers/RefCountedPool.h"
+#include "helpers/ObjectPool.h"
 
 
 namespace elem
@@ -30,6 +31,28 @@ namespace elem
             return o;
         }
 
+        // Copies `n` samples into a power of two ring buffer, starting at `start` and
+        // wrapping with `mask`, as at most two contiguous copies
+        template <typename FloatType>
+        inline void copyIntoRing(FloatType const* source, FloatType* ring, int mask, int start, int n) {
+            auto const begin = start & mask;
+            auto const first = std::min(n, mask + 1 - begin);
+
+            std::copy_n(source, first, ring + begin);
+            std::copy_n(source + first, n - first, ring);
+        }
+
+        // Copies `n` samples out of a power of two ring buffer, starting at `start`, which
+        // may be negative, and wrapping with `mask`
+        template <typename FloatType>
+        inline void copyFromRing(FloatType const* ring, FloatType* dest, int mask, int start, int n) {
+            auto const begin = start & mask;
+            auto const first = std::min(n, mask + 1 - begin);
+
+            std::copy_n(ring + begin, first, dest);
+            std::copy_n(ring, n - first, dest + first);
+        }
+
     }
 
     // A single sample delay node.
@@ -69,6 +92,12 @@ namespace elem
     //
     // At small delay lengths and with a feedback or feedforward component, this becomes
     // a simple comb filter.
+    //
+    // The line is stored in a power of two buffer at least one sample longer than `size`,
+    // so that reads and writes wrap with a mask rather than a modulo, and the per-sample
+    // work has no branches. When every delay length in a block is at least one block
+    // long, which is the usual case, none of the block's reads can see its own writes, and
+    // the reads and the writes each run as a separate loop without serial dependencies.
     template <typename FloatType>
     struct VariableDelayNode : public GraphNode<FloatType> {
         VariableDelayNode(NodeId id, FloatType const sr, int const blockSize)
@@ -79,23 +108,27 @@ namespace elem
 
         void setProperty(std::string const& key, js::Value const& val) override
         {
+            GraphNode<FloatType>::setProperty(key, val);
+
             if (key == "size") {
                 invariant(val.isNumber(), "size prop must be a number.");
 
-                auto const size = static_cast<int>((js::Number) val);
-                auto data = bufferPool.allocate();
+                auto const size = std::max(0, static_cast<int>((js::Number) val));
+                auto* line = linePool.allocate();
 
-                // The buffer that we get from the pool may have been
-                // previously used for a different delay buffer. Need to
-                // resize here and then overwrite below.
-                data->resize(size);
+                // Pool exhausted, see SequenceNode
+                if (line == nullptr)
+                    return;
 
-                for (size_t i = 0; i < data->size(); ++i)
-                    data->at(i) = FloatType(0);
+                // The line that we get from the pool may have been previously used for a
+                // different delay length. Need to resize here and then overwrite below.
+                line->length = size;
+                line->data.resize(size > 0 ? detail::bitciel(size + 1) : 0);
 
-                // Finally, we push our new buffer into the event
-                // queue for the realtime thread.
-                bufferQueue.push(std::move(data));
+                std::fill(line->data.begin(), line->data.end(), FloatType(0));
+
+                // Finally, we push our new line into the event queue for the realtime thread.
+                lineQueue.push(std::move(line));
             }
         }
 
@@ -105,83 +138,100 @@ namespace elem
             auto numChannels = ctx.numInputChannels;
             auto numSamples = ctx.numSamples;
 
-            // First order of business: grab the most recent delay buffer to use if
+            // First order of business: grab the most recent delay line to use if
             // there's anything in the queue
-            while (bufferQueue.size() > 0) {
-                bufferQueue.pop(activeBuffer);
+            lineQueue.consume([this](DelayLine* next) {
+                linePool.release(activeLine);
+                activeLine = next;
                 writeIndex = 0;
-            }
+            });
 
             // If we don't have the inputs we need, we bail here and zero the buffer
             // hoping to prevent unexpected signals.
-            if (numChannels < 3)
+            if (numChannels < 3 || activeLine == nullptr)
                 return (void) std::fill_n(outputData, numSamples, FloatType(0));
 
-            auto const size = static_cast<int>(activeBuffer->size());
-            auto* delayData = activeBuffer->data();
+            auto const size = activeLine->length;
 
             if (size == 0)
-                return (void) std::copy_n(inputData[0], numSamples, outputData);
+                return (void) std::copy_n(inputData[2], numSamples, outputData);
 
-            for (size_t i = 0; i < numSamples; ++i) {
-                auto const offset = std::clamp(inputData[0][i], FloatType(0), FloatType(size));
+            auto* delayData = activeLine->data.data();
+            auto const mask = static_cast<int>(activeLine->data.size()) - 1;
+            auto const maxOffset = FloatType(size);
 
-                // In order to get the feedback right for non-zero read offsets, we read from the
-                // line and sum with the input before writing. If we have a read offset of zero, then
-                // reading before writing doesn't work: we should be reading the same thing that we're
-                // writing. In that case, feedback doesn't make much sense anyways, so here we have a
-                // special case which ignores the feedback value and reads and writes correctly
-                if (offset <= std::numeric_limits<FloatType>::epsilon()) {
-                    auto const in = inputData[2][i];
+            auto const* offsets = inputData[0];
+            auto const* feedback = inputData[1];
+            auto const* x = inputData[2];
 
-                    delayData[writeIndex] = in;
-                    outputData[i] = in;
+            auto minOffset = maxOffset;
 
-                    // Nudge the write index
-                    if (++writeIndex >= size)
-                        writeIndex -= size;
+            for (size_t i = 0; i < numSamples; ++i) {
+                minOffset = std::min(minOffset, offsets[i]);
+            }
 
-                    continue;
+            if (minOffset >= FloatType(numSamples)) {
+                // Every read lands before the start of this block, so first read the whole
+                // block from the line...
+                for (size_t i = 0; i < numSamples; ++i) {
+                    outputData[i] = read(delayData, mask, writeIndex + static_cast<int>(i), std::min(offsets[i], maxOffset));
                 }
 
-                auto const readFrac = FloatType(size + writeIndex) - offset;
-                auto const readLeft = static_cast<int>(readFrac);
-                auto const readRight = readLeft + 1;
-                auto const frac = readFrac - std::floor(readFrac);
+                // ...then write the input with its feedback behind it
+                for (size_t i = 0; i < numSamples; ++i) {
+                    auto const fb = std::clamp(feedback[i], FloatType(-1), FloatType(1));
+                    delayData[(writeIndex + static_cast<int>(i)) & mask] = flushDenormal(x[i] + fb * outputData[i]);
+                }
 
-                // Because of summing `size` with `writeIndex` when forming
-                // `readFrac` above, we know that we don't run our read pointers
-                // below 0 ever, so here we only need to account for wrapping past
-                // size which we do via modulo.
-                auto const left = delayData[readLeft % size];
-                auto const right = delayData[readRight % size];
+                writeIndex = (writeIndex + static_cast<int>(numSamples)) & mask;
+                return;
+            }
 
-                // Now we can read the next sample out of the delay line with linear
-                // interpolation for sub-sample delays.
-                auto const out = left + frac * (right - left);
+            for (size_t i = 0; i < numSamples; ++i) {
+                auto const offset = std::clamp(offsets[i], FloatType(0), maxOffset);
+                auto const whole = static_cast<int>(offset);
+                auto const frac = offset - FloatType(whole);
+
+                // Reading before writing means that a read offset under one sample has to
+                // take the nearer of its two samples from the input itself, as the line
+                // doesn't hold it yet.
+                auto const near = (whole == 0) ? x[i] : delayData[(writeIndex - whole) & mask];
+                auto const far = delayData[(writeIndex - whole - 1) & mask];
+                auto const out = near + frac * (far - near);
+
+                // At a read offset of zero, feedback doesn't make much sense anyways, so
+                // there we ignore it and pass the input straight through
+                auto const fb = (offset <= std::numeric_limits<FloatType>::epsilon())
+                    ? FloatType(0)
+                    : std::clamp(feedback[i], FloatType(-1), FloatType(1));
+
+                delayData[writeIndex] = flushDenormal(x[i] + fb * out);
+                outputData[i] = out;
 
-                // Then we can form the input to the delay line with the feedback
-                // component
-                auto const fb = std::clamp(inputData[1][i], FloatType(-1), FloatType(1));
-                auto const in = inputData[2][i] + fb * out;
+                writeIndex = (writeIndex + 1) & mask;
+            }
+        }
 
-                // Write to the delay line
-                delayData[writeIndex] = in;
+        // Reads from the line `offset` samples behind `position`, with linear interpolation
+        // for sub-sample delays. The offset must be at least one sample.
+        static FloatType read(FloatType const* delayData, int mask, int position, FloatType offset) {
+            auto const whole = static_cast<int>(offset);
+            auto const frac = offset - FloatType(whole);
 
-                // Write to the output buffer
-                outputData[i] = out;
+            auto const near = delayData[(position - whole) & mask];
+            auto const far = delayData[(position - whole - 1) & mask];
 
-                // Nudge the write index
-                if (++writeIndex >= size)
-                    writeIndex -= size;
-            }
+            return near + frac * (far - near);
         }
 
-        using DelayBuffer = std::vector<FloatType>;
+        struct DelayLine {
+            std::vector<FloatType> data;
+            int length = 0;
+        };
 
-        RefCountedPool<DelayBuffer> bufferPool;
-        SingleWriterSingleReaderQueue<std::shared_ptr<DelayBuffer>> bufferQueue;
-        std::shared_ptr<DelayBuffer> activeBuffer;
+        ObjectPool<DelayLine> linePool;
+        SingleWriterSingleReaderQueue<DelayLine*> lineQueue;
+        DelayLine* activeLine = nullptr;
 
         int writeIndex = 0;
     };
@@ -203,6 +253,8 @@ namespace elem
 
         void setProperty(std::string const& key, js::Value const& val) override
         {
+            GraphNode<FloatType>::setProperty(key, val);
+
             if (key == "size") {
                 invariant(val.isNumber(), "size prop must be a number.");
 
@@ -213,7 +265,11 @@ namespace elem
                 // the delay line length.
                 auto const len = static_cast<int>((js::Number) val);
                 auto const size = detail::bitciel(len + blockSize);
-                auto data = bufferPool.allocate();
+                auto* data = bufferPool.allocate();
+
+                // Pool exhausted, see SequenceNode
+                if (data == nullptr)
+                    return;
 
                 // The buffer that we get from the pool may have been
                 // previously used for a different delay buffer. Need to
@@ -238,10 +294,11 @@ namespace elem
 
             // First order of business: grab the most recent delay buffer to use if
             // there's anything in the queue
-            while (bufferQueue.size() > 0) {
-                bufferQueue.pop(activeBuffer);
+            bufferQueue.consume([this](DelayBuffer* next) {
+                bufferPool.release(activeBuffer);
+                activeBuffer = next;
                 writeIndex = 0;
-            }
+            });
 
             // If we don't have the inputs we need, we bail here and zero the buffer
             // hoping to prevent unexpected signals.
@@ -256,32 +313,164 @@ namespace elem
                 return (void) std::fill_n(outputData, numSamples, FloatType(0));
 
             auto* delayData = activeBuffer->data();
-            auto* inData = inputData[0];
+            auto const n = static_cast<int>(numSamples);
 
-            auto readStart = writeIndex - len;
+            // Write the block to the delay line, then read the block back out of it from
+            // `len` samples behind. Because the line is a power of two in size, each of
+            // these is at most two contiguous copies either side of the wrap.
+            detail::copyIntoRing(inputData[0], delayData, mask, writeIndex, n);
+            detail::copyFromRing(delayData, outputData, mask, writeIndex - len, n);
 
-            for (size_t i = 0; i < numSamples; ++i) {
-                // Write to the delay line
-                auto const in = inData[i];
-                delayData[writeIndex] = in;
+            writeIndex = (writeIndex + n) & mask;
+        }
 
-                // Nudge the write index
-                writeIndex = (writeIndex + 1) & mask;
+        using DelayBuffer = std::vector<FloatType>;
+
+        ObjectPool<DelayBuffer> bufferPool;
+        SingleWriterSingleReaderQueue<DelayBuffer*> bufferQueue;
+        DelayBuffer* activeBuffer = nullptr;
+
+        std::atomic<int> length = 0;
+        int writeIndex = 0;
+        int blockSize = 0;
+    };
+
+    // A delay line read by any number of taps, each with its own modulated delay length,
+    // and summed to a single output.
+    //
+    //   el.multitap({size: 44100, gains: [0.5, 0.3, 0.2]}, x, len1, len2, len3)
+    //
+    // The first child is the input to the line, and each child after it is the delay
+    // length in samples of one tap, read with linear interpolation. The `gains` prop
+    // weights the taps in order; taps without a gain are summed at unity. A tap length of
+    // zero reads the input as it is written, and lengths are clamped to `size`.
+    //
+    // Compared to a delay node per tap, each of which holds its own copy of the same
+    // signal, this keeps one line for all of them, which is much easier on memory and the
+    // cache for multitap echoes, chorus voices and the early reflections of a reverb.
+    template <typename FloatType>
+    struct MultiTapDelayNode : public GraphNode<FloatType> {
+        MultiTapDelayNode(NodeId id, FloatType const sr, int const bs)
+            : GraphNode<FloatType>::GraphNode(id, sr, bs)
+            , blockSize(bs)
+        {
+            setProperty("size", js::Value((js::Number) blockSize));
+        }
+
+        void setProperty(std::string const& key, js::Value const& val) override
+        {
+            GraphNode<FloatType>::setProperty(key, val);
+
+            if (key == "size") {
+                invariant(val.isNumber(), "size prop must be a number.");
+
+                // The whole block is written before any of it is read, so the line has
+                // room for the longest tap plus a block, and one more sample for the far
+                // side of the interpolation
+                auto const size = std::max(0, static_cast<int>((js::Number) val));
+                auto* line = linePool.allocate();
+
+                // Pool exhausted, see SequenceNode
+                if (line == nullptr)
+                    return;
+
+                line->length = size;
+                line->data.resize(detail::bitciel(size + blockSize + 1));
+
+                std::fill(line->data.begin(), line->data.end(), FloatType(0));
+                lineQueue.push(std::move(line));
             }
 
-            for (int i = 0; i < static_cast<int>(numSamples); ++i) {
-                // Write to the output buffer
-                outputData[i] = delayData[(size + readStart + i) & mask];
+            if (key == "gains") {
+                invariant(val.isArray(), "gains prop must be an array.");
+
+                auto& arr = val.getArray();
+                auto* data = gainPool.allocate();
+
+                // Pool exhausted, see SequenceNode
+                if (data == nullptr)
+                    return;
+
+                data->resize(arr.size());
+
+                for (size_t i = 0; i < arr.size(); ++i) {
+                    invariant(arr[i].isNumber(), "gains prop must be an array of numbers.");
+                    data->at(i) = FloatType((js::Number) arr[i]);
+                }
+
+                gainQueue.push(std::move(data));
             }
         }
 
-        using DelayBuffer = std::vector<FloatType>;
+        void process (BlockContext<FloatType> const& ctx) override {
+            auto** inputData = ctx.inputData;
+            auto* outputData = ctx.outputData;
+            auto numChannels = ctx.numInputChannels;
+            auto numSamples = ctx.numSamples;
 
-        RefCountedPool<DelayBuffer> bufferPool;
-        SingleWriterSingleReaderQueue<std::shared_ptr<DelayBuffer>> bufferQueue;
-        std::shared_ptr<DelayBuffer> activeBuffer;
+            lineQueue.consume([this](DelayLine* next) {
+                linePool.release(activeLine);
+                activeLine = next;
+                writeIndex = 0;
+            });
+
+            gainQueue.consume([this](GainList* next) {
+                gainPool.release(activeGains);
+                activeGains = next;
+            });
+
+            // If we don't have the inputs we need, we bail here and zero the buffer
+            // hoping to prevent unexpected signals.
+            if (numChannels < 2 || activeLine == nullptr)
+                return (void) std::fill_n(outputData, numSamples, FloatType(0));
+
+            auto* delayData = activeLine->data.data();
+            auto const mask = static_cast<int>(activeLine->data.size()) - 1;
+            auto const maxOffset = FloatType(activeLine->length);
+            auto const n = static_cast<int>(numSamples);
+
+            detail::copyIntoRing(inputData[0], delayData, mask, writeIndex, n);
+            std::fill_n(outputData, numSamples, FloatType(0));
+
+            auto const numGains = (activeGains != nullptr) ? activeGains->size() : 0;
+
+            // Each tap reads the samples it needs from the line into the output without
+            // depending on any other, so the taps are summed one whole block at a time
+            for (size_t k = 1; k < numChannels; ++k) {
+                auto const* offsets = inputData[k];
+                auto const gain = (k - 1 < numGains) ? activeGains->at(k - 1) : FloatType(1);
+
+                for (int i = 0; i < n; ++i) {
+                    auto const offset = std::clamp(offsets[i], FloatType(0), maxOffset);
+                    auto const whole = static_cast<int>(offset);
+                    auto const frac = offset - FloatType(whole);
+
+                    auto const position = writeIndex + i - whole;
+                    auto const near = delayData[position & mask];
+                    auto const far = delayData[(position - 1) & mask];
+
+                    outputData[i] += gain * (near + frac * (far - near));
+                }
+            }
+
+            writeIndex = (writeIndex + n) & mask;
+        }
+
+        struct DelayLine {
+            std::vector<FloatType> data;
+            int length = 0;
+        };
+
+        using GainList = std::vector<FloatType>;
+
+        ObjectPool<DelayLine> linePool;
+        SingleWriterSingleReaderQueue<DelayLine*> lineQueue;
+        DelayLine* activeLine = nullptr;
+
+        ObjectPool<GainList> gainPool;
+        SingleWriterSingleReaderQueue<GainList*> gainQueue;
+        GainList* activeGains = nullptr;
 
-        std::atomic<int> length = 0;
         int writeIndex = 0;
         int blockSize = 0;
     };
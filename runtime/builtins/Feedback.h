@@ -2,12 +2,11 @@
 
 #include <functional>
 
+#include "../Denormals.h"
 #include "../GraphNode.h"
 #include "../Invariant.h"
 #include "../SingleWriterSingleReaderQueue.h"
 
-#include "helpers/RefCountedPool.h"
-
 
 namespace elem
 {
@@ -36,9 +35,7 @@ namespace elem
             auto* outputData = ctx.outputData;
             auto numSamples = ctx.numSamples;
 
-            while (bufferQueue.size() > 0) {
-                bufferQueue.pop(activeBuffer);
-            }
+            bufferQueue.popAll(activeBuffer);
 
             if (!activeBuffer)
                 return (void) std::fill_n(outputData, numSamples, FloatType(0));
@@ -56,6 +53,13 @@ namespace elem
     // signal into a circular buffer which should be drained by the GraphRenderer
     // via `promoteTapBuffers` and then served to the appropriate TapInNodes during
     // the render pass.
+    //
+    // By default the loop through a tapOut has a latency of one full block. With the
+    // `blockSize` prop, the loop instead has a latency of that many samples: the render
+    // sequence then runs the nodes of the loop in sub-blocks of (at most) that size, and
+    // before each one moves the history of our input into the tap line by way of
+    // `promoteLoopTapBuffer`. Should any tapIn reading such a tap render from another
+    // root than it, the loop keeps the latency of one block.
     template <typename FloatType>
     struct TapOutNode : public GraphNode<FloatType> {
         TapOutNode(NodeId id, FloatType const sr, int const blockSize)
@@ -63,6 +67,15 @@ namespace elem
         {
             delayBuffer.resize(blockSize);
             std::fill_n(delayBuffer.data(), blockSize, FloatType(0));
+
+            // A power of two so that the history can be indexed with a mask
+            size_t historySize = 1;
+
+            while (historySize < static_cast<size_t>(blockSize))
+                historySize <<= 1;
+
+            history.resize(historySize, FloatType(0));
+            historyMask = historySize - 1;
         }
 
         void setProperty(std::string const& key, js::Value const& val, SharedResourceMap<FloatType>& resources) override
@@ -75,6 +88,21 @@ namespace elem
                 auto ref = resources.getOrCreateMutable((js::String) val, GraphNode<FloatType>::getBlockSize());
                 tapBufferQueue.push(std::move(ref));
             }
+
+            if (key == "blockSize") {
+                invariant(val.isNumber(), "blockSize prop for tapOut node must be a number type");
+
+                auto const size = static_cast<int>((js::Number) val);
+                invariant(size >= 1 && static_cast<size_t>(size) <= GraphNode<FloatType>::getBlockSize(), "blockSize prop for tapOut node must be between 1 and the host block size");
+
+                loopLatency = static_cast<size_t>(size);
+            }
+        }
+
+        // The latency of the loop through this tap in samples, or zero for the default of
+        // one full block. Read by the runtime when building the render sequence.
+        size_t getLoopLatency() const {
+            return loopLatency;
         }
 
         void promoteTapBuffers(size_t numSamples) {
@@ -85,9 +113,7 @@ namespace elem
             // we cycle in the appropriate active buffer here so that we have a chance to move the
             // read pointer before moving the write pointer below. This way the writer doesn't get
             // ahead of the reader, and the reader remains appropriately behind the writer.
-            while (tapBufferQueue.size() > 0) {
-                tapBufferQueue.pop(activeTapBuffer);
-            }
+            tapBufferQueue.popAll(activeTapBuffer);
 
             // If after the above we still don't have an active buffer, there's nothing to do
             if (activeTapBuffer == nullptr)
@@ -97,6 +123,21 @@ namespace elem
             std::copy_n(delayBuffer.data(), numSamples, activeTapBuffer->data());
         }
 
+        // Called by the render sequence before each sub-block of a loop, this fills the
+        // first `numSamples` of the tap line with our input from `latency` samples ago.
+        // The latency must be at least `numSamples`, so that we only read what's been written.
+        void promoteLoopTapBuffer(size_t numSamples, size_t latency) {
+            if (activeTapBuffer == nullptr)
+                return;
+
+            auto* tapData = activeTapBuffer->data();
+            auto const start = historyIndex - latency;
+
+            for (size_t i = 0; i < numSamples; ++i) {
+                tapData[i] = history[(start + i) & historyMask];
+            }
+        }
+
         void process (BlockContext<FloatType> const& ctx) override {
             auto** inputData = ctx.inputData;
             auto* outputData = ctx.outputData;
@@ -110,11 +151,25 @@ namespace elem
             // Else, we write to our delay line and pass through our input
             auto* delayData = delayBuffer.data();
 
-            std::copy_n(inputData[0], numSamples, delayData);
             std::copy_n(inputData[0], numSamples, outputData);
+
+            // A signal decaying around the loop would otherwise come back as subnormals
+            // where the CPU can't flush them itself
+            for (size_t i = 0; i < numSamples; ++i) {
+                auto const x = flushDenormal(inputData[0][i]);
+
+                delayData[i] = x;
+                history[(historyIndex + i) & historyMask] = x;
+            }
+
+            historyIndex = (historyIndex + numSamples) & historyMask;
         }
 
         std::vector<FloatType> delayBuffer;
+        std::vector<FloatType> history;
+        size_t historyIndex = 0;
+        size_t historyMask = 0;
+        size_t loopLatency = 0;
         SingleWriterSingleReaderQueue<MutableSharedResourceBuffer<FloatType>> tapBufferQueue;
         MutableSharedResourceBuffer<FloatType> activeTapBuffer;
     };
@@ -1,6 +1,8 @@
 #pragma once
 
+#include "../Denormals.h"
 #include "../GraphNode.h"
+#include "helpers/VoiceBatch.h"
 
 
 namespace elem
@@ -33,6 +35,8 @@ namespace elem
                 z = x + p * z;
                 outputData[i] = z;
             }
+
+            z = flushDenormal(z);
         }
 
         FloatType z = 0;
@@ -44,8 +48,8 @@ namespace elem
     // This is an envelope follower with a parameterizable attack and release
     // coefficient, given by the first and second input channel respectively.
     template <typename FloatType>
-    struct EnvelopeNode : public GraphNode<FloatType> {
-        using GraphNode<FloatType>::GraphNode;
+    struct EnvelopeNode : public BatchableNode<FloatType> {
+        using BatchableNode<FloatType>::BatchableNode;
 
         void process (BlockContext<FloatType> const& ctx) override {
             auto** inputData = ctx.inputData;
@@ -57,6 +61,9 @@ namespace elem
             if (numChannels < 3)
                 return (void) std::fill_n(outputData, numSamples, FloatType(0));
 
+            if (trySleep(ctx))
+                return;
+
             // First channel is the pole position when the input exceeds the current
             // filter output, second channel is the pole position otherwise. The third
             // channel is the input signal to be filtered
@@ -73,6 +80,70 @@ namespace elem
 
                 outputData[i] = z;
             }
+
+            z = flushDenormal(z);
+        }
+
+        // Once the envelope has fully decayed on a silent input, it stays at zero for
+        // as long as the input does, and we can skip the block
+        bool trySleep(BlockContext<FloatType> const& ctx) {
+            if (z != FloatType(0) || !ctx.isInputConstant(2) || ctx.inputData[2][0] != FloatType(0))
+                return false;
+
+            std::fill_n(ctx.outputData, ctx.numSamples, FloatType(0));
+            ctx.markOutputConstant();
+            return true;
+        }
+
+        typename BatchableNode<FloatType>::BatchFn getBatchFunction() override {
+            return &processBatch;
+        }
+
+        static void processBatch(BatchableNode<FloatType>* const* nodes, BlockContext<FloatType> const* contexts, size_t count) {
+            if (contexts[0].numInputChannels < 3) {
+                for (size_t i = 0; i < count; ++i) {
+                    nodes[i]->process(contexts[i]);
+                }
+
+                return;
+            }
+
+            batch::forEachGroup<EnvelopeNode>(nodes, contexts, count, [](EnvelopeNode* const* group, BlockContext<FloatType> const* const* lanes, size_t n) {
+                using namespace batch;
+
+                FloatType z[kLanes] = {};
+
+                for (size_t l = 0; l < n; ++l) {
+                    z[l] = group[l]->z;
+                }
+
+                auto const numSamples = lanes[0]->numSamples;
+                Tile<FloatType> ap, rp, x, out;
+
+                for (size_t start = 0; start < numSamples; start += kTileSize) {
+                    auto const len = std::min(kTileSize, numSamples - start);
+
+                    load(ap, lanes, n, 0, start, len);
+                    load(rp, lanes, n, 1, start, len);
+                    load(x, lanes, n, 2, start, len);
+
+                    for (size_t i = 0; i < len; ++i) {
+                        for (size_t l = 0; l < kLanes; ++l) {
+                            auto const vn = std::abs(x[i][l]);
+                            auto const p = vn > z[l] ? ap[i][l] : rp[i][l];
+
+                            z[l] = p * (z[l] - vn) + vn;
+                            out[i][l] = z[l];
+                        }
+                    }
+
+                    store(out, lanes, n, start, len);
+                }
+
+                for (size_t l = 0; l < n; ++l) {
+                    group[l]->z = flushDenormal(z[l]);
+                }
+            });
         }
 
         FloatType z = 0;
@@ -85,8 +156,8 @@ namespace elem
     //  https://ccrma.stanford.edu/~jos/filters/Transposed_Direct_Forms.html
     //  https://os.mbed.com/users/simon/code/dsp/docs/tip/group__BiquadCascadeDF2T.html
     template <typename FloatType>
-    struct BiquadFilterNode : public GraphNode<FloatType> {
-        using GraphNode<FloatType>::GraphNode;
+    struct BiquadFilterNode : public BatchableNode<FloatType> {
+        using BatchableNode<FloatType>::BatchableNode;
 
         void process (BlockContext<FloatType> const& ctx) override {
             auto** inputData = ctx.inputData;
@@ -99,6 +170,9 @@ namespace elem
             if (numChannels < 6)
                 return (void) std::fill_n(outputData, numSamples, FloatType(0));
 
+            if (trySleep(ctx))
+                return;
+
             for (size_t i = 0; i < numSamples; ++i) {
                 auto const b0 = inputData[0][i];
                 auto const b1 = inputData[1][i];
@@ -113,6 +187,76 @@ namespace elem
 
                 outputData[i] = y;
             }
+
+            z1 = flushDenormal(z1);
+            z2 = flushDenormal(z2);
+        }
+
+        // A filter at rest on a silent input stays at rest, so we can skip the block
+        bool trySleep(BlockContext<FloatType> const& ctx) {
+            if (z1 != FloatType(0) || z2 != FloatType(0) || !ctx.isInputConstant(5) || ctx.inputData[5][0] != FloatType(0))
+                return false;
+
+            std::fill_n(ctx.outputData, ctx.numSamples, FloatType(0));
+            ctx.markOutputConstant();
+            return true;
+        }
+
+        typename BatchableNode<FloatType>::BatchFn getBatchFunction() override {
+            return &processBatch;
+        }
+
+        static void processBatch(BatchableNode<FloatType>* const* nodes, BlockContext<FloatType> const* contexts, size_t count) {
+            if (contexts[0].numInputChannels < 6) {
+                for (size_t i = 0; i < count; ++i) {
+                    nodes[i]->process(contexts[i]);
+                }
+
+                return;
+            }
+
+            batch::forEachGroup<BiquadFilterNode>(nodes, contexts, count, [](BiquadFilterNode* const* group, BlockContext<FloatType> const* const* lanes, size_t n) {
+                using namespace batch;
+
+                FloatType z1[kLanes] = {};
+                FloatType z2[kLanes] = {};
+
+                for (size_t l = 0; l < n; ++l) {
+                    z1[l] = group[l]->z1;
+                    z2[l] = group[l]->z2;
+                }
+
+                auto const numSamples = lanes[0]->numSamples;
+                Tile<FloatType> b0, b1, b2, a1, a2, x, out;
+
+                for (size_t start = 0; start < numSamples; start += kTileSize) {
+                    auto const len = std::min(kTileSize, numSamples - start);
+
+                    load(b0, lanes, n, 0, start, len);
+                    load(b1, lanes, n, 1, start, len);
+                    load(b2, lanes, n, 2, start, len);
+                    load(a1, lanes, n, 3, start, len);
+                    load(a2, lanes, n, 4, start, len);
+                    load(x, lanes, n, 5, start, len);
+
+                    for (size_t i = 0; i < len; ++i) {
+                        for (size_t l = 0; l < kLanes; ++l) {
+                            auto const y = b0[i][l] * x[i][l] + z1[l];
+                            z1[l] = b1[i][l] * x[i][l] - a1[i][l] * y + z2[l];
+                            z2[l] = b2[i][l] * x[i][l] - a2[i][l] * y;
+
+                            out[i][l] = y;
+                        }
+                    }
+
+                    store(out, lanes, n, start, len);
+                }
+
+                for (size_t l = 0; l < n; ++l) {
+                    group[l]->z1 = flushDenormal(z1[l]);
+                    group[l]->z2 = flushDenormal(z2[l]);
+                }
+            });
         }
 
         FloatType z1 = 0;
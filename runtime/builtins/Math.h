@@ -1,15 +1,44 @@
 #pragma once
 
 #include "../GraphNode.h"
+#include "helpers/FastMath.h"
+
+#include <functional>
+#include <type_traits>
 
 
 namespace elem
 {
 
-    template <typename FloatType, FloatType op(FloatType)>
-    struct UnaryOperationNode : public GraphNode<FloatType> {
+    // A base for nodes whose output at each sample depends only on their inputs at that
+    // same sample, and which may therefore write their output directly over one of their
+    // input buffers. When building the render sequence, we use this to collapse chains of
+    // such nodes onto a single buffer.
+    //
+    // Pointwise nodes must also keep no state from one sample to the next, and read nothing
+    // in `process` but their inputs and props. The runtime relies on this to fold those
+    // with only constant inputs into a constant, by calling `process` for a single sample
+    // while building the render sequence, and to merge identical ones.
+    template <typename FloatType>
+    struct PointwiseNode : public GraphNode<FloatType> {
         using GraphNode<FloatType>::GraphNode;
 
+        // Returns true if `process` is safe to call with the output buffer being the
+        // same as the buffer of the given input channel.
+        virtual bool canProcessInPlace(size_t inputIndex) = 0;
+
+        // Being stateless, pointwise nodes render the same at any rate
+        bool canRenderAtControlRate() override { return true; }
+    };
+
+    template <typename FloatType, FloatType op(FloatType)>
+    struct UnaryOperationNode : public PointwiseNode<FloatType> {
+        using PointwiseNode<FloatType>::PointwiseNode;
+
+        bool canProcessInPlace(size_t inputIndex) override {
+            return inputIndex == 0;
+        }
+
         void process (BlockContext<FloatType> const& ctx) override {
             auto** inputData = ctx.inputData;
             auto* outputData = ctx.outputData;
@@ -21,15 +50,27 @@ namespace elem
             if (numChannels < 1)
                 return (void) std::fill_n(outputData, numSamples, FloatType(0));
 
+            // A constant input needs only a single evaluation
+            if (ctx.isInputConstant(0)) {
+                std::fill_n(outputData, numSamples, op(inputData[0][0]));
+                return ctx.markOutputConstant();
+            }
+
+            auto const* x = inputData[0];
+
             for (size_t i = 0; i < numSamples; ++i) {
-                outputData[i] = op(inputData[0][i]);
+                outputData[i] = op(x[i]);
             }
         }
     };
 
     template <typename FloatType, typename BinaryOp>
-    struct BinaryOperationNode : public GraphNode<FloatType> {
-        using GraphNode<FloatType>::GraphNode;
+    struct BinaryOperationNode : public PointwiseNode<FloatType> {
+        using PointwiseNode<FloatType>::PointwiseNode;
+
+        bool canProcessInPlace(size_t inputIndex) override {
+            return inputIndex < 2;
+        }
 
         void process (BlockContext<FloatType> const& ctx) override {
             auto** inputData = ctx.inputData;
@@ -42,14 +83,19 @@ namespace elem
             if (numChannels < 2)
                 return (void) std::fill_n(outputData, numSamples, FloatType(0));
 
-            // Copy the first input to the output buffer
-            for (size_t i = 0; i < numSamples; ++i) {
-                outputData[i] = inputData[0][i];
+            // Two constant inputs need only a single evaluation
+            if (ctx.isInputConstant(0) && ctx.isInputConstant(1)) {
+                std::fill_n(outputData, numSamples, op(inputData[0][0], inputData[1][0]));
+                return ctx.markOutputConstant();
             }
 
-            // Then walk the second channel with the operator
+            // A single pass over both inputs. The operators here are all simple enough
+            // to inline, leaving a loop which the compiler can vectorize.
+            auto const* x = inputData[0];
+            auto const* y = inputData[1];
+
             for (size_t i = 0; i < numSamples; ++i) {
-                outputData[i] = op(outputData[i], inputData[1][i]);
+                outputData[i] = op(x[i], y[i]);
             }
         }
 
@@ -57,8 +103,14 @@ namespace elem
     };
 
     template <typename FloatType, typename BinaryOp>
-    struct BinaryReducingNode : public GraphNode<FloatType> {
-        using GraphNode<FloatType>::GraphNode;
+    struct BinaryReducingNode : public PointwiseNode<FloatType> {
+        using PointwiseNode<FloatType>::PointwiseNode;
+
+        // We read from the first two inputs in the same pass that first writes the output,
+        // but all others are read after the output has already been written
+        bool canProcessInPlace(size_t inputIndex) override {
+            return inputIndex < 2;
+        }
 
         void process (BlockContext<FloatType> const& ctx) override {
             auto** inputData = ctx.inputData;
@@ -71,16 +123,59 @@ namespace elem
             if (numChannels < 1)
                 return (void) std::fill_n(outputData, numSamples, FloatType(0));
 
-            // Copy the first input to the output buffer
-            for (size_t i = 0; i < numSamples; ++i) {
-                outputData[i] = inputData[0][i];
+            // A product with a constant zero factor is zero, which lets us skip
+            // the rest of the work for gated-off voices and similar
+            if constexpr (std::is_same_v<BinaryOp, std::multiplies<FloatType>>) {
+                for (size_t i = 0; i < numChannels; ++i) {
+                    if (ctx.isInputConstant(i) && inputData[i][0] == FloatType(0)) {
+                        std::fill_n(outputData, numSamples, FloatType(0));
+                        return ctx.markOutputConstant();
+                    }
+                }
+            }
+
+            // If every input is constant, we only need to reduce the first sample
+            bool allConstant = true;
+
+            for (size_t i = 0; i < numChannels && allConstant; ++i) {
+                allConstant = ctx.isInputConstant(i);
+            }
+
+            if (allConstant) {
+                auto y = inputData[0][0];
+
+                for (size_t i = 1; i < numChannels; ++i) {
+                    y = op(y, inputData[i][0]);
+                }
+
+                std::fill_n(outputData, numSamples, y);
+                return ctx.markOutputConstant();
+            }
+
+            if (numChannels == 1) {
+                if (outputData != inputData[0]) {
+                    std::copy_n(inputData[0], numSamples, outputData);
+                }
+
+                return;
+            }
+
+            // Reduce the first two inputs in a single pass rather than first copying
+            // the first input into the output buffer
+            auto const* x0 = inputData[0];
+            auto const* x1 = inputData[1];
+
+            for (size_t j = 0; j < numSamples; ++j) {
+                outputData[j] = op(x0[j], x1[j]);
             }
 
             // Then for each remaining channel, perform the arithmetic operation
             // into the output buffer.
-            for (size_t i = 1; i < numChannels; ++i) {
+            for (size_t i = 2; i < numChannels; ++i) {
+                auto const* x = inputData[i];
+
                 for (size_t j = 0; j < numSamples; ++j) {
-                    outputData[j] = op(outputData[j], inputData[i][j]);
+                    outputData[j] = op(outputData[j], x[j]);
                 }
             }
         }
@@ -94,6 +189,8 @@ namespace elem
 
         void setProperty(std::string const& key, js::Value const& val) override
         {
+            GraphNode<FloatType>::setProperty(key, val);
+
             if (key == "channel") {
                 channel.store(static_cast<int>((js::Number) val));
             }
@@ -10,8 +10,12 @@ namespace elem
     struct UniformRandomNoiseNode : public GraphNode<FloatType> {
         using GraphNode<FloatType>::GraphNode;
 
+        bool canRenderAtControlRate() override { return true; }
+
         void setProperty(std::string const& key, js::Value const& val) override
         {
+            GraphNode<FloatType>::setProperty(key, val);
+
             if (key == "seed") {
                 seed = static_cast<uint32_t>((js::Number) val);
             }
@@ -2,24 +2,41 @@
 
 #include "../GraphNode.h"
 #include "../Invariant.h"
+#include "../SampleStream.h"
 #include "../SingleWriterSingleReaderQueue.h"
 #include "../Types.h"
 
 #include "./helpers/Change.h"
+#include "./helpers/Interpolation.h"
 
 
 namespace elem
 {
 
     template <typename FloatType>
-    struct VariablePitchLerpReader;
+    struct SampleBufferSource;
+
+    template <typename FloatType>
+    struct SampleStreamSource;
+
+    template <typename FloatType, typename SourceType = SampleBufferSource<FloatType>>
+    struct VariablePitchReader;
 
     // SampleNode is a core builtin for sample playback.
     //
     // The sample file is loaded from disk or from virtual memory with a path set by the `path` property.
+    // The path may name either a buffer in the shared resource map or a sample stream, in
+    // which case the sample is read from disk as it plays. For multichannel buffers, the
+    // `channel` property picks which channel to play: the first by default, and the last
+    // for any channel beyond the buffer's own. Streams have a single channel.
     // The sample is then triggered on the rising edge of an incoming pulse train, so
     // this node expects a single child node delivering that train.
-    template <typename FloatType, typename ReaderType = VariablePitchLerpReader<FloatType>>
+    //
+    // The `interpolation` property chooses how the sample is read between its samples:
+    // "linear" by default, "hermite", or "sinc". See helpers/Interpolation.h.
+    template <typename FloatType,
+              typename ReaderType = VariablePitchReader<FloatType>,
+              typename StreamReaderType = VariablePitchReader<FloatType, SampleStreamSource<FloatType>>>
     struct SampleNode : public GraphNode<FloatType> {
         using GraphNode<FloatType>::GraphNode;
 
@@ -29,10 +46,49 @@ namespace elem
 
             if (key == "path") {
                 invariant(val.isString(), "path prop must be a string");
-                invariant(resources.has((js::String) val), "failed to find a resource at the given path");
 
-                auto ref = resources.get((js::String) val);
-                bufferQueue.push(std::move(ref));
+                auto const path = (js::String) val;
+                Source source { nullptr, {}, latestSource.channel };
+
+                if (resources.has(path)) {
+                    source.buffer = resources.get(path);
+                } else {
+                    invariant(resources.hasStream(path), "failed to find a resource at the given path");
+
+                    // Each reader gets its own voice, with its own read-ahead, so that
+                    // a new note can start while the previous one fades out
+                    auto const& stream = resources.getStream(path);
+                    source.voices = {{ stream->createVoice(), stream->createVoice() }};
+                }
+
+                latestSource = source;
+                sourceQueue.push(std::move(source));
+            }
+
+            if (key == "channel") {
+                invariant(val.isNumber(), "channel prop for the sample node must be a number.");
+
+                auto const vi = static_cast<int>((js::Number) val);
+                invariant(vi >= 0, "channel prop for the sample node must be a positive number.");
+
+                latestSource.channel = static_cast<size_t>(vi);
+
+                // If the path came first, switch the readers over to the new channel
+                if (latestSource.buffer != nullptr) {
+                    auto source = latestSource;
+                    sourceQueue.push(std::move(source));
+                }
+            }
+
+            if (key == "interpolation") {
+                invariant(val.isString(), "interpolation prop for the sample node must be a string.");
+                auto const m = parseInterpolationMode((js::String) val);
+
+                // Make sure the sinc table is built here rather than on the realtime thread
+                if (m == InterpolationMode::Sinc)
+                    SincInterpolator<FloatType>::getTable();
+
+                interpolation.store(m);
             }
 
             if (key == "mode") {
@@ -68,66 +124,118 @@ namespace elem
         void reset() override {
             readers[0].noteOff();
             readers[1].noteOff();
+            streamReaders[0].noteOff();
+            streamReaders[1].noteOff();
         }
 
         void process (BlockContext<FloatType> const& ctx) override {
-            auto** inputData = ctx.inputData;
             auto* outputData = ctx.outputData;
             auto numChannels = ctx.numInputChannels;
             auto numSamples = ctx.numSamples;
 
             auto const sampleRate = GraphNode<FloatType>::getSampleRate();
 
-            // First order of business: grab the most recent sample buffer to use if
-            // there's anything in the queue. This behavior means that changing the buffer
+            // First order of business: grab the most recent sample source to use if
+            // there's anything in the queue. This behavior means that changing the source
             // while playing the sample will cause a discontinuity.
-            while (bufferQueue.size() > 0) {
-                bufferQueue.pop(activeBuffer);
-
-                readers[0] = ReaderType(sampleRate, activeBuffer);
-                readers[1] = ReaderType(sampleRate, activeBuffer);
+            if (sourceQueue.popAll(activeSource)) {
+                readers[0] = ReaderType(sampleRate, SampleBufferSource<FloatType>(activeSource.buffer, activeSource.channel));
+                readers[1] = ReaderType(sampleRate, SampleBufferSource<FloatType>(activeSource.buffer, activeSource.channel));
+                streamReaders[0] = StreamReaderType(sampleRate, activeSource.voices[0]);
+                streamReaders[1] = StreamReaderType(sampleRate, activeSource.voices[1]);
             }
 
-            // If we don't have an input trigger or an active buffer, we can just return here
-            if (numChannels < 1 || activeBuffer == nullptr)
+            // If we don't have an input trigger or an active source, we can just return here
+            if (numChannels < 1 || (activeSource.buffer == nullptr && activeSource.voices[0] == nullptr))
                 return (void) std::fill_n(outputData, numSamples, FloatType(0));
 
+            if (activeSource.buffer != nullptr)
+                return processReaders(ctx, readers);
+
+            processReaders(ctx, streamReaders);
+        }
+
+        template <typename Readers>
+        void processReaders (BlockContext<FloatType> const& ctx, Readers& rs) {
+            auto** inputData = ctx.inputData;
+            auto* outputData = ctx.outputData;
+            auto numChannels = ctx.numInputChannels;
+            auto numSamples = ctx.numSamples;
+
+            // If neither reader is playing and the trigger holds steady for the whole
+            // block, there's no edge to start one and we know we'll output silence
+            if (rs[0].isIdle() && rs[1].isIdle() && ctx.isInputConstant(0) && inputData[0][0] == change.lastIn) {
+                std::fill_n(outputData, numSamples, FloatType(0));
+                return ctx.markOutputConstant();
+            }
+
             // Now we expect the first input channel to carry a pulse train, and we
-            // look through that input for the next rising edge. When that edge is found,
-            // we process the current chunk and then allocate the next reader.
+            // look through that input for the next edge. When that edge is found,
+            // we render the readers up to it and then start or stop a reader there.
             auto const playbackMode = mode.load();
             auto const wantsLoop = mode == Mode::Loop;
             auto const ostart = startOffset.load();
             auto const ostop = stopOffset.load();
 
-            // Optionally accept a second input signal specifying the playback rate
+            // Optionally accept a second input signal specifying the playback rate. If
+            // that holds steady for the block, the readers can take a faster path.
             auto const hasPlaybackRateSignal = numChannels >= 2;
+            auto const hasConstantRate = !hasPlaybackRateSignal || ctx.isInputConstant(1);
+            auto const* rates = hasConstantRate ? nullptr : inputData[1];
+            auto const rate = hasPlaybackRateSignal ? inputData[1][0] : FloatType(1);
 
-            for (size_t i = 0; i < numSamples; ++i) {
-                auto cv = change(inputData[0][i]);
-                auto const rate = hasPlaybackRateSignal ? inputData[1][i] : FloatType(1);
+            std::fill_n(outputData, numSamples, FloatType(0));
 
-                // Rising edge
-                if (cv > FloatType(0.5)) {
-                    readers[currentReader & 1].noteOff();
-                    readers[++currentReader & 1].noteOn(ostart);
-                }
+            withInterpolator<FloatType>(interpolation.load(), [&](auto const& interp) {
+                auto renderTo = [&](size_t start, size_t end) {
+                    for (auto& r : rs) {
+                        r.render(interp, outputData + start, end - start, rates != nullptr ? rates + start : nullptr, rate, ostart, ostop, wantsLoop);
+                    }
+                };
+
+                size_t segmentStart = 0;
 
-                // If we're in trigger mode then we can ignore falling edges
-                if (cv < FloatType(-0.5) && playbackMode != Mode::Trigger) {
-                    readers[currentReader & 1].noteOff();
+                for (size_t i = 0; i < numSamples; ++i) {
+                    auto const cv = change(inputData[0][i]);
+                    auto const rising = cv > FloatType(0.5);
+
+                    // If we're in trigger mode then we can ignore falling edges
+                    auto const falling = cv < FloatType(-0.5) && playbackMode != Mode::Trigger;
+
+                    if (!rising && !falling)
+                        continue;
+
+                    renderTo(segmentStart, i);
+                    segmentStart = i;
+
+                    if (rising) {
+                        rs[currentReader & 1].noteOff();
+                        rs[++currentReader & 1].noteOn(ostart);
+                    } else {
+                        rs[currentReader & 1].noteOff();
+                    }
                 }
 
-                // Process both readers for the current sample
-                outputData[i] = readers[0].tick(ostart, ostop, rate, wantsLoop) + readers[1].tick(ostart, ostop, rate, wantsLoop);
-            }
+                renderTo(segmentStart, numSamples);
+            });
         }
 
-        SingleWriterSingleReaderQueue<SharedResourceBuffer<FloatType>> bufferQueue;
-        SharedResourceBuffer<FloatType> activeBuffer;
+        // Either a buffer or a pair of stream voices, one for each reader
+        struct Source {
+            SharedResourceBuffer<FloatType> buffer;
+            std::array<std::shared_ptr<SampleStreamVoice<FloatType>>, 2> voices;
+            size_t channel = 0;
+        };
+
+        SingleWriterSingleReaderQueue<Source> sourceQueue;
+        Source activeSource;
+
+        // Only touched on the non-realtime thread, by setProperty
+        Source latestSource;
 
         Change<FloatType> change;
         std::array<ReaderType, 2> readers;
+        std::array<StreamReaderType, 2> streamReaders;
         size_t currentReader = 0;
 
         enum class Mode
@@ -138,27 +246,83 @@ namespace elem
         };
 
         std::atomic<Mode> mode = Mode::Trigger;
+        std::atomic<InterpolationMode> interpolation = InterpolationMode::Linear;
         std::atomic<size_t> startOffset = 0;
         std::atomic<size_t> stopOffset = 0;
     };
 
-    // A helper struct for reading from sample data with variable rate using
-    // linear interpolation.
+    // The sample data that a reader plays from: one channel of a buffer held entirely
+    // in memory.
+    //
+    // A reader tells its source where playback starts via `seek`, and how far it has
+    // got via `release`, for sources which need to know what to fetch next.
     template <typename FloatType>
-    struct VariablePitchLerpReader
+    struct SampleBufferSource
     {
-        VariablePitchLerpReader() = default;
+        SampleBufferSource() = default;
+
+        SampleBufferSource(SharedResourceBuffer<FloatType> b, size_t channelIndex = 0)
+            : buffer(std::move(b))
+        {
+            if (buffer != nullptr) {
+                channel = buffer->getChannel(std::min(channelIndex, buffer->getNumChannels() - 1));
+            }
+        }
+
+        bool empty() const { return buffer == nullptr; }
+        size_t size() const { return channel.size; }
+        FloatType read(size_t i) const { return channel[i]; }
+
+        void seek(size_t) {}
+        void release(size_t) {}
 
-        VariablePitchLerpReader(FloatType _sampleRate, SharedResourceBuffer<FloatType> _sourceBuffer)
-            : sourceBuffer(_sourceBuffer), sampleRate(_sampleRate), gainSmoothAlpha(1.0 - std::exp(-1.0 / (0.01 * _sampleRate))) {}
+        SharedResourceBuffer<FloatType> buffer;
+        typename SharedResource<FloatType>::Channel channel;
+    };
 
-        VariablePitchLerpReader(VariablePitchLerpReader& other)
-            : sourceBuffer(other.sourceBuffer), sampleRate(other.sampleRate), gainSmoothAlpha(1.0 - std::exp(-1.0 / (0.01 * other.sampleRate))) {}
+    // The sample data that a reader plays from: one voice of a sample stream, which
+    // reads the sample from disk as it plays. See SampleStream.h.
+    template <typename FloatType>
+    struct SampleStreamSource
+    {
+        SampleStreamSource() = default;
+        SampleStreamSource(std::shared_ptr<SampleStreamVoice<FloatType>> v) : voice(std::move(v)) {}
+
+        bool empty() const { return voice == nullptr; }
+        size_t size() const { return voice->size(); }
+        FloatType read(size_t i) const { return voice->read(i); }
+
+        void seek(size_t pos) { voice->seek(pos); }
+        void release(size_t pos) { voice->release(pos); }
+
+        std::shared_ptr<SampleStreamVoice<FloatType>> voice;
+    };
+
+    // A helper struct for reading from sample data with variable rate, which renders
+    // blocks of output through any of the interpolators in helpers/Interpolation.h.
+    //
+    // Wherever the playback rate is constant, the gain has settled, and every sample
+    // the interpolator needs lies inside the buffer, a run of output is rendered without
+    // any of the per-sample checks for the sample's end, for wrapping reads or for the
+    // gain ramp. Otherwise the reader falls back to rendering one checked sample at a time.
+    template <typename FloatType, typename SourceType>
+    struct VariablePitchReader
+    {
+        VariablePitchReader() = default;
+
+        VariablePitchReader(FloatType _sampleRate, SourceType _source)
+            : source(std::move(_source)), sampleRate(_sampleRate), gainSmoothAlpha(1.0 - std::exp(-1.0 / (0.01 * _sampleRate))) {}
+
+        VariablePitchReader(VariablePitchReader& other)
+            : source(other.source), sampleRate(other.sampleRate), gainSmoothAlpha(1.0 - std::exp(-1.0 / (0.01 * other.sampleRate))) {}
 
         void noteOn(size_t const startOffset)
         {
             targetGain = FloatType(1);
             pos = FloatType(startOffset);
+
+            if (!source.empty())
+                source.seek(startOffset);
         }
 
         void noteOff()
@@ -166,41 +330,120 @@ namespace elem
             targetGain = FloatType(0);
         }
 
-        FloatType tick (size_t const startOffset, size_t const stopOffset, FloatType const stepSize, bool const wantsLoop)
+        // True if `render` would add nothing without advancing until the next noteOn
+        bool isIdle() const
+        {
+            return source.empty() || pos < 0.0 || (gain == FloatType(0) && targetGain == FloatType(0));
+        }
+
+        // Adds `numSamples` of output to `out`. The playback rate for each sample comes
+        // from `rates`, or is `rate` throughout if `rates` is null.
+        template <typename Interpolator>
+        void render (Interpolator const& interp, FloatType* out, size_t numSamples, FloatType const* rates, FloatType rate, size_t const startOffset, size_t const stopOffset, bool const wantsLoop)
         {
-            if (sourceBuffer == nullptr || pos < 0.0 || (gain == FloatType(0) && targetGain == FloatType(0)))
-                return FloatType(0);
+            size_t i = 0;
 
-            auto* sourceData = sourceBuffer->data();
-            size_t const sourceLength = sourceBuffer->size();
+            while (i < numSamples) {
+                if (isIdle())
+                    return;
 
-            if (pos >= (double) (sourceLength - stopOffset)) {
-                if (!wantsLoop) {
-                    return FloatType(0);
+                size_t const sourceLength = source.size();
+
+                if (pos >= (double) (sourceLength - stopOffset)) {
+                    if (!wantsLoop) {
+                        return;
+                    }
+
+                    pos = (double) startOffset;
+                    source.seek(startOffset);
+                }
+
+                auto const n = rates == nullptr ? getUncheckedRunLength<Interpolator>(sourceLength, stopOffset, (double) rate) : 0;
+
+                if (n > 0) {
+                    auto const m = std::min(n, numSamples - i);
+                    renderUnchecked(interp, out + i, m, (double) rate);
+                    i += m;
+                    continue;
                 }
 
-                pos = (double) startOffset;
+                out[i] += tick(interp, sourceLength, rates != nullptr ? rates[i] : rate);
+                i++;
+            }
+        }
+
+        SourceType source;
+
+        FloatType sampleRate = 0;
+        FloatType gainSmoothAlpha = 0;
+        FloatType targetGain = 0;
+        FloatType gain = 0;
+        double pos = 0;
+
+    private:
+        // How many samples from here can be rendered at a constant step without reaching
+        // the end of the sample or reading past either edge of the buffer
+        template <typename Interpolator>
+        size_t getUncheckedRunLength(size_t sourceLength, size_t stopOffset, double step) const
+        {
+            if (gain != targetGain || step <= 0.0 || pos < (double) Interpolator::kBefore)
+                return 0;
+
+            auto const end = std::min((double) (sourceLength - stopOffset), (double) sourceLength - (double) Interpolator::kAfter);
+            auto const remaining = (end - pos) / step;
+
+            // Leave a sample of headroom for the rounding in the running position
+            return remaining > 2.0 ? static_cast<size_t>(remaining) - 1 : 0;
+        }
+
+        template <typename Interpolator>
+        void renderUnchecked(Interpolator const& interp, FloatType* out, size_t numSamples, double step)
+        {
+            auto const g = gain;
+            size_t readLeft = 0;
+
+            for (size_t i = 0; i < numSamples; ++i) {
+                readLeft = static_cast<size_t>(pos);
+                auto const frac = FloatType(pos - (double) readLeft);
+
+                out[i] += g * interp([&](int k) { return source.read(readLeft + k); }, frac);
+                pos = pos + step;
             }
 
-            // Linear interpolation on the buffer read
+            // Nothing before the earliest sample the interpolator reads is needed again
+            // until the next seek
+            source.release(readLeft - static_cast<size_t>(Interpolator::kBefore));
+        }
+
+        template <typename Interpolator>
+        FloatType tick (Interpolator const& interp, size_t const sourceLength, FloatType const stepSize)
+        {
+            // Interpolated reads which fall off either end of the buffer wrap around
             auto readLeft = static_cast<size_t>(pos);
-            auto readRight = readLeft + 1;
             auto const frac = FloatType(pos - (double) readLeft);
 
             if (readLeft >= sourceLength)
                 readLeft -= sourceLength;
 
-            if (readRight >= sourceLength)
-                readRight -= sourceLength;
+            auto const x = [&](int k) {
+                auto j = static_cast<int64_t>(readLeft) + k;
+
+                if (j < 0)
+                    j += static_cast<int64_t>(sourceLength);
 
-            auto const left = sourceData[readLeft];
-            auto const right = sourceData[readRight];
+                if (j >= static_cast<int64_t>(sourceLength))
+                    j -= static_cast<int64_t>(sourceLength);
 
-            // Now we can read the next sample out of the buffer with linear
-            // interpolation for sub-sample reads.
-            auto const out = gain * (left + frac * (right - left));
+                return source.read(static_cast<size_t>(j));
+            };
+
+            // Now we can read the next sample out of the buffer with interpolation for
+            // sub-sample reads.
+            auto const out = gain * interp(x, frac);
             auto const gainSettled = std::abs(targetGain - gain) <= std::numeric_limits<FloatType>::epsilon();
 
+            source.release(readLeft - std::min(readLeft, static_cast<size_t>(Interpolator::kBefore)));
+
             // Update our state
             pos = pos + (double) stepSize;
             gain = gainSettled ? targetGain : gain + gainSmoothAlpha * (targetGain - gain);
@@ -209,14 +452,6 @@ namespace elem
             // And return
             return out;
         }
-
-        SharedResourceBuffer<FloatType> sourceBuffer;
-
-        FloatType sampleRate = 0;
-        FloatType gainSmoothAlpha = 0;
-        FloatType targetGain = 0;
-        FloatType gain = 0;
-        double pos = 0;
     };
 
 } // namespace elem
@@ -5,7 +5,7 @@
 #include "../SingleWriterSingleReaderQueue.h"
 
 #include "helpers/Change.h"
-#include "helpers/RefCountedPool.h"
+#include "helpers/ObjectPool.h"
 
 
 namespace elem
@@ -36,6 +36,8 @@ namespace elem
     struct Seq2Node : public GraphNode<FloatType> {
         using GraphNode<FloatType>::GraphNode;
 
+        bool canRenderAtControlRate() override { return true; }
+
         void setProperty(std::string const& key, js::Value const& val) override
         {
             GraphNode<FloatType>::setProperty(key, val);
@@ -59,7 +61,11 @@ namespace elem
             if (key == "seq") {
                 invariant(val.isArray(), "seq prop for seq node must be an array type.");
                 auto& seq = val.getArray();
-                auto data = sequencePool.allocate();
+                auto* data = sequencePool.allocate();
+
+                // Pool exhausted, see SequenceNode
+                if (data == nullptr)
+                    return;
 
                 // The data array that we get from the pool may have been
                 // previously used to represent a different sequence. Need to
@@ -67,7 +73,7 @@ namespace elem
                 data->resize(seq.size());
 
                 for (size_t i = 0; i < seq.size(); ++i)
-                    data->at(i) = FloatType((js::Number) seq[i]);
+                    (*data)[i] = FloatType((js::Number) seq[i]);
 
                 // Finally, we push our new sequence data into the event
                 // queue for the realtime thread.
@@ -83,15 +89,14 @@ namespace elem
 
             // First order of business: grab the most recent sequence buffer to use if
             // there's anything in the queue
-            if (sequenceQueue.size() > 0) {
-                while (sequenceQueue.size() > 0) {
-                    sequenceQueue.pop(activeSequence);
-                }
-            }
+            sequenceQueue.consume([this](SequenceData* next) {
+                sequencePool.release(activeSequence);
+                activeSequence = next;
+            });
 
             // Next, if we don't have the inputs we need, we bail here and zero the buffer
             // hoping to prevent unexpected signals.
-            if (numChannels < 1 || activeSequence == nullptr)
+            if (numChannels < 1 || activeSequence == nullptr || activeSequence->empty())
                 return (void) std::fill_n(outputData, numSamples, FloatType(0));
 
             // We let the user optionally supply a second input, a pulse train whose
@@ -101,6 +106,9 @@ namespace elem
             bool const loop = wantsLoop.load();
             auto const offset = seqOffset.load();
 
+            auto const* seqData = activeSequence->data();
+            auto const seqSize = activeSequence->size();
+
             for (size_t i = 0; i < numSamples; ++i) {
                 auto const in = inputData[0][i];
                 auto const reset = hasResetSignal ? inputData[1][i] : FloatType(0);
@@ -122,15 +130,14 @@ namespace elem
                 //  * Emit 0 if hold = false
                 //  * Emit the last value in the seq array if hold = true
                 //  * Loop around using the modulo operator if loop = true
-                auto const seqSize = activeSequence->size();
                 auto const seqIndex = offset + edgeCount;
 
                 auto const nextOut = (seqIndex < seqSize)
-                    ? activeSequence->at(seqIndex)
+                    ? seqData[seqIndex]
                     : (loop
-                        ? activeSequence->at(seqIndex % seqSize)
+                        ? seqData[seqIndex % seqSize]
                         : (hold
-                            ? activeSequence->at(seqSize - 1)
+                            ? seqData[seqSize - 1]
                             : FloatType(0)));
 
                 // Finally, when holding, we don't fall to 0 with the incoming pulse train.
@@ -140,9 +147,9 @@ namespace elem
 
         using SequenceData = std::vector<FloatType>;
 
-        RefCountedPool<SequenceData> sequencePool;
-        SingleWriterSingleReaderQueue<std::shared_ptr<SequenceData>> sequenceQueue;
-        std::shared_ptr<SequenceData> activeSequence;
+        ObjectPool<SequenceData> sequencePool;
+        SingleWriterSingleReaderQueue<SequenceData*> sequenceQueue;
+        SequenceData* activeSequence = nullptr;
 
         Change<FloatType> change;
         Change<FloatType> resetChange;
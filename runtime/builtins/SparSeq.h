@@ -6,9 +6,12 @@
 #include "../deps/variant.hpp"
 
 #include "helpers/Change.h"
-#include "helpers/RefCountedPool.h"
+#include "helpers/ObjectPool.h"
 
+#include <algorithm>
+#include <numeric>
 #include <optional>
+#include <vector>
 
 
 namespace elem
@@ -17,7 +20,17 @@ namespace elem
     template <typename FloatType>
     struct SparSeqNode : public GraphNode<FloatType> {
         using GraphNode<FloatType>::GraphNode;
-        using SequenceData = std::map<int32_t, FloatType>;
+
+        bool canRenderAtControlRate() override { return true; }
+
+        // The sequence is held as its tick times, sorted and unique, alongside the value
+        // taken at each. Both arrays are contiguous, and keep their capacity when the pool
+        // hands them out again, so that a new sequence of similar length fills in without
+        // allocating and a seek is a binary search over the times alone.
+        struct SequenceData {
+            std::vector<int32_t> times;
+            std::vector<FloatType> values;
+        };
 
         // Here we follow a pattern just like the larger GraphRenderer event queue pattern for
         // moving change events from the non-realtime thread into the realtime thread safely
@@ -27,7 +40,7 @@ namespace elem
         struct EmptyEvent {};
 
         struct NewSequenceEvent {
-            std::shared_ptr<SequenceData> sequence;
+            SequenceData* sequence;
         };
 
         struct NewLoopPointsEvent {
@@ -81,56 +94,118 @@ namespace elem
                 auto const ti = (js::Number) val;
                 invariant(ti >= 0.0, "tickInterval prop for sparseq node must be >= 0");
 
-                auto const tickIntervalSamples = GraphNode<FloatType>::getSampleRate() *  ti;
-                tickInterval.store(tickIntervalSamples);
+                tickInterval.store(ti);
             }
 
             if (key == "seq") {
                 invariant(val.isArray(), "seq prop for sparseq node must be an array type.");
                 auto& seq = val.getArray();
-                auto data = sequencePool.allocate();
+                auto* data = sequencePool.allocate();
+
+                // Pool exhausted, see SequenceNode
+                if (data == nullptr)
+                    return;
 
-                // The data array that we get from the pool may have been
+                // The data that we get from the pool may have been
                 // previously used to represent a different sequence.
-                data->clear();
+                data->times.clear();
+                data->values.clear();
+                data->times.reserve(seq.size());
+                data->values.reserve(seq.size());
 
                 // We expect from the JavaScript side an array of event objects, where each
                 // event includes a value to take and a 32-bit int tick time at which to take that value.
+                bool sorted = true;
+
                 for (size_t i = 0; i < seq.size(); ++i) {
                     auto& event = seq[i].getObject();
 
                     FloatType value = static_cast<FloatType>((js::Number) event.at("value"));
                     int32_t time = static_cast<int32_t>((js::Number) event.at("tickTime"));
 
-                    data->insert({time, value});
+                    sorted = sorted && (data->times.empty() || time > data->times.back());
+
+                    data->times.push_back(time);
+                    data->values.push_back(value);
+                }
+
+                // Sequences usually arrive in order, but otherwise we sort them here, keeping
+                // the first event given for any one tick time
+                if (!sorted) {
+                    sortEvents(*data);
                 }
 
                 // Finally, we push our new sequence data into the event
                 // queue for the realtime thread.
-                changeEventQueue.push(ChangeEvent { NewSequenceEvent { std::move(data) } });
+                //
+                // This queue also carries loop point changes, so unlike the seq node we can't
+                // count on the pool running dry first. If the push fails, the element never
+                // reached the realtime thread and goes straight back to the pool.
+                if (!changeEventQueue.push(ChangeEvent { NewSequenceEvent { data } })) {
+                    sequencePool.recycle(data);
+                }
             }
         }
 
-        typename SequenceData::iterator findTickValue(int32_t tickTime) {
-            // Look up the value we should take by considering where the counter
-            // is in relation to our sparsely defined sequence. We find the first event _after_
-            // the current time using upper_bound, then step back once to find the value we
-            // should take currently.
-            auto it = activeSequence->upper_bound(tickTime);
+        static void sortEvents(SequenceData& data) {
+            std::vector<size_t> order(data.times.size());
+            std::iota(order.begin(), order.end(), size_t(0));
+
+            std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+                return data.times[a] < data.times[b];
+            });
+
+            std::vector<int32_t> times;
+            std::vector<FloatType> values;
+
+            for (auto const i : order) {
+                if (times.empty() || data.times[i] != times.back()) {
+                    times.push_back(data.times[i]);
+                    values.push_back(data.values[i]);
+                }
+            }
 
-            // If we get back the beginning of the map, that means that either
+            // Copied back rather than swapped so that the pooled arrays keep their capacity
+            data.times.assign(times.begin(), times.end());
+            data.values.assign(values.begin(), values.end());
+        }
+
+        // Returns the index of the event whose value we should take at the given tick time,
+        // or the size of the sequence if there is none.
+        size_t findTickValue(int32_t tickTime) {
+            auto const& times = activeSequence->times;
+            auto const size = times.size();
+
+            // Ticks usually arrive one after another, so before searching we check whether
+            // we're still within the event we hold, or have stepped into the next one. This
+            // also validates a hold index left over from a previous sequence.
+            if (holdIndex < size && times[holdIndex] <= tickTime) {
+                if (holdIndex + 1 == size || tickTime < times[holdIndex + 1])
+                    return holdIndex;
+
+                if (holdIndex + 2 >= size || tickTime < times[holdIndex + 2])
+                    return holdIndex + 1;
+            }
+
+            // Otherwise, as on a seek or a loop, we look up the value we should take by
+            // considering where the counter is in relation to our sparsely defined sequence.
+            // We find the first event _after_ the current time using upper_bound, then step
+            // back once to find the value we should take currently.
+            auto it = std::upper_bound(times.begin(), times.end(), tickTime);
+
+            // If we get back the beginning of the sequence, that means that either
             //   (1) the first entry specifies a value for a time that we haven't reached yet,
             //       in which case we just stay silent. Or,
             //   (2) the first entry defines a value for tickTime 0, in which case we take it
-            if (it == activeSequence->begin()) {
-                if (it->first == 0) {
-                    return it;
+            if (it == times.begin()) {
+                if (it != times.end() && *it == 0) {
+                    return 0;
                 }
 
-                return activeSequence->end();
+                return size;
             }
 
-            return --it;
+            return static_cast<size_t>(it - times.begin()) - 1;
         }
 
         int32_t getTickTime(int32_t offset) {
@@ -193,34 +268,32 @@ namespace elem
             auto const offset = seqOffset.load();
             auto const follow = followAction.load();
             auto const ho = holdOrder.load();
-            auto const samplesPerClockCycle = tickInterval.load();
+            auto const samplesPerClockCycle = tickInterval.load() * GraphNode<FloatType>::getSampleRate();
 
             // Current sequence "time" in ticks
             auto tickTime = getTickTime(offset);
 
             // First order of business: grab the most recent sequence buffer to use if
             // there's anything in the queue
-            if (changeEventQueue.size() > 0) {
-                while (changeEventQueue.size() > 0) {
-                    ChangeEvent nextEvent;
-                    changeEventQueue.pop(nextEvent);
-
-                    mpark::visit([this](auto && evt) {
-                        using EventType = std::decay_t<decltype(evt)>;
+            auto const numReceived = changeEventQueue.consume([this](ChangeEvent& nextEvent) {
+                mpark::visit([this](auto && evt) {
+                    using EventType = std::decay_t<decltype(evt)>;
 
-                        if constexpr (std::is_same_v<EventType, NewSequenceEvent>) {
-                            activeSequence = std::move(evt.sequence);
-                        }
+                    if constexpr (std::is_same_v<EventType, NewSequenceEvent>) {
+                        sequencePool.release(activeSequence);
+                        activeSequence = evt.sequence;
+                    }
 
-                        if constexpr (std::is_same_v<EventType, NewLoopPointsEvent>) {
-                            pendingLoopPoints = LoopPoints { evt.loopStart, evt.loopEnd };
-                        }
-                    }, nextEvent);
-                }
+                    if constexpr (std::is_same_v<EventType, NewLoopPointsEvent>) {
+                        pendingLoopPoints = LoopPoints { evt.loopStart, evt.loopEnd };
+                    }
+                }, nextEvent);
+            });
 
+            if (numReceived > 0) {
                 // New sequence, but our internal count state is maintained so we immediately
                 // perform a lookup.
-                holdValue = findTickValue(tickTime);
+                holdIndex = findTickValue(tickTime);
             }
 
             // If after draining the changeEventQueue we have pending loop points, then here we
@@ -242,6 +315,10 @@ namespace elem
             if (numChannels < 1 || activeSequence == nullptr)
                 return (void) std::fill_n(outputData, numSamples, FloatType(0));
 
+            auto const* times = activeSequence->times.data();
+            auto const* values = activeSequence->values.data();
+            auto const numEvents = activeSequence->times.size();
+
             for (size_t i = 0; i < numSamples; ++i) {
                 samplesSinceClockEdge++;
 
@@ -269,11 +346,11 @@ namespace elem
                     tickTime = getTickTime(offset);
 
                     // And update our current hold
-                    holdValue = findTickValue(tickTime);
+                    holdIndex = findTickValue(tickTime);
                 }
 
                 // Invalid hold value; output zeros
-                if (holdValue == activeSequence->end()) {
+                if (holdIndex >= numEvents) {
                     outputData[i] = FloatType(0);
                     continue;
                 }
@@ -281,19 +358,19 @@ namespace elem
                 switch (ho) {
                     case 1:
                     {
-                        auto holdRight = std::next(holdValue);
+                        auto const holdRight = holdIndex + 1;
 
                         // Linear interpolation between two values. If our RHS is off the end of the container
                         // then we just return the last value in the sequence.
-                        if (holdRight == activeSequence->end()) {
-                            outputData[i] = holdValue->second;
+                        if (holdRight == numEvents) {
+                            outputData[i] = values[holdIndex];
                             break;
                         }
 
-                        auto const tl = holdValue->first;
-                        auto const tr = holdRight->first;
-                        auto const leftValue = holdValue->second;
-                        auto const rightValue = holdRight->second;
+                        auto const tl = times[holdIndex];
+                        auto const tr = times[holdRight];
+                        auto const leftValue = values[holdIndex];
+                        auto const rightValue = values[holdRight];
 
                         // This gets us linear interp but still stair-stepped according to the clock edge.
                         double alpha = (double) std::max(0, tickTime - tl) / (double) (tr - tl);
@@ -314,16 +391,16 @@ namespace elem
                     case 0:
                     default:
                     {
-                        outputData[i] = holdValue->second;
+                        outputData[i] = values[holdIndex];
                         break;
                     }
                 }
             }
         }
 
-        RefCountedPool<SequenceData> sequencePool;
+        ObjectPool<SequenceData> sequencePool;
         SingleWriterSingleReaderQueue<ChangeEvent> changeEventQueue;
-        std::shared_ptr<SequenceData> activeSequence;
+        SequenceData* activeSequence = nullptr;
 
         Change<FloatType> change;
         Change<FloatType> resetChange;
@@ -349,10 +426,13 @@ namespace elem
         // The number of elapsed samples counted since the last clock edge.
         size_t samplesSinceClockEdge = 0;
 
-        // Because our sparse lookup uses a binary search, we only want to do it
-        // when we absolutely have to. The rest of the time, we just hold that value here.
-        typename SequenceData::iterator holdValue;
+        // The index of the event whose value we hold, which serves as the cursor for the
+        // next lookup. Because a seek is a binary search, we only want to do one when we
+        // absolutely have to.
+        size_t holdIndex = 0;
         std::atomic<int32_t> holdOrder { 0 };
+
+        // In seconds, which `process` converts to samples at the rate the node renders
         std::atomic<double> tickInterval { 0 };
 
         static_assert(std::atomic<double>::is_always_lock_free);
@@ -0,0 +1,558 @@
+#pragma once
+
+#include "../GraphNode.h"
+#include "../Invariant.h"
+#include "../MultiChannelRingBuffer.h"
+#include "../SingleWriterSingleReaderQueue.h"
+
+#include "helpers/FFT.h"
+#include "helpers/TypedEvents.h"
+
+#include <array>
+#include <cmath>
+
+
+namespace elem
+{
+
+    //==============================================================================
+    // Window shapes for spectral analysis and processing
+    enum class WindowShape
+    {
+        Hann = 0,
+        BlackmanHarris = 1,
+        Rectangular = 2,
+    };
+
+    inline WindowShape parseWindowShape(std::string const& s)
+    {
+        if (s == "hann") { return WindowShape::Hann; }
+        if (s == "blackman-harris") { return WindowShape::BlackmanHarris; }
+        if (s == "rectangular") { return WindowShape::Rectangular; }
+
+        invariant(false, "window prop must be one of \"hann\", \"blackman-harris\" or \"rectangular\".");
+        return WindowShape::Hann;
+    }
+
+    // Fills `data` with a window of the given shape. Periodic windows, which repeat
+    // with a period of `size` samples, are the ones which overlap-add cleanly; symmetric
+    // windows are the usual choice for a one-off analysis.
+    template <typename FloatType>
+    void fillWindow(WindowShape shape, FloatType* data, size_t size, bool periodic)
+    {
+        constexpr double kPi = 3.1415926535897932385;
+        auto const period = static_cast<double>(periodic ? size : size - 1);
+
+        for (size_t i = 0; i < size; ++i) {
+            auto const x = 2.0 * kPi * static_cast<double>(i) / period;
+
+            switch (shape) {
+                case WindowShape::Hann:
+                    data[i] = FloatType(0.5 * (1.0 - std::cos(x)));
+                    break;
+                case WindowShape::BlackmanHarris:
+                    data[i] = FloatType(0.35875 - 0.48829 * std::cos(x) + 0.14128 * std::cos(2.0 * x) - 0.01168 * std::cos(3.0 * x));
+                    break;
+                case WindowShape::Rectangular:
+                default:
+                    data[i] = FloatType(1);
+                    break;
+            }
+        }
+    }
+
+    //==============================================================================
+    // What a spectral kernel is told about the frames it will be given
+    template <typename FloatType>
+    struct StftFrameInfo
+    {
+        size_t size;
+        size_t numBins;
+        size_t hop;
+        double sampleRate;
+
+        // Scales a bin magnitude such that a full scale sinusoid centered on the bin
+        // has a magnitude of one
+        FloatType magnitudeScale;
+    };
+
+    //==============================================================================
+    // The audio thread half of a short-time Fourier transform, for one configuration of
+    // frame size, hop size and window.
+    //
+    // Every `hop` samples the most recent `size` samples of input are windowed and
+    // transformed, handed to the kernel to modify in place, then transformed back and
+    // overlap-added into the output through a synthesis window. The synthesis window is
+    // normalized for the overlap, so that any window shape reconstructs the input exactly
+    // when the kernel leaves the spectrum alone. Output lags input by exactly `size`
+    // samples.
+    //
+    // All of the frame buffers are allocated up front, along with the kernel's own state
+    // for this configuration; processing allocates nothing.
+    template <typename FloatType, typename Kernel>
+    class StftProcessor
+    {
+    public:
+        StftProcessor(size_t size, size_t hop, WindowShape shape, double sampleRate)
+            : size(size)
+            , hop(hop)
+            , mask(size - 1)
+            , fft(size)
+            , analysisWindow(size)
+            , synthesisWindow(size)
+            , inputRing(size, FloatType(0))
+            , outputRing(size, FloatType(0))
+            , frame(size, FloatType(0))
+            , re(size / 2 + 1, FloatType(0))
+            , im(size / 2 + 1, FloatType(0))
+            , state(makeFrameInfo(size, hop, shape, sampleRate))
+        {
+            invariant(hop > 0 && hop <= size / 2 && size % hop == 0, "stft hop size must divide the frame size, and be at most half of it");
+
+            fillWindow(shape, analysisWindow.data(), size, true);
+
+            // Normalize the synthesis window such that the overlapping products of the two
+            // windows sum to one at every position
+            std::vector<double> overlap(hop, 0.0);
+
+            for (size_t i = 0; i < size; ++i) {
+                overlap[i % hop] += double(analysisWindow[i]) * double(analysisWindow[i]);
+            }
+
+            for (size_t i = 0; i < size; ++i) {
+                auto const sum = overlap[i % hop];
+                synthesisWindow[i] = sum > 1e-9 ? FloatType(double(analysisWindow[i]) / sum) : FloatType(0);
+            }
+        }
+
+        size_t getLatency() const { return size; }
+
+        void process(Kernel& kernel, FloatType const* input, FloatType* output, size_t numSamples)
+        {
+            size_t done = 0;
+
+            while (done < numSamples) {
+                auto const len = std::min({ numSamples - done, hop - hopFill, size - pos });
+
+                for (size_t i = 0; i < len; ++i) {
+                    inputRing[pos + i] = input[done + i];
+                    output[done + i] = outputRing[pos + i];
+                    outputRing[pos + i] = FloatType(0);
+                }
+
+                pos = (pos + len) & mask;
+                hopFill += len;
+                done += len;
+
+                if (hopFill == hop) {
+                    hopFill = 0;
+                    processFrame(kernel);
+                }
+            }
+        }
+
+    private:
+        static StftFrameInfo<FloatType> makeFrameInfo(size_t size, size_t hop, WindowShape shape, double sampleRate)
+        {
+            std::vector<FloatType> w(size);
+            fillWindow(shape, w.data(), size, true);
+
+            double sum = 0;
+
+            for (auto const x : w) {
+                sum += double(x);
+            }
+
+            return { size, size / 2 + 1, hop, sampleRate, FloatType(2.0 / sum) };
+        }
+
+        void processFrame(Kernel& kernel)
+        {
+            // The ring's oldest sample is at the write position
+            for (size_t i = 0; i < size; ++i) {
+                frame[i] = inputRing[(pos + i) & mask] * analysisWindow[i];
+            }
+
+            fft.forward(frame.data(), re.data(), im.data());
+            kernel.process(state, re.data(), im.data(), re.size());
+            fft.inverse(re.data(), im.data(), frame.data());
+
+            for (size_t i = 0; i < size; ++i) {
+                outputRing[(pos + i) & mask] += frame[i] * synthesisWindow[i];
+            }
+        }
+
+        size_t size;
+        size_t hop;
+        size_t mask;
+        size_t pos = 0;
+        size_t hopFill = 0;
+
+        RealFFT<FloatType> fft;
+        std::vector<FloatType> analysisWindow;
+        std::vector<FloatType> synthesisWindow;
+        std::vector<FloatType> inputRing;
+        std::vector<FloatType> outputRing;
+        std::vector<FloatType> frame;
+        std::vector<FloatType> re;
+        std::vector<FloatType> im;
+
+        typename Kernel::State state;
+    };
+
+    //==============================================================================
+    // A node which runs its input through a short-time Fourier transform, with `Kernel`
+    // processing each frame's spectrum on the audio thread.
+    //
+    // Props:
+    //   size     The frame size, a power of two from 64 to 16384, 1024 by default
+    //   hop      The hop size, a power of two no more than half the frame size. A quarter
+    //            of the frame size by default, and clamped to half of it
+    //   window   "hann" by default, or "blackman-harris" or "rectangular"
+    //
+    // Any other props go to the kernel, which must provide:
+    //
+    //   struct State                   Per-configuration state, constructed from a
+    //                                  StftFrameInfo on the non-realtime thread
+    //   void setProperty(key, value)   Called on the non-realtime thread
+    //   void process(State&, re, im, numBins)
+    //                                  Modifies a spectrum in place on the audio thread
+    //
+    // Changing the size, hop or window builds a new processor on the non-realtime thread,
+    // and restarts the transform with a gap of one frame's latency.
+    template <typename FloatType, typename Kernel>
+    struct StftNode : public GraphNode<FloatType> {
+        using Processor = StftProcessor<FloatType, Kernel>;
+
+        StftNode(NodeId id, FloatType const sr, int const blockSize)
+            : GraphNode<FloatType>::GraphNode(id, sr, blockSize)
+        {
+            GraphNode<FloatType>::enableEventNotifications();
+            processorQueue.push(createProcessor());
+        }
+
+        void setProperty(std::string const& key, js::Value const& val) override
+        {
+            GraphNode<FloatType>::setProperty(key, val);
+
+            if (key == "size" || key == "hop") {
+                invariant(val.isNumber(), key + " prop on the stft node must be a number");
+
+                auto const n = static_cast<int>((js::Number) val);
+                invariant(n > 0 && (n & (n - 1)) == 0, key + " prop on the stft node must be a power of two");
+                invariant(key == "hop" || (n >= 64 && n <= 16384), "size prop on the stft node must be between 64 and 16384");
+
+                (key == "size" ? size : hop) = static_cast<size_t>(n);
+            }
+
+            if (key == "window") {
+                invariant(val.isString(), "window prop on the stft node must be a string");
+                window = parseWindowShape((js::String) val);
+            }
+
+            if (key == "size" || key == "hop" || key == "window") {
+                releaseRetired();
+                processorQueue.push(createProcessor());
+                return;
+            }
+
+            kernel.setProperty(key, val);
+        }
+
+        std::shared_ptr<Processor> createProcessor()
+        {
+            auto const h = hop > 0 ? std::min(hop, size / 2) : size / 4;
+            return std::make_shared<Processor>(size, h, window, GraphNode<FloatType>::getSampleRate());
+        }
+
+        void process (BlockContext<FloatType> const& ctx) override {
+            auto** inputData = ctx.inputData;
+            auto* outputData = ctx.outputData;
+            auto numChannels = ctx.numInputChannels;
+            auto numSamples = ctx.numSamples;
+
+            // Keeping the most recent processor in the queue, each one it replaces goes back
+            // to the non-realtime thread to be freed
+            std::shared_ptr<Processor> next;
+
+            while (processorQueue.pop(next)) {
+                if (processor != nullptr) {
+                    (void) retiredQueue.push(std::move(processor));
+                    GraphNode<FloatType>::notifyEventsPending();
+                }
+
+                processor = std::move(next);
+            }
+
+            if (numChannels < 1 || processor == nullptr)
+                return (void) std::fill_n(outputData, numSamples, FloatType(0));
+
+            processor->process(kernel, inputData[0], outputData, numSamples);
+        }
+
+        void processEvents(std::function<void(std::string const&, js::Value)>&) override {
+            releaseRetired();
+        }
+
+        void releaseRetired()
+        {
+            std::shared_ptr<Processor> retired;
+
+            while (retiredQueue.pop(retired)) {
+                retired.reset();
+            }
+        }
+
+        size_t size = 1024;
+        size_t hop = 0;
+        WindowShape window = WindowShape::Hann;
+
+        Kernel kernel;
+
+        SingleWriterSingleReaderQueue<std::shared_ptr<Processor>> processorQueue;
+        SingleWriterSingleReaderQueue<std::shared_ptr<Processor>> retiredQueue;
+        std::shared_ptr<Processor> processor;
+    };
+
+    //==============================================================================
+    // A spectral gate: bins quieter than `threshold`, in decibels relative to a full
+    // scale sinusoid, -60 by default, are attenuated down to `floor`, -80dB by default.
+    // Bins open at once, and close over about 20ms, which avoids most of the warbling
+    // of a hard gate. Useful as a simple broadband denoiser.
+    template <typename FloatType>
+    struct SpectralGateKernel
+    {
+        struct State
+        {
+            State(StftFrameInfo<FloatType> const& info)
+                : gains(info.numBins, FloatType(1))
+                , magnitudeScale(info.magnitudeScale)
+                , release(FloatType(1.0 - std::exp(-static_cast<double>(info.hop) / (0.02 * info.sampleRate))))
+            {}
+
+            std::vector<FloatType> gains;
+            FloatType magnitudeScale;
+            FloatType release;
+        };
+
+        void setProperty(std::string const& key, js::Value const& val)
+        {
+            if (key == "threshold" || key == "floor") {
+                invariant(val.isNumber(), key + " prop on the spectral gate must be a number");
+
+                auto const gain = FloatType(std::pow(10.0, (js::Number) val / 20.0));
+                (key == "threshold" ? threshold : floor).store(gain);
+            }
+        }
+
+        void process(State& state, FloatType* re, FloatType* im, size_t numBins)
+        {
+            auto const t = threshold.load() / state.magnitudeScale;
+            auto const f = floor.load();
+            auto const t2 = t * t;
+
+            for (size_t k = 0; k < numBins; ++k) {
+                auto const power = re[k] * re[k] + im[k] * im[k];
+                auto const target = power >= t2 ? FloatType(1) : f;
+                auto& g = state.gains[k];
+
+                g = target > g ? target : g + (target - g) * state.release;
+
+                re[k] *= g;
+                im[k] *= g;
+            }
+        }
+
+        std::atomic<FloatType> threshold = FloatType(0.001);
+        std::atomic<FloatType> floor = FloatType(0.0001);
+    };
+
+    // A spectral freeze: while the `frozen` prop is true the kernel holds the spectrum
+    // from the moment it was frozen, advancing each bin's phase by the amount it was
+    // last seen to advance per hop, which sustains the sound as a steady drone.
+    template <typename FloatType>
+    struct SpectralFreezeKernel
+    {
+        struct State
+        {
+            State(StftFrameInfo<FloatType> const& info)
+                : magnitudes(info.numBins, FloatType(0))
+                , phases(info.numBins, FloatType(0))
+                , deltas(info.numBins, FloatType(0))
+                , lastPhases(info.numBins, FloatType(0))
+            {}
+
+            std::vector<FloatType> magnitudes;
+            std::vector<FloatType> phases;
+            std::vector<FloatType> deltas;
+            std::vector<FloatType> lastPhases;
+            bool wasFrozen = false;
+        };
+
+        void setProperty(std::string const& key, js::Value const& val)
+        {
+            if (key == "frozen") {
+                invariant(val.isBool(), "frozen prop on the spectral freeze must be a boolean");
+                frozen.store((js::Boolean) val);
+            }
+        }
+
+        void process(State& state, FloatType* re, FloatType* im, size_t numBins)
+        {
+            auto const isFrozen = frozen.load();
+
+            if (!isFrozen) {
+                for (size_t k = 0; k < numBins; ++k) {
+                    auto const phase = std::atan2(im[k], re[k]);
+
+                    state.deltas[k] = phase - state.lastPhases[k];
+                    state.lastPhases[k] = phase;
+                }
+
+                state.wasFrozen = false;
+                return;
+            }
+
+            if (!state.wasFrozen) {
+                for (size_t k = 0; k < numBins; ++k) {
+                    state.magnitudes[k] = std::sqrt(re[k] * re[k] + im[k] * im[k]);
+                    state.phases[k] = std::atan2(im[k], re[k]);
+                }
+
+                state.wasFrozen = true;
+            }
+
+            constexpr FloatType kTwoPi = FloatType(6.283185307179586);
+
+            for (size_t k = 0; k < numBins; ++k) {
+                auto& phase = state.phases[k];
+
+                phase += state.deltas[k];
+                phase -= kTwoPi * std::floor(phase / kTwoPi);
+
+                re[k] = state.magnitudes[k] * std::cos(phase);
+                im[k] = state.magnitudes[k] * std::sin(phase);
+            }
+        }
+
+        std::atomic<bool> frozen = false;
+    };
+
+    //==============================================================================
+    // An FFT node which reports the spectrum of its input through the event processing
+    // interface, passing its input through unchanged.
+    //
+    // Each call to processEvents reports at most one frame, the next `size` samples
+    // from the ring buffer, as an "fft" event. The analysis runs in buffers allocated
+    // when the size is set, and writes into the frames of an EventBuffer, so draining
+    // events into a reused buffer allocates nothing.
+    //
+    // Expects exactly one child.
+    template <typename FloatType>
+    struct FFTNode : public TypedEventNode<FloatType> {
+        FFTNode(NodeId id, FloatType const sr, int const blockSize)
+            : TypedEventNode<FloatType>::TypedEventNode(id, sr, blockSize)
+            , ringBuffer(1)
+        {
+            GraphNode<FloatType>::bindProperty("size", size);
+            GraphNode<FloatType>::bindProperty("name", name);
+            GraphNode<FloatType>::enableEventNotifications();
+
+            resize(static_cast<size_t>(size));
+        }
+
+        void setProperty(std::string const& key, js::Value const& val) override
+        {
+            if (key == "size") {
+                invariant(val.isNumber(), "size prop on the fft node must be a number.");
+
+                int const n = static_cast<int>((js::Number) val);
+
+                invariant((n > 255) && (n < 8193), "size prop on the fft node must be betwen 256 and 8192, inclusive");
+                invariant((n & (n - 1)) == 0, "size prop on the fft node must be a power of two");
+
+                resize(static_cast<size_t>(n));
+            }
+
+            if (key == "name") {
+                invariant(val.isString(), "name prop on the fft node must be a string.");
+            }
+
+            GraphNode<FloatType>::setProperty(key, val);
+        }
+
+        void resize(size_t n)
+        {
+            fft.init(n);
+            scratchData.resize(n);
+            window.resize(n);
+            re.resize(fft.getNumBins());
+            im.resize(fft.getNumBins());
+
+            fillWindow(WindowShape::BlackmanHarris, window.data(), n, false);
+        }
+
+        void process (BlockContext<FloatType> const& ctx) override {
+            auto** inputData = ctx.inputData;
+            auto* outputData = ctx.outputData;
+            auto numChannels = ctx.numInputChannels;
+            auto numSamples = ctx.numSamples;
+
+            // If we don't have the inputs we need, we bail here and zero the buffer
+            // hoping to prevent unexpected signals.
+            if (numChannels < 1)
+                return (void) std::fill_n(outputData, numSamples, FloatType(0));
+
+            // Copy input to output
+            std::copy_n(inputData[0], numSamples, outputData);
+
+            // Fill our ring buffer
+            ringBuffer.write(inputData, 1, numSamples);
+            GraphNode<FloatType>::notifyEventsPending();
+        }
+
+        void processEvents(EventBuffer& events) override {
+            auto const n = scratchData.size();
+
+            // If we have enough samples, read from the ring buffer into the scratch, then process
+            std::array<FloatType*, 1> data {scratchData.data()};
+
+            if (ringBuffer.size() < n || !ringBuffer.read(data.data(), 1, n))
+                return;
+
+            // Window the data first...
+            for (size_t i = 0; i < n; ++i) {
+                scratchData[i] *= window[i];
+            }
+
+            auto const numBins = fft.getNumBins();
+            auto* frames = events.pushFrames(EventType::FFT, GraphNode<FloatType>::getId(), name, 2, numBins);
+
+            // Then transform it straight into the event's frames where we can
+            if constexpr (std::is_same_v<FloatType, float>) {
+                fft.forward(scratchData.data(), frames, frames + numBins);
+            }
+
+            if constexpr (!std::is_same_v<FloatType, float>) {
+                fft.forward(scratchData.data(), re.data(), im.data());
+
+                for (size_t k = 0; k < numBins; ++k) {
+                    frames[k] = static_cast<float>(re[k]);
+                    frames[numBins + k] = static_cast<float>(im[k]);
+                }
+            }
+        }
+
+        RealFFT<FloatType> fft;
+        std::vector<FloatType> window;
+        std::vector<FloatType> scratchData;
+        std::vector<FloatType> re;
+        std::vector<FloatType> im;
+        MultiChannelRingBuffer<FloatType> ringBuffer;
+
+        // Bound to the node's props
+        js::Number size = 1024;
+        js::Value name;
+    };
+
+} // namespace elem
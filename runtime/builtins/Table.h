@@ -5,6 +5,8 @@
 #include "../SingleWriterSingleReaderQueue.h"
 #include "../Types.h"
 
+#include "./helpers/Interpolation.h"
+
 
 namespace elem
 {
@@ -13,7 +15,10 @@ namespace elem
     //
     // Can be used for loading sample buffers and reading from them at variable
     // playback rates, or as windowed grain readers, or for loading various functions
-    // as lookup tables, etc.
+    // as lookup tables, etc. For multichannel resources, the `channel` property picks
+    // which channel to read: the first by default, and the last for any channel beyond
+    // the resource's own. The `interpolation` property chooses how the table is read
+    // between its samples: "linear" by default, "hermite", or "sinc".
     template <typename FloatType>
     struct TableNode : public GraphNode<FloatType> {
         using GraphNode<FloatType>::GraphNode;
@@ -29,6 +34,26 @@ namespace elem
                 auto ref = resources.get((js::String) val);
                 bufferQueue.push(std::move(ref));
             }
+
+            if (key == "interpolation") {
+                invariant(val.isString(), "interpolation prop for the table node must be a string.");
+                auto const m = parseInterpolationMode((js::String) val);
+
+                // Make sure the sinc table is built here rather than on the realtime thread
+                if (m == InterpolationMode::Sinc)
+                    SincInterpolator<FloatType>::getTable();
+
+                interpolation.store(m);
+            }
+
+            if (key == "channel") {
+                invariant(val.isNumber(), "channel prop for the table node must be a number.");
+
+                auto const vi = static_cast<int>((js::Number) val);
+                invariant(vi >= 0, "channel prop for the table node must be a positive number.");
+
+                channel.store(static_cast<size_t>(vi));
+            }
         }
 
         void process (BlockContext<FloatType> const& ctx) override {
@@ -40,36 +65,48 @@ namespace elem
             // First order of business: grab the most recent sample buffer to use if
             // there's anything in the queue. This behavior means that changing the buffer
             // while playing the sample will cause a discontinuity.
-            while (bufferQueue.size() > 0)
-                bufferQueue.pop(activeBuffer);
+            bufferQueue.popAll(activeBuffer);
 
             if (numChannels == 0 || activeBuffer == nullptr)
                 return (void) std::fill_n(outputData, numSamples, FloatType(0));
 
-            auto const bufferSize = static_cast<int>(activeBuffer->size());
-            auto const bufferData = activeBuffer->data();
+            auto const channelIndex = std::min(channel.load(), activeBuffer->getNumChannels() - 1);
+            auto const& bufferData = activeBuffer->getChannel(channelIndex);
+            auto const bufferSize = static_cast<int>(bufferData.size);
 
             if (bufferSize == 0)
                 return (void) std::fill_n(outputData, numSamples, FloatType(0));
 
             // Finally, render sample output
-            for (size_t i = 0; i < numSamples; ++i) {
-                auto const readPos = std::clamp(inputData[0][i], FloatType(0), FloatType(1)) * FloatType(bufferSize - 1);
-                auto const readLeft = static_cast<int>(readPos);
-                auto const readRight = readLeft + 1;
-                auto const frac = readPos - std::floor(readPos);
-
-                auto const left = bufferData[readLeft % bufferSize];
-                auto const right = bufferData[readRight % bufferSize];
-
-                // Now we can read the next sample out with linear
-                // interpolation for sub-sample reads.
-                outputData[i] = left + frac * (right - left);
-            }
+            withInterpolator<FloatType>(interpolation.load(), [&](auto const& interp) {
+                using Interpolator = std::decay_t<decltype(interp)>;
+
+                for (size_t i = 0; i < numSamples; ++i) {
+                    auto const readPos = std::clamp(inputData[0][i], FloatType(0), FloatType(1)) * FloatType(bufferSize - 1);
+                    auto const readLeft = static_cast<int>(readPos);
+                    auto const frac = readPos - std::floor(readPos);
+
+                    // Reads inside the table need no wrapping
+                    if (readLeft >= Interpolator::kBefore && readLeft + Interpolator::kAfter < bufferSize) {
+                        outputData[i] = interp([&](int k) { return bufferData[static_cast<size_t>(readLeft + k)]; }, frac);
+                        continue;
+                    }
+
+                    // Now we can read the next sample out with interpolation for sub-sample
+                    // reads, wrapping around the ends of the table
+                    outputData[i] = interp([&](int k) {
+                        auto const j = ((readLeft + k) % bufferSize + bufferSize) % bufferSize;
+                        return bufferData[static_cast<size_t>(j)];
+                    }, frac);
+                }
+            });
         }
 
         SingleWriterSingleReaderQueue<SharedResourceBuffer<FloatType>> bufferQueue;
         SharedResourceBuffer<FloatType> activeBuffer;
+
+        std::atomic<size_t> channel = 0;
+        std::atomic<InterpolationMode> interpolation = InterpolationMode::Linear;
     };
 
 } // namespace elem
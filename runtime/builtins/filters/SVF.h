@@ -1,7 +1,9 @@
 #pragma once
 
+#include "../../Denormals.h"
 #include "../../GraphNode.h"
 #include "../../Invariant.h"
+#include "../helpers/VoiceBatch.h"
 
 
 namespace elem
@@ -17,8 +19,8 @@ namespace elem
     // fast modulation at the processing expense of computing the coefficients on
     // every tick of the filter.
     template <typename FloatType>
-    struct StateVariableFilterNode : public GraphNode<FloatType> {
-        using GraphNode<FloatType>::GraphNode;
+    struct StateVariableFilterNode : public BatchableNode<FloatType> {
+        using BatchableNode<FloatType>::BatchableNode;
 
         enum class Mode {
             Low = 0,
@@ -52,20 +54,7 @@ namespace elem
             _ic1eq = v1 * 2.0 - _ic1eq;
             _ic2eq = v2 * 2.0 - _ic2eq;
 
-            switch (m) {
-                case Mode::Low:
-                    return FloatType(v2);
-                case Mode::Band:
-                    return FloatType(v1);
-                case Mode::High:
-                    return FloatType(v0 - _k * v1 - v2);
-                case Mode::Notch:
-                    return FloatType(v0 - _k * v1);
-                case Mode::All:
-                    return FloatType(v0 - 2.0 * _k * v1);
-                default:
-                    return FloatType(0);
-            }
+            return output(m, v0, v1, v2, _k);
         }
 
         inline void updateCoeffs (double fc, double q) {
@@ -90,6 +79,22 @@ namespace elem
             if (numChannels < 3)
                 return (void) std::fill_n(outputData, numSamples, FloatType(0));
 
+            if (trySleep(ctx))
+                return;
+
+            // With a constant cutoff and Q, the coefficients need only be computed once
+            if (ctx.isInputConstant(0) && ctx.isInputConstant(1)) {
+                updateCoeffs(inputData[0][0], inputData[1][0]);
+
+                for (size_t i = 0; i < numSamples; ++i) {
+                    outputData[i] = tick(m, inputData[2][i]);
+                }
+
+                _ic1eq = flushDenormal(_ic1eq);
+                _ic2eq = flushDenormal(_ic2eq);
+                return;
+            }
+
             for (size_t i = 0; i < numSamples; ++i) {
                 auto fc = inputData[0][i];
                 auto q = inputData[1][i];
@@ -101,6 +106,144 @@ namespace elem
                 // Tick the filter
                 outputData[i] = tick(m, xn);
             }
+
+            _ic1eq = flushDenormal(_ic1eq);
+            _ic2eq = flushDenormal(_ic2eq);
+        }
+
+        // A filter at rest on a silent input stays at rest, so we can skip the block. The
+        // coefficients are recomputed before every tick, so we needn't keep them up to date.
+        bool trySleep(BlockContext<FloatType> const& ctx) {
+            if (_ic1eq != 0.0 || _ic2eq != 0.0 || !ctx.isInputConstant(2) || ctx.inputData[2][0] != FloatType(0))
+                return false;
+
+            std::fill_n(ctx.outputData, ctx.numSamples, FloatType(0));
+            ctx.markOutputConstant();
+            return true;
+        }
+
+        typename BatchableNode<FloatType>::BatchFn getBatchFunction() override {
+            return &processBatch;
+        }
+
+        static void processBatch(BatchableNode<FloatType>* const* nodes, BlockContext<FloatType> const* contexts, size_t count) {
+            if (contexts[0].numInputChannels < 3) {
+                for (size_t i = 0; i < count; ++i) {
+                    nodes[i]->process(contexts[i]);
+                }
+
+                return;
+            }
+
+            batch::forEachGroup<StateVariableFilterNode>(nodes, contexts, count, [](StateVariableFilterNode* const* group, BlockContext<FloatType> const* const* lanes, size_t n) {
+                using namespace batch;
+
+                double ic1eq[kLanes] = {};
+                double ic2eq[kLanes] = {};
+                Mode modes[kLanes] = {};
+                bool uniform = true;
+
+                for (size_t l = 0; l < n; ++l) {
+                    ic1eq[l] = group[l]->_ic1eq;
+                    ic2eq[l] = group[l]->_ic2eq;
+                    modes[l] = group[l]->_mode.load();
+                    uniform = uniform && modes[l] == modes[0];
+                }
+
+                // Coefficients are computed one lane at a time, as the tangent doesn't
+                // vectorize, and only once per block for lanes whose cutoff and Q are constant
+                //
+                // NB: The tiles are double precision, matching the state of the filter
+                Tile<double> k, a1, a2, a3, v0;
+                Tile<FloatType> fc, q, x;
+                FloatType out[kTileSize][kLanes] = {};
+
+                auto const numSamples = lanes[0]->numSamples;
+
+                for (size_t start = 0; start < numSamples; start += kTileSize) {
+                    auto const len = std::min(kTileSize, numSamples - start);
+
+                    load(fc, lanes, n, 0, start, len);
+                    load(q, lanes, n, 1, start, len);
+                    load(x, lanes, n, 2, start, len);
+
+                    for (size_t l = 0; l < n; ++l) {
+                        auto* node = group[l];
+                        bool const fixed = lanes[l]->isInputConstant(0) && lanes[l]->isInputConstant(1);
+
+                        for (size_t i = 0; i < len; ++i) {
+                            if (!fixed || (start == 0 && i == 0)) {
+                                node->updateCoeffs(fc[i][l], q[i][l]);
+                            }
+
+                            k[i][l] = node->_k;
+                            a1[i][l] = node->_a1;
+                            a2[i][l] = node->_a2;
+                            a3[i][l] = node->_a3;
+                            v0[i][l] = static_cast<double>(x[i][l]);
+                        }
+                    }
+
+                    auto const tickAll = [&](auto const mode) {
+                        for (size_t i = 0; i < len; ++i) {
+                            for (size_t l = 0; l < kLanes; ++l) {
+                                auto const m = decltype(mode)::value == -1 ? modes[l] : static_cast<Mode>(decltype(mode)::value);
+                                auto const vn = v0[i][l];
+
+                                double v3 = vn - ic2eq[l];
+                                double v1 = ic1eq[l] * a1[i][l] + v3 * a2[i][l];
+                                double v2 = ic2eq[l] + ic1eq[l] * a2[i][l] + v3 * a3[i][l];
+
+                                ic1eq[l] = v1 * 2.0 - ic1eq[l];
+                                ic2eq[l] = v2 * 2.0 - ic2eq[l];
+
+                                out[i][l] = output(m, vn, v1, v2, k[i][l]);
+                            }
+                        }
+                    };
+
+                    // Lanes sharing a mode, by far the common case, get a loop without a
+                    // branch in it
+                    switch (uniform ? static_cast<int>(modes[0]) : -1) {
+                        case 0: tickAll(std::integral_constant<int, 0>()); break;
+                        case 1: tickAll(std::integral_constant<int, 1>()); break;
+                        case 2: tickAll(std::integral_constant<int, 2>()); break;
+                        case 3: tickAll(std::integral_constant<int, 3>()); break;
+                        case 4: tickAll(std::integral_constant<int, 4>()); break;
+                        default: tickAll(std::integral_constant<int, -1>()); break;
+                    }
+
+                    for (size_t l = 0; l < n; ++l) {
+                        auto* o = lanes[l]->outputData + start;
+
+                        for (size_t i = 0; i < len; ++i) {
+                            o[i] = out[i][l];
+                        }
+                    }
+                }
+
+                for (size_t l = 0; l < n; ++l) {
+                    group[l]->_ic1eq = flushDenormal(ic1eq[l]);
+                    group[l]->_ic2eq = flushDenormal(ic2eq[l]);
+                }
+            });
+        }
+
+        static FloatType output(Mode m, double v0, double v1, double v2, double k) {
+            switch (m) {
+                case Mode::Low:
+                    return FloatType(v2);
+                case Mode::Band:
+                    return FloatType(v1);
+                case Mode::High:
+                    return FloatType(v0 - k * v1 - v2);
+                case Mode::Notch:
+                    return FloatType(v0 - k * v1);
+                case Mode::All:
+                    return FloatType(v0 - 2.0 * k * v1);
+                default:
+                    return FloatType(0);
+            }
         }
 
         // Props
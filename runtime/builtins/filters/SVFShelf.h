@@ -1,5 +1,6 @@
 #pragma once
 
+#include "../../Denormals.h"
 #include "../../GraphNode.h"
 #include "../../Invariant.h"
 
@@ -106,6 +107,9 @@ namespace elem
                 // Tick the filter
                 outputData[i] = tick(m, xn);
             }
+
+            _ic1eq = flushDenormal(_ic1eq);
+            _ic2eq = flushDenormal(_ic2eq);
         }
 
         // Props
@@ -0,0 +1,376 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "FFT.h"
+#include "../../Invariant.h"
+#include "../../RenderThreadPool.h"
+
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+  #define ELEM_HAS_THREADS 1
+#endif
+
+
+namespace elem
+{
+
+    //==============================================================================
+    // A uniformly partitioned convolver with no latency.
+    //
+    // The impulse response is cut into segments of blockSize samples, each transformed
+    // once up front, and the transforms of the most recent blocks of input are kept in a
+    // ring. Every call then runs one forward and one inverse transform of twice the block
+    // size, however many samples it's given, and the products of all but the newest input
+    // block with their segments are summed once per block rather than once per call.
+    template <typename FloatType>
+    class UniformConvolver
+    {
+    public:
+        void init(size_t blockSize, FloatType const* ir, size_t irSize)
+        {
+            invariant(blockSize >= 2 && (blockSize & (blockSize - 1)) == 0, "convolver block size must be a power of two");
+
+            this->blockSize = blockSize;
+            numSegments = (irSize + blockSize - 1) / blockSize;
+
+            fft.init(2 * blockSize);
+            numBins = fft.getNumBins();
+
+            irRe.assign(numSegments * numBins, FloatType(0));
+            irIm.assign(numSegments * numBins, FloatType(0));
+            inRe.assign(numSegments * numBins, FloatType(0));
+            inIm.assign(numSegments * numBins, FloatType(0));
+
+            std::vector<FloatType> padded(2 * blockSize);
+
+            for (size_t s = 0; s < numSegments; ++s) {
+                auto const offset = s * blockSize;
+                auto const len = std::min(blockSize, irSize - offset);
+
+                std::fill(padded.begin(), padded.end(), FloatType(0));
+                std::copy_n(ir + offset, len, padded.begin());
+
+                fft.forward(padded.data(), irRe.data() + s * numBins, irIm.data() + s * numBins);
+            }
+
+            accRe.assign(numBins, FloatType(0));
+            accIm.assign(numBins, FloatType(0));
+            sumRe.assign(numBins, FloatType(0));
+            sumIm.assign(numBins, FloatType(0));
+
+            inputBuffer.assign(2 * blockSize, FloatType(0));
+            outputBuffer.assign(2 * blockSize, FloatType(0));
+            overlap.assign(blockSize, FloatType(0));
+
+            inputFill = 0;
+            current = 0;
+        }
+
+        bool isEmpty() const { return numSegments == 0; }
+
+        void reset()
+        {
+            std::fill(inRe.begin(), inRe.end(), FloatType(0));
+            std::fill(inIm.begin(), inIm.end(), FloatType(0));
+            std::fill(inputBuffer.begin(), inputBuffer.end(), FloatType(0));
+            std::fill(overlap.begin(), overlap.end(), FloatType(0));
+
+            inputFill = 0;
+            current = 0;
+        }
+
+        // Convolves `numSamples` of input into the output, which may not be the same buffer
+        void process(FloatType const* input, FloatType* output, size_t numSamples)
+        {
+            if (numSegments == 0)
+                return (void) std::fill_n(output, numSamples, FloatType(0));
+
+            size_t processed = 0;
+
+            while (processed < numSamples) {
+                auto const wasEmpty = inputFill == 0;
+                auto const len = std::min(numSamples - processed, blockSize - inputFill);
+                auto const offset = inputFill;
+
+                std::copy_n(input + processed, len, inputBuffer.data() + offset);
+
+                auto* re = inRe.data() + current * numBins;
+                auto* im = inIm.data() + current * numBins;
+
+                fft.forward(inputBuffer.data(), re, im);
+
+                // The older blocks of input only change once per block
+                if (wasEmpty) {
+                    std::fill(sumRe.begin(), sumRe.end(), FloatType(0));
+                    std::fill(sumIm.begin(), sumIm.end(), FloatType(0));
+
+                    for (size_t s = 1; s < numSegments; ++s) {
+                        auto const block = (current + s) % numSegments;
+
+                        multiplyAdd(sumRe.data(), sumIm.data(),
+                            irRe.data() + s * numBins, irIm.data() + s * numBins,
+                            inRe.data() + block * numBins, inIm.data() + block * numBins);
+                    }
+                }
+
+                std::copy(sumRe.begin(), sumRe.end(), accRe.begin());
+                std::copy(sumIm.begin(), sumIm.end(), accIm.begin());
+
+                multiplyAdd(accRe.data(), accIm.data(), irRe.data(), irIm.data(), re, im);
+                fft.inverse(accRe.data(), accIm.data(), outputBuffer.data());
+
+                for (size_t i = 0; i < len; ++i) {
+                    output[processed + i] = outputBuffer[offset + i] + overlap[offset + i];
+                }
+
+                inputFill += len;
+
+                // With a full block of input, what spills past it overlaps the next
+                if (inputFill == blockSize) {
+                    std::copy_n(outputBuffer.data() + blockSize, blockSize, overlap.data());
+                    std::fill_n(inputBuffer.data(), blockSize, FloatType(0));
+
+                    inputFill = 0;
+                    current = (current > 0) ? current - 1 : numSegments - 1;
+                }
+
+                processed += len;
+            }
+        }
+
+    private:
+        void multiplyAdd(FloatType* accRe, FloatType* accIm, FloatType const* aRe, FloatType const* aIm, FloatType const* bRe, FloatType const* bIm)
+        {
+            for (size_t k = 0; k < numBins; ++k) {
+                accRe[k] += aRe[k] * bRe[k] - aIm[k] * bIm[k];
+                accIm[k] += aRe[k] * bIm[k] + aIm[k] * bRe[k];
+            }
+        }
+
+        RealFFT<FloatType> fft;
+
+        size_t blockSize = 0;
+        size_t numSegments = 0;
+        size_t numBins = 0;
+        size_t inputFill = 0;
+        size_t current = 0;
+
+        // The segment transforms, and the ring of input block transforms, one after
+        // the other in each array
+        std::vector<FloatType> irRe, irIm;
+        std::vector<FloatType> inRe, inIm;
+
+        std::vector<FloatType> accRe, accIm;
+        std::vector<FloatType> sumRe, sumIm;
+
+        std::vector<FloatType> inputBuffer;
+        std::vector<FloatType> outputBuffer;
+        std::vector<FloatType> overlap;
+    };
+
+    //==============================================================================
+    // A convolver for long impulse responses, also without latency, which splits the
+    // response into a head and a tail.
+    //
+    // The head, the first tailSize samples, is convolved in small partitions of
+    // headSize samples to keep the cost of each call low. The rest goes through
+    // partitions of tailSize, which are far cheaper per sample but only run once every
+    // tailSize samples: the second tailSize samples of the response on the calling
+    // thread in headSize steps, and everything after on a background thread.
+    //
+    // Since that last stage starts 2 * tailSize samples into the response, its output
+    // for one block of input isn't due until a whole block after the block has been
+    // collected. We hand each block to the background thread as it completes and
+    // collect the result a block later, which gives the thread tailSize samples of time
+    // in which to finish. Only if it hasn't by then does the calling thread wait for it.
+    template <typename FloatType>
+    class TwoStageConvolver
+    {
+    public:
+        // When `background` is false, or the platform has no threads, the tail is
+        // convolved on the calling thread when each block completes
+        TwoStageConvolver(size_t headSize, size_t tailSize, FloatType const* ir, size_t irSize, bool background = true)
+            : headSize(headSize)
+            , tailSize(tailSize)
+        {
+            invariant(headSize >= 2 && (headSize & (headSize - 1)) == 0, "convolver head size must be a power of two");
+            invariant(tailSize >= headSize && (tailSize & (tailSize - 1)) == 0, "convolver tail size must be a power of two no smaller than the head size");
+
+            auto const headLen = std::min(irSize, tailSize);
+            head.init(headSize, ir, headLen);
+
+            if (irSize > tailSize) {
+                tail0.init(headSize, ir + tailSize, std::min(irSize - tailSize, tailSize));
+                tail0Output.assign(tailSize, FloatType(0));
+                tail0Ready.assign(tailSize, FloatType(0));
+                tailInput.assign(tailSize, FloatType(0));
+            }
+
+            if (irSize > 2 * tailSize) {
+                tail.init(tailSize, ir + 2 * tailSize, irSize - 2 * tailSize);
+                tailOutput.assign(tailSize, FloatType(0));
+                tailReady.assign(tailSize, FloatType(0));
+                backgroundInput.assign(tailSize, FloatType(0));
+
+#if defined(ELEM_HAS_THREADS)
+                if (background) {
+                    worker = std::thread([this]() { run(); });
+                }
+#else
+                (void) background;
+#endif
+            }
+        }
+
+        ~TwoStageConvolver()
+        {
+#if defined(ELEM_HAS_THREADS)
+            if (worker.joinable()) {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    shouldExit = true;
+                }
+
+                cv.notify_one();
+                worker.join();
+            }
+#endif
+        }
+
+        TwoStageConvolver(TwoStageConvolver const&) = delete;
+        TwoStageConvolver& operator=(TwoStageConvolver const&) = delete;
+
+        // The number of times the calling thread had to wait for the background thread
+        uint64_t getNumLateBlocks() const { return numLateBlocks.load(std::memory_order_relaxed); }
+
+        // Convolves `numSamples` of input into the output, which may not be the same buffer
+        void process(FloatType const* input, FloatType* output, size_t numSamples)
+        {
+            head.process(input, output, numSamples);
+
+            if (tailInput.empty())
+                return;
+
+            size_t processed = 0;
+
+            while (processed < numSamples) {
+                auto const len = std::min(numSamples - processed, headSize - (tailFill % headSize));
+
+                // Sum in the tail outputs computed over the previous blocks
+                for (size_t i = 0; i < len; ++i) {
+                    output[processed + i] += tail0Ready[tailFill + i];
+                }
+
+                if (!tailReady.empty()) {
+                    for (size_t i = 0; i < len; ++i) {
+                        output[processed + i] += tailReady[tailFill + i];
+                    }
+                }
+
+                std::copy_n(input + processed, len, tailInput.data() + tailFill);
+                tailFill += len;
+
+                // The second tailSize samples of the response, a head block at a time
+                if (tailFill % headSize == 0) {
+                    auto const offset = tailFill - headSize;
+                    tail0.process(tailInput.data() + offset, tail0Output.data() + offset, headSize);
+                }
+
+                if (tailFill == tailSize) {
+                    std::swap(tail0Ready, tail0Output);
+
+                    // And the rest, which is the one we hand to the background thread
+                    if (!tailReady.empty()) {
+                        waitForTail();
+                        std::swap(tailReady, tailOutput);
+                        std::copy(tailInput.begin(), tailInput.end(), backgroundInput.begin());
+                        startTail();
+                    }
+
+                    tailFill = 0;
+                }
+
+                processed += len;
+            }
+        }
+
+    private:
+        void startTail()
+        {
+#if defined(ELEM_HAS_THREADS)
+            if (worker.joinable()) {
+                pending.store(true, std::memory_order_release);
+                return;
+            }
+#endif
+
+            tail.process(backgroundInput.data(), tailOutput.data(), tailSize);
+        }
+
+        void waitForTail()
+        {
+#if defined(ELEM_HAS_THREADS)
+            if (!worker.joinable() || !pending.load(std::memory_order_acquire))
+                return;
+
+            numLateBlocks.fetch_add(1, std::memory_order_relaxed);
+
+            while (pending.load(std::memory_order_acquire)) {
+                ELEM_CPU_PAUSE();
+            }
+#endif
+        }
+
+#if defined(ELEM_HAS_THREADS)
+        // The realtime thread only ever flips `pending`, so that it never touches the
+        // mutex. The worker polls for it instead of being woken, which costs at most a
+        // millisecond of the tailSize samples it has.
+        void run()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+
+            while (!shouldExit) {
+                if (pending.load(std::memory_order_acquire)) {
+                    lock.unlock();
+                    tail.process(backgroundInput.data(), tailOutput.data(), tailSize);
+                    pending.store(false, std::memory_order_release);
+                    lock.lock();
+                    continue;
+                }
+
+                cv.wait_for(lock, std::chrono::milliseconds(1));
+            }
+        }
+
+        std::thread worker;
+        std::mutex mutex;
+        std::condition_variable cv;
+        bool shouldExit = false;
+#endif
+
+        size_t headSize;
+        size_t tailSize;
+        size_t tailFill = 0;
+
+        UniformConvolver<FloatType> head;
+        UniformConvolver<FloatType> tail0;
+        UniformConvolver<FloatType> tail;
+
+        std::vector<FloatType> tailInput;
+        std::vector<FloatType> tail0Output;
+        std::vector<FloatType> tail0Ready;
+        std::vector<FloatType> tailOutput;
+        std::vector<FloatType> tailReady;
+        std::vector<FloatType> backgroundInput;
+
+        std::atomic<bool> pending = false;
+        std::atomic<uint64_t> numLateBlocks = 0;
+    };
+
+} // namespace elem
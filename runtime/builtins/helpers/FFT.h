@@ -0,0 +1,195 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include "../../Invariant.h"
+
+
+namespace elem
+{
+
+    // A radix-2 FFT of real signals, for power of two sizes of at least four.
+    //
+    // Spectra are held split, as separate arrays of the real and imaginary parts of the
+    // size / 2 + 1 bins from DC to Nyquist, which keeps arithmetic on them in simple loops
+    // that vectorize. The transform of size N runs as a complex transform of size N / 2
+    // over the signal's even and odd samples, followed by a pass that untangles the two.
+    //
+    // The inverse is scaled by 1 / N, so that a forward and inverse pair is the identity.
+    template <typename FloatType>
+    class RealFFT
+    {
+    public:
+        RealFFT() = default;
+
+        explicit RealFFT(size_t size)
+        {
+            init(size);
+        }
+
+        void init(size_t size)
+        {
+            invariant(size >= 4 && (size & (size - 1)) == 0, "FFT size must be a power of two of at least 4");
+
+            n = size;
+            m = size / 2;
+
+            constexpr double kPi = 3.14159265358979323846;
+
+            // Twiddles for the complex transform of size m, and for the split pass
+            // of size n
+            cosTable.resize(m / 2);
+            sinTable.resize(m / 2);
+
+            for (size_t k = 0; k < m / 2; ++k) {
+                cosTable[k] = FloatType(std::cos(2.0 * kPi * double(k) / double(m)));
+                sinTable[k] = FloatType(-std::sin(2.0 * kPi * double(k) / double(m)));
+            }
+
+            splitCos.resize(m + 1);
+            splitSin.resize(m + 1);
+
+            for (size_t k = 0; k <= m; ++k) {
+                splitCos[k] = FloatType(std::cos(2.0 * kPi * double(k) / double(n)));
+                splitSin[k] = FloatType(-std::sin(2.0 * kPi * double(k) / double(n)));
+            }
+
+            bitReversed.resize(m);
+            size_t bits = 0;
+
+            while ((size_t(1) << bits) < m)
+                ++bits;
+
+            for (size_t i = 0; i < m; ++i) {
+                size_t r = 0;
+
+                for (size_t b = 0; b < bits; ++b) {
+                    r |= ((i >> b) & 1) << (bits - 1 - b);
+                }
+
+                bitReversed[i] = r;
+            }
+
+            workRe.resize(m);
+            workIm.resize(m);
+        }
+
+        size_t getSize() const { return n; }
+        size_t getNumBins() const { return m + 1; }
+
+        // Transforms `size` real samples into getNumBins() complex bins
+        void forward(FloatType const* input, FloatType* re, FloatType* im)
+        {
+            // Pack even samples into the real part and odd into the imaginary
+            for (size_t i = 0; i < m; ++i) {
+                auto const j = bitReversed[i];
+
+                workRe[j] = input[2 * i];
+                workIm[j] = input[2 * i + 1];
+            }
+
+            transform(false);
+
+            // Untangle the spectra of the even and odd samples, and combine them
+            re[0] = workRe[0] + workIm[0];
+            im[0] = FloatType(0);
+            re[m] = workRe[0] - workIm[0];
+            im[m] = FloatType(0);
+
+            for (size_t k = 1; k < m; ++k) {
+                auto const ar = workRe[k];
+                auto const ai = workIm[k];
+                auto const br = workRe[m - k];
+                auto const bi = -workIm[m - k];
+
+                auto const er = FloatType(0.5) * (ar + br);
+                auto const ei = FloatType(0.5) * (ai + bi);
+                auto const or_ = FloatType(0.5) * (ai - bi);
+                auto const oi = FloatType(-0.5) * (ar - br);
+
+                re[k] = er + splitCos[k] * or_ - splitSin[k] * oi;
+                im[k] = ei + splitCos[k] * oi + splitSin[k] * or_;
+            }
+        }
+
+        // Transforms getNumBins() complex bins back into `size` real samples
+        void inverse(FloatType const* re, FloatType const* im, FloatType* output)
+        {
+            for (size_t k = 0; k < m; ++k) {
+                auto const ar = re[k];
+                auto const ai = im[k];
+                auto const br = re[m - k];
+                auto const bi = -im[m - k];
+
+                auto const er = FloatType(0.5) * (ar + br);
+                auto const ei = FloatType(0.5) * (ai + bi);
+
+                // (X[k] - conj(X[m - k])) / 2, rotated back by the split twiddle
+                auto const dr = FloatType(0.5) * (ar - br);
+                auto const di = FloatType(0.5) * (ai - bi);
+                auto const or_ = dr * splitCos[k] + di * splitSin[k];
+                auto const oi = di * splitCos[k] - dr * splitSin[k];
+
+                // Z = E + iO
+                auto const j = bitReversed[k];
+
+                workRe[j] = er - oi;
+                workIm[j] = ei + or_;
+            }
+
+            transform(true);
+
+            auto const scale = FloatType(1) / FloatType(m);
+
+            for (size_t i = 0; i < m; ++i) {
+                output[2 * i] = workRe[i] * scale;
+                output[2 * i + 1] = workIm[i] * scale;
+            }
+        }
+
+    private:
+        // An in-place, iterative complex transform of the bit reversed work buffers
+        void transform(bool inverse)
+        {
+            auto const sign = inverse ? FloatType(-1) : FloatType(1);
+
+            for (size_t len = 2; len <= m; len <<= 1) {
+                auto const half = len / 2;
+                auto const stride = m / len;
+
+                for (size_t start = 0; start < m; start += len) {
+                    for (size_t k = 0; k < half; ++k) {
+                        auto const wr = cosTable[k * stride];
+                        auto const wi = sign * sinTable[k * stride];
+
+                        auto const a = start + k;
+                        auto const b = a + half;
+
+                        auto const tr = workRe[b] * wr - workIm[b] * wi;
+                        auto const ti = workRe[b] * wi + workIm[b] * wr;
+
+                        workRe[b] = workRe[a] - tr;
+                        workIm[b] = workIm[a] - ti;
+                        workRe[a] += tr;
+                        workIm[a] += ti;
+                    }
+                }
+            }
+        }
+
+        size_t n = 0;
+        size_t m = 0;
+
+        std::vector<FloatType> cosTable;
+        std::vector<FloatType> sinTable;
+        std::vector<FloatType> splitCos;
+        std::vector<FloatType> splitSin;
+        std::vector<size_t> bitReversed;
+
+        std::vector<FloatType> workRe;
+        std::vector<FloatType> workIm;
+    };
+
+} // namespace elem
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+
+namespace elem
+{
+
+    // Fast approximations of common transcendental functions.
+    //
+    // These trade a little accuracy (around 1e-6 error for sin, cos, exp and log over
+    // typical audio-rate arguments, and 1e-4 for tanh near saturation) for functions
+    // that are cheap to inline and are written without branches so that the compiler
+    // can vectorize the loops that call them. The unary math nodes use these in place
+    // of their <cmath> counterparts when the runtime is built with ELEM_USE_FAST_MATH.
+    //
+    // Note that GCC will only vectorize the selects here with -fno-trapping-math.
+    namespace fastmath
+    {
+        namespace detail
+        {
+            template <typename FloatType>
+            struct FloatBits;
+
+            template <>
+            struct FloatBits<float> {
+                using IntType = int32_t;
+                static constexpr int mantissaBits = 23;
+                static constexpr int exponentBias = 127;
+            };
+
+            template <>
+            struct FloatBits<double> {
+                using IntType = int64_t;
+                static constexpr int mantissaBits = 52;
+                static constexpr int exponentBias = 1023;
+            };
+
+            // Rounds to the nearest integer through a truncating conversion, which unlike
+            // std::floor or std::round vectorizes on any target. We clamp first so that the
+            // conversion is always defined; NaN clamps to the upper limit.
+            template <typename FloatType>
+            inline FloatType roundToInt(FloatType x) {
+                constexpr FloatType limit = FloatType(1 << 30);
+
+                x = (x < limit) ? x : limit;
+                x = (x > -limit) ? x : -limit;
+
+                return FloatType(static_cast<int32_t>(x + ((x < FloatType(0)) ? FloatType(-0.5) : FloatType(0.5))));
+            }
+
+            template <typename FloatType>
+            inline typename FloatBits<FloatType>::IntType toBits(FloatType x) {
+                typename FloatBits<FloatType>::IntType i;
+                std::memcpy(&i, &x, sizeof(x));
+                return i;
+            }
+
+            template <typename FloatType>
+            inline FloatType fromBits(typename FloatBits<FloatType>::IntType i) {
+                FloatType x;
+                std::memcpy(&x, &i, sizeof(x));
+                return x;
+            }
+        }
+
+        template <typename FloatType>
+        inline FloatType sin(FloatType x) {
+            constexpr FloatType pi = FloatType(3.14159265358979323846);
+            constexpr FloatType twoPi = FloatType(2) * pi;
+            constexpr FloatType halfPi = FloatType(0.5) * pi;
+
+            // Wrap to [-pi, pi], then fold onto [-pi/2, pi/2] using sin(pi - x) = sin(x)
+            x = x - twoPi * detail::roundToInt(x * (FloatType(1) / twoPi));
+            x = (x > halfPi) ? (pi - x) : x;
+            x = (x < -halfPi) ? (-pi - x) : x;
+
+            // Taylor series through the 11th order term, which is plenty within this range
+            auto const x2 = x * x;
+
+            return x * (FloatType(1) + x2 * (FloatType(-1.0 / 6.0) + x2 * (FloatType(1.0 / 120.0)
+                + x2 * (FloatType(-1.0 / 5040.0) + x2 * (FloatType(1.0 / 362880.0) + x2 * FloatType(-1.0 / 39916800.0))))));
+        }
+
+        template <typename FloatType>
+        inline FloatType cos(FloatType x) {
+            return fastmath::sin(x + FloatType(1.57079632679489661923));
+        }
+
+        template <typename FloatType>
+        inline FloatType tanh(FloatType x) {
+            // A continued fraction expansion of tanh, which holds up well until the
+            // function has all but saturated
+            constexpr FloatType limit = FloatType(4.97);
+
+            x = (x > limit) ? limit : ((x < -limit) ? -limit : x);
+
+            auto const x2 = x * x;
+            auto const p = x * (FloatType(135135) + x2 * (FloatType(17325) + x2 * (FloatType(378) + x2)));
+            auto const q = FloatType(135135) + x2 * (FloatType(62370) + x2 * (FloatType(3150) + x2 * FloatType(28)));
+            auto const y = p / q;
+
+            return (y > FloatType(1)) ? FloatType(1) : ((y < FloatType(-1)) ? FloatType(-1) : y);
+        }
+
+        template <typename FloatType>
+        inline FloatType exp(FloatType x) {
+            using Bits = detail::FloatBits<FloatType>;
+            using IntType = typename Bits::IntType;
+
+            // exp(x) = 2^n * 2^f where n is an integer and f is in [-1/2, 1/2]. We clamp n to the
+            // normal exponent range, so very small results flush to zero and very large ones
+            // saturate to a large finite value.
+            constexpr FloatType maxExponent = FloatType(Bits::exponentBias);
+            constexpr FloatType minExponent = FloatType(1 - Bits::exponentBias);
+
+            // Written such that a NaN input clamps to the top of the range before we
+            // convert to an integer; the NaN itself is restored on return
+            auto t = x * FloatType(1.44269504088896340736);
+            t = (t < maxExponent) ? t : maxExponent;
+            t = (t > minExponent) ? t : minExponent;
+
+            auto const n = detail::roundToInt(t);
+            auto const f = t - n;
+
+            // Taylor series for 2^f, accurate to around 1e-7 over [-1/2, 1/2]
+            auto const p = FloatType(1) + f * (FloatType(0.693147180559945) + f * (FloatType(0.240226506959101)
+                + f * (FloatType(0.0555041086648216) + f * (FloatType(0.00961812910762848)
+                + f * (FloatType(0.00133335581464284) + f * FloatType(0.000154035303933816))))));
+
+            auto const scale = detail::fromBits<FloatType>(static_cast<IntType>(static_cast<IntType>(n) + Bits::exponentBias) << Bits::mantissaBits);
+            auto const y = p * scale;
+
+            return (x != x) ? x : ((n <= minExponent) ? FloatType(0) : y);
+        }
+
+        template <typename FloatType>
+        inline FloatType log(FloatType x) {
+            using Bits = detail::FloatBits<FloatType>;
+            using IntType = typename Bits::IntType;
+
+            constexpr IntType mantissaMask = (IntType(1) << Bits::mantissaBits) - 1;
+            constexpr IntType exponentOne = IntType(Bits::exponentBias) << Bits::mantissaBits;
+
+            // Split x into 2^e * m with m in [1, 2), then shift m to [sqrt(1/2), sqrt(2))
+            // so that the series below stays centered on 1
+            auto const bits = detail::toBits<FloatType>(x);
+            auto e = static_cast<FloatType>((bits >> Bits::mantissaBits) - Bits::exponentBias);
+            auto m = detail::fromBits<FloatType>((bits & mantissaMask) | exponentOne);
+
+            auto const shift = m > FloatType(1.41421356237309504880);
+            m = shift ? m * FloatType(0.5) : m;
+            e = shift ? e + FloatType(1) : e;
+
+            // log(m) = 2 * atanh(s) where s = (m - 1) / (m + 1), with |s| < 0.172
+            auto const s = (m - FloatType(1)) / (m + FloatType(1));
+            auto const s2 = s * s;
+            auto const lm = FloatType(2) * s * (FloatType(1) + s2 * (FloatType(1.0 / 3.0) + s2 * (FloatType(1.0 / 5.0)
+                + s2 * (FloatType(1.0 / 7.0) + s2 * (FloatType(1.0 / 9.0) + s2 * FloatType(1.0 / 11.0))))));
+
+            auto const y = e * FloatType(0.693147180559945309417) + lm;
+
+            // Match std::log at the edges of its domain, passing through infinity and NaN.
+            // Subnormal inputs are treated as zero.
+            auto const minNormal = std::numeric_limits<FloatType>::min();
+            auto const maxNormal = std::numeric_limits<FloatType>::max();
+            auto const edge = (x < FloatType(0)) ? std::numeric_limits<FloatType>::quiet_NaN() : -std::numeric_limits<FloatType>::infinity();
+
+            return (x < minNormal) ? edge : ((x <= maxNormal) ? y : x);
+        }
+    }
+
+} // namespace elem
@@ -0,0 +1,200 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <string>
+
+#include "../../Invariant.h"
+
+
+namespace elem
+{
+
+    // Interpolators for reading sample data at fractional positions.
+    //
+    // Each is called with `x`, a function where x(k) gives the sample k places from
+    // the one at or just before the read position, for k in [-kBefore, kAfter], and with
+    // `t`, the fractional part of the read position. The readers which use these read
+    // without bounds checks wherever all of those samples lie inside the buffer, and
+    // only wrap indices near its edges.
+    enum class InterpolationMode
+    {
+        Linear = 0,
+        Hermite = 1,
+        Sinc = 2,
+    };
+
+    // Parses the value of an `interpolation` node prop
+    inline InterpolationMode parseInterpolationMode(std::string const& s)
+    {
+        if (s == "linear") { return InterpolationMode::Linear; }
+        if (s == "hermite") { return InterpolationMode::Hermite; }
+        if (s == "sinc") { return InterpolationMode::Sinc; }
+
+        invariant(false, "interpolation prop must be one of \"linear\", \"hermite\" or \"sinc\".");
+        return InterpolationMode::Linear;
+    }
+
+    template <typename FloatType>
+    struct LinearInterpolator
+    {
+        static constexpr int kBefore = 0;
+        static constexpr int kAfter = 1;
+
+        template <typename X>
+        FloatType operator()(X&& x, FloatType t) const
+        {
+            auto const left = x(0);
+            auto const right = x(1);
+
+            return left + t * (right - left);
+        }
+    };
+
+    // Four point, third order Hermite interpolation: smoother than linear for about
+    // twice the cost, and with much less high frequency loss.
+    template <typename FloatType>
+    struct HermiteInterpolator
+    {
+        static constexpr int kBefore = 1;
+        static constexpr int kAfter = 2;
+
+        template <typename X>
+        FloatType operator()(X&& x, FloatType t) const
+        {
+            auto const xm1 = x(-1);
+            auto const x0 = x(0);
+            auto const x1 = x(1);
+            auto const x2 = x(2);
+
+            auto const c1 = FloatType(0.5) * (x1 - xm1);
+            auto const c2 = xm1 - FloatType(2.5) * x0 + FloatType(2) * x1 - FloatType(0.5) * x2;
+            auto const c3 = FloatType(0.5) * (x2 - xm1) + FloatType(1.5) * (x0 - x1);
+
+            return ((c3 * t + c2) * t + c1) * t + x0;
+        }
+    };
+
+    // Eight point windowed sinc interpolation from a precomputed polyphase table, for
+    // the best quality of the three.
+    //
+    // The table holds a Kaiser windowed sinc kernel at kPhases fractional offsets, one
+    // row of taps each, and a read interpolates between the two rows either side of
+    // `t`. The kernel passes integer positions through untouched, so playback at the
+    // original rate is exact. Its cutoff doesn't track the playback rate, so playing
+    // far above the original pitch can still alias.
+    template <typename FloatType>
+    struct SincInterpolator
+    {
+        static constexpr int kBefore = 3;
+        static constexpr int kAfter = 4;
+        static constexpr int kTaps = kBefore + kAfter + 1;
+        static constexpr int kPhases = 256;
+
+        struct Table
+        {
+            Table()
+            {
+                constexpr double kPi = 3.14159265358979323846;
+                constexpr double kBeta = 6.0;
+
+                for (int p = 0; p <= kPhases; ++p) {
+                    auto* row = coeffs.data() + p * kTaps;
+                    auto const t = (double) p / (double) kPhases;
+
+                    std::array<double, kTaps> taps;
+                    double sum = 0;
+
+                    for (int k = 0; k < kTaps; ++k) {
+                        // Distance from the read position, and where that falls in the
+                        // window, from -1 to 1
+                        auto const d = (double) (k - kBefore) - t;
+                        auto const r = 2.0 * (d + (double) kTaps * 0.5) / (double) kTaps - 1.0;
+
+                        auto const sinc = std::abs(d) < 1e-9 ? 1.0 : std::sin(kPi * d) / (kPi * d);
+                        auto const window = besselI0(kBeta * std::sqrt(std::max(0.0, 1.0 - r * r))) / besselI0(kBeta);
+
+                        taps[k] = sinc * window;
+                        sum += taps[k];
+                    }
+
+                    // Normalise each phase for unity gain at DC
+                    for (int k = 0; k < kTaps; ++k) {
+                        row[k] = FloatType(taps[k] / sum);
+                    }
+                }
+            }
+
+            // The zeroth order modified Bessel function of the first kind, by its series
+            static double besselI0(double x)
+            {
+                double sum = 1;
+                double term = 1;
+
+                for (int k = 1; k < 32; ++k) {
+                    term *= (x / (2.0 * k)) * (x / (2.0 * k));
+                    sum += term;
+                }
+
+                return sum;
+            }
+
+            std::array<FloatType, (kPhases + 1) * kTaps> coeffs;
+        };
+
+        // The table is built on first use, which nodes arrange to happen on the
+        // non-realtime thread, when the sinc mode is chosen
+        static Table const& getTable()
+        {
+            static Table const table;
+            return table;
+        }
+
+        SincInterpolator() : coeffs(getTable().coeffs.data()) {}
+
+        template <typename X>
+        FloatType operator()(X&& x, FloatType t) const
+        {
+            auto const p = t * FloatType(kPhases);
+            auto const phase = std::min(static_cast<int>(p), kPhases - 1);
+            auto const frac = p - FloatType(phase);
+
+            auto const* c0 = coeffs + phase * kTaps;
+            auto const* c1 = c0 + kTaps;
+
+            std::array<FloatType, kTaps> xs;
+
+            for (int k = 0; k < kTaps; ++k) {
+                xs[k] = x(k - kBefore);
+            }
+
+            FloatType acc = 0;
+
+            for (int k = 0; k < kTaps; ++k) {
+                acc += (c0[k] + frac * (c1[k] - c0[k])) * xs[k];
+            }
+
+            return acc;
+        }
+
+        FloatType const* coeffs;
+    };
+
+    // Calls `fn` with an instance of the interpolator for the given mode, so that the
+    // caller's loop is compiled once for each and the mode is only checked once per call
+    template <typename FloatType, typename Fn>
+    void withInterpolator(InterpolationMode mode, Fn&& fn)
+    {
+        switch (mode) {
+            case InterpolationMode::Hermite:
+                return fn(HermiteInterpolator<FloatType>());
+            case InterpolationMode::Sinc:
+                return fn(SincInterpolator<FloatType>());
+            case InterpolationMode::Linear:
+            default:
+                return fn(LinearInterpolator<FloatType>());
+        }
+    }
+
+} // namespace elem
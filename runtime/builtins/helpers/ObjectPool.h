@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "../../SingleWriterSingleReaderQueue.h"
+
+
+namespace elem
+{
+
+    // A fixed size object pool for handing objects from the non-realtime thread to the
+    // realtime thread and back again.
+    //
+    // The non-realtime thread allocates an element, fills it in, and passes the pointer
+    // through a lock free queue to the realtime thread. When the realtime thread is done
+    // with the element, typically once the next one arrives, it releases it back to the
+    // pool. Releasing is a push onto a single writer single reader queue, so it never
+    // locks or frees memory on the realtime thread; the non-realtime thread reclaims the
+    // released elements into its free list on the next call to `allocate`.
+    //
+    // All elements are constructed up front and owned by the pool, so every operation
+    // here is O(1) and the pool never grows. When every element is in use, `allocate`
+    // returns nullptr and counts the failure, leaving the caller to decide how to surface
+    // the pressure. The default capacity matches the number of elements that a default
+    // SingleWriterSingleReaderQueue can hold, which means that when elements are passed
+    // through such a queue, a successful allocation can always be pushed.
+    //
+    // See the SequenceNode for an example of this pattern.
+    template <typename ElementType>
+    class ObjectPool
+    {
+    public:
+        ObjectPool(size_t capacity = 31)
+            : releaseQueue(queueSizeFor(capacity))
+        {
+            storage.reserve(capacity);
+            freeList.reserve(capacity);
+
+            for (size_t i = 0; i < capacity; ++i) {
+                storage.push_back(std::make_unique<ElementType>());
+                freeList.push_back(storage.back().get());
+            }
+        }
+
+        // Returns an element which is not in use on the realtime thread, or nullptr if
+        // there is none. Must only be called from the non-realtime thread.
+        //
+        // The element may hold state from a previous use, which the caller should overwrite.
+        ElementType* allocate()
+        {
+            releaseQueue.consume([this](ElementType* el) {
+                freeList.push_back(el);
+            });
+
+            if (freeList.empty()) {
+                numFailedAllocations++;
+                return nullptr;
+            }
+
+            auto* el = freeList.back();
+            freeList.pop_back();
+
+            return el;
+        }
+
+        // Returns an element to the pool from the realtime thread. Null pointers are ignored,
+        // so this may be called unconditionally with the element being replaced.
+        void release(ElementType* el)
+        {
+            if (el != nullptr) {
+                releaseQueue.push(std::move(el));
+            }
+        }
+
+        // Returns an element which was allocated but never handed to the realtime thread.
+        // Must only be called from the non-realtime thread.
+        void recycle(ElementType* el)
+        {
+            if (el != nullptr) {
+                freeList.push_back(el);
+            }
+        }
+
+        size_t getCapacity() const { return storage.size(); }
+
+        // The number of calls to `allocate` which found the pool exhausted
+        size_t getNumFailedAllocations() const { return numFailedAllocations; }
+
+    private:
+        // The release queue must be able to hold every element at once, and a queue of
+        // size n holds n - 1 elements
+        static size_t queueSizeFor(size_t capacity)
+        {
+            size_t n = 1;
+
+            while (n < capacity + 1)
+                n <<= 1;
+
+            return n;
+        }
+
+        std::vector<std::unique_ptr<ElementType>> storage;
+        std::vector<ElementType*> freeList;
+        SingleWriterSingleReaderQueue<ElementType*> releaseQueue;
+
+        size_t numFailedAllocations = 0;
+    };
+
+} // namespace elem
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "../../GraphNode.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+
+
+namespace elem
+{
+
+    // A timestamped change to one of a node's parameters, as given to the runtime's
+    // `scheduleParameterEvent`. The time is in samples of the runtime's own clock, see
+    // Runtime::getSampleTime, and a non-zero ramp moves the parameter linearly from its
+    // current value to the new one over that many samples, rather than stepping.
+    template <typename FloatType>
+    struct ParameterEvent {
+        NodeId nodeId = 0;
+        uint32_t slot = 0;
+        FloatType value = 0;
+        int64_t sampleTime = 0;
+        uint32_t rampSamples = 0;
+    };
+
+    // A base for nodes which take parameter events, the sample accurate path for automation
+    // which skips the instruction batches and the reconciler altogether.
+    //
+    // Before each block the render sequence hands every node the events which fall within
+    // that block, by offset from its start. The node then applies them from its `process`:
+    // each call renders up to `nextParameterEventOffset` at a time, and asks
+    // `takeParameterEvents` for the events due at that point. Because the node counts
+    // the samples it has rendered itself, this holds when the block is rendered in
+    // pieces, as within a feedback loop, just as well as when it's rendered whole.
+    //
+    // Events are scheduled and taken on the realtime thread, and never allocate. Each node
+    // holds up to kMaxEvents at once; scheduling any more fails, and the event is dropped.
+    template <typename FloatType>
+    struct ParameterEventNode : public GraphNode<FloatType> {
+        using GraphNode<FloatType>::GraphNode;
+
+        static constexpr size_t kMaxEvents = 64;
+
+        struct Event {
+            int64_t time;
+            uint32_t slot;
+            FloatType value;
+            uint32_t rampSamples;
+        };
+
+        // Schedules an event `offset` samples after the start of the block about to render.
+        // Events at the same offset apply in the order they were scheduled.
+        bool scheduleParameterEvent(size_t offset, uint32_t slot, FloatType value, uint32_t rampSamples)
+        {
+            markAutomated();
+
+            if (head > 0) {
+                std::move(events + head, events + numEvents, events);
+                numEvents -= head;
+                head = 0;
+            }
+
+            if (numEvents == kMaxEvents)
+                return false;
+
+            Event const e { elapsed + static_cast<int64_t>(offset), slot, value, rampSamples };
+
+            auto i = numEvents++;
+
+            while (i > 0 && events[i - 1].time > e.time) {
+                events[i] = events[i - 1];
+                --i;
+            }
+
+            events[i] = e;
+            return true;
+        }
+
+        // Whether the node has ever been sent a parameter event, after which the runtime
+        // no longer takes its output to follow its props alone, e.g. for constant folding.
+        // May be read from any thread.
+        bool isAutomated() const { return automated.load(std::memory_order_relaxed); }
+        void markAutomated() { automated.store(true, std::memory_order_relaxed); }
+
+    protected:
+        // Returns the offset, from the start of the current call to `process`, of the next
+        // event which falls before `numSamples`, or `numSamples` if there isn't one
+        size_t nextParameterEventOffset(size_t numSamples) const
+        {
+            if (head == numEvents)
+                return numSamples;
+
+            auto const d = events[head].time - elapsed;
+            return d <= 0 ? 0 : std::min(numSamples, static_cast<size_t>(d));
+        }
+
+        // Calls `fn` with each event due at or before `offset` samples into the current call
+        // to `process`, in order, and removes them
+        template <typename Fn>
+        void takeParameterEvents(size_t offset, Fn&& fn)
+        {
+            while (head < numEvents && events[head].time <= elapsed + static_cast<int64_t>(offset)) {
+                fn(events[head++]);
+            }
+        }
+
+        // Must be called at the end of each call to `process` with the number of samples
+        // it rendered
+        void advanceParameterEvents(size_t numSamples)
+        {
+            elapsed += static_cast<int64_t>(numSamples);
+        }
+
+    private:
+        Event events[kMaxEvents];
+        size_t head = 0;
+        size_t numEvents = 0;
+        int64_t elapsed = 0;
+        std::atomic<bool> automated = false;
+    };
+
+} // namespace elem
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "../../EventBuffer.h"
+#include "../../GraphNode.h"
+
+
+namespace elem
+{
+
+    // A base for nodes which write their events into an EventBuffer, see
+    // GraphNode::processEvents.
+    //
+    // Derived classes implement only the EventBuffer overload of `processEvents`. The
+    // callback overload is implemented here in terms of it, by way of a scratch buffer
+    // which the node keeps between calls, so that both paths always raise the same events.
+    template <typename FloatType>
+    struct TypedEventNode : public GraphNode<FloatType> {
+        using GraphNode<FloatType>::GraphNode;
+        using GraphNode<FloatType>::processEvents;
+
+        void processEvents(std::function<void(std::string const&, js::Value)>& eventHandler) override {
+            scratchEvents.clear();
+            processEvents(scratchEvents);
+            scratchEvents.forEach(eventHandler);
+        }
+
+        EventBuffer scratchEvents;
+    };
+
+} // namespace elem
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "../../GraphNode.h"
+
+#include <algorithm>
+
+
+namespace elem
+{
+
+    // A base for nodes of which a graph typically holds many identical instances, such as
+    // the oscillators and filters in each voice of a synth, and which can render a group
+    // of those instances together faster than one at a time.
+    //
+    // When building the render sequence, neighbouring nodes which don't depend on one
+    // another, and which return the same batch function and have the same number of
+    // inputs, are gathered into a batch. The batch function is then called once for the
+    // whole group in place of each node's `process`, and must leave every node's output
+    // and state exactly as `process` would have.
+    template <typename FloatType>
+    struct BatchableNode : public GraphNode<FloatType> {
+        using GraphNode<FloatType>::GraphNode;
+
+        using BatchFn = void (*)(BatchableNode<FloatType>* const* nodes, BlockContext<FloatType> const* contexts, size_t count);
+
+        virtual BatchFn getBatchFunction() = 0;
+    };
+
+    namespace batch
+    {
+        // Batched nodes render in groups of kLanes with their state held as one array per
+        // variable, structure-of-arrays, and with their inputs transposed kTileSize samples
+        // at a time. The inner loops then run across voices rather than along each voice's
+        // recurrence, which the compiler is able to vectorize.
+        constexpr size_t kLanes = 8;
+        constexpr size_t kTileSize = 16;
+
+        template <typename FloatType>
+        struct Tile {
+            FloatType data[kTileSize][kLanes] = {};
+
+            FloatType* operator[](size_t i) { return data[i]; }
+        };
+
+        // Transposes samples [start, start + len) of input `channel` of each lane into the tile
+        template <typename FloatType>
+        void load(Tile<FloatType>& tile, BlockContext<FloatType> const* const* lanes, size_t numLanes, size_t channel, size_t start, size_t len)
+        {
+            for (size_t l = 0; l < numLanes; ++l) {
+                auto const* in = lanes[l]->inputData[channel] + start;
+
+                for (size_t i = 0; i < len; ++i) {
+                    tile[i][l] = in[i];
+                }
+            }
+        }
+
+        // Transposes the tile back out into samples [start, start + len) of each lane's output
+        template <typename FloatType>
+        void store(Tile<FloatType>& tile, BlockContext<FloatType> const* const* lanes, size_t numLanes, size_t start, size_t len)
+        {
+            for (size_t l = 0; l < numLanes; ++l) {
+                auto* out = lanes[l]->outputData + start;
+
+                for (size_t i = 0; i < len; ++i) {
+                    out[i] = tile[i][l];
+                }
+            }
+        }
+
+        // Splits a batch into groups of up to kLanes nodes for `fn`, first giving each node
+        // the chance to skip the block entirely through its `trySleep` method, which renders
+        // the node's output itself if it returns true.
+        template <typename NodeType, typename FloatType, typename Fn>
+        void forEachGroup(BatchableNode<FloatType>* const* nodes, BlockContext<FloatType> const* contexts, size_t count, Fn&& fn)
+        {
+            NodeType* group[kLanes];
+            BlockContext<FloatType> const* groupContexts[kLanes];
+            size_t n = 0;
+
+            for (size_t i = 0; i < count; ++i) {
+                auto* node = static_cast<NodeType*>(nodes[i]);
+
+                if (node->trySleep(contexts[i]))
+                    continue;
+
+                group[n] = node;
+                groupContexts[n] = &contexts[i];
+
+                if (++n == kLanes) {
+                    fn(group, groupContexts, n);
+                    n = 0;
+                }
+            }
+
+            if (n > 0) {
+                fn(group, groupContexts, n);
+            }
+        }
+    }
+
+} // namespace elem
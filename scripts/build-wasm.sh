@@ -12,7 +12,7 @@ el__build() {
     mkdir -p "/elembuild/wasm/"
     pushd "/elembuild/wasm/"
 
-    ELEM_BUILD_ASYNC="${ELEM_BUILD_ASYNC:-0}" emcmake cmake \
+    ELEM_BUILD_ASYNC="${ELEM_BUILD_ASYNC:-0}" ELEM_BUILD_THREADS="${ELEM_BUILD_THREADS:-0}" emcmake cmake \
         -DCMAKE_BUILD_TYPE=Release \
         -DONLY_BUILD_WASM=ON \
         -DCMAKE_CXX_FLAGS="-O3" \
@@ -20,10 +20,24 @@ el__build() {
 
     emmake make
 
-    # Because we build out of the source dir, copy the resulting file back to the
-    # source dir so that it exists outside the container
+    # Because we build out of the source dir, bundle the resulting variants back into the
+    # source dir so that they exist outside the container. The loader goes last, and picks
+    # between the variants before it at runtime
+    local VARIANTS=(elementary-wasm.js elementary-wasm-simd.js)
+
+    if [ "${ELEM_BUILD_THREADS:-0}" == "1" ]; then
+        VARIANTS+=(elementary-wasm-threads.js)
+    fi
+
     mkdir -p /src/build/out/
-    cp /elembuild/wasm/wasm/elementary-wasm.js /src/build/out/elementary-wasm.js
+    rm -f /src/build/out/elementary-wasm.js
+
+    for variant in "${VARIANTS[@]}"; do
+        cat "/elembuild/wasm/wasm/$variant" >> /src/build/out/elementary-wasm.js
+        echo "" >> /src/build/out/elementary-wasm.js
+    done
+
+    cat /src/wasm/ModuleLoader.js >> /src/build/out/elementary-wasm.js
 
     popd
 }
@@ -41,11 +55,13 @@ el__main() {
         # the build command from within an emscripten/emsdk docker container.
         local OUTPUT_FILENAME=""
         local ELEM_BUILD_ASYNC=0
+        local ELEM_BUILD_THREADS=0
 
-        while getopts ao: opt; do
+        while getopts ato: opt; do
             case $opt in
                 o)  OUTPUT_FILENAME="$OPTARG";;
                 a)  ELEM_BUILD_ASYNC=1;;
+                t)  ELEM_BUILD_THREADS=1;;
             esac
         done
 
@@ -59,6 +75,7 @@ el__main() {
         docker run \
           -v $(pwd):/src \
           --env ELEM_BUILD_ASYNC="$ELEM_BUILD_ASYNC" \
+          --env ELEM_BUILD_THREADS="$ELEM_BUILD_THREADS" \
           emscripten/emsdk:3.1.8 \
           ./scripts/build-wasm.sh build
 
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <EventBuffer.h>
+#include <JSON.h>
+
+
+namespace elem
+{
+
+    // Encodes a batch of events into a compact binary form, for passing to JavaScript
+    // through shared memory without building a tree of values for each event.
+    //
+    // All fields are little-endian and 4-byte aligned. The batch is a u32 event count,
+    // followed by each event as:
+    //
+    //   u32 type, i32 source node id, u32 numChannels, u32 frameSize
+    //   f64 value0, f64 value1
+    //   u32 name byte length, UTF-8 name bytes padded to 4
+    //   payload
+    //
+    // Where the type is an elem::EventType, and the payload holds numChannels frames of
+    // frameSize f32 samples, one after the other. Events of type Value instead carry a
+    // u32 byte length and the JSON encoding of their [type, event] pair, padded to 4.
+    //
+    // The output vector is cleared first and keeps its capacity, so encoding into the
+    // same vector each time only allocates while it grows.
+    inline void encodeEvents(EventBuffer const& events, std::vector<uint8_t>& out)
+    {
+        out.clear();
+
+        auto append = [&](void const* data, size_t size) {
+            auto const* bytes = static_cast<uint8_t const*>(data);
+            out.insert(out.end(), bytes, bytes + size);
+        };
+
+        auto appendWord = [&](uint32_t w) { append(&w, sizeof(w)); };
+        auto pad = [&]() { out.resize((out.size() + 3) & ~size_t(3), 0); };
+
+        auto appendString = [&](char const* data, size_t size) {
+            appendWord(static_cast<uint32_t>(size));
+            append(data, size);
+            pad();
+        };
+
+        appendWord(static_cast<uint32_t>(events.size()));
+
+        for (auto const& e : events.getEvents()) {
+            appendWord(static_cast<uint32_t>(e.type));
+            appendWord(static_cast<uint32_t>(e.source));
+            appendWord(e.numChannels);
+            appendWord(e.frameSize);
+            append(&e.values[0], sizeof(double));
+            append(&e.values[1], sizeof(double));
+
+            if (e.name != nullptr && e.name->isString()) {
+                auto const& name = e.name->getString();
+                appendString(name.data(), name.size());
+            } else {
+                appendWord(0);
+            }
+
+            if (e.type == EventType::Value) {
+                auto [type, value] = events.toValue(e);
+                auto const json = js::serialize(js::Array({type, value}));
+
+                appendString(json.data(), json.size());
+                continue;
+            }
+
+            append(events.getFrameData(e), sizeof(float) * e.numChannels * e.frameSize);
+        }
+    }
+
+} // namespace elem
@@ -3,8 +3,7 @@
 #include <memory>
 #include <Runtime.h>
 
-#include "Convolve.h"
-#include "FFT.h"
+#include "BinaryEvents.h"
 #include "Metro.h"
 #include "SampleTime.h"
 
@@ -38,18 +37,12 @@ public:
         for (int i = 0; i < (numInputChannels + numOutputChannels); ++i)
             scratchPointers.push_back(scratchBuffers[i].data());
 
+        ioPointers.resize(numInputChannels + numOutputChannels);
+
         // Configure the runtime
         runtime = std::make_unique<elem::Runtime<float>>(sampleRate, maxBlockSize);
 
         // Register extension nodes
-        runtime->registerNodeType("convolve", [](elem::NodeId const id, double fs, int const bs) {
-            return std::make_shared<elem::ConvolutionNode<float>>(id, fs, bs);
-        });
-
-        runtime->registerNodeType("fft", [](elem::NodeId const id, double fs, int const bs) {
-            return std::make_shared<elem::FFTNode<float>>(id, fs, bs);
-        });
-
         runtime->registerNodeType("metro", [](elem::NodeId const id, double fs, int const bs) {
             return std::make_shared<elem::MetronomeNode<float>>(id, fs, bs);
         });
@@ -107,6 +100,55 @@ public:
         runtime->reset();
     }
 
+#if defined(__EMSCRIPTEN_PTHREADS__)
+    /** Renders independent parts of the graph on worker threads, see
+     *  elem::Runtime::setNumRenderThreads. Only the threaded build of the module has this.
+     */
+    void setNumRenderThreads (int numWorkerThreads)
+    {
+        runtime->setNumRenderThreads(static_cast<size_t>(std::max(0, numWorkerThreads)));
+    }
+#endif
+
+    /** Renders each call to process in blocks of at most the given size, see
+     *  elem::Runtime::setInternalBlockSize.
+     */
+    void setInternalBlockSize (int size)
+    {
+        runtime->setInternalBlockSize(size);
+    }
+
+    void setProfilingEnabled(bool enabled)
+    {
+        runtime->setProfilingEnabled(enabled);
+    }
+
+    void setNumericChecksEnabled(bool enabled)
+    {
+        runtime->setNumericChecksEnabled(enabled);
+    }
+
+    /** Schedules a sample accurate parameter event, see elem::Runtime::scheduleParameterEvent.
+     *
+     *  The sample time is in the runtime's clock, as given by getSampleTime. Returns false
+     *  if the event was dropped.
+     */
+    bool scheduleParameterEvent(int nodeId, int slot, double value, double sampleTime, int rampSamples)
+    {
+        return runtime->scheduleParameterEvent(
+            static_cast<elem::NodeId>(nodeId),
+            static_cast<uint32_t>(std::max(0, slot)),
+            static_cast<float>(value),
+            static_cast<int64_t>(sampleTime),
+            static_cast<uint32_t>(std::max(0, rampSamples))
+        );
+    }
+
+    double getSampleTime()
+    {
+        return static_cast<double>(runtime->getSampleTime());
+    }
+
     void updateSharedResourceMap(val path, val buffer, val errorCallback)
     {
         auto p = emValToValue(path);
@@ -119,13 +161,46 @@ public:
             return (void) errorCallback(val("Buffer argument must be an Array or Float32Array type"));
 
         try {
-            auto buf = b.isArray() ? arrayToFloatVector(b.getArray()) : b.getFloat32Array();
-            runtime->updateSharedResourceMap((elem::js::String) p, buf.data(), buf.size());
+            auto const name = (elem::js::String) p;
+
+            // An Array of Float32Arrays is a multichannel resource, with one array per channel. In
+            // either case the conversion from JavaScript has already made a copy, which the runtime
+            // adopts rather than copying again.
+            if (b.isArray() && !b.getArray().empty() && b.getArray()[0].isFloat32Array()) {
+                std::vector<std::vector<float>> channels;
+
+                for (auto& c : b.getArray()) {
+                    elem::invariant(c.isFloat32Array(), "Every channel of a multichannel buffer must be a Float32Array");
+                    channels.push_back(std::move(c.getFloat32Array()));
+                }
+
+                runtime->updateSharedResourceMap(name, elem::SharedResource<float>::adopt(std::move(channels)));
+            } else {
+                auto buf = b.isArray() ? arrayToFloatVector(b.getArray()) : std::move(b.getFloat32Array());
+                runtime->updateSharedResourceMap(name, elem::SharedResource<float>::adopt(std::move(buf)));
+            }
         } catch (elem::InvariantViolation const& e) {
             errorCallback(val("Invalid buffer for updating resource map"));
         }
     }
 
+    /** Removes every resource that no node is using. */
+    void pruneSharedResourceMap()
+    {
+        runtime->pruneSharedResourceMap();
+    }
+
+    val listSharedResourceMap()
+    {
+        auto result = val::array();
+
+        for (auto const& k : runtime->getSharedResourceMapKeys()) {
+            result.call<void>("push", val(k));
+        }
+
+        return result;
+    }
+
     /** Audio block processing. */
     void process (int const numSamples)
     {
@@ -144,6 +219,86 @@ public:
         sampleTime += static_cast<int64_t>(numSamples);
     }
 
+    /** Audio block processing with caller-owned buffers.
+     *
+     *  The inputs and outputs are addresses in the module's memory of planar float
+     *  data, with each channel following the last at a stride of numSamples, which the
+     *  runtime reads and writes in place. This lets a host which keeps its audio in the
+     *  module's memory, such as one sharing that memory between threads, avoid copying
+     *  audio through getInputBufferData and getOutputBufferData.
+     */
+    void processBuffers (uintptr_t inputs, uintptr_t outputs, int const numSamples)
+    {
+        auto const n = static_cast<size_t>(numSamples);
+        auto* in = reinterpret_cast<float*>(inputs);
+        auto* out = reinterpret_cast<float*>(outputs);
+
+        for (size_t i = 0; i < numInputChannels; ++i)
+            ioPointers[i] = in + i * n;
+
+        for (size_t i = 0; i < numOutputChannels; ++i)
+            ioPointers[numInputChannels + i] = out + i * n;
+
+        runtime->process(
+            const_cast<const float**>(ioPointers.data()),
+            numInputChannels,
+            ioPointers.data() + numInputChannels,
+            numOutputChannels,
+            n,
+            static_cast<void*>(&sampleTime)
+        );
+
+        sampleTime += static_cast<int64_t>(numSamples);
+    }
+
+    //==============================================================================
+    /** Binary message handling.
+     *
+     *  For hosts which pass instruction batches in the binary format of
+     *  elem::BinaryInstructionWriter, usually through a SharedArrayBuffer ring, in place
+     *  of postMessageBatch. The host copies a batch of `size` bytes into the view this
+     *  returns, then applies it with applyBinaryInstructions. The staging buffer is
+     *  reused, and only grows to fit the largest batch.
+     */
+    val getInstructionBuffer (int const size)
+    {
+        if (instructionBuffer.size() < static_cast<size_t>(size))
+            instructionBuffer.resize(static_cast<size_t>(size));
+
+        return val(typed_memory_view(static_cast<size_t>(size), instructionBuffer.data()));
+    }
+
+    void applyBinaryInstructions (int const size, val errorCallback)
+    {
+        try {
+            runtime->applyInstructions(instructionBuffer.data(), static_cast<size_t>(size));
+        } catch (elem::InvariantViolation const& e) {
+            errorCallback(val("error"), val(e.what()));
+        } catch (mpark::bad_variant_access const& e) {
+            errorCallback(val("error"), val("Bad variant access"));
+        } catch (...) {
+            errorCallback(val("error"), val("Unhandled exception"));
+        }
+    }
+
+    /** Drains the queued events in the binary format of elem::encodeEvents.
+     *
+     *  Returns a Uint8Array view onto the encoded batch, which is only valid until the
+     *  next call into the processor. An empty view means there were no events.
+     */
+    val drainEncodedEvents()
+    {
+        runtime->processQueuedEvents(eventBuffer);
+
+        if (eventBuffer.empty()) {
+            encodedEvents.clear();
+        } else {
+            elem::encodeEvents(eventBuffer, encodedEvents);
+        }
+
+        return val(typed_memory_view(encodedEvents.size(), encodedEvents.data()));
+    }
+
     /** Callback events. */
     void processQueuedEvents(val callback)
     {
@@ -156,6 +311,53 @@ public:
         callback(valueToEmVal(batch));
     }
 
+    /** Bulk event drain.
+     *
+     *  Drains the queued events into a reused typed buffer, and calls back once with
+     *  views onto it: a Float64Array of headers, with a row of seven values per
+     *  event, a Float32Array holding the sample frames of every event, and an array
+     *  of the [type, event] pairs of any events without a typed form.
+     *
+     *  Each header row holds the event type (see elem::EventType), the id of the node
+     *  which raised it, the number of frames and their size, the offset of the first
+     *  frame, and two scalar values. Events of type 0 give the index of their entry in
+     *  the array of pairs in place of the offset.
+     *
+     *  The views are only valid for the duration of the callback.
+     */
+    void drainEvents(val callback)
+    {
+        runtime->processQueuedEvents(eventBuffer);
+
+        eventHeaders.clear();
+        elem::js::Array values;
+
+        for (auto const& e : eventBuffer.getEvents()) {
+            if (e.type == elem::EventType::Value) {
+                auto [type, value] = eventBuffer.toValue(e);
+                values.push_back(elem::js::Array({type, value}));
+            }
+
+            eventHeaders.insert(eventHeaders.end(), {
+                static_cast<double>(e.type),
+                static_cast<double>(e.source),
+                static_cast<double>(e.numChannels),
+                static_cast<double>(e.frameSize),
+                static_cast<double>(e.type == elem::EventType::Value ? values.size() - 1 : e.offset),
+                e.values[0],
+                e.values[1],
+            });
+        }
+
+        auto const& frames = eventBuffer.getFramePool();
+
+        callback(
+            val(typed_memory_view(eventHeaders.size(), eventHeaders.data())),
+            val(typed_memory_view(frames.size(), frames.data())),
+            valueToEmVal(values)
+        );
+    }
+
 private:
     //==============================================================================
     std::vector<float> arrayToFloatVector (elem::js::Array const& ar)
@@ -294,6 +496,13 @@ private:
     std::vector<std::vector<float>> scratchBuffers;
     std::vector<float*> scratchPointers;
 
+    std::vector<float*> ioPointers;
+
+    elem::EventBuffer eventBuffer;
+    std::vector<double> eventHeaders;
+    std::vector<uint8_t> encodedEvents;
+    std::vector<uint8_t> instructionBuffer;
+
     int64_t sampleTime = 0;
 
     size_t numInputChannels = 0;
@@ -308,7 +517,22 @@ EMSCRIPTEN_BINDINGS(Elementary) {
         .function("getOutputBufferData", &ElementaryAudioProcessor::getOutputBufferData)
         .function("postMessageBatch", &ElementaryAudioProcessor::postMessageBatch)
         .function("reset", &ElementaryAudioProcessor::reset)
+#if defined(__EMSCRIPTEN_PTHREADS__)
+        .function("setNumRenderThreads", &ElementaryAudioProcessor::setNumRenderThreads)
+#endif
+        .function("setInternalBlockSize", &ElementaryAudioProcessor::setInternalBlockSize)
+        .function("setProfilingEnabled", &ElementaryAudioProcessor::setProfilingEnabled)
+        .function("setNumericChecksEnabled", &ElementaryAudioProcessor::setNumericChecksEnabled)
+        .function("scheduleParameterEvent", &ElementaryAudioProcessor::scheduleParameterEvent)
+        .function("getSampleTime", &ElementaryAudioProcessor::getSampleTime)
         .function("updateSharedResourceMap", &ElementaryAudioProcessor::updateSharedResourceMap)
+        .function("pruneSharedResourceMap", &ElementaryAudioProcessor::pruneSharedResourceMap)
+        .function("listSharedResourceMap", &ElementaryAudioProcessor::listSharedResourceMap)
         .function("process", &ElementaryAudioProcessor::process)
-        .function("processQueuedEvents", &ElementaryAudioProcessor::processQueuedEvents);
+        .function("processBuffers", &ElementaryAudioProcessor::processBuffers)
+        .function("getInstructionBuffer", &ElementaryAudioProcessor::getInstructionBuffer)
+        .function("applyBinaryInstructions", &ElementaryAudioProcessor::applyBinaryInstructions)
+        .function("drainEncodedEvents", &ElementaryAudioProcessor::drainEncodedEvents)
+        .function("processQueuedEvents", &ElementaryAudioProcessor::processQueuedEvents)
+        .function("drainEvents", &ElementaryAudioProcessor::drainEvents);
 };
@@ -12,6 +12,9 @@ namespace elem
         MetronomeNode(NodeId id, FloatType const sr, int const bs)
             : GraphNode<FloatType>::GraphNode(id, sr, bs)
         {
+            GraphNode<FloatType>::bindProperty("name", name);
+            GraphNode<FloatType>::enableEventNotifications();
+
             // By default the metro interval is exactly one second
             setProperty("interval", js::Value((js::Number) 1000.0));
         }
@@ -45,6 +48,7 @@ namespace elem
 
                 if (lastOut < FloatType(0.5) && nextOut >= FloatType(0.5)) {
                     eventFlag.store(true);
+                    GraphNode<FloatType>::notifyEventsPending();
                 }
 
                 outputData[i] = nextOut;
@@ -57,7 +61,7 @@ namespace elem
 
             if (flag) {
                 eventHandler("metro", js::Object({
-                    {"source", GraphNode<FloatType>::getPropertyWithDefault("name", js::Value())},
+                    {"source", name},
                 }));
             }
         }
@@ -65,6 +69,7 @@ namespace elem
         FloatType lastOut = 0;
         std::atomic<bool> eventFlag = false;
         std::atomic<int64_t> intervalSamps = 0;
+        js::Value name;
         static_assert(std::atomic<int64_t>::is_always_lock_free);
     };
 
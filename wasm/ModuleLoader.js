@@ -0,0 +1,49 @@
+// Appended by scripts/build-wasm.sh to the module variants it bundles, this defines the
+// `Module` factory that the renderers call. It returns the fastest variant the engine
+// supports: the threaded variant when asked for with `{threads: true}` and shared memory
+// is available, else the SIMD variant, else the baseline.
+var Module = (() => {
+  // A module with a single function using i8x16.popcnt, which only validates where the
+  // engine supports fixed-width SIMD
+  var simdProbe = new Uint8Array([
+    0, 97, 115, 109, 1, 0, 0, 0, 1, 5, 1, 96, 0, 1, 123, 3, 2, 1, 0, 10, 10, 1, 8, 0, 65, 0, 253, 15, 253, 98, 11,
+  ]);
+
+  var supportsSimd = () => {
+    try {
+      return typeof WebAssembly === 'object' && WebAssembly.validate(simdProbe);
+    } catch (e) {
+      return false;
+    }
+  };
+
+  // Threads need shared memory, which browsers only allow pages that are cross-origin
+  // isolated, and somewhere to run workers, which audio worklets don't have
+  var supportsThreads = () => {
+    var isNode = typeof process === 'object' && typeof process.versions === 'object' && typeof process.versions.node === 'string';
+
+    return typeof SharedArrayBuffer !== 'undefined' &&
+      (isNode || (typeof Worker !== 'undefined' && typeof crossOriginIsolated !== 'undefined' && crossOriginIsolated));
+  };
+
+  return (options) => {
+    options = options || {};
+
+    if (options.threads && typeof ElementaryWasmThreads !== 'undefined' && supportsThreads()) {
+      return ElementaryWasmThreads(options);
+    }
+
+    if (typeof ElementaryWasmSimd !== 'undefined' && supportsSimd()) {
+      return ElementaryWasmSimd(options);
+    }
+
+    return ElementaryWasmBaseline(options);
+  };
+})();
+
+if (typeof exports === 'object' && typeof module === 'object')
+  module.exports = Module;
+else if (typeof define === 'function' && define['amd'])
+  define([], function() { return Module; });
+else if (typeof exports === 'object')
+  exports["Module"] = Module;